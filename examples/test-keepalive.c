@@ -0,0 +1,96 @@
+/* GStreamer
+ * Copyright (C) 2015 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+/* Measures the rate of GET_PARAMETER and OPTIONS keepalive requests that one
+ * client handles on one core. The requests are passed to the client directly,
+ * without a connection. */
+
+#include <stdlib.h>
+
+#include <gst/gst.h>
+
+#include <gst/rtsp-server/rtsp-server.h>
+
+#define DEFAULT_REQUESTS 100000
+
+static gboolean
+count_response (GstRTSPClient * client, GstRTSPMessage * response,
+    gboolean close, gpointer user_data)
+{
+  guint *count = user_data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+int
+main (int argc, char *argv[])
+{
+  GstRTSPClient *client;
+  GstRTSPSessionPool *pool;
+  GstRTSPSession *session;
+  GstRTSPMessage request = { 0, };
+  const gchar *sessid;
+  guint count = 0;
+  gint64 start, elapsed;
+  gint i, requests;
+
+  gst_init (&argc, &argv);
+
+  requests = argc > 1 ? atoi (argv[1]) : DEFAULT_REQUESTS;
+  if (requests <= 0) {
+    g_printerr ("usage: %s [<requests>]\n", argv[0]);
+    return -1;
+  }
+
+  client = gst_rtsp_client_new ();
+  pool = gst_rtsp_session_pool_new ();
+  gst_rtsp_client_set_session_pool (client, pool);
+
+  session = gst_rtsp_session_pool_create (pool);
+  sessid = gst_rtsp_session_get_sessionid (session);
+
+  gst_rtsp_client_set_send_func (client, count_response, &count, NULL);
+
+  start = g_get_monotonic_time ();
+  for (i = 0; i < requests; i++) {
+    gst_rtsp_message_init_request (&request,
+        i % 2 ? GST_RTSP_OPTIONS : GST_RTSP_GET_PARAMETER,
+        "rtsp://localhost/test");
+    gst_rtsp_message_take_header (&request, GST_RTSP_HDR_CSEQ,
+        g_strdup_printf ("%d", i));
+    gst_rtsp_message_add_header (&request, GST_RTSP_HDR_SESSION, sessid);
+
+    gst_rtsp_client_handle_message (client, &request);
+    gst_rtsp_message_unset (&request);
+  }
+  elapsed = MAX (g_get_monotonic_time () - start, 1);
+
+  g_print ("%u responses to %d keepalive requests in %" G_GINT64_FORMAT
+      " us, %" G_GINT64_FORMAT " requests/s\n", count, requests, elapsed,
+      (gint64) requests * G_USEC_PER_SEC / elapsed);
+
+  gst_rtsp_session_pool_remove (pool, session);
+  g_object_unref (session);
+  g_object_unref (pool);
+  g_object_unref (client);
+
+  return 0;
+}
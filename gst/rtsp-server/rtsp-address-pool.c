@@ -34,6 +34,12 @@
  * #GstRTSPAddress that should be freed with gst_rtsp_address_free() after
  * usage, which brings the address back into the pool.
  *
+ * The ports of ranges with a single address are tracked in a bitmap so that
+ * they can be acquired and released quickly, even when most of the ports are
+ * in use. For the unicast ranges with a single address, the pool can also keep
+ * RTP and RTCP socket pairs bound and ready, see
+ * gst_rtsp_address_pool_set_prebound_pairs().
+ *
  * Last reviewed on 2013-07-16 (1.0.0)
  */
 
@@ -103,9 +109,14 @@ struct _GstRTSPAddressPoolPrivate
 {
   GMutex lock;                  /* protects everything in this struct */
   GList *addresses;
-  GList *allocated;
+  /* PortMap for the ranges with a single address */
+  GList *portmaps;
+  /* set of allocated AddrRange */
+  GHashTable *allocated;
 
   gboolean has_unicast_addresses;
+  /* socket pairs to keep bound for each unicast PortMap */
+  guint n_prebound;
 };
 
 #define ADDR_IS_IPV4(a)      ((a)->size == 4)
@@ -119,15 +130,47 @@ typedef struct
   guint16 port;
 } Addr;
 
+typedef struct _PortMap PortMap;
+
 typedef struct
 {
   Addr min;
   Addr max;
   guint8 ttl;
+  /* the PortMap the ports were allocated from or NULL */
+  PortMap *map;
 } AddrRange;
 
 #define RANGE_IS_SINGLE(r) (memcmp ((r)->min.bytes, (r)->max.bytes, (r)->min.size) == 0)
 
+/* a range with a single address. Its ports are tracked in a bitmap instead of
+ * splitting the range for each allocation */
+struct _PortMap
+{
+  AddrRange range;
+  guint n_ports;
+  guint n_free;
+  /* offset where the next search for free ports starts */
+  guint cursor;
+  /* a bit for each port, set when the port is in use */
+  guint64 *used;
+  /* PreboundPair that are ready to be handed out */
+  GQueue prebound;
+};
+
+typedef struct
+{
+  guint offset;
+  GSocket *rtp_socket;
+  GSocket *rtcp_socket;
+} PreboundPair;
+
+#define PORT_BIT(o)        (G_GUINT64_CONSTANT (1) << ((o) & 63))
+#define PORT_IS_USED(m,o)  (((m)->used[(o) >> 6] & PORT_BIT (o)) != 0)
+
+/* stop looking for ports to prebind after this many bind failures */
+#define MAX_PREBIND_FAILURES 20
+
 #define gst_rtsp_address_pool_parent_class parent_class
 G_DEFINE_TYPE (GstRTSPAddressPool, gst_rtsp_address_pool, G_TYPE_OBJECT);
 
@@ -154,6 +197,7 @@ gst_rtsp_address_pool_init (GstRTSPAddressPool * pool)
   pool->priv = GST_RTSP_ADDRESS_POOL_GET_PRIVATE (pool);
 
   g_mutex_init (&pool->priv->lock);
+  pool->priv->allocated = g_hash_table_new (NULL, NULL);
 }
 
 static void
@@ -162,6 +206,125 @@ free_range (AddrRange * range)
   g_slice_free (AddrRange, range);
 }
 
+static PortMap *
+port_map_new (AddrRange * range)
+{
+  PortMap *map;
+  guint i, n_words;
+
+  map = g_slice_new0 (PortMap);
+  map->range = *range;
+  map->n_ports = range->max.port - range->min.port + 1;
+  map->n_free = map->n_ports;
+  n_words = (map->n_ports + 63) / 64;
+  map->used = g_new0 (guint64, n_words);
+  /* the bits after the last port are never free */
+  for (i = map->n_ports; i < n_words * 64; i++)
+    map->used[i >> 6] |= PORT_BIT (i);
+  g_queue_init (&map->prebound);
+
+  return map;
+}
+
+static void
+port_map_mark (PortMap * map, guint offset, guint n_ports, gboolean used)
+{
+  guint i;
+
+  for (i = offset; i < offset + n_ports; i++) {
+    if (used)
+      map->used[i >> 6] |= PORT_BIT (i);
+    else
+      map->used[i >> 6] &= ~PORT_BIT (i);
+  }
+  if (used)
+    map->n_free -= n_ports;
+  else
+    map->n_free += n_ports;
+}
+
+static gboolean
+port_map_is_free (PortMap * map, guint offset, guint n_ports)
+{
+  guint i;
+
+  for (i = offset; i < offset + n_ports; i++) {
+    if (PORT_IS_USED (map, i))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+/* find and mark @n_ports free consecutive ports. The search continues where
+ * the previous one stopped and skips a word of 64 used ports at a time, so
+ * that the ports that were just handed out are not looked at again. The last
+ * word can be shorter, the search then wraps to the start of the range.
+ * Returns the offset of the first port or -1 */
+static gint
+port_map_acquire (PortMap * map, guint n_ports, gboolean even)
+{
+  guint i, offset, parity;
+
+  if (map->n_free < n_ports)
+    return -1;
+
+  /* the ports at offsets with this parity are even */
+  parity = map->range.min.port & 1;
+
+  for (i = 0; i < map->n_ports;) {
+    offset = (map->cursor + i) % map->n_ports;
+
+    if ((offset & 63) == 0 && map->used[offset >> 6] == G_MAXUINT64) {
+      i += MIN (64, map->n_ports - offset);
+      continue;
+    }
+    if ((even && (offset & 1) != parity) || offset + n_ports > map->n_ports ||
+        !port_map_is_free (map, offset, n_ports)) {
+      i++;
+      continue;
+    }
+    port_map_mark (map, offset, n_ports, TRUE);
+    map->cursor = (offset + n_ports) % map->n_ports;
+
+    return offset;
+  }
+  return -1;
+}
+
+/* make the range for the ports at @offset of @map */
+static AddrRange *
+port_map_range (PortMap * map, guint offset, guint n_ports)
+{
+  AddrRange *range;
+
+  range = g_slice_dup (AddrRange, &map->range);
+  range->min.port += offset;
+  range->max.port = range->min.port + n_ports - 1;
+  range->map = map;
+
+  return range;
+}
+
+static void
+free_prebound (PortMap * map, PreboundPair * pair)
+{
+  g_object_unref (pair->rtp_socket);
+  g_object_unref (pair->rtcp_socket);
+  port_map_mark (map, pair->offset, 2, FALSE);
+  g_slice_free (PreboundPair, pair);
+}
+
+static void
+port_map_free (PortMap * map)
+{
+  PreboundPair *pair;
+
+  while ((pair = g_queue_pop_head (&map->prebound)))
+    free_prebound (map, pair);
+  g_free (map->used);
+  g_slice_free (PortMap, map);
+}
+
 static void
 gst_rtsp_address_pool_finalize (GObject * obj)
 {
@@ -170,7 +333,9 @@ gst_rtsp_address_pool_finalize (GObject * obj)
   pool = GST_RTSP_ADDRESS_POOL (obj);
 
   g_list_free_full (pool->priv->addresses, (GDestroyNotify) free_range);
-  g_list_free_full (pool->priv->allocated, (GDestroyNotify) free_range);
+  g_list_free_full (pool->priv->portmaps, (GDestroyNotify) port_map_free);
+  /* every allocation holds a ref on the pool, there are none left */
+  g_hash_table_unref (pool->priv->allocated);
   g_mutex_clear (&pool->priv->lock);
 
   G_OBJECT_CLASS (parent_class)->finalize (obj);
@@ -206,13 +371,15 @@ gst_rtsp_address_pool_clear (GstRTSPAddressPool * pool)
   GstRTSPAddressPoolPrivate *priv;
 
   g_return_if_fail (GST_IS_RTSP_ADDRESS_POOL (pool));
-  g_return_if_fail (pool->priv->allocated == NULL);
+  g_return_if_fail (g_hash_table_size (pool->priv->allocated) == 0);
 
   priv = pool->priv;
 
   g_mutex_lock (&priv->lock);
   g_list_free_full (priv->addresses, (GDestroyNotify) free_range);
   priv->addresses = NULL;
+  g_list_free_full (priv->portmaps, (GDestroyNotify) port_map_free);
+  priv->portmaps = NULL;
   g_mutex_unlock (&priv->lock);
 }
 
@@ -253,6 +420,102 @@ get_address_string (Addr * addr)
   return res;
 }
 
+static GSocket *
+bind_port (GInetAddress * inet, guint16 port)
+{
+  GSocket *socket;
+  GSocketAddress *sockaddr;
+  gboolean res;
+
+  socket = g_socket_new (g_inet_address_get_family (inet),
+      G_SOCKET_TYPE_DATAGRAM, G_SOCKET_PROTOCOL_UDP, NULL);
+  if (socket == NULL)
+    return NULL;
+
+  sockaddr = g_inet_socket_address_new (inet, port);
+  res = g_socket_bind (socket, sockaddr, FALSE, NULL);
+  g_object_unref (sockaddr);
+
+  if (!res) {
+    g_object_unref (socket);
+    return NULL;
+  }
+  return socket;
+}
+
+/* bind the RTP and RTCP socket for the ports at @offset of @map */
+static PreboundPair *
+make_prebound (PortMap * map, guint offset)
+{
+  PreboundPair *pair;
+  GInetAddress *inet;
+  guint16 port;
+
+  inet = g_inet_address_new_from_bytes (map->range.min.bytes,
+      ADDR_IS_IPV4 (&map->range.min) ? G_SOCKET_FAMILY_IPV4 :
+      G_SOCKET_FAMILY_IPV6);
+  port = map->range.min.port + offset;
+
+  pair = g_slice_new0 (PreboundPair);
+  pair->offset = offset;
+  pair->rtp_socket = bind_port (inet, port);
+  if (pair->rtp_socket)
+    pair->rtcp_socket = bind_port (inet, port + 1);
+  g_object_unref (inet);
+
+  if (pair->rtcp_socket == NULL) {
+    if (pair->rtp_socket)
+      g_object_unref (pair->rtp_socket);
+    g_slice_free (PreboundPair, pair);
+    return NULL;
+  }
+  return pair;
+}
+
+/* bind socket pairs until @map has the configured amount of them. Must be
+ * called with the lock */
+static void
+prebind (GstRTSPAddressPool * pool, PortMap * map)
+{
+  GstRTSPAddressPoolPrivate *priv = pool->priv;
+  PreboundPair *pair;
+  GList *rejected = NULL, *walk;
+  guint failed = 0;
+
+  if (map->range.ttl != 0)
+    return;
+
+  while (g_queue_get_length (&map->prebound) > priv->n_prebound) {
+    pair = g_queue_pop_tail (&map->prebound);
+    free_prebound (map, pair);
+  }
+
+  while (g_queue_get_length (&map->prebound) < priv->n_prebound) {
+    gint offset;
+
+    offset = port_map_acquire (map, 2, TRUE);
+    if (offset < 0)
+      break;
+
+    pair = make_prebound (map, offset);
+    if (pair == NULL) {
+      /* used by someone else, keep it until we are done looking */
+      rejected = g_list_prepend (rejected, GINT_TO_POINTER (offset));
+      if (++failed > MAX_PREBIND_FAILURES)
+        break;
+      continue;
+    }
+    g_queue_push_tail (&map->prebound, pair);
+  }
+  for (walk = rejected; walk; walk = walk->next)
+    port_map_mark (map, GPOINTER_TO_INT (walk->data), 2, FALSE);
+  g_list_free (rejected);
+
+  if (g_queue_get_length (&map->prebound) < priv->n_prebound)
+    GST_WARNING_OBJECT (pool, "could only prebind %u of %u socket pairs",
+        g_queue_get_length (&map->prebound), priv->n_prebound);
+}
+
 /**
  * gst_rtsp_address_pool_add_range:
  * @pool: a #GstRTSPAddressPool
@@ -309,7 +572,15 @@ gst_rtsp_address_pool_add_range (GstRTSPAddressPool * pool,
       min_port, max_port, ttl);
 
   g_mutex_lock (&priv->lock);
-  priv->addresses = g_list_prepend (priv->addresses, range);
+  if (RANGE_IS_SINGLE (range)) {
+    PortMap *map = port_map_new (range);
+
+    g_slice_free (AddrRange, range);
+    priv->portmaps = g_list_prepend (priv->portmaps, map);
+    prebind (pool, map);
+  } else {
+    priv->addresses = g_list_prepend (priv->addresses, range);
+  }
 
   if (!is_multicast)
     priv->has_unicast_addresses = TRUE;
@@ -413,6 +684,38 @@ split_range (GstRTSPAddressPool * pool, AddrRange * range, guint skip_addr,
   return range;
 }
 
+static gboolean
+range_has_flags (AddrRange * range, GstRTSPAddressFlags flags)
+{
+  /* check address type when given */
+  if (flags & GST_RTSP_ADDRESS_FLAG_IPV4 && !ADDR_IS_IPV4 (&range->min))
+    return FALSE;
+  if (flags & GST_RTSP_ADDRESS_FLAG_IPV6 && !ADDR_IS_IPV6 (&range->min))
+    return FALSE;
+  if (flags & GST_RTSP_ADDRESS_FLAG_MULTICAST && range->ttl == 0)
+    return FALSE;
+  if (flags & GST_RTSP_ADDRESS_FLAG_UNICAST && range->ttl != 0)
+    return FALSE;
+
+  return TRUE;
+}
+
+static GstRTSPAddress *
+make_address (GstRTSPAddressPool * pool, AddrRange * range, gint n_ports)
+{
+  GstRTSPAddress *addr;
+
+  addr = g_slice_new0 (GstRTSPAddress);
+  addr->pool = g_object_ref (pool);
+  addr->address = get_address_string (&range->min);
+  addr->n_ports = n_ports;
+  addr->port = range->min.port;
+  addr->ttl = range->ttl;
+  addr->priv = range;
+
+  return addr;
+}
+
 /**
  * gst_rtsp_address_pool_acquire_address:
  * @pool: a #GstRTSPAddressPool
@@ -444,22 +747,32 @@ gst_rtsp_address_pool_acquire_address (GstRTSPAddressPool * pool,
   addr = NULL;
 
   g_mutex_lock (&priv->lock);
+  /* first the ranges with a single address */
+  for (walk = priv->portmaps; walk; walk = walk->next) {
+    PortMap *map = walk->data;
+    gint offset;
+
+    if (!range_has_flags (&map->range, flags))
+      continue;
+
+    offset = port_map_acquire (map, n_ports,
+        (flags & GST_RTSP_ADDRESS_FLAG_EVEN_PORT) != 0);
+    if (offset < 0)
+      continue;
+
+    result = port_map_range (map, offset, n_ports);
+    break;
+  }
+
   /* go over available ranges */
-  for (walk = priv->addresses; walk; walk = next) {
+  for (walk = priv->addresses; walk && result == NULL; walk = next) {
     AddrRange *range;
     gint ports, skip;
 
     range = walk->data;
     next = walk->next;
 
-    /* check address type when given */
-    if (flags & GST_RTSP_ADDRESS_FLAG_IPV4 && !ADDR_IS_IPV4 (&range->min))
-      continue;
-    if (flags & GST_RTSP_ADDRESS_FLAG_IPV6 && !ADDR_IS_IPV6 (&range->min))
-      continue;
-    if (flags & GST_RTSP_ADDRESS_FLAG_MULTICAST && range->ttl == 0)
-      continue;
-    if (flags & GST_RTSP_ADDRESS_FLAG_UNICAST && range->ttl != 0)
+    if (!range_has_flags (range, flags))
       continue;
 
     /* check for enough ports */
@@ -476,19 +789,14 @@ gst_rtsp_address_pool_acquire_address (GstRTSPAddressPool * pool,
     priv->addresses = g_list_delete_link (priv->addresses, walk);
     /* now split and exit our loop */
     result = split_range (pool, range, 0, skip, n_ports);
-    priv->allocated = g_list_prepend (priv->allocated, result);
     break;
   }
+  if (result)
+    g_hash_table_add (priv->allocated, result);
   g_mutex_unlock (&priv->lock);
 
   if (result) {
-    addr = g_slice_new0 (GstRTSPAddress);
-    addr->pool = g_object_ref (pool);
-    addr->address = get_address_string (&result->min);
-    addr->n_ports = n_ports;
-    addr->port = result->min.port;
-    addr->ttl = result->ttl;
-    addr->priv = result;
+    addr = make_address (pool, result, n_ports);
 
     GST_DEBUG_OBJECT (pool, "got address %s:%u ttl %u", addr->address,
         addr->port, addr->ttl);
@@ -510,7 +818,6 @@ gst_rtsp_address_pool_release_address (GstRTSPAddressPool * pool,
     GstRTSPAddress * addr)
 {
   GstRTSPAddressPoolPrivate *priv;
-  GList *find;
   AddrRange *range;
 
   g_return_if_fail (GST_IS_RTSP_ADDRESS_POOL (pool));
@@ -525,14 +832,21 @@ gst_rtsp_address_pool_release_address (GstRTSPAddressPool * pool,
   addr->pool = NULL;
 
   g_mutex_lock (&priv->lock);
-  find = g_list_find (priv->allocated, range);
-  if (find == NULL)
+  if (!g_hash_table_remove (priv->allocated, range))
     goto not_found;
 
-  priv->allocated = g_list_delete_link (priv->allocated, find);
+  if (range->map) {
+    PortMap *map = range->map;
 
-  /* FIXME, merge and do something clever */
-  priv->addresses = g_list_prepend (priv->addresses, range);
+    port_map_mark (map, range->min.port - map->range.min.port,
+        range->max.port - range->min.port + 1, FALSE);
+    free_range (range);
+    /* bind new pairs now, while no client is waiting for them */
+    prebind (pool, map);
+  } else {
+    /* FIXME, merge and do something clever */
+    priv->addresses = g_list_prepend (priv->addresses, range);
+  }
   g_mutex_unlock (&priv->lock);
 
   g_object_unref (pool);
@@ -561,6 +875,24 @@ dump_range (AddrRange * range, GstRTSPAddressPool * pool)
   g_free (addr2);
 }
 
+static void
+dump_port_map (PortMap * map, GstRTSPAddressPool * pool)
+{
+  gchar *addr;
+
+  addr = get_address_string (&map->range.min);
+  g_print ("  address %s, port %u-%u, ttl %u, %u ports free, %u prebound\n",
+      addr, map->range.min.port, map->range.max.port, map->range.ttl,
+      map->n_free, g_queue_get_length (&map->prebound));
+  g_free (addr);
+}
+
+static void
+dump_allocated (AddrRange * range, gpointer unused, GstRTSPAddressPool * pool)
+{
+  dump_range (range, pool);
+}
+
 /**
  * gst_rtsp_address_pool_dump:
  * @pool: a #GstRTSPAddressPool
@@ -579,11 +911,35 @@ gst_rtsp_address_pool_dump (GstRTSPAddressPool * pool)
   g_mutex_lock (&priv->lock);
   g_print ("free:\n");
   g_list_foreach (priv->addresses, (GFunc) dump_range, pool);
+  g_list_foreach (priv->portmaps, (GFunc) dump_port_map, pool);
   g_print ("allocated:\n");
-  g_list_foreach (priv->allocated, (GFunc) dump_range, pool);
+  g_hash_table_foreach (priv->allocated, (GHFunc) dump_allocated, pool);
   g_mutex_unlock (&priv->lock);
 }
 
+static gboolean
+range_contains (AddrRange * range, Addr * addr, guint port, guint n_ports,
+    guint ttl)
+{
+  /* Not the right type of address */
+  if (range->min.size != addr->size)
+    return FALSE;
+
+  /* Check that the address is in the interval */
+  if (memcmp (range->min.bytes, addr->bytes, addr->size) > 0 ||
+      memcmp (range->max.bytes, addr->bytes, addr->size) < 0)
+    return FALSE;
+
+  /* Make sure the requested ports are inside the range */
+  if (port < range->min.port || port + n_ports - 1 > range->max.port)
+    return FALSE;
+
+  if (ttl != range->ttl)
+    return FALSE;
+
+  return TRUE;
+}
+
 static GList *
 find_address_in_ranges (GList * addresses, Addr * addr, guint port,
     guint n_ports, guint ttl)
@@ -597,26 +953,26 @@ find_address_in_ranges (GList * addresses, Addr * addr, guint port,
     range = walk->data;
     next = walk->next;
 
-    /* Not the right type of address */
-    if (range->min.size != addr->size)
-      continue;
+    if (range_contains (range, addr, port, n_ports, ttl))
+      break;
+  }
 
-    /* Check that the address is in the interval */
-    if (memcmp (range->min.bytes, addr->bytes, addr->size) > 0 ||
-        memcmp (range->max.bytes, addr->bytes, addr->size) < 0)
-      continue;
+  return walk;
+}
 
-    /* Make sure the requested ports are inside the range */
-    if (port < range->min.port || port + n_ports - 1 > range->max.port)
-      continue;
+static PortMap *
+find_address_in_port_maps (GList * portmaps, Addr * addr, guint port,
+    guint n_ports, guint ttl)
+{
+  GList *walk;
 
-    if (ttl != range->ttl)
-      continue;
+  for (walk = portmaps; walk; walk = walk->next) {
+    PortMap *map = walk->data;
 
-    break;
+    if (range_contains (&map->range, addr, port, n_ports, ttl))
+      return map;
   }
-
-  return walk;
+  return NULL;
 }
 
 /**
@@ -647,9 +1003,10 @@ gst_rtsp_address_pool_reserve_address (GstRTSPAddressPool * pool,
   GstRTSPAddressPoolPrivate *priv;
   Addr input_addr;
   GList *list;
+  PortMap *map;
   AddrRange *addr_range;
   GstRTSPAddress *addr;
-  gboolean is_multicast;
+  gboolean is_multicast, in_use;
   GstRTSPAddressPoolResult result;
 
   g_return_val_if_fail (GST_IS_RTSP_ADDRESS_POOL (pool),
@@ -662,14 +1019,30 @@ gst_rtsp_address_pool_reserve_address (GstRTSPAddressPool * pool,
   priv = pool->priv;
   addr_range = NULL;
   addr = NULL;
+  in_use = FALSE;
   is_multicast = ttl != 0;
 
   if (!fill_address (ip_address, port, &input_addr, is_multicast))
     goto invalid;
 
   g_mutex_lock (&priv->lock);
-  list = find_address_in_ranges (priv->addresses, &input_addr, port, n_ports,
+  map = find_address_in_port_maps (priv->portmaps, &input_addr, port, n_ports,
       ttl);
+  if (map != NULL) {
+    guint offset = port - map->range.min.port;
+
+    if (port_map_is_free (map, offset, n_ports)) {
+      port_map_mark (map, offset, n_ports, TRUE);
+      addr_range = port_map_range (map, offset, n_ports);
+    } else {
+      in_use = TRUE;
+    }
+  }
+
+  list = NULL;
+  if (addr_range == NULL && !in_use)
+    list = find_address_in_ranges (priv->addresses, &input_addr, port, n_ports,
+        ttl);
   if (list != NULL) {
     AddrRange *range = list->data;
     guint skip_port, skip_addr;
@@ -683,17 +1056,11 @@ gst_rtsp_address_pool_reserve_address (GstRTSPAddressPool * pool,
     priv->addresses = g_list_delete_link (priv->addresses, list);
     /* now split and exit our loop */
     addr_range = split_range (pool, range, skip_addr, skip_port, n_ports);
-    priv->allocated = g_list_prepend (priv->allocated, addr_range);
   }
 
   if (addr_range) {
-    addr = g_slice_new0 (GstRTSPAddress);
-    addr->pool = g_object_ref (pool);
-    addr->address = get_address_string (&addr_range->min);
-    addr->n_ports = n_ports;
-    addr->port = addr_range->min.port;
-    addr->ttl = addr_range->ttl;
-    addr->priv = addr_range;
+    g_hash_table_add (priv->allocated, addr_range);
+    addr = make_address (pool, addr_range, n_ports);
 
     result = GST_RTSP_ADDRESS_POOL_OK;
     GST_DEBUG_OBJECT (pool, "reserved address %s:%u ttl %u", addr->address,
@@ -701,9 +1068,14 @@ gst_rtsp_address_pool_reserve_address (GstRTSPAddressPool * pool,
   } else {
     /* We failed to reserve the address. Check if it was because the address
      * was already in use or if it wasn't in the pool to begin with */
-    list = find_address_in_ranges (priv->allocated, &input_addr, port, n_ports,
-        ttl);
-    if (list != NULL) {
+    if (!in_use) {
+      GList *allocated = g_hash_table_get_keys (priv->allocated);
+
+      in_use = find_address_in_ranges (allocated, &input_addr, port, n_ports,
+          ttl) != NULL;
+      g_list_free (allocated);
+    }
+    if (in_use) {
       result = GST_RTSP_ADDRESS_POOL_ERESERVED;
     } else {
       result = GST_RTSP_ADDRESS_POOL_ERANGE;
@@ -749,3 +1121,131 @@ gst_rtsp_address_pool_has_unicast_addresses (GstRTSPAddressPool * pool)
 
   return has_unicast_addresses;
 }
+
+/**
+ * gst_rtsp_address_pool_set_prebound_pairs:
+ * @pool: a #GstRTSPAddressPool
+ * @n_pairs: the amount of socket pairs
+ *
+ * Keep @n_pairs RTP and RTCP socket pairs bound to an even and the next port
+ * for each unicast range of @pool with a single address. The pairs can be
+ * taken with gst_rtsp_address_pool_acquire_sockets() without binding sockets
+ * while a client waits. The pairs are bound again when addresses are
+ * released.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_address_pool_set_prebound_pairs (GstRTSPAddressPool * pool,
+    guint n_pairs)
+{
+  GstRTSPAddressPoolPrivate *priv;
+  GList *walk;
+
+  g_return_if_fail (GST_IS_RTSP_ADDRESS_POOL (pool));
+
+  priv = pool->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->n_prebound = n_pairs;
+  for (walk = priv->portmaps; walk; walk = walk->next)
+    prebind (pool, walk->data);
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_address_pool_get_prebound_pairs:
+ * @pool: a #GstRTSPAddressPool
+ *
+ * Get the amount of socket pairs that @pool keeps bound for each unicast range
+ * with a single address.
+ *
+ * Returns: the amount of socket pairs.
+ *
+ * Since: 1.6
+ */
+guint
+gst_rtsp_address_pool_get_prebound_pairs (GstRTSPAddressPool * pool)
+{
+  GstRTSPAddressPoolPrivate *priv;
+  guint n_pairs;
+
+  g_return_val_if_fail (GST_IS_RTSP_ADDRESS_POOL (pool), 0);
+
+  priv = pool->priv;
+
+  g_mutex_lock (&priv->lock);
+  n_pairs = priv->n_prebound;
+  g_mutex_unlock (&priv->lock);
+
+  return n_pairs;
+}
+
+/**
+ * gst_rtsp_address_pool_acquire_sockets:
+ * @pool: a #GstRTSPAddressPool
+ * @flags: flags
+ * @rtp_socket: (out) (transfer full): the socket bound to the RTP port
+ * @rtcp_socket: (out) (transfer full): the socket bound to the RTCP port
+ *
+ * Take a unicast address with an even RTP port and the next RTCP port from
+ * @pool together with the sockets that are already bound to them. @flags can
+ * be used to select the address family.
+ *
+ * This only returns a result when @pool has socket pairs ready, see
+ * gst_rtsp_address_pool_set_prebound_pairs().
+ *
+ * Returns: (nullable): a #GstRTSPAddress that should be freed with
+ * gst_rtsp_address_free after use or %NULL when no socket pair was ready.
+ *
+ * Since: 1.6
+ */
+GstRTSPAddress *
+gst_rtsp_address_pool_acquire_sockets (GstRTSPAddressPool * pool,
+    GstRTSPAddressFlags flags, GSocket ** rtp_socket, GSocket ** rtcp_socket)
+{
+  GstRTSPAddressPoolPrivate *priv;
+  GList *walk;
+  AddrRange *result;
+  GstRTSPAddress *addr;
+
+  g_return_val_if_fail (GST_IS_RTSP_ADDRESS_POOL (pool), NULL);
+  g_return_val_if_fail (rtp_socket != NULL, NULL);
+  g_return_val_if_fail (rtcp_socket != NULL, NULL);
+
+  priv = pool->priv;
+  result = NULL;
+  addr = NULL;
+
+  g_mutex_lock (&priv->lock);
+  for (walk = priv->portmaps; walk; walk = walk->next) {
+    PortMap *map = walk->data;
+    PreboundPair *pair;
+
+    if (map->range.ttl != 0 || !range_has_flags (&map->range, flags))
+      continue;
+
+    pair = g_queue_pop_head (&map->prebound);
+    if (pair == NULL)
+      continue;
+
+    /* the ports stay marked as used */
+    result = port_map_range (map, pair->offset, 2);
+    *rtp_socket = pair->rtp_socket;
+    *rtcp_socket = pair->rtcp_socket;
+    g_slice_free (PreboundPair, pair);
+
+    g_hash_table_add (priv->allocated, result);
+    break;
+  }
+  g_mutex_unlock (&priv->lock);
+
+  if (result) {
+    addr = make_address (pool, result, 2);
+
+    GST_DEBUG_OBJECT (pool, "got prebound address %s:%u", addr->address,
+        addr->port);
+  }
+
+  return addr;
+}
@@ -18,6 +18,7 @@
  */
 
 #include <gst/gst.h>
+#include <gio/gio.h>
 
 #ifndef __GST_RTSP_ADDRESS_POOL_H__
 #define __GST_RTSP_ADDRESS_POOL_H__
@@ -177,6 +178,15 @@ GstRTSPAddressPoolResult  gst_rtsp_address_pool_reserve_address (GstRTSPAddressP
 
 gboolean               gst_rtsp_address_pool_has_unicast_addresses (GstRTSPAddressPool * pool);
 
+void                   gst_rtsp_address_pool_set_prebound_pairs (GstRTSPAddressPool * pool,
+                                                              guint n_pairs);
+guint                  gst_rtsp_address_pool_get_prebound_pairs (GstRTSPAddressPool * pool);
+
+GstRTSPAddress *       gst_rtsp_address_pool_acquire_sockets (GstRTSPAddressPool * pool,
+                                                              GstRTSPAddressFlags flags,
+                                                              GSocket ** rtp_socket,
+                                                              GSocket ** rtcp_socket);
+
 G_END_DECLS
 
 #endif /* __GST_RTSP_ADDRESS_POOL_H__ */
@@ -49,6 +49,7 @@
 #include <string.h>
 
 #include "rtsp-auth.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_AUTH_GET_PRIVATE(obj)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_AUTH, GstRTSPAuthPrivate))
@@ -779,6 +780,25 @@ no_context:
   }
 }
 
+/* get the methods for which a GST_RTSP_AUTH_CHECK_URL check of @auth always
+ * succeeds without looking at the request. Subclasses that override the check
+ * can decide on anything, for them no method is returned. */
+GstRTSPMethod
+gst_rtsp_auth_get_unchecked_methods (GstRTSPAuth * auth)
+{
+  GstRTSPAuthPrivate *priv = auth->priv;
+  GstRTSPMethod result;
+
+  if (GST_RTSP_AUTH_GET_CLASS (auth)->check != default_check)
+    return GST_RTSP_INVALID;
+
+  g_mutex_lock (&priv->lock);
+  result = (GstRTSPMethod) ~priv->methods;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
 /**
  * gst_rtsp_auth_make_basic:
  * @user: a userid
@@ -45,10 +45,13 @@
 #include <string.h>
 
 #include <gst/sdp/gstmikey.h>
+#include <gst/rtp/gstrtpbuffer.h>
 
 #include "rtsp-client.h"
 #include "rtsp-sdp.h"
 #include "rtsp-params.h"
+#include "rtsp-server-internal.h"
+#include "rtsp-metrics.h"
 
 #define GST_RTSP_CLIENT_GET_PRIVATE(obj)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_CLIENT, GstRTSPClientPrivate))
@@ -77,18 +80,62 @@ struct _GstRTSPClientPrivate
   gulong session_removed_id;
   GstRTSPMountPoints *mount_points;
   GstRTSPAuth *auth;
+  /* methods that pass the url check of auth without checking */
+  GstRTSPMethod unchecked_methods;
   GstRTSPThreadPool *thread_pool;
 
+  /* the url of the last request, parsed and sanitized. Keepalive requests
+   * usually repeat the same url. Only used from the client thread. */
+  gchar *uri_str;
+  GstRTSPUrl *uri;
+
   /* used to cache the media in the last requested DESCRIBE so that
    * we can pick it up in the next SETUP immediately */
   gchar *path;
   GstRTSPMedia *media;
+  /* the cached media is still prerolling */
+  gboolean media_preparing;
+
+  /* a request waiting for its media to preroll and the requests that arrived
+   * after it. Only used from the client thread. */
+  gboolean suspend;
+  GstRTSPMessage *suspended;
+  GQueue pending_requests;
+  /* the suspended request is being handled again, the checks done before
+   * it was suspended are skipped */
+  gboolean resuming;
+  guint suspend_seq;
+  GSource *suspend_timeout;
+  /* when the suspended request was received and when the request that is
+   * resumed now was received */
+  gint64 suspended_start;
+  gint64 resumed_start;
+  /* request latency histograms of the server */
+  GstRTSPRequestMetrics *request_metrics;
+  /* counters of the server for the packets that were copied for us */
+  GstRTSPCopyMetrics *copy_metrics;
+  /* the trace of the suspended request and its "suspended" span */
+  GArray *suspended_trace;
+  guint suspended_span;
 
   GHashTable *transports;
   GList *sessions;
   guint sessions_cookie;
 
   gboolean drop_backlog;
+
+  /* packets waiting for room in the watch backlog, protected by send_lock */
+  GQueue send_queue;
+  guint send_queue_bytes;
+  guint send_queue_max_bytes;
+  GstClockTime send_queue_max_time;
+  /* retries the flush of the send queue when the send_lock was busy after a
+   * message was sent. Only used from the client thread. */
+  GSource *send_queue_retry;
+  /* channels that drop packets until the next complete keyframe and the
+   * RTP timestamp of the frame that was damaged on them */
+  guint8 resync[32];
+  guint32 resync_rtptime[256];
 };
 
 static GMutex tunnels_lock;
@@ -101,6 +148,16 @@ static GHashTable *tunnels;     /* protected by tunnels_lock */
 #define DEFAULT_SESSION_POOL            NULL
 #define DEFAULT_MOUNT_POINTS            NULL
 #define DEFAULT_DROP_BACKLOG            TRUE
+#define DEFAULT_SEND_QUEUE_MAX_BYTES    0
+#define DEFAULT_SEND_QUEUE_MAX_TIME     0
+
+/* how long a request waits for its media to preroll, in seconds */
+#define PREPARE_TIMEOUT                 20
+/* how many requests can wait behind a suspended request */
+#define MAX_PENDING_REQUESTS            16
+/* how long to wait before flushing the send queue again when the send_lock
+ * was busy, in milliseconds */
+#define SEND_QUEUE_RETRY_INTERVAL       10
 
 enum
 {
@@ -108,6 +165,8 @@ enum
   PROP_SESSION_POOL,
   PROP_MOUNT_POINTS,
   PROP_DROP_BACKLOG,
+  PROP_SEND_QUEUE_MAX_BYTES,
+  PROP_SEND_QUEUE_MAX_TIME,
   PROP_LAST
 };
 
@@ -128,6 +187,7 @@ enum
   SIGNAL_ANNOUNCE_REQUEST,
   SIGNAL_RECORD_REQUEST,
   SIGNAL_CHECK_REQUIREMENTS,
+  SIGNAL_REQUEST_TRACED,
   SIGNAL_LAST
 };
 
@@ -157,6 +217,7 @@ static gchar *default_make_path_from_uri (GstRTSPClient * client,
     const GstRTSPUrl * uri);
 static void client_session_removed (GstRTSPSessionPool * pool,
     GstRTSPSession * session, GstRTSPClient * client);
+static void send_queue_clear (GstRTSPClient * client);
 
 G_DEFINE_TYPE (GstRTSPClient, gst_rtsp_client, G_TYPE_OBJECT);
 
@@ -198,6 +259,41 @@ gst_rtsp_client_class_init (GstRTSPClientClass * klass)
           "Drop data when the backlog queue is full",
           DEFAULT_DROP_BACKLOG, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTSPClient:send-queue-max-bytes:
+   *
+   * The maximum amount of interleaved data in bytes to queue when the
+   * connection can't keep up. When the limit is reached, delta units are
+   * dropped first and the affected stream is resynced at the next complete
+   * keyframe.
+   * RTCP and codec headers are never dropped. 0 disables the limit.
+   *
+   * The queue is only used when this property or
+   * #GstRTSPClient:send-queue-max-time is not 0.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_SEND_QUEUE_MAX_BYTES,
+      g_param_spec_uint ("send-queue-max-bytes", "Send Queue Max Bytes",
+          "Maximum amount of data to queue for a slow client (0 = disabled)",
+          0, G_MAXUINT, DEFAULT_SEND_QUEUE_MAX_BYTES,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  /**
+   * GstRTSPClient:send-queue-max-time:
+   *
+   * The maximum duration of interleaved data in nanoseconds to queue when
+   * the connection can't keep up, measured between the timestamps of the
+   * oldest and the newest queued packet. 0 disables the limit.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_SEND_QUEUE_MAX_TIME,
+      g_param_spec_uint64 ("send-queue-max-time", "Send Queue Max Time",
+          "Maximum duration of data to queue for a slow client in ns "
+          "(0 = disabled)", 0, G_MAXUINT64, DEFAULT_SEND_QUEUE_MAX_TIME,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_rtsp_client_signals[SIGNAL_CLOSED] =
       g_signal_new ("closed", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
       G_STRUCT_OFFSET (GstRTSPClientClass, closed), NULL, NULL,
@@ -304,6 +400,25 @@ gst_rtsp_client_class_init (GstRTSPClientClass * klass)
           check_requirements), NULL, NULL, g_cclosure_marshal_generic,
       G_TYPE_STRING, 2, GST_TYPE_RTSP_CONTEXT, G_TYPE_STRV);
 
+  /**
+   * GstRTSPClient::request-traced:
+   * @client: a #GstRTSPClient
+   * @ctx: a #GstRTSPContext
+   *
+   * Emitted after a request was handled with the time spent in each stage of
+   * the request in the trace field of @ctx. The first span covers the
+   * complete request, including the time it was suspended while the media
+   * prerolled.
+   *
+   * Requests are only traced while a handler is connected to this signal.
+   *
+   * Since: 1.6
+   */
+  gst_rtsp_client_signals[SIGNAL_REQUEST_TRACED] =
+      g_signal_new ("request-traced", G_TYPE_FROM_CLASS (klass),
+      G_SIGNAL_RUN_LAST, 0, NULL, NULL, g_cclosure_marshal_generic,
+      G_TYPE_NONE, 1, GST_TYPE_RTSP_CONTEXT);
+
   tunnels =
       g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
   g_mutex_init (&tunnels_lock);
@@ -323,6 +438,12 @@ gst_rtsp_client_init (GstRTSPClient * client)
   g_mutex_init (&priv->watch_lock);
   priv->close_seq = 0;
   priv->drop_backlog = DEFAULT_DROP_BACKLOG;
+  g_queue_init (&priv->send_queue);
+  g_queue_init (&priv->pending_requests);
+  priv->send_queue_max_bytes = DEFAULT_SEND_QUEUE_MAX_BYTES;
+  priv->send_queue_max_time = DEFAULT_SEND_QUEUE_MAX_TIME;
+  /* without auth, all url checks pass */
+  priv->unchecked_methods = (GstRTSPMethod) ~0;
   priv->transports =
       g_hash_table_new_full (g_direct_hash, g_direct_equal, NULL,
       g_object_unref);
@@ -417,6 +538,43 @@ clean_cached_media (GstRTSPClient * client, gboolean unprepare)
     g_object_unref (priv->media);
     priv->media = NULL;
   }
+  priv->media_preparing = FALSE;
+}
+
+static void
+clear_cached_uri (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  g_free (priv->uri_str);
+  priv->uri_str = NULL;
+  if (priv->uri) {
+    gst_rtsp_url_free (priv->uri);
+    priv->uri = NULL;
+  }
+}
+
+static void
+clear_suspended (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GstRTSPMessage *request;
+
+  if (priv->suspend_timeout) {
+    g_source_destroy (priv->suspend_timeout);
+    g_source_unref (priv->suspend_timeout);
+    priv->suspend_timeout = NULL;
+  }
+  if (priv->suspended) {
+    gst_rtsp_message_free (priv->suspended);
+    priv->suspended = NULL;
+  }
+  if (priv->suspended_trace) {
+    g_array_free (priv->suspended_trace, TRUE);
+    priv->suspended_trace = NULL;
+  }
+  while ((request = g_queue_pop_head (&priv->pending_requests)))
+    gst_rtsp_message_free (request);
 }
 
 /* A client is finalized when the connection is broken */
@@ -457,8 +615,16 @@ gst_rtsp_client_finalize (GObject * obj)
     g_object_unref (priv->auth);
   if (priv->thread_pool)
     g_object_unref (priv->thread_pool);
+  if (priv->request_metrics)
+    gst_rtsp_request_metrics_unref (priv->request_metrics);
+  if (priv->copy_metrics)
+    gst_rtsp_copy_metrics_unref (priv->copy_metrics);
 
+  clear_suspended (client);
   clean_cached_media (client, TRUE);
+  clear_cached_uri (client);
+
+  send_queue_clear (client);
 
   g_free (priv->server_ip);
   g_mutex_clear (&priv->lock);
@@ -485,6 +651,16 @@ gst_rtsp_client_get_property (GObject * object, guint propid,
     case PROP_DROP_BACKLOG:
       g_value_set_boolean (value, priv->drop_backlog);
       break;
+    case PROP_SEND_QUEUE_MAX_BYTES:
+      g_mutex_lock (&priv->send_lock);
+      g_value_set_uint (value, priv->send_queue_max_bytes);
+      g_mutex_unlock (&priv->send_lock);
+      break;
+    case PROP_SEND_QUEUE_MAX_TIME:
+      g_mutex_lock (&priv->send_lock);
+      g_value_set_uint64 (value, priv->send_queue_max_time);
+      g_mutex_unlock (&priv->send_lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -509,6 +685,16 @@ gst_rtsp_client_set_property (GObject * object, guint propid,
       priv->drop_backlog = g_value_get_boolean (value);
       g_mutex_unlock (&priv->lock);
       break;
+    case PROP_SEND_QUEUE_MAX_BYTES:
+      g_mutex_lock (&priv->send_lock);
+      priv->send_queue_max_bytes = g_value_get_uint (value);
+      g_mutex_unlock (&priv->send_lock);
+      break;
+    case PROP_SEND_QUEUE_MAX_TIME:
+      g_mutex_lock (&priv->send_lock);
+      priv->send_queue_max_time = g_value_get_uint64 (value);
+      g_mutex_unlock (&priv->send_lock);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -531,11 +717,23 @@ gst_rtsp_client_new (void)
   return result;
 }
 
+/* check if emitting @signal has any effect. The emission itself is costly
+ * compared to the handling of a keepalive request. */
+static gboolean
+signal_is_connected (GstRTSPClient * client, guint signal,
+    gconstpointer class_handler)
+{
+  return class_handler != NULL ||
+      g_signal_has_handler_pending (client, gst_rtsp_client_signals[signal], 0,
+      FALSE);
+}
+
 static void
 send_message (GstRTSPClient * client, GstRTSPContext * ctx,
     GstRTSPMessage * message, gboolean close)
 {
   GstRTSPClientPrivate *priv = client->priv;
+  guint span;
 
   gst_rtsp_message_add_header (message, GST_RTSP_HDR_SERVER,
       "GStreamer RTSP server");
@@ -556,13 +754,17 @@ send_message (GstRTSPClient * client, GstRTSPContext * ctx,
   if (close)
     gst_rtsp_message_add_header (message, GST_RTSP_HDR_CONNECTION, "close");
 
-  g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_SEND_MESSAGE],
-      0, ctx, message);
+  if (signal_is_connected (client, SIGNAL_SEND_MESSAGE,
+          GST_RTSP_CLIENT_GET_CLASS (client)->send_message))
+    g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_SEND_MESSAGE],
+        0, ctx, message);
 
+  span = gst_rtsp_context_trace_begin (ctx, "send");
   g_mutex_lock (&priv->send_lock);
   if (priv->send_func)
     priv->send_func (client, message, close, priv->send_data);
   g_mutex_unlock (&priv->send_lock);
+  gst_rtsp_context_trace_end (ctx, span);
 
   gst_rtsp_message_unset (message);
 }
@@ -613,6 +815,163 @@ paths_are_equal (const gchar * path1, const gchar * path2, gint len2)
   return TRUE;
 }
 
+typedef struct
+{
+  GWeakRef client;
+  GMainContext *context;
+  guint seq;
+} ResumeData;
+
+static ResumeData *
+resume_data_new (GstRTSPClient * client, GMainContext * context, guint seq)
+{
+  ResumeData *data = g_slice_new (ResumeData);
+
+  g_weak_ref_init (&data->client, client);
+  data->context = g_main_context_ref (context);
+  data->seq = seq;
+
+  return data;
+}
+
+static void
+resume_data_free (ResumeData * data)
+{
+  g_weak_ref_clear (&data->client);
+  g_main_context_unref (data->context);
+  g_slice_free (ResumeData, data);
+}
+
+static void handle_request (GstRTSPClient * client, GstRTSPMessage * request);
+
+/* take the contents of @message, leaving @message empty */
+static GstRTSPMessage *
+steal_message (GstRTSPMessage * message)
+{
+  GstRTSPMessage *result;
+
+  gst_rtsp_message_new (&result);
+  gst_rtsp_message_unset (result);
+  *result = *message;
+  memset (message, 0, sizeof (GstRTSPMessage));
+
+  return result;
+}
+
+/* runs in the client thread, handles the suspended request again followed
+ * by the requests that arrived meanwhile */
+static gboolean
+resume_request (ResumeData * data)
+{
+  GstRTSPClient *client;
+  GstRTSPClientPrivate *priv;
+  GstRTSPMessage *request;
+
+  if (!(client = g_weak_ref_get (&data->client)))
+    return G_SOURCE_REMOVE;
+
+  priv = client->priv;
+
+  /* a later suspend or the timeout got here first */
+  if (data->seq != priv->suspend_seq || priv->suspended == NULL)
+    goto done;
+
+  if (priv->suspend_timeout) {
+    g_source_destroy (priv->suspend_timeout);
+    g_source_unref (priv->suspend_timeout);
+    priv->suspend_timeout = NULL;
+  }
+
+  GST_INFO ("client %p: resuming request", client);
+  request = priv->suspended;
+  priv->suspended = NULL;
+  priv->resumed_start = priv->suspended_start;
+  priv->resuming = TRUE;
+  handle_request (client, request);
+  priv->resuming = FALSE;
+  gst_rtsp_message_free (request);
+
+  while (priv->suspended == NULL &&
+      (request = g_queue_pop_head (&priv->pending_requests))) {
+    handle_request (client, request);
+    gst_rtsp_message_free (request);
+  }
+
+done:
+  g_object_unref (client);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* called from the media thread when the media stopped preparing */
+static void
+media_prepare_done (GstRTSPMedia * media, ResumeData * data)
+{
+  GstRTSPClient *client;
+  GSource *source;
+
+  if (!(client = g_weak_ref_get (&data->client)))
+    return;
+
+  /* continue in the client thread */
+  source = g_idle_source_new ();
+  g_source_set_callback (source, (GSourceFunc) resume_request,
+      resume_data_new (client, data->context, data->seq),
+      (GDestroyNotify) resume_data_free);
+  g_source_attach (source, data->context);
+  g_source_unref (source);
+
+  g_object_unref (client);
+}
+
+/* suspend the current request until @media is done prerolling */
+static void
+suspend_request (GstRTSPClient * client, GstRTSPMedia * media)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  GST_INFO ("client %p: suspending request until media %p is prepared",
+      client, media);
+
+  /* handle_request() takes the request when we return */
+  priv->suspend = TRUE;
+  priv->suspend_seq++;
+
+  priv->suspend_timeout = g_timeout_source_new_seconds (PREPARE_TIMEOUT);
+  g_source_set_callback (priv->suspend_timeout, (GSourceFunc) resume_request,
+      resume_data_new (client, priv->watch_context, priv->suspend_seq),
+      (GDestroyNotify) resume_data_free);
+  g_source_attach (priv->suspend_timeout, priv->watch_context);
+
+  gst_rtsp_media_add_prepare_watch (media,
+      (GstRTSPMediaPrepareFunc) media_prepare_done,
+      resume_data_new (client, priv->watch_context, priv->suspend_seq),
+      (GDestroyNotify) resume_data_free);
+}
+
+/* add the port allocation of the streams of @media to the trace of @ctx. The
+ * ports are allocated in the media thread, only the allocations done while
+ * handling this request are added. */
+static void
+trace_alloc_ports (GstRTSPContext * ctx, GstRTSPMedia * media)
+{
+  gint64 request_start, start, end;
+  guint i, n_streams;
+
+  if (ctx->trace == NULL || ctx->trace->len == 0)
+    return;
+
+  request_start = g_array_index (ctx->trace, GstRTSPTraceSpan, 0).start;
+
+  n_streams = gst_rtsp_media_n_streams (media);
+  for (i = 0; i < n_streams; i++) {
+    gst_rtsp_stream_get_alloc_time (gst_rtsp_media_get_stream (media, i),
+        &start, &end);
+    if (start >= request_start)
+      gst_rtsp_context_trace_add (ctx, "alloc-ports", start, end);
+  }
+}
+
 /* this function is called to initially find the media for the DESCRIBE request
  * but is cached for when the same client (without breaking the connection) is
  * doing a setup for the exact same url. */
@@ -624,19 +983,29 @@ find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
   GstRTSPMediaFactory *factory;
   GstRTSPMedia *media;
   gint path_len;
+  guint span;
+
+  /* the factory was found and checked before the request was suspended */
+  if (priv->resuming && priv->media_preparing &&
+      g_str_has_prefix (path, priv->path))
+    goto resume_media;
 
   /* find the longest matching factory for the uri first */
+  span = gst_rtsp_context_trace_begin (ctx, "find-factory");
   if (!(factory = gst_rtsp_mount_points_match (priv->mount_points,
               path, matched)))
     goto no_factory;
+  gst_rtsp_context_trace_end (ctx, span);
 
   ctx->factory = factory;
 
+  span = gst_rtsp_context_trace_begin (ctx, "auth");
   if (!gst_rtsp_auth_check (GST_RTSP_AUTH_CHECK_MEDIA_FACTORY_ACCESS))
     goto no_factory_access;
 
   if (!gst_rtsp_auth_check (GST_RTSP_AUTH_CHECK_MEDIA_FACTORY_CONSTRUCT))
     goto not_authorized;
+  gst_rtsp_context_trace_end (ctx, span);
 
   if (matched)
     path_len = *matched;
@@ -649,8 +1018,10 @@ find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
     clean_cached_media (client, TRUE);
 
     /* prepare the media and add it to the pipeline */
+    span = gst_rtsp_context_trace_begin (ctx, "construct");
     if (!(media = gst_rtsp_media_factory_construct (factory, ctx->uri)))
       goto no_media;
+    gst_rtsp_context_trace_end (ctx, span);
 
     ctx->media = media;
 
@@ -663,9 +1034,23 @@ find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
       if (thread == NULL)
         goto no_thread;
 
-      /* prepare the media */
-      if (!gst_rtsp_media_prepare (media, thread))
-        goto no_prepare;
+      span = gst_rtsp_context_trace_begin (ctx, "prepare");
+      if (priv->watch_context) {
+        gboolean prepared;
+
+        /* start preparing, we don't want to block the client thread while the
+         * pipeline prerolls */
+        if (!gst_rtsp_media_prepare_start (media, thread, &prepared))
+          goto no_prepare;
+        if (!prepared)
+          goto suspend;
+      } else {
+        /* prepare the media */
+        if (!gst_rtsp_media_prepare (media, thread))
+          goto no_prepare;
+      }
+      gst_rtsp_context_trace_end (ctx, span);
+      trace_alloc_ports (ctx, media);
     }
 
     /* now keep track of the uri and the media */
@@ -686,6 +1071,25 @@ find_media (GstRTSPClient * client, GstRTSPContext * ctx, gchar * path,
 
   return media;
 
+resume_media:
+  {
+    /* the request was suspended until now, the media is done prerolling */
+    media = priv->media;
+    ctx->media = media;
+    if (matched)
+      *matched = strlen (priv->path);
+    GST_INFO ("resuming with media %p for path %s", media, priv->path);
+
+    priv->media_preparing = FALSE;
+    span = gst_rtsp_context_trace_begin (ctx, "prepare-finish");
+    if (!gst_rtsp_media_prepare_finish (media))
+      goto no_preroll;
+    gst_rtsp_context_trace_end (ctx, span);
+    trace_alloc_ports (ctx, media);
+
+    return g_object_ref (media);
+  }
+
   /* ERRORS */
 no_factory:
   {
@@ -714,30 +1118,506 @@ no_media:
     ctx->factory = NULL;
     return NULL;
   }
-no_thread:
+no_thread:
+  {
+    GST_ERROR ("client %p: can't create thread", client);
+    send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
+    /* a media from the standby pool is prepared already */
+    gst_rtsp_media_release_standby (media);
+    g_object_unref (media);
+    ctx->media = NULL;
+    g_object_unref (factory);
+    ctx->factory = NULL;
+    return NULL;
+  }
+no_prepare:
+  {
+    GST_ERROR ("client %p: can't prepare media", client);
+    send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
+    g_object_unref (media);
+    ctx->media = NULL;
+    g_object_unref (factory);
+    ctx->factory = NULL;
+    return NULL;
+  }
+no_preroll:
+  {
+    GST_ERROR ("client %p: media failed to preroll", client);
+    send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
+    /* the prepare count was released when the preroll failed */
+    clean_cached_media (client, FALSE);
+    ctx->media = NULL;
+    return NULL;
+  }
+suspend:
+  {
+    /* keep the media, the request is handled again when it is prerolled */
+    priv->path = g_strndup (path, path_len);
+    priv->media = media;
+    priv->media_preparing = TRUE;
+    suspend_request (client, media);
+    ctx->media = NULL;
+    g_object_unref (factory);
+    ctx->factory = NULL;
+    return NULL;
+  }
+}
+
+/* size of the header of an interleaved frame: '$', the channel and a 16 bits
+ * length in network byte order */
+#define INTERLEAVED_HEADER_SIZE         4
+
+/* write the interleaved header for @size bytes of @channel at @data */
+static void
+write_interleaved_header (guint8 * data, guint8 channel, gsize size)
+{
+  data[0] = '$';
+  data[1] = channel;
+  GST_WRITE_UINT16_BE (data + 2, size);
+}
+
+/* count @packets with @bytes that were copied for @client */
+static void
+count_copies (GstRTSPClient * client, guint packets, gsize bytes)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  if (priv->copy_metrics)
+    gst_rtsp_copy_metrics_count (priv->copy_metrics, packets, bytes);
+}
+
+/* make an interleaved frame for @buffer in one allocation. The result can be
+ * handed to the watch as-is so we don't need to wrap it in a GstRTSPMessage
+ * and serialize that again. The watch only takes a block of memory that it
+ * frees itself, this is the one copy of the packet for a TCP client. */
+static guint8 *
+make_interleaved_data (GstRTSPClient * client, GstBuffer * buffer,
+    guint8 channel, guint * size)
+{
+  guint8 *data;
+  gsize bsize;
+
+  bsize = gst_buffer_get_size (buffer);
+  if (bsize > G_MAXUINT16)
+    goto too_big;
+
+  *size = INTERLEAVED_HEADER_SIZE + bsize;
+  data = g_malloc (*size);
+
+  write_interleaved_header (data, channel, bsize);
+  gst_buffer_extract (buffer, 0, data + INTERLEAVED_HEADER_SIZE, bsize);
+
+  count_copies (client, 1, bsize);
+
+  return data;
+
+  /* ERRORS */
+too_big:
+  {
+    GST_WARNING ("buffer of %" G_GSIZE_FORMAT " bytes too big for channel %u",
+        bsize, channel);
+    return NULL;
+  }
+}
+
+/* make the interleaved frames for all buffers in @list in one allocation so
+ * that they can be written with one call */
+static guint8 *
+make_interleaved_data_list (GstRTSPClient * client, GstBufferList * list,
+    guint8 channel, guint * size)
+{
+  guint i, len;
+  gsize total = 0;
+  guint8 *data, *ptr;
+
+  len = gst_buffer_list_length (list);
+  for (i = 0; i < len; i++) {
+    gsize bsize = gst_buffer_get_size (gst_buffer_list_get (list, i));
+
+    if (bsize > G_MAXUINT16)
+      goto too_big;
+
+    total += INTERLEAVED_HEADER_SIZE + bsize;
+  }
+  if (total > G_MAXUINT)
+    goto too_big;
+
+  *size = total;
+  ptr = data = g_malloc (total);
+
+  for (i = 0; i < len; i++) {
+    GstBuffer *buffer = gst_buffer_list_get (list, i);
+    gsize bsize = gst_buffer_get_size (buffer);
+
+    write_interleaved_header (ptr, channel, bsize);
+    ptr += INTERLEAVED_HEADER_SIZE;
+    gst_buffer_extract (buffer, 0, ptr, bsize);
+    ptr += bsize;
+  }
+
+  count_copies (client, len, total - len * INTERLEAVED_HEADER_SIZE);
+
+  return data;
+
+  /* ERRORS */
+too_big:
+  {
+    GST_WARNING ("buffer list too big for channel %u", channel);
+    return NULL;
+  }
+}
+
+static GstRTSPResult do_send_message (GstRTSPClient * client,
+    GstRTSPMessage * message, gboolean close, gpointer user_data);
+
+typedef guint8 *(*MakeDataFunc) (GstRTSPClient * client, gpointer obj,
+    guint8 channel, guint * size);
+
+/* check if the backlog of the watch has room, so that we don't copy packets
+ * into a frame that the watch would refuse. Must be called with the
+ * send_lock */
+static gboolean
+watch_has_room (GstRTSPClientPrivate * priv)
+{
+  GTimeVal time = { 0, 0 };
+
+  return gst_rtsp_watch_wait_backlog (priv->watch, &time) == GST_RTSP_OK;
+}
+
+/* make the interleaved data for @obj with @make and write it on the watch.
+ * The watch takes ownership of the data, also when it can't be queued, so we
+ * make it again when we need to retry after waiting for the backlog. We only
+ * make it when the backlog has room. Must be called with the send_lock. */
+static GstRTSPResult
+do_write_data (GstRTSPClient * client, MakeDataFunc make, gpointer obj,
+    guint8 channel)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GstRTSPResult ret;
+  GTimeVal time;
+  guint8 *data;
+  guint size;
+
+  time.tv_sec = 1;
+  time.tv_usec = 0;
+
+  do {
+    if (watch_has_room (priv)) {
+      if (!(data = make (client, obj, channel, &size)))
+        goto no_data;
+
+      ret = gst_rtsp_watch_write_data (priv->watch, data, size, NULL);
+      if (ret == GST_RTSP_OK)
+        break;
+
+      if (ret != GST_RTSP_ENOMEM)
+        goto error;
+    } else {
+      ret = GST_RTSP_ENOMEM;
+    }
+
+    /* drop backlog */
+    if (priv->drop_backlog)
+      break;
+
+    /* queue was full, wait for more space */
+    GST_DEBUG_OBJECT (client, "waiting for backlog");
+    ret = gst_rtsp_watch_wait_backlog (priv->watch, &time);
+    GST_DEBUG_OBJECT (client, "Resend due to backlog full");
+  } while (ret != GST_RTSP_EINTR);
+
+  return ret;
+
+  /* ERRORS */
+no_data:
+  {
+    GST_DEBUG_OBJECT (client, "could not make interleaved data");
+    return GST_RTSP_EINVAL;
+  }
+error:
+  {
+    GST_DEBUG_OBJECT (client, "got error %d", ret);
+    return ret;
+  }
+}
+
+typedef struct
+{
+  GstBuffer *buffer;
+  guint8 channel;
+  gboolean is_rtcp;
+  guint32 rtptime;
+} SendQueueItem;
+
+static void
+send_queue_item_free (SendQueueItem * item)
+{
+  gst_buffer_unref (item->buffer);
+  g_slice_free (SendQueueItem, item);
+}
+
+#define SEND_QUEUE_ENABLED(priv) \
+    ((priv)->send_queue_max_bytes != 0 || (priv)->send_queue_max_time != 0)
+
+/* RTCP and codec headers are never dropped */
+#define ITEM_IS_DROPPABLE(item) \
+    (!(item)->is_rtcp && \
+     !GST_BUFFER_FLAG_IS_SET ((item)->buffer, GST_BUFFER_FLAG_HEADER))
+#define ITEM_IS_DELTA(item) \
+    GST_BUFFER_FLAG_IS_SET ((item)->buffer, GST_BUFFER_FLAG_DELTA_UNIT)
+
+static gboolean
+needs_resync (GstRTSPClientPrivate * priv, guint8 channel)
+{
+  return (priv->resync[channel >> 3] & (1 << (channel & 7))) != 0;
+}
+
+static void
+set_resync (GstRTSPClientPrivate * priv, guint8 channel, gboolean resync)
+{
+  if (resync)
+    priv->resync[channel >> 3] |= (1 << (channel & 7));
+  else
+    priv->resync[channel >> 3] &= ~(1 << (channel & 7));
+}
+
+/* all fragments of a frame share the RTP timestamp, so the first keyframe
+ * packet with another timestamp than the damaged frame starts a complete
+ * keyframe */
+static gboolean
+item_ends_resync (GstRTSPClientPrivate * priv, SendQueueItem * item)
+{
+  return !ITEM_IS_DELTA (item) &&
+      item->rtptime != priv->resync_rtptime[item->channel];
+}
+
+/* must be called with the send_lock */
+static void
+send_queue_clear (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  g_queue_foreach (&priv->send_queue, (GFunc) send_queue_item_free, NULL);
+  g_queue_clear (&priv->send_queue);
+  priv->send_queue_bytes = 0;
+  memset (priv->resync, 0, sizeof (priv->resync));
+}
+
+/* must be called with the send_lock */
+static void
+send_queue_drop_link (GstRTSPClient * client, GList * link)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  SendQueueItem *item = link->data;
+
+  GST_LOG_OBJECT (client, "dropping %s packet of %" G_GSIZE_FORMAT
+      " bytes on channel %u", ITEM_IS_DELTA (item) ? "delta" : "key",
+      gst_buffer_get_size (item->buffer), item->channel);
+
+  priv->send_queue_bytes -= gst_buffer_get_size (item->buffer);
+  g_queue_delete_link (&priv->send_queue, link);
+  send_queue_item_free (item);
+}
+
+/* drop one packet from the queue, preferring the oldest delta unit. All
+ * following packets of the same channel can't be decoded anymore and are
+ * dropped until the first packet of the next complete keyframe. Returns
+ * %FALSE when nothing could be dropped. Must be called with the send_lock */
+static gboolean
+send_queue_drop (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GList *walk, *next, *victim = NULL;
+  guint8 channel;
+
+  for (walk = priv->send_queue.head; walk; walk = g_list_next (walk)) {
+    SendQueueItem *item = walk->data;
+
+    if (!ITEM_IS_DROPPABLE (item))
+      continue;
+
+    if (ITEM_IS_DELTA (item)) {
+      victim = walk;
+      break;
+    }
+    if (victim == NULL)
+      victim = walk;
+  }
+  if (victim == NULL)
+    return FALSE;
+
+  channel = ((SendQueueItem *) victim->data)->channel;
+  priv->resync_rtptime[channel] = ((SendQueueItem *) victim->data)->rtptime;
+  walk = g_list_next (victim);
+  send_queue_drop_link (client, victim);
+
+  /* wait for the next complete keyframe on this channel */
+  set_resync (priv, channel, TRUE);
+  for (; walk; walk = next) {
+    SendQueueItem *item = walk->data;
+
+    next = g_list_next (walk);
+
+    if (item->channel != channel || !ITEM_IS_DROPPABLE (item))
+      continue;
+
+    if (item_ends_resync (priv, item)) {
+      set_resync (priv, channel, FALSE);
+      break;
+    }
+    send_queue_drop_link (client, walk);
+  }
+  return TRUE;
+}
+
+/* must be called with the send_lock */
+static gboolean
+send_queue_is_full (GstRTSPClientPrivate * priv)
+{
+  SendQueueItem *head, *tail;
+  GstClockTime first, last;
+
+  if (priv->send_queue_max_bytes != 0 &&
+      priv->send_queue_bytes > priv->send_queue_max_bytes)
+    return TRUE;
+
+  if (priv->send_queue_max_time == 0 || priv->send_queue.length < 2)
+    return FALSE;
+
+  head = g_queue_peek_head (&priv->send_queue);
+  tail = g_queue_peek_tail (&priv->send_queue);
+  first = GST_BUFFER_TIMESTAMP (head->buffer);
+  last = GST_BUFFER_TIMESTAMP (tail->buffer);
+
+  return GST_CLOCK_TIME_IS_VALID (first) && GST_CLOCK_TIME_IS_VALID (last) &&
+      last > first && last - first > priv->send_queue_max_time;
+}
+
+/* queue @buffer until the watch has room for it. Must be called with the
+ * send_lock */
+static void
+send_queue_push (GstRTSPClient * client, GstBuffer * buffer, guint8 channel,
+    gboolean is_rtcp)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  SendQueueItem *item;
+
+  item = g_slice_new (SendQueueItem);
+  item->buffer = gst_buffer_ref (buffer);
+  item->channel = channel;
+  item->is_rtcp = is_rtcp;
+  item->rtptime = 0;
+
+  if (ITEM_IS_DROPPABLE (item)) {
+    GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+
+    if (gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp)) {
+      item->rtptime = gst_rtp_buffer_get_timestamp (&rtp);
+      gst_rtp_buffer_unmap (&rtp);
+    }
+
+    if (needs_resync (priv, channel)) {
+      if (!item_ends_resync (priv, item)) {
+        GST_LOG_OBJECT (client, "waiting for keyframe on channel %u", channel);
+        send_queue_item_free (item);
+        return;
+      }
+      set_resync (priv, channel, FALSE);
+    }
+  }
+
+  g_queue_push_tail (&priv->send_queue, item);
+  priv->send_queue_bytes += gst_buffer_get_size (buffer);
+
+  while (send_queue_is_full (priv)) {
+    if (!send_queue_drop (client))
+      break;
+  }
+}
+
+/* write as many queued packets as the watch accepts. Must be called with the
+ * send_lock */
+static void
+send_queue_flush (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  SendQueueItem *item;
+  GstRTSPResult res;
+
+  while ((item = g_queue_peek_head (&priv->send_queue))) {
+    guint8 *data;
+    guint size;
+
+    if (!watch_has_room (priv))
+      break;
+
+    data = make_interleaved_data (client, item->buffer, item->channel, &size);
+    if (data) {
+      res = gst_rtsp_watch_write_data (priv->watch, data, size, NULL);
+      if (res == GST_RTSP_ENOMEM)
+        break;
+      if (res != GST_RTSP_OK)
+        goto error;
+    }
+    priv->send_queue_bytes -= gst_buffer_get_size (item->buffer);
+    g_queue_pop_head (&priv->send_queue);
+    send_queue_item_free (item);
+  }
+  return;
+
+  /* ERRORS */
+error:
   {
-    GST_ERROR ("client %p: can't create thread", client);
-    send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
-    g_object_unref (media);
-    ctx->media = NULL;
-    g_object_unref (factory);
-    ctx->factory = NULL;
-    return NULL;
+    GST_DEBUG_OBJECT (client, "got error %d, clearing send queue", res);
+    send_queue_clear (client);
+    return;
   }
-no_prepare:
-  {
-    GST_ERROR ("client %p: can't prepare media", client);
-    send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, ctx);
-    g_object_unref (media);
-    ctx->media = NULL;
-    g_object_unref (factory);
-    ctx->factory = NULL;
-    return NULL;
+}
+
+/* send @buffer on the watch, going through the send queue when it is
+ * enabled. Must be called with the send_lock */
+static GstRTSPResult
+do_write_buffer (GstRTSPClient * client, GstBuffer * buffer, guint8 channel,
+    gboolean is_rtcp)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GstRTSPResult res;
+  guint8 *data;
+  guint size;
+
+  if (!SEND_QUEUE_ENABLED (priv))
+    return do_write_data (client, (MakeDataFunc) make_interleaved_data,
+        buffer, channel);
+
+  /* keep the order of the packets when there is something queued */
+  if (priv->send_queue.length > 0) {
+    send_queue_flush (client);
+    if (priv->send_queue.length > 0) {
+      send_queue_push (client, buffer, channel, is_rtcp);
+      return GST_RTSP_OK;
+    }
+  }
+
+  /* when the watch backlog is full, keep the packet in our own queue where we
+   * can decide what to drop */
+  if (!watch_has_room (priv)) {
+    res = GST_RTSP_ENOMEM;
+  } else {
+    if (!(data = make_interleaved_data (client, buffer, channel, &size)))
+      return GST_RTSP_EINVAL;
+
+    res = gst_rtsp_watch_write_data (priv->watch, data, size, NULL);
+  }
+  if (res == GST_RTSP_ENOMEM) {
+    send_queue_push (client, buffer, channel, is_rtcp);
+    res = GST_RTSP_OK;
   }
+  return res;
 }
 
 static gboolean
-do_send_data (GstBuffer * buffer, guint8 channel, GstRTSPClient * client)
+do_send_data (GstBuffer * buffer, guint8 channel, GstRTSPClient * client,
+    gboolean is_rtcp)
 {
   GstRTSPClientPrivate *priv = client->priv;
   GstRTSPMessage message = { 0 };
@@ -746,9 +1626,20 @@ do_send_data (GstBuffer * buffer, guint8 channel, GstRTSPClient * client)
   guint8 *data;
   guint usize;
 
+  g_mutex_lock (&priv->send_lock);
+  if (priv->send_func == do_send_message) {
+    /* we are sending on our own watch, write the interleaved frame directly
+     * without going through a GstRTSPMessage */
+    res = do_write_buffer (client, buffer, channel, is_rtcp);
+    g_mutex_unlock (&priv->send_lock);
+
+    return res == GST_RTSP_OK;
+  }
+  g_mutex_unlock (&priv->send_lock);
+
   gst_rtsp_message_init_data (&message, channel);
 
-  /* FIXME, need some sort of iovec RTSPMessage here */
+  /* a custom send function wants a message */
   if (!gst_buffer_map (buffer, &map_info, GST_MAP_READ))
     return FALSE;
 
@@ -767,6 +1658,109 @@ do_send_data (GstBuffer * buffer, guint8 channel, GstRTSPClient * client)
   return res == GST_RTSP_OK;
 }
 
+static gboolean
+do_send_rtp_data (GstBuffer * buffer, guint8 channel, GstRTSPClient * client)
+{
+  return do_send_data (buffer, channel, client, FALSE);
+}
+
+static gboolean
+do_send_rtcp_data (GstBuffer * buffer, guint8 channel, GstRTSPClient * client)
+{
+  return do_send_data (buffer, channel, client, TRUE);
+}
+
+typedef struct
+{
+  GstRTSPClient *client;
+  guint8 channel;
+  gboolean is_rtcp;
+  gboolean res;
+} SendDataListData;
+
+static gboolean
+send_data_list_item (GstBuffer ** buffer, guint idx, SendDataListData * data)
+{
+  data->res =
+      do_send_data (*buffer, data->channel, data->client, data->is_rtcp);
+
+  return data->res;
+}
+
+static gboolean
+do_send_data_list (GstBufferList * buffer_list, guint8 channel,
+    GstRTSPClient * client, gboolean is_rtcp)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  SendDataListData data;
+  GstRTSPResult res;
+
+  g_mutex_lock (&priv->send_lock);
+  if (priv->send_func == do_send_message && !SEND_QUEUE_ENABLED (priv)) {
+    /* write all packets of the list with one call on our watch */
+    res = do_write_data (client, (MakeDataFunc) make_interleaved_data_list,
+        buffer_list, channel);
+    g_mutex_unlock (&priv->send_lock);
+
+    return res == GST_RTSP_OK;
+  } else if (priv->send_func == do_send_message &&
+      priv->send_queue.length == 0) {
+    guint8 *wdata;
+    guint size;
+
+    /* try the whole list at once, queue the packets when the backlog is full */
+    if (!watch_has_room (priv)) {
+      res = GST_RTSP_ENOMEM;
+    } else {
+      if (!(wdata = make_interleaved_data_list (client, buffer_list, channel,
+                  &size))) {
+        g_mutex_unlock (&priv->send_lock);
+        return FALSE;
+      }
+
+      res = gst_rtsp_watch_write_data (priv->watch, wdata, size, NULL);
+    }
+    if (res == GST_RTSP_ENOMEM) {
+      guint i, len;
+
+      len = gst_buffer_list_length (buffer_list);
+      for (i = 0; i < len; i++)
+        send_queue_push (client, gst_buffer_list_get (buffer_list, i),
+            channel, is_rtcp);
+      res = GST_RTSP_OK;
+    }
+    g_mutex_unlock (&priv->send_lock);
+
+    return res == GST_RTSP_OK;
+  }
+  g_mutex_unlock (&priv->send_lock);
+
+  /* send packet by packet, either through the send queue or as messages for
+   * a custom send function */
+  data.client = client;
+  data.channel = channel;
+  data.is_rtcp = is_rtcp;
+  data.res = TRUE;
+  gst_buffer_list_foreach (buffer_list,
+      (GstBufferListFunc) send_data_list_item, &data);
+
+  return data.res;
+}
+
+static gboolean
+do_send_rtp_data_list (GstBufferList * buffer_list, guint8 channel,
+    GstRTSPClient * client)
+{
+  return do_send_data_list (buffer_list, channel, client, FALSE);
+}
+
+static gboolean
+do_send_rtcp_data_list (GstBufferList * buffer_list, guint8 channel,
+    GstRTSPClient * client)
+{
+  return do_send_data_list (buffer_list, channel, client, TRUE);
+}
+
 /**
  * gst_rtsp_client_close:
  * @client: a #GstRTSPClient
@@ -951,8 +1945,10 @@ handle_get_param_request (GstRTSPClient * client, GstRTSPContext * ctx)
     send_message (client, ctx, ctx->response, FALSE);
   }
 
-  g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_GET_PARAMETER_REQUEST],
-      0, ctx);
+  if (signal_is_connected (client, SIGNAL_GET_PARAMETER_REQUEST,
+          GST_RTSP_CLIENT_GET_CLASS (client)->get_parameter_request))
+    g_signal_emit (client,
+        gst_rtsp_client_signals[SIGNAL_GET_PARAMETER_REQUEST], 0, ctx);
 
   return TRUE;
 
@@ -1133,6 +2129,7 @@ handle_play_request (GstRTSPClient * client, GstRTSPContext * ctx)
   GstRTSPRangeUnit unit = GST_RTSP_RANGE_NPT;
   gchar *path, *rtpinfo;
   gint matched;
+  guint span;
 
   if (!(session = ctx->session))
     goto no_session;
@@ -1166,8 +2163,10 @@ handle_play_request (GstRTSPClient * client, GstRTSPContext * ctx)
     goto invalid_state;
 
   /* in play we first unsuspend, media could be suspended from SDP or PAUSED */
+  span = gst_rtsp_context_trace_begin (ctx, "unsuspend");
   if (!gst_rtsp_media_unsuspend (media))
     goto unsuspend_failed;
+  gst_rtsp_context_trace_end (ctx, span);
 
   /* parse the range header if we have one */
   res = gst_rtsp_message_get_header (ctx->request, GST_RTSP_HDR_RANGE, &str, 0);
@@ -1176,6 +2175,7 @@ handle_play_request (GstRTSPClient * client, GstRTSPContext * ctx)
       GstRTSPMediaStatus media_status;
 
       /* we have a range, seek to the position */
+      span = gst_rtsp_context_trace_begin (ctx, "seek");
       unit = range->unit;
       gst_rtsp_media_seek (media, range);
       gst_rtsp_range_free (range);
@@ -1183,6 +2183,7 @@ handle_play_request (GstRTSPClient * client, GstRTSPContext * ctx)
       media_status = gst_rtsp_media_get_status (media);
       if (media_status == GST_RTSP_MEDIA_STATUS_ERROR)
         goto seek_failed;
+      gst_rtsp_context_trace_end (ctx, span);
     }
   }
 
@@ -1207,7 +2208,9 @@ handle_play_request (GstRTSPClient * client, GstRTSPContext * ctx)
   send_message (client, ctx, ctx->response, FALSE);
 
   /* start playing after sending the response */
+  span = gst_rtsp_context_trace_begin (ctx, "play");
   gst_rtsp_session_media_set_state (sessmedia, GST_STATE_PLAYING);
+  gst_rtsp_context_trace_end (ctx, span);
 
   gst_rtsp_session_media_set_rtsp_state (sessmedia, GST_RTSP_STATE_PLAYING);
 
@@ -1613,9 +2616,11 @@ mikey_apply_policy (GstCaps * caps, GstMIKEYMessage * msg, guint8 policy)
   return TRUE;
 }
 
+/* the crypto info of the first crypto session is returned in @crypto, it has
+ * the master key that the client uses for the whole bundle */
 static gboolean
 handle_mikey_data (GstRTSPClient * client, GstRTSPContext * ctx,
-    guint8 * data, gsize size)
+    guint8 * data, gsize size, GstCaps ** crypto)
 {
   GstMIKEYMessage *msg;
   guint i, n_cs;
@@ -1670,6 +2675,8 @@ handle_mikey_data (GstRTSPClient * client, GstRTSPContext * ctx,
     mikey_apply_policy (caps, msg, map->policy);
 
     gst_rtsp_stream_update_crypto (ctx->stream, map->ssrc, caps);
+    if (*crypto == NULL)
+      *crypto = gst_caps_ref (caps);
     gst_caps_unref (caps);
   }
   gst_mikey_message_unref (msg);
@@ -1732,7 +2739,8 @@ strip_chars (gchar * str)
  * key-mgmt-spec = "prot" "=" KMPID ";" ["uri" "=" %x22 URI %x22 ";"]
  */
 static gboolean
-handle_keymgmt (GstRTSPClient * client, GstRTSPContext * ctx, gchar * keymgmt)
+handle_keymgmt (GstRTSPClient * client, GstRTSPContext * ctx, gchar * keymgmt,
+    GstCaps ** crypto)
 {
   gchar **specs;
   gint i, j;
@@ -1758,7 +2766,7 @@ handle_keymgmt (GstRTSPClient * client, GstRTSPContext * ctx, gchar * keymgmt)
         strip_chars (split[j] + 5);
         GST_DEBUG ("found data '%s'", split[j] + 5);
         data = g_base64_decode_inplace (split[j] + 5, &size);
-        handle_mikey_data (client, ctx, data, size);
+        handle_mikey_data (client, ctx, data, size, crypto);
       }
     }
     g_strfreev (split);
@@ -1787,6 +2795,8 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   gchar *path, *control = NULL;
   gint matched;
   gboolean new_session = FALSE;
+  guint span;
+  GstCaps *crypto = NULL;
 
   if (!ctx->uri)
     goto no_uri;
@@ -1873,8 +2883,10 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
     ctx->session = session;
   }
 
+  span = gst_rtsp_context_trace_begin (ctx, "configure-media");
   if (!klass->configure_client_media (client, media, stream, ctx))
     goto configure_media_failed_no_reply;
+  gst_rtsp_context_trace_end (ctx, span);
 
   gst_rtsp_transport_new (&ct);
 
@@ -1892,8 +2904,21 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   /* parse the keymgmt */
   if (gst_rtsp_message_get_header (ctx->request, GST_RTSP_HDR_KEYMGMT,
           &keymgmt, 0) == GST_RTSP_OK) {
-    if (!handle_keymgmt (client, ctx, keymgmt))
+    if (!handle_keymgmt (client, ctx, keymgmt, &crypto))
+      goto keymgmt_error;
+  }
+
+  /* a secure transport is encrypted with the key of the client when the
+   * stream does not encrypt */
+  if (gst_rtsp_stream_get_per_transport_keys (stream) &&
+      (ct->profile & (GST_RTSP_PROFILE_SAVP | GST_RTSP_PROFILE_SAVPF))) {
+    if (crypto == NULL)
+      goto keymgmt_error;
+    if (ct->lower_transport == GST_RTSP_LOWER_TRANS_UDP_MCAST)
       goto keymgmt_error;
+  } else if (crypto) {
+    gst_caps_unref (crypto);
+    crypto = NULL;
   }
 
   if (sessmedia == NULL) {
@@ -1912,13 +2937,19 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   ctx->sessmedia = sessmedia;
 
   /* update the client transport */
+  span = gst_rtsp_context_trace_begin (ctx, "configure-transport");
   if (!klass->configure_client_transport (client, ctx, ct))
     goto unsupported_client_transport;
 
   /* set in the session media transport */
   trans = gst_rtsp_session_media_set_transport (sessmedia, stream, ct);
+  gst_rtsp_context_trace_end (ctx, span);
 
   ctx->trans = trans;
+  gst_rtsp_stream_transport_set_copy_metrics (trans, priv->copy_metrics);
+
+  if (crypto && !gst_rtsp_stream_transport_set_crypto (trans, crypto))
+    goto crypto_error;
 
   /* configure the url used to set this transport, this we will use when
    * generating the response for the PLAY request */
@@ -1930,8 +2961,11 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
   if (ct->lower_transport == GST_RTSP_LOWER_TRANS_TCP) {
     /* our callbacks to send data on this TCP connection */
     gst_rtsp_stream_transport_set_callbacks (trans,
-        (GstRTSPSendFunc) do_send_data,
-        (GstRTSPSendFunc) do_send_data, client, NULL);
+        (GstRTSPSendFunc) do_send_rtp_data,
+        (GstRTSPSendFunc) do_send_rtcp_data, client, NULL);
+    gst_rtsp_stream_transport_set_list_callbacks (trans,
+        (GstRTSPSendListFunc) do_send_rtp_data_list,
+        (GstRTSPSendListFunc) do_send_rtcp_data_list, client, NULL);
 
     g_hash_table_insert (priv->transports,
         GINT_TO_POINTER (ct->interleaved.min), trans);
@@ -1969,6 +3003,8 @@ handle_setup_request (GstRTSPClient * client, GstRTSPContext * ctx)
       gst_rtsp_session_media_set_rtsp_state (sessmedia, GST_RTSP_STATE_READY);
       break;
   }
+  if (crypto)
+    gst_caps_unref (crypto);
   g_object_unref (session);
   g_free (path);
 
@@ -1997,7 +3033,9 @@ no_pool:
   }
 media_not_found_no_reply:
   {
-    GST_ERROR ("client %p: media '%s' not found", client, path);
+    /* a suspended request is handled again when the media is prepared */
+    if (!priv->suspend)
+      GST_ERROR ("client %p: media '%s' not found", client, path);
     /* error reply is already sent */
     goto cleanup_path;
   }
@@ -2071,8 +3109,18 @@ keymgmt_error:
     send_generic_response (client, GST_RTSP_STS_KEY_MANAGEMENT_FAILURE, ctx);
     goto cleanup_transport;
   }
+crypto_error:
+  {
+    GST_ERROR ("client %p: could not use the key of the client", client);
+    send_generic_response (client, GST_RTSP_STS_KEY_MANAGEMENT_FAILURE, ctx);
+    /* the transport belongs to the session media now */
+    gst_caps_unref (crypto);
+    goto cleanup_session;
+  }
   {
   cleanup_transport:
+    if (crypto)
+      gst_caps_unref (crypto);
     gst_rtsp_transport_free (ct);
   cleanup_session:
     if (new_session)
@@ -2084,6 +3132,15 @@ keymgmt_error:
   }
 }
 
+static void
+make_sdp_session_id (gchar * session_id, gsize len)
+{
+  guint64 session_id_tmp;
+
+  session_id_tmp = (((guint64) g_random_int ()) << 32) | g_random_int ();
+  g_snprintf (session_id, len, "%" G_GUINT64_FORMAT, session_id_tmp);
+}
+
 static GstSDPMessage *
 create_sdp (GstRTSPClient * client, GstRTSPMedia * media)
 {
@@ -2091,7 +3148,6 @@ create_sdp (GstRTSPClient * client, GstRTSPMedia * media)
   GstSDPMessage *sdp;
   GstSDPInfo info;
   const gchar *proto;
-  guint64 session_id_tmp;
   gchar session_id[21];
 
   gst_sdp_message_new (&sdp);
@@ -2104,9 +3160,7 @@ create_sdp (GstRTSPClient * client, GstRTSPMedia * media)
   else
     proto = "IP4";
 
-  session_id_tmp = (((guint64) g_random_int ()) << 32) | g_random_int ();
-  g_snprintf (session_id, sizeof (session_id), "%" G_GUINT64_FORMAT,
-      session_id_tmp);
+  make_sdp_session_id (session_id, sizeof (session_id));
 
   gst_sdp_message_set_origin (sdp, "-", session_id, "1", "IN", proto,
       priv->server_ip);
@@ -2136,19 +3190,88 @@ no_sdp:
   }
 }
 
+/* get the cached SDP of @media for @key with a new session id in the origin,
+ * NULL when nothing is cached or @fp changed */
+static gchar *
+sdp_cache_lookup (GstRTSPMedia * media, const gchar * key,
+    GstRTSPSdpFingerprint * fp)
+{
+  gchar *text, *result, session_id[21];
+  gsize id_offset, id_len;
+
+  if (!(text = gst_rtsp_media_lookup_sdp (media, key, fp, &id_offset,
+              &id_len)))
+    return NULL;
+
+  make_sdp_session_id (session_id, sizeof (session_id));
+  result = g_strdup_printf ("%.*s%s%s", (gint) id_offset, text, session_id,
+      text + id_offset + id_len);
+  g_free (text);
+
+  return result;
+}
+
+/* make the SDP text for @media, use the cached SDP for shared media when we
+ * use the default create_sdp */
+static gchar *
+make_sdp_text (GstRTSPClient * client, GstRTSPMedia * media)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  GstRTSPClientClass *klass;
+  GstSDPMessage *sdp;
+  GstRTSPSdpFingerprint *fp = NULL;
+  gchar *key = NULL, *text;
+
+  klass = GST_RTSP_CLIENT_GET_CLASS (client);
+
+  if (klass->create_sdp == create_sdp && gst_rtsp_media_is_shared (media)) {
+    key = g_strdup_printf ("%s %s", priv->is_ipv6 ? "IP6" : "IP4",
+        GST_STR_NULL (priv->server_ip));
+    /* take the fingerprint before making the SDP, if something changes while
+     * we make the SDP, the next lookup will not match */
+    fp = gst_rtsp_media_sdp_fingerprint_new (media);
+
+    if (fp && (text = sdp_cache_lookup (media, key, fp))) {
+      GST_DEBUG ("client %p: using cached SDP", client);
+      gst_rtsp_media_sdp_fingerprint_free (fp);
+      g_free (key);
+      return text;
+    }
+  }
+
+  /* create an SDP for the media object on this client */
+  if (!(sdp = klass->create_sdp (client, media)))
+    goto no_sdp;
+
+  text = gst_sdp_message_as_text (sdp);
+  gst_sdp_message_free (sdp);
+
+  if (fp)
+    gst_rtsp_media_cache_sdp (media, key, fp, text);
+  g_free (key);
+
+  return text;
+
+  /* ERRORS */
+no_sdp:
+  {
+    if (fp)
+      gst_rtsp_media_sdp_fingerprint_free (fp);
+    g_free (key);
+    return NULL;
+  }
+}
+
 /* for the describe we must generate an SDP */
 static gboolean
 handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
 {
   GstRTSPClientPrivate *priv = client->priv;
   GstRTSPResult res;
-  GstSDPMessage *sdp;
   guint i;
-  gchar *path, *str;
+  gchar *path, *str, *sdp;
   GstRTSPMedia *media;
-  GstRTSPClientClass *klass;
-
-  klass = GST_RTSP_CLIENT_GET_CLASS (client);
+  guint span;
 
   if (!ctx->uri)
     goto no_uri;
@@ -2183,8 +3306,10 @@ handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
     goto unsupported_mode;
 
   /* create an SDP for the media object on this client */
-  if (!(sdp = klass->create_sdp (client, media)))
+  span = gst_rtsp_context_trace_begin (ctx, "sdp");
+  if (!(sdp = make_sdp_text (client, media)))
     goto no_sdp;
+  gst_rtsp_context_trace_end (ctx, span);
 
   /* we suspend after the describe */
   gst_rtsp_media_suspend (media);
@@ -2204,9 +3329,7 @@ handle_describe_request (GstRTSPClient * client, GstRTSPContext * ctx)
   gst_rtsp_message_take_header (ctx->response, GST_RTSP_HDR_CONTENT_BASE, str);
 
   /* add SDP to the response body */
-  str = gst_sdp_message_as_text (sdp);
-  gst_rtsp_message_take_body (ctx->response, (guint8 *) str, strlen (str));
-  gst_sdp_message_free (sdp);
+  gst_rtsp_message_take_body (ctx->response, (guint8 *) sdp, strlen (sdp));
 
   send_message (client, ctx, ctx->response, FALSE);
 
@@ -2236,7 +3359,9 @@ no_path:
   }
 no_media:
   {
-    GST_ERROR ("client %p: no media", client);
+    /* a suspended request is handled again when the media is prepared */
+    if (!priv->suspend)
+      GST_ERROR ("client %p: no media", client);
     g_free (path);
     /* error reply is already sent */
     return FALSE;
@@ -2570,8 +3695,10 @@ handle_options_request (GstRTSPClient * client, GstRTSPContext * ctx)
 
   send_message (client, ctx, ctx->response, FALSE);
 
-  g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_OPTIONS_REQUEST],
-      0, ctx);
+  if (signal_is_connected (client, SIGNAL_OPTIONS_REQUEST,
+          GST_RTSP_CLIENT_GET_CLASS (client)->options_request))
+    g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_OPTIONS_REQUEST],
+        0, ctx);
 
   return TRUE;
 }
@@ -2690,6 +3817,40 @@ done:
   return result;
 }
 
+/* parse @uristr, an absolute path is taken relative to the server ip */
+static gboolean
+parse_uri (GstRTSPClient * client, const gchar * uristr, GstRTSPUrl ** uri)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+  gchar *scheme, *absolute_uristr;
+  GstRTSPResult res;
+
+  if (gst_rtsp_url_parse (uristr, uri) == GST_RTSP_OK)
+    return TRUE;
+
+  /* check if the uristr is an absolute path <=> scheme and host information
+   * is missing */
+  scheme = g_uri_parse_scheme (uristr);
+  if (scheme != NULL || !g_str_has_prefix (uristr, "/")) {
+    g_free (scheme);
+    return FALSE;
+  }
+
+  GST_WARNING_OBJECT (client, "request doesn't contain absolute url");
+  if (priv->server_ip == NULL) {
+    GST_WARNING_OBJECT (client, "host information missing");
+    return FALSE;
+  }
+
+  absolute_uristr = g_strdup_printf ("rtsp://%s%s", priv->server_ip, uristr);
+
+  GST_DEBUG_OBJECT (client, "absolute url: %s", absolute_uristr);
+  res = gst_rtsp_url_parse (absolute_uristr, uri);
+  g_free (absolute_uristr);
+
+  return res == GST_RTSP_OK;
+}
+
 static void
 handle_request (GstRTSPClient * client, GstRTSPMessage * request)
 {
@@ -2704,6 +3865,19 @@ handle_request (GstRTSPClient * client, GstRTSPMessage * request)
   GstRTSPMessage response = { 0 };
   gchar *unsupported_reqs = NULL;
   gchar *sessid;
+  gint64 start;
+  GArray *trace = NULL, *old_trace;
+  guint request_span = 0, span;
+
+  if (priv->suspended) {
+    if (g_queue_get_length (&priv->pending_requests) >= MAX_PENDING_REQUESTS)
+      goto too_many_pending;
+
+    /* keep the order, handle this after the suspended request */
+    GST_DEBUG ("client %p: queueing request, waiting for media", client);
+    g_queue_push_tail (&priv->pending_requests, steal_message (request));
+    return;
+  }
 
   if (!(ctx = gst_rtsp_context_get_current ())) {
     ctx = &sctx;
@@ -2711,6 +3885,29 @@ handle_request (GstRTSPClient * client, GstRTSPMessage * request)
     gst_rtsp_context_push_current (ctx);
   }
 
+  /* a resumed request is timed from when it was first received and continues
+   * its trace */
+  old_trace = ctx->trace;
+  if (priv->resumed_start) {
+    start = priv->resumed_start;
+    priv->resumed_start = 0;
+    if ((trace = priv->suspended_trace)) {
+      priv->suspended_trace = NULL;
+      ctx->trace = trace;
+      gst_rtsp_context_trace_end (ctx, priv->suspended_span);
+      /* the first span is the one of the request */
+      request_span = 1;
+    }
+  } else {
+    start = g_get_monotonic_time ();
+    if (signal_is_connected (client, SIGNAL_REQUEST_TRACED, NULL)) {
+      trace = g_array_new (FALSE, FALSE, sizeof (GstRTSPTraceSpan));
+      ctx->trace = trace;
+      request_span = gst_rtsp_context_trace_begin (ctx, "request");
+    }
+  }
+  ctx->trace = trace;
+
   ctx->conn = priv->connection;
   ctx->client = client;
   ctx->request = request;
@@ -2735,34 +3932,19 @@ handle_request (GstRTSPClient * client, GstRTSPMessage * request)
   /* we always try to parse the url first */
   if (strcmp (uristr, "*") == 0) {
     /* special case where we have * as uri, keep uri = NULL */
-  } else if (gst_rtsp_url_parse (uristr, &uri) != GST_RTSP_OK) {
-    /* check if the uristr is an absolute path <=> scheme and host information
-     * is missing */
-    gchar *scheme;
-
-    scheme = g_uri_parse_scheme (uristr);
-    if (scheme == NULL && g_str_has_prefix (uristr, "/")) {
-      gchar *absolute_uristr = NULL;
-
-      GST_WARNING_OBJECT (client, "request doesn't contain absolute url");
-      if (priv->server_ip == NULL) {
-        GST_WARNING_OBJECT (client, "host information missing");
-        goto bad_request;
-      }
+  } else if (priv->uri_str && strcmp (uristr, priv->uri_str) == 0) {
+    /* same url as the previous request, it was parsed and sanitized already */
+    uri = priv->uri;
+  } else {
+    if (!parse_uri (client, uristr, &uri))
+      goto bad_request;
 
-      absolute_uristr =
-          g_strdup_printf ("rtsp://%s%s", priv->server_ip, uristr);
+    /* sanitize the uri */
+    sanitize_uri (uri);
 
-      GST_DEBUG_OBJECT (client, "absolute url: %s", absolute_uristr);
-      if (gst_rtsp_url_parse (absolute_uristr, &uri) != GST_RTSP_OK) {
-        g_free (absolute_uristr);
-        goto bad_request;
-      }
-      g_free (absolute_uristr);
-    } else {
-      g_free (scheme);
-      goto bad_request;
-    }
+    clear_cached_uri (client);
+    priv->uri_str = g_strdup (uristr);
+    priv->uri = uri;
   }
 
   /* get the session if there is any */
@@ -2781,17 +3963,23 @@ handle_request (GstRTSPClient * client, GstRTSPMessage * request)
     client_watch_session (client, session);
   }
 
-  /* sanitize the uri */
-  if (uri)
-    sanitize_uri (uri);
   ctx->uri = uri;
   ctx->session = session;
 
-  if (!gst_rtsp_auth_check (GST_RTSP_AUTH_CHECK_URL))
-    goto not_authorized;
+  /* only check when the auth could refuse the method, a resumed request was
+   * checked before it was suspended */
+  if (priv->resuming) {
+    /* nothing to check */
+  } else if ((method & priv->unchecked_methods) == 0 ||
+      ctx->auth != priv->auth) {
+    span = gst_rtsp_context_trace_begin (ctx, "auth");
+    if (!gst_rtsp_auth_check (GST_RTSP_AUTH_CHECK_URL))
+      goto not_authorized;
+    gst_rtsp_context_trace_end (ctx, span);
+  }
 
   /* handle any 'Require' headers */
-  if (!check_request_requirements (ctx, &unsupported_reqs))
+  if (!priv->resuming && !check_request_requirements (ctx, &unsupported_reqs))
     goto unsupported_requirement;
 
   /* the backlog must be unlimited while processing requests.
@@ -2872,15 +4060,46 @@ handle_request (GstRTSPClient * client, GstRTSPMessage * request)
     gst_rtsp_watch_set_send_backlog (priv->watch, 0, WATCH_BACKLOG_SIZE);
 
 done:
+  if (trace) {
+    if (priv->suspend) {
+      /* continue the trace when the request is resumed */
+      priv->suspended_span = gst_rtsp_context_trace_begin (ctx, "suspended");
+      priv->suspended_trace = trace;
+    } else {
+      gst_rtsp_context_trace_end (ctx, request_span);
+      g_signal_emit (client, gst_rtsp_client_signals[SIGNAL_REQUEST_TRACED],
+          0, ctx);
+      g_array_free (trace, TRUE);
+    }
+  }
+  ctx->trace = old_trace;
+
   if (ctx == &sctx)
     gst_rtsp_context_pop_current (ctx);
   if (session)
     g_object_unref (session);
-  if (uri)
-    gst_rtsp_url_free (uri);
+  if (priv->suspend) {
+    /* keep the request until the media is prepared */
+    priv->suspend = FALSE;
+    priv->suspended = steal_message (request);
+    priv->suspended_start = start;
+  } else if (method != GST_RTSP_INVALID && priv->request_metrics) {
+    gst_rtsp_request_metrics_observe (priv->request_metrics, method,
+        (g_get_monotonic_time () - start) * GST_USECOND);
+  }
   return;
 
   /* ERRORS */
+too_many_pending:
+  {
+    GST_ERROR ("client %p: too many requests waiting for media", client);
+    sctx.conn = priv->connection;
+    sctx.client = client;
+    sctx.request = request;
+    sctx.response = &response;
+    send_generic_response (client, GST_RTSP_STS_SERVICE_UNAVAILABLE, &sctx);
+    return;
+  }
 not_supported:
   {
     GST_ERROR ("client %p: version %d not supported", client, version);
@@ -3192,6 +4411,10 @@ gst_rtsp_client_set_auth (GstRTSPClient * client, GstRTSPAuth * auth)
   g_mutex_lock (&priv->lock);
   old = priv->auth;
   priv->auth = auth;
+  if (auth)
+    priv->unchecked_methods = gst_rtsp_auth_get_unchecked_methods (auth);
+  else
+    priv->unchecked_methods = (GstRTSPMethod) ~0;
   g_mutex_unlock (&priv->lock);
 
   if (old)
@@ -3328,6 +4551,8 @@ gst_rtsp_client_set_connection (GstRTSPClient * client,
     priv->is_ipv6 = g_socket_get_family (read_socket) == G_SOCKET_FAMILY_IPV6;
     priv->server_ip = g_strdup ("unknown");
   }
+  /* relative urls are resolved against the server ip */
+  clear_cached_uri (client);
 
   GST_INFO ("client %p connected to server ip %s, ipv6 = %d", client,
       priv->server_ip, priv->is_ipv6);
@@ -3528,6 +4753,58 @@ message_received (GstRTSPWatch * watch, GstRTSPMessage * message,
   return gst_rtsp_client_handle_message (GST_RTSP_CLIENT (user_data), message);
 }
 
+/* flush the send queue if the send_lock is free. A streaming thread can hold
+ * the send_lock while it waits for room in the backlog of the watch, we can't
+ * block on it from the watch callbacks */
+static gboolean
+send_queue_try_flush (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  if (!g_mutex_trylock (&priv->send_lock))
+    return FALSE;
+
+  if (priv->send_func == do_send_message && priv->send_queue.length > 0)
+    send_queue_flush (client);
+  g_mutex_unlock (&priv->send_lock);
+
+  return TRUE;
+}
+
+static gboolean
+send_queue_retry (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  if (!send_queue_try_flush (client))
+    return G_SOURCE_CONTINUE;
+
+  priv->send_queue_retry = NULL;
+
+  return G_SOURCE_REMOVE;
+}
+
+/* try the flush again later from the client thread, packets that are queued
+ * now would otherwise wait for the next packet of the stream, which might
+ * never come after EOS or PAUSE */
+static void
+send_queue_schedule_retry (GstRTSPClient * client)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  if (priv->send_queue_retry || priv->watch_context == NULL)
+    return;
+
+  GST_DEBUG_OBJECT (client, "send_lock busy, retrying the flush later");
+
+  priv->send_queue_retry = g_timeout_source_new (SEND_QUEUE_RETRY_INTERVAL);
+  g_source_set_callback (priv->send_queue_retry,
+      (GSourceFunc) send_queue_retry, g_object_ref (client),
+      (GDestroyNotify) g_object_unref);
+  g_source_attach (priv->send_queue_retry, priv->watch_context);
+  g_source_unref (priv->send_queue_retry);
+}
+
 static GstRTSPResult
 message_sent (GstRTSPWatch * watch, guint cseq, gpointer user_data)
 {
@@ -3540,6 +4817,10 @@ message_sent (GstRTSPWatch * watch, guint cseq, gpointer user_data)
     gst_rtsp_client_close (client);
   }
 
+  /* there is room in the backlog again, move queued packets to the watch */
+  if (!send_queue_try_flush (client))
+    send_queue_schedule_retry (client);
+
   return GST_RTSP_OK;
 }
 
@@ -3564,6 +4845,10 @@ closed (GstRTSPWatch * watch, gpointer user_data)
   gst_rtsp_client_set_send_func (client, NULL, NULL, NULL);
   g_mutex_unlock (&priv->watch_lock);
 
+  g_mutex_lock (&priv->send_lock);
+  send_queue_clear (client);
+  g_mutex_unlock (&priv->send_lock);
+
   return GST_RTSP_OK;
 }
 
@@ -3924,3 +5209,43 @@ restart:
 
   return result;
 }
+
+/* get the number of packets and bytes waiting in the send queue of @client */
+void
+gst_rtsp_client_get_send_queue_depth (GstRTSPClient * client,
+    guint * packets, guint * bytes)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  g_mutex_lock (&priv->send_lock);
+  *packets = priv->send_queue.length;
+  *bytes = priv->send_queue_bytes;
+  g_mutex_unlock (&priv->send_lock);
+}
+
+/* count the request latency of @client in @metrics, must be called before
+ * @client is attached */
+void
+gst_rtsp_client_set_request_metrics (GstRTSPClient * client,
+    GstRTSPRequestMetrics * metrics)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  if (priv->request_metrics)
+    gst_rtsp_request_metrics_unref (priv->request_metrics);
+  priv->request_metrics =
+      metrics ? gst_rtsp_request_metrics_ref (metrics) : NULL;
+}
+
+/* count the packets that are copied for @client and its transports in
+ * @metrics, must be called before @client is attached */
+void
+gst_rtsp_client_set_copy_metrics (GstRTSPClient * client,
+    GstRTSPCopyMetrics * metrics)
+{
+  GstRTSPClientPrivate *priv = client->priv;
+
+  if (priv->copy_metrics)
+    gst_rtsp_copy_metrics_unref (priv->copy_metrics);
+  priv->copy_metrics = metrics ? gst_rtsp_copy_metrics_ref (metrics) : NULL;
+}
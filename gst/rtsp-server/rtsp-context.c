@@ -25,6 +25,7 @@
  */
 
 #include "rtsp-context.h"
+#include "rtsp-server-internal.h"
 
 G_DEFINE_POINTER_TYPE (GstRTSPContext, gst_rtsp_context);
 
@@ -90,3 +91,70 @@ gst_rtsp_context_pop_current (GstRTSPContext * ctx)
   l = g_slist_delete_link (l, l);
   g_private_set (&current_context, l);
 }
+
+/**
+ * gst_rtsp_context_trace_begin:
+ * @ctx: (allow-none): a #GstRTSPContext
+ * @name: the name of the stage, must stay valid for the lifetime of the
+ *   process such as a string literal
+ *
+ * Record the start of stage @name of the request in @ctx. This only checks
+ * @ctx when the request is not traced. Requests are traced when a handler is
+ * connected to the #GstRTSPClient::request-traced signal.
+ *
+ * Returns: the span to pass to gst_rtsp_context_trace_end(), 0 when the
+ * request is not traced.
+ *
+ * Since: 1.6
+ */
+guint
+gst_rtsp_context_trace_begin (GstRTSPContext * ctx, const gchar * name)
+{
+  GstRTSPTraceSpan span;
+
+  if (ctx == NULL || ctx->trace == NULL)
+    return 0;
+
+  span.name = name;
+  span.start = g_get_monotonic_time ();
+  span.end = 0;
+  g_array_append_val (ctx->trace, span);
+
+  return ctx->trace->len;
+}
+
+/**
+ * gst_rtsp_context_trace_end:
+ * @ctx: (allow-none): a #GstRTSPContext
+ * @span: a span returned by gst_rtsp_context_trace_begin()
+ *
+ * Record the end of @span of the request in @ctx.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_context_trace_end (GstRTSPContext * ctx, guint span)
+{
+  if (ctx == NULL || ctx->trace == NULL || span == 0 || span > ctx->trace->len)
+    return;
+
+  g_array_index (ctx->trace, GstRTSPTraceSpan, span - 1).end =
+      g_get_monotonic_time ();
+}
+
+/* add a span of a stage that was measured elsewhere, such as in another
+ * thread */
+void
+gst_rtsp_context_trace_add (GstRTSPContext * ctx, const gchar * name,
+    gint64 start, gint64 end)
+{
+  GstRTSPTraceSpan span;
+
+  if (ctx == NULL || ctx->trace == NULL)
+    return;
+
+  span.name = name;
+  span.start = start;
+  span.end = end;
+  g_array_append_val (ctx->trace, span);
+}
@@ -28,6 +28,7 @@ G_BEGIN_DECLS
 #define GST_TYPE_RTSP_CONTEXT              (gst_rtsp_context_get_type ())
 
 typedef struct _GstRTSPContext GstRTSPContext;
+typedef struct _GstRTSPTraceSpan GstRTSPTraceSpan;
 
 #include "rtsp-server.h"
 #include "rtsp-media.h"
@@ -54,6 +55,8 @@ typedef struct _GstRTSPContext GstRTSPContext;
  * @stream: the stream for the url can be %NULL
  * @response: the response
  * @trans: the stream transport, can be %NULL
+ * @trace: (element-type GstRTSPTraceSpan): the #GstRTSPTraceSpan of the
+ *   stages of the request or %NULL when the request is not traced. Since 1.6
  *
  * Information passed around containing the context of a request.
  */
@@ -73,9 +76,27 @@ struct _GstRTSPContext {
   GstRTSPStream          *stream;
   GstRTSPMessage         *response;
   GstRTSPStreamTransport *trans;
+  GArray                 *trace;
 
   /*< private >*/
-  gpointer            _gst_reserved[GST_PADDING - 1];
+  gpointer            _gst_reserved[GST_PADDING - 2];
+};
+
+/**
+ * GstRTSPTraceSpan:
+ * @name: the name of the stage
+ * @start: the monotonic time when the stage started, in microseconds
+ * @end: the monotonic time when the stage ended, in microseconds, or 0 when
+ *   the stage did not complete
+ *
+ * The time spent in one stage of a request.
+ *
+ * Since: 1.6
+ */
+struct _GstRTSPTraceSpan {
+  const gchar *name;
+  gint64       start;
+  gint64       end;
 };
 
 GType gst_rtsp_context_get_type (void);
@@ -84,6 +105,9 @@ GstRTSPContext *     gst_rtsp_context_get_current   (void);
 void                 gst_rtsp_context_push_current  (GstRTSPContext * ctx);
 void                 gst_rtsp_context_pop_current   (GstRTSPContext * ctx);
 
+guint                gst_rtsp_context_trace_begin   (GstRTSPContext * ctx, const gchar * name);
+void                 gst_rtsp_context_trace_end     (GstRTSPContext * ctx, guint span);
+
 
 G_END_DECLS
 
@@ -39,6 +39,8 @@
  */
 
 #include "rtsp-media-factory.h"
+#include "rtsp-server-internal.h"
+#include "rtsp-metrics.h"
 
 #define GST_RTSP_MEDIA_FACTORY_GET_PRIVATE(obj)  \
        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_MEDIA_FACTORY, GstRTSPMediaFactoryPrivate))
@@ -60,6 +62,9 @@ struct _GstRTSPMediaFactoryPrivate
   guint buffer_size;
   GstRTSPAddressPool *pool;
   GstRTSPTransportMode transport_mode;
+  GstRTSPUdpSendMode udp_send_mode;
+  gboolean gop_cache;
+  gboolean connected_udp;
 
   GstClockTime rtx_time;
   guint latency;
@@ -67,7 +72,18 @@ struct _GstRTSPMediaFactoryPrivate
   GMutex medias_lock;
   GHashTable *medias;           /* protected by medias_lock */
 
+  /* media prepared in advance per key, protected by medias_lock */
+  guint standby_size;
+  GHashTable *standby;
+  GThreadPool *standby_worker;
+  /* for media constructed outside of a request */
+  GstRTSPThreadPool *standby_threads;
+
   GType media_gtype;
+
+  /* metrics */
+  gint n_constructed;           /* atomic */
+  GstRTSPHistogram *prepare_latency;
 };
 
 #define DEFAULT_LAUNCH          NULL
@@ -80,6 +96,18 @@ struct _GstRTSPMediaFactoryPrivate
 #define DEFAULT_BUFFER_SIZE     0x80000
 #define DEFAULT_LATENCY         200
 #define DEFAULT_TRANSPORT_MODE  GST_RTSP_TRANSPORT_MODE_PLAY
+#define DEFAULT_UDP_SEND_MODE   GST_RTSP_UDP_SEND_MODE_SINK
+#define DEFAULT_GOP_CACHE       FALSE
+#define DEFAULT_CONNECTED_UDP   FALSE
+#define DEFAULT_STANDBY_POOL_SIZE 0
+
+/* the request rate for the standby pool is measured over this window */
+#define STANDBY_WINDOW          (10 * G_TIME_SPAN_SECOND)
+/* the max number of urls that have media on standby */
+#define STANDBY_MAX_KEYS        8
+/* the media on standby for a url are dropped when it was not requested for
+ * this long */
+#define STANDBY_IDLE            (6 * STANDBY_WINDOW)
 
 enum
 {
@@ -93,6 +121,10 @@ enum
   PROP_BUFFER_SIZE,
   PROP_LATENCY,
   PROP_TRANSPORT_MODE,
+  PROP_UDP_SEND_MODE,
+  PROP_GOP_CACHE,
+  PROP_CONNECTED_UDP,
+  PROP_STANDBY_POOL_SIZE,
   PROP_LAST
 };
 
@@ -125,6 +157,26 @@ static void default_configure (GstRTSPMediaFactory * factory,
 static GstElement *default_create_pipeline (GstRTSPMediaFactory * factory,
     GstRTSPMedia * media);
 
+/* the media on standby for one key */
+typedef struct
+{
+  gchar *key;
+  GstRTSPUrl *url;
+  /* the thread pool of the server that last requested @url */
+  GstRTSPThreadPool *threads;
+  GQueue media;
+  guint target;
+  guint requests;
+  gint64 window;
+  gint64 last_used;
+  gboolean filling;
+} StandbyPool;
+
+static void standby_pool_free (StandbyPool * sp);
+static GList *standby_trim (StandbyPool * sp, guint size);
+static void standby_release (GList * stale);
+static void standby_fill (GstRTSPMediaFactory * factory, gpointer user_data);
+
 G_DEFINE_TYPE (GstRTSPMediaFactory, gst_rtsp_media_factory, G_TYPE_OBJECT);
 
 static void
@@ -202,6 +254,28 @@ gst_rtsp_media_factory_class_init (GstRTSPMediaFactoryClass * klass)
           GST_TYPE_RTSP_TRANSPORT_MODE, DEFAULT_TRANSPORT_MODE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_UDP_SEND_MODE,
+      g_param_spec_enum ("udp-send-mode", "UDP Send Mode",
+          "How media from this factory send to UDP unicast destinations",
+          GST_TYPE_RTSP_UDP_SEND_MODE, DEFAULT_UDP_SEND_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE,
+      g_param_spec_boolean ("gop-cache", "GOP Cache",
+          "Send the packets since the last keyframe to new clients",
+          DEFAULT_GOP_CACHE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CONNECTED_UDP,
+      g_param_spec_boolean ("connected-udp", "Connected UDP",
+          "Receive from each UDP unicast client on its own connected socket",
+          DEFAULT_CONNECTED_UDP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_STANDBY_POOL_SIZE,
+      g_param_spec_uint ("standby-pool-size", "Standby Pool Size",
+          "The maximum number of prepared media to keep ready for new "
+          "clients (0 = disabled)", 0, G_MAXUINT, DEFAULT_STANDBY_POOL_SIZE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONSTRUCTED] =
       g_signal_new ("media-constructed", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (GstRTSPMediaFactoryClass,
@@ -240,12 +314,19 @@ gst_rtsp_media_factory_init (GstRTSPMediaFactory * factory)
   priv->buffer_size = DEFAULT_BUFFER_SIZE;
   priv->latency = DEFAULT_LATENCY;
   priv->transport_mode = DEFAULT_TRANSPORT_MODE;
+  priv->udp_send_mode = DEFAULT_UDP_SEND_MODE;
+  priv->gop_cache = DEFAULT_GOP_CACHE;
+  priv->connected_udp = DEFAULT_CONNECTED_UDP;
+  priv->standby_size = DEFAULT_STANDBY_POOL_SIZE;
 
   g_mutex_init (&priv->lock);
   g_mutex_init (&priv->medias_lock);
   priv->medias = g_hash_table_new_full (g_str_hash, g_str_equal,
       g_free, g_object_unref);
+  priv->standby = g_hash_table_new_full (g_str_hash, g_str_equal,
+      NULL, (GDestroyNotify) standby_pool_free);
   priv->media_gtype = GST_TYPE_RTSP_MEDIA;
+  priv->prepare_latency = gst_rtsp_histogram_new ();
 }
 
 static void
@@ -253,6 +334,21 @@ gst_rtsp_media_factory_finalize (GObject * obj)
 {
   GstRTSPMediaFactory *factory = GST_RTSP_MEDIA_FACTORY (obj);
   GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  GHashTableIter iter;
+  gpointer value;
+  GList *stale = NULL;
+
+  g_hash_table_iter_init (&iter, priv->standby);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    stale = g_list_concat (stale, standby_trim (value, 0));
+  g_hash_table_unref (priv->standby);
+  standby_release (stale);
+  /* the worker keeps a ref while it runs, this can be called from the worker
+   * so don't wait for it */
+  if (priv->standby_worker)
+    g_thread_pool_free (priv->standby_worker, TRUE, FALSE);
+  if (priv->standby_threads)
+    g_object_unref (priv->standby_threads);
 
   if (priv->permissions)
     gst_rtsp_permissions_unref (priv->permissions);
@@ -262,6 +358,7 @@ gst_rtsp_media_factory_finalize (GObject * obj)
   g_mutex_clear (&priv->lock);
   if (priv->pool)
     g_object_unref (priv->pool);
+  gst_rtsp_histogram_free (priv->prepare_latency);
 
   G_OBJECT_CLASS (gst_rtsp_media_factory_parent_class)->finalize (obj);
 }
@@ -304,6 +401,22 @@ gst_rtsp_media_factory_get_property (GObject * object, guint propid,
       g_value_set_flags (value,
           gst_rtsp_media_factory_get_transport_mode (factory));
       break;
+    case PROP_UDP_SEND_MODE:
+      g_value_set_enum (value,
+          gst_rtsp_media_factory_get_udp_send_mode (factory));
+      break;
+    case PROP_GOP_CACHE:
+      g_value_set_boolean (value,
+          gst_rtsp_media_factory_get_gop_cache (factory));
+      break;
+    case PROP_CONNECTED_UDP:
+      g_value_set_boolean (value,
+          gst_rtsp_media_factory_get_connected_udp (factory));
+      break;
+    case PROP_STANDBY_POOL_SIZE:
+      g_value_set_uint (value,
+          gst_rtsp_media_factory_get_standby_pool_size (factory));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -347,6 +460,22 @@ gst_rtsp_media_factory_set_property (GObject * object, guint propid,
       gst_rtsp_media_factory_set_transport_mode (factory,
           g_value_get_flags (value));
       break;
+    case PROP_UDP_SEND_MODE:
+      gst_rtsp_media_factory_set_udp_send_mode (factory,
+          g_value_get_enum (value));
+      break;
+    case PROP_GOP_CACHE:
+      gst_rtsp_media_factory_set_gop_cache (factory,
+          g_value_get_boolean (value));
+      break;
+    case PROP_CONNECTED_UDP:
+      gst_rtsp_media_factory_set_connected_udp (factory,
+          g_value_get_boolean (value));
+      break;
+    case PROP_STANDBY_POOL_SIZE:
+      gst_rtsp_media_factory_set_standby_pool_size (factory,
+          g_value_get_uint (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -984,6 +1113,23 @@ media_unprepared (GstRTSPMedia * media, GWeakRef * ref)
   g_object_unref (factory);
 }
 
+static void
+media_prepared (GstRTSPMedia * media, GWeakRef * ref)
+{
+  GstRTSPMediaFactory *factory = g_weak_ref_get (ref);
+  GstClockTime latency;
+
+  if (!factory)
+    return;
+
+  /* prepared is emitted for each waiting client, count the prepare once */
+  latency = gst_rtsp_media_take_prepare_latency (media);
+  if (GST_CLOCK_TIME_IS_VALID (latency))
+    gst_rtsp_histogram_observe (factory->priv->prepare_latency, latency);
+
+  g_object_unref (factory);
+}
+
 static GWeakRef *
 weak_ref_new (gpointer obj)
 {
@@ -1000,6 +1146,370 @@ weak_ref_free (GWeakRef * ref)
   g_slice_free (GWeakRef, ref);
 }
 
+/* construct and configure a new media for @url */
+static GstRTSPMedia *
+construct_media (GstRTSPMediaFactory * factory, const GstRTSPUrl * url)
+{
+  GstRTSPMediaFactoryClass *klass;
+  GstRTSPMedia *media;
+
+  klass = GST_RTSP_MEDIA_FACTORY_GET_CLASS (factory);
+
+  if (klass->construct == NULL)
+    return NULL;
+
+  media = klass->construct (factory, url);
+  if (media == NULL)
+    return NULL;
+
+  g_atomic_int_inc (&factory->priv->n_constructed);
+  g_signal_connect_data (media, "prepared", (GCallback) media_prepared,
+      weak_ref_new (factory), (GClosureNotify) weak_ref_free, 0);
+
+  g_signal_emit (factory,
+      gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONSTRUCTED], 0, media, NULL);
+
+  /* configure the media */
+  if (klass->configure)
+    klass->configure (factory, media);
+
+  g_signal_emit (factory,
+      gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONFIGURE], 0, media, NULL);
+
+  if (!gst_rtsp_media_is_reusable (media)) {
+    /* when not reusable, connect to the unprepare signal to remove the item
+     * from our cache when it gets unprepared */
+    g_signal_connect_data (media, "unprepared",
+        (GCallback) media_unprepared, weak_ref_new (factory),
+        (GClosureNotify) weak_ref_free, 0);
+  }
+  return media;
+}
+
+static StandbyPool *
+standby_pool_new (const gchar * key, const GstRTSPUrl * url)
+{
+  StandbyPool *sp;
+
+  sp = g_slice_new0 (StandbyPool);
+  sp->key = g_strdup (key);
+  sp->url = gst_rtsp_url_copy (url);
+  g_queue_init (&sp->media);
+
+  return sp;
+}
+
+/* the media of @sp must have been trimmed */
+static void
+standby_pool_free (StandbyPool * sp)
+{
+  g_free (sp->key);
+  gst_rtsp_url_free (sp->url);
+  if (sp->threads)
+    g_object_unref (sp->threads);
+  g_slice_free (StandbyPool, sp);
+}
+
+/* called with medias_lock, returns the media that were removed from @sp. They
+ * must be released without the lock. */
+static GList *
+standby_trim (StandbyPool * sp, guint size)
+{
+  GList *stale = NULL;
+
+  while (g_queue_get_length (&sp->media) > size)
+    stale = g_list_prepend (stale, g_queue_pop_tail (&sp->media));
+
+  return stale;
+}
+
+static void
+standby_release (GList * stale)
+{
+  GList *walk;
+
+  for (walk = stale; walk; walk = g_list_next (walk)) {
+    GstRTSPMedia *media = walk->data;
+
+    gst_rtsp_media_unprepare (media);
+    g_object_unref (media);
+  }
+  g_list_free (stale);
+}
+
+/* called with medias_lock. Drop the pools that were not requested for
+ * STANDBY_IDLE and the least recently requested pools until at most @max
+ * are left. */
+static GList *
+standby_expire (GstRTSPMediaFactoryPrivate * priv, guint max, gint64 now)
+{
+  GHashTableIter iter;
+  gpointer value;
+  StandbyPool *oldest;
+  GList *stale = NULL;
+
+  do {
+    oldest = NULL;
+    g_hash_table_iter_init (&iter, priv->standby);
+    while (g_hash_table_iter_next (&iter, NULL, &value)) {
+      StandbyPool *sp = value;
+
+      if (now - sp->last_used >= STANDBY_IDLE) {
+        GST_DEBUG ("standby pool for %s idle", sp->key);
+        stale = g_list_concat (stale, standby_trim (sp, 0));
+        g_hash_table_iter_remove (&iter);
+      } else if (oldest == NULL || sp->last_used < oldest->last_used) {
+        oldest = sp;
+      }
+    }
+    if (oldest && g_hash_table_size (priv->standby) > max) {
+      GST_DEBUG ("dropping standby pool for %s", oldest->key);
+      stale = g_list_concat (stale, standby_trim (oldest, 0));
+      g_hash_table_remove (priv->standby, oldest->key);
+    } else {
+      oldest = NULL;
+    }
+  } while (oldest);
+
+  return stale;
+}
+
+/* called with medias_lock. Take a prepared media for @key from the standby
+ * pool and schedule a refill. The size of the pool of each key follows the
+ * number of requests for it in the last STANDBY_WINDOW, up to standby_size.
+ * Media are prepared in a thread of @threads. */
+static GstRTSPMedia *
+standby_take (GstRTSPMediaFactory * factory, const gchar * key,
+    const GstRTSPUrl * url, GstRTSPThreadPool * threads, GList ** stale)
+{
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  StandbyPool *sp;
+  GstRTSPMedia *media;
+  gboolean shared;
+  gint64 now;
+
+  if (priv->standby_size == 0 || key == NULL)
+    return NULL;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  shared = priv->shared;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  /* shared media are prepared once anyway */
+  if (shared)
+    return NULL;
+
+  now = g_get_monotonic_time ();
+  if (!(sp = g_hash_table_lookup (priv->standby, key))) {
+    GST_DEBUG ("factory %p: new standby pool for %s", factory, key);
+    *stale = g_list_concat (*stale,
+        standby_expire (priv, STANDBY_MAX_KEYS - 1, now));
+    sp = standby_pool_new (key, url);
+    sp->window = now;
+    g_hash_table_insert (priv->standby, sp->key, sp);
+  }
+  if (threads && threads != sp->threads) {
+    if (sp->threads)
+      g_object_unref (sp->threads);
+    sp->threads = g_object_ref (threads);
+  }
+  sp->last_used = now;
+
+  if (now - sp->window >= STANDBY_WINDOW) {
+    sp->target = CLAMP (sp->requests, 1, priv->standby_size);
+    sp->requests = 0;
+    sp->window = now;
+    *stale = g_list_concat (*stale, standby_trim (sp, sp->target));
+  }
+  sp->requests++;
+  /* grow right away when a burst exceeds the current target */
+  if (sp->requests > sp->target)
+    sp->target = MIN (sp->requests, priv->standby_size);
+
+  media = g_queue_pop_head (&sp->media);
+  GST_DEBUG ("factory %p: standby media %p for %s, target %u", factory, media,
+      key, sp->target);
+
+  if (!sp->filling && g_queue_get_length (&sp->media) < sp->target) {
+    if (priv->standby_worker == NULL)
+      priv->standby_worker = g_thread_pool_new ((GFunc) standby_fill, NULL, 1,
+          FALSE, NULL);
+    sp->filling = TRUE;
+    g_thread_pool_push (priv->standby_worker, g_object_ref (factory), NULL);
+  }
+  return media;
+}
+
+/* called with medias_lock. Get a pool that is below its target, NULL when all
+ * pools are filled */
+static StandbyPool *
+standby_next_fill (GstRTSPMediaFactoryPrivate * priv)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, priv->standby);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    StandbyPool *sp = value;
+
+    if (!sp->filling)
+      continue;
+    if (g_queue_get_length (&sp->media) < sp->target)
+      return sp;
+    sp->filling = FALSE;
+  }
+  return NULL;
+}
+
+/* called with medias_lock, stop filling after an error. The next request for
+ * a key will try again */
+static void
+standby_stop_fill (GstRTSPMediaFactoryPrivate * priv)
+{
+  GHashTableIter iter;
+  gpointer value;
+
+  g_hash_table_iter_init (&iter, priv->standby);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    ((StandbyPool *) value)->filling = FALSE;
+}
+
+typedef struct
+{
+  GstRTSPMediaFactory *factory;
+  const gchar *key;
+  gboolean queued;
+} StandbyPrepare;
+
+/* called from the prepare in standby_fill(), the media goes on standby as
+ * soon as it is prepared */
+static void
+standby_prepared (GstRTSPMedia * media, StandbyPrepare * prepare)
+{
+  GstRTSPMediaFactoryPrivate *priv = prepare->factory->priv;
+  StandbyPool *sp;
+
+  g_mutex_lock (&priv->medias_lock);
+  /* the pool could have been dropped or shrunk meanwhile */
+  sp = g_hash_table_lookup (priv->standby, prepare->key);
+  if (sp && g_queue_get_length (&sp->media) < priv->standby_size) {
+    GST_DEBUG ("factory %p: media %p on standby for %s", prepare->factory,
+        media, sp->key);
+    g_queue_push_tail (&sp->media, g_object_ref (media));
+    prepare->queued = TRUE;
+  }
+  g_mutex_unlock (&priv->medias_lock);
+}
+
+/* runs in the standby_worker pool, prepares media until the standby pools
+ * of @factory reach their target size */
+static void
+standby_fill (GstRTSPMediaFactory * factory, gpointer user_data)
+{
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  StandbyPool *sp;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPMedia *media;
+  GstRTSPUrl *url;
+  gchar *key;
+  StandbyPrepare prepare;
+  gulong id;
+  gboolean res;
+
+  g_mutex_lock (&priv->medias_lock);
+  while ((sp = standby_next_fill (priv))) {
+    if (sp->threads == NULL) {
+      if (priv->standby_threads == NULL)
+        priv->standby_threads = gst_rtsp_thread_pool_new ();
+      pool = g_object_ref (priv->standby_threads);
+    } else {
+      pool = g_object_ref (sp->threads);
+    }
+    url = gst_rtsp_url_copy (sp->url);
+    key = g_strdup (sp->key);
+    g_mutex_unlock (&priv->medias_lock);
+
+    media = construct_media (factory, url);
+    gst_rtsp_url_free (url);
+    if (media == NULL)
+      goto no_media;
+
+    if (gst_rtsp_media_is_shared (media) ||
+        gst_rtsp_media_get_transport_mode (media) !=
+        GST_RTSP_TRANSPORT_MODE_PLAY)
+      goto not_supported;
+
+    thread = gst_rtsp_thread_pool_get_thread (pool,
+        GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+    if (thread == NULL)
+      goto no_thread;
+
+    prepare.factory = factory;
+    prepare.key = key;
+    prepare.queued = FALSE;
+    id = g_signal_connect (media, "prepared", (GCallback) standby_prepared,
+        &prepare);
+
+    /* prepare takes ownership of the thread */
+    res = gst_rtsp_media_prepare (media, thread);
+    g_signal_handler_disconnect (media, id);
+    if (!res)
+      goto prepare_failed;
+
+    g_object_unref (pool);
+    g_free (key);
+
+    /* the standby pool has its own ref */
+    if (!prepare.queued)
+      gst_rtsp_media_unprepare (media);
+    g_object_unref (media);
+
+    g_mutex_lock (&priv->medias_lock);
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  g_object_unref (factory);
+  return;
+
+  /* ERRORS */
+no_media:
+  {
+    GST_WARNING ("factory %p: could not construct standby media", factory);
+    goto failed;
+  }
+not_supported:
+  {
+    GST_WARNING ("factory %p: shared or record media can't be on standby",
+        factory);
+    goto failed;
+  }
+no_thread:
+  {
+    GST_WARNING ("factory %p: no thread for standby media", factory);
+    goto failed;
+  }
+prepare_failed:
+  {
+    GST_WARNING ("factory %p: could not prepare standby media", factory);
+    goto failed;
+  }
+failed:
+  {
+    if (media)
+      g_object_unref (media);
+    g_object_unref (pool);
+    g_free (key);
+
+    g_mutex_lock (&priv->medias_lock);
+    standby_stop_fill (priv);
+    g_mutex_unlock (&priv->medias_lock);
+
+    g_object_unref (factory);
+    return;
+  }
+}
+
 /**
  * gst_rtsp_media_factory_construct:
  * @factory: a #GstRTSPMediaFactory
@@ -1015,6 +1525,11 @@ weak_ref_free (GWeakRef * ref)
  * After the media is constructed, it can be configured and then prepared
  * with gst_rtsp_media_prepare ().
  *
+ * When the standby pool is enabled with
+ * gst_rtsp_media_factory_set_standby_pool_size(), the returned media can
+ * already be prepared. It must still be prepared and unprepared as usual,
+ * the next gst_rtsp_media_prepare() takes over the prepare of the factory.
+ *
  * Returns: (transfer full): a new #GstRTSPMedia if the media could be prepared.
  */
 GstRTSPMedia *
@@ -1025,6 +1540,10 @@ gst_rtsp_media_factory_construct (GstRTSPMediaFactory * factory,
   gchar *key;
   GstRTSPMedia *media;
   GstRTSPMediaFactoryClass *klass;
+  gboolean standby;
+  GList *stale = NULL;
+  GstRTSPContext *ctx;
+  GstRTSPThreadPool *threads = NULL;
 
   g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), NULL);
   g_return_val_if_fail (url != NULL, NULL);
@@ -1039,6 +1558,11 @@ gst_rtsp_media_factory_construct (GstRTSPMediaFactory * factory,
   else
     key = NULL;
 
+  /* standby media are prepared in the threads of the server of the client */
+  if ((ctx = gst_rtsp_context_get_current ()) && ctx->client)
+    threads = gst_rtsp_client_get_thread_pool (ctx->client);
+
+retry:
   g_mutex_lock (&priv->medias_lock);
   if (key) {
     /* we have a key, see if we find a cached media */
@@ -1048,46 +1572,40 @@ gst_rtsp_media_factory_construct (GstRTSPMediaFactory * factory,
   } else
     media = NULL;
 
+  /* see if we have one prepared in advance */
+  standby = FALSE;
+  if (media == NULL &&
+      (media = standby_take (factory, key, url, threads, &stale)))
+    standby = TRUE;
+
   if (media == NULL) {
     /* nothing cached found, try to create one */
-    if (klass->construct) {
-      media = klass->construct (factory, url);
-      if (media)
-        g_signal_emit (factory,
-            gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONSTRUCTED], 0, media,
-            NULL);
-    } else
-      media = NULL;
-
-    if (media) {
-      /* configure the media */
-      if (klass->configure)
-        klass->configure (factory, media);
-
-      g_signal_emit (factory,
-          gst_rtsp_media_factory_signals[SIGNAL_MEDIA_CONFIGURE], 0, media,
-          NULL);
-
-      /* check if we can cache this media */
-      if (gst_rtsp_media_is_shared (media)) {
-        /* insert in the hashtable, takes ownership of the key */
-        g_object_ref (media);
-        g_hash_table_insert (priv->medias, key, media);
-        key = NULL;
-      }
-      if (!gst_rtsp_media_is_reusable (media)) {
-        /* when not reusable, connect to the unprepare signal to remove the item
-         * from our cache when it gets unprepared */
-        g_signal_connect_data (media, "unprepared",
-            (GCallback) media_unprepared, weak_ref_new (factory),
-            (GClosureNotify) weak_ref_free, 0);
-      }
+    media = construct_media (factory, url);
+
+    /* check if we can cache this media */
+    if (media && gst_rtsp_media_is_shared (media)) {
+      /* insert in the hashtable, takes ownership of the key */
+      g_object_ref (media);
+      g_hash_table_insert (priv->medias, key, media);
+      key = NULL;
     }
   }
   g_mutex_unlock (&priv->medias_lock);
 
+  standby_release (stale);
+  stale = NULL;
+
+  if (standby && !gst_rtsp_media_claim_standby (media)) {
+    GST_WARNING ("standby media %p is not usable anymore", media);
+    gst_rtsp_media_unprepare (media);
+    g_object_unref (media);
+    goto retry;
+  }
+
   if (key)
     g_free (key);
+  if (threads)
+    g_object_unref (threads);
 
   GST_INFO ("constructed media %p for url %s", media, url->abspath);
 
@@ -1278,6 +1796,9 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   GstClockTime rtx_time;
   guint latency;
   GstRTSPTransportMode transport_mode;
+  GstRTSPUdpSendMode udp_send_mode;
+  gboolean gop_cache;
+  gboolean connected_udp;
 
   /* configure the sharedness */
   GST_RTSP_MEDIA_FACTORY_LOCK (factory);
@@ -1290,6 +1811,9 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   rtx_time = priv->rtx_time;
   latency = priv->latency;
   transport_mode = priv->transport_mode;
+  udp_send_mode = priv->udp_send_mode;
+  gop_cache = priv->gop_cache;
+  connected_udp = priv->connected_udp;
   GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
 
   gst_rtsp_media_set_suspend_mode (media, suspend_mode);
@@ -1301,6 +1825,9 @@ default_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media)
   gst_rtsp_media_set_retransmission_time (media, rtx_time);
   gst_rtsp_media_set_latency (media, latency);
   gst_rtsp_media_set_transport_mode (media, transport_mode);
+  gst_rtsp_media_set_udp_send_mode (media, udp_send_mode);
+  gst_rtsp_media_set_gop_cache (media, gop_cache);
+  gst_rtsp_media_set_connected_udp (media, connected_udp);
 
   if ((pool = gst_rtsp_media_factory_get_address_pool (factory))) {
     gst_rtsp_media_set_address_pool (media, pool);
@@ -1393,3 +1920,268 @@ gst_rtsp_media_factory_get_transport_mode (GstRTSPMediaFactory * factory)
 
   return result;
 }
+
+/**
+ * gst_rtsp_media_factory_set_udp_send_mode:
+ * @factory: a #GstRTSPMediaFactory
+ * @mode: a #GstRTSPUdpSendMode
+ *
+ * Configure how media created from this factory send packets to UDP unicast
+ * destinations. With many unicast clients per stream,
+ * #GST_RTSP_UDP_SEND_MODE_FANOUT sends all packets to all clients in batches
+ * instead of with one system call per packet and client.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_factory_set_udp_send_mode (GstRTSPMediaFactory * factory,
+    GstRTSPUdpSendMode mode)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->udp_send_mode = mode;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_udp_send_mode:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get how media created from this factory send packets to UDP unicast
+ * destinations.
+ *
+ * Returns: the #GstRTSPUdpSendMode.
+ *
+ * Since: 1.6
+ */
+GstRTSPUdpSendMode
+gst_rtsp_media_factory_get_udp_send_mode (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GstRTSPUdpSendMode result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory),
+      GST_RTSP_UDP_SEND_MODE_SINK);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->udp_send_mode;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_gop_cache:
+ * @factory: a #GstRTSPMediaFactory
+ * @gop_cache: if the last GOP should be cached
+ *
+ * Configure media created from this factory to send the packets since the
+ * last keyframe to clients that join a shared media that is already playing,
+ * so that they can start decoding right away. This is meant for video.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_factory_set_gop_cache (GstRTSPMediaFactory * factory,
+    gboolean gop_cache)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->gop_cache = gop_cache;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_gop_cache:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Check if media created from this factory cache the packets since the last
+ * keyframe.
+ *
+ * Returns: %TRUE if the media have a GOP cache.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_media_factory_get_gop_cache (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  gboolean result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), FALSE);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->gop_cache;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_connected_udp:
+ * @factory: a #GstRTSPMediaFactory
+ * @connected_udp: if clients get their own connected sockets
+ *
+ * Configure media created from this factory to receive from each UDP unicast
+ * client on its own connected socket, so that the RTCP of many clients is not
+ * handled by a single thread. See gst_rtsp_stream_set_connected_udp().
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_factory_set_connected_udp (GstRTSPMediaFactory * factory,
+    gboolean connected_udp)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  priv->connected_udp = connected_udp;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+}
+
+/**
+ * gst_rtsp_media_factory_get_connected_udp:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Check if media created from this factory give UDP unicast clients their own
+ * connected sockets.
+ *
+ * Returns: %TRUE if the media use connected sockets.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_media_factory_get_connected_udp (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  gboolean result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), FALSE);
+
+  priv = factory->priv;
+
+  GST_RTSP_MEDIA_FACTORY_LOCK (factory);
+  result = priv->connected_udp;
+  GST_RTSP_MEDIA_FACTORY_UNLOCK (factory);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_media_factory_set_standby_pool_size:
+ * @factory: a #GstRTSPMediaFactory
+ * @size: the maximum number of media on standby
+ *
+ * Keep up to @size prepared media ready to be handed out by
+ * gst_rtsp_media_factory_construct() so that new clients don't have to wait
+ * for the pipeline to preroll. The media are prepared in the background, in
+ * the thread pool of the server, for the recently requested urls. The number
+ * of media on standby for each url follows the rate of requests for it. This
+ * only has effect for media that are not shared.
+ *
+ * The media-constructed and media-configure signals for standby media are
+ * emitted from a background thread.
+ *
+ * A @size of 0 disables the standby pool.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_factory_set_standby_pool_size (GstRTSPMediaFactory * factory,
+    guint size)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  GHashTableIter iter;
+  gpointer value;
+  GList *stale = NULL;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->medias_lock);
+  priv->standby_size = size;
+  g_hash_table_iter_init (&iter, priv->standby);
+  while (g_hash_table_iter_next (&iter, NULL, &value)) {
+    StandbyPool *sp = value;
+
+    sp->target = MIN (sp->target, size);
+    stale = g_list_concat (stale, standby_trim (sp, size));
+  }
+  g_mutex_unlock (&priv->medias_lock);
+
+  standby_release (stale);
+}
+
+/**
+ * gst_rtsp_media_factory_get_standby_pool_size:
+ * @factory: a #GstRTSPMediaFactory
+ *
+ * Get the maximum number of prepared media kept on standby.
+ *
+ * Returns: the standby pool size, 0 when disabled.
+ *
+ * Since: 1.6
+ */
+guint
+gst_rtsp_media_factory_get_standby_pool_size (GstRTSPMediaFactory * factory)
+{
+  GstRTSPMediaFactoryPrivate *priv;
+  guint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory), 0);
+
+  priv = factory->priv;
+
+  g_mutex_lock (&priv->medias_lock);
+  result = priv->standby_size;
+  g_mutex_unlock (&priv->medias_lock);
+
+  return result;
+}
+
+/* get the number of cached shared media, the number of media on standby and
+ * the number of media constructed by @factory */
+void
+gst_rtsp_media_factory_get_counters (GstRTSPMediaFactory * factory,
+    guint * media, guint * standby, guint * constructed)
+{
+  GstRTSPMediaFactoryPrivate *priv = factory->priv;
+  GHashTableIter iter;
+  gpointer value;
+
+  g_mutex_lock (&priv->medias_lock);
+  *media = g_hash_table_size (priv->medias);
+  *standby = 0;
+  g_hash_table_iter_init (&iter, priv->standby);
+  while (g_hash_table_iter_next (&iter, NULL, &value))
+    *standby += g_queue_get_length (&((StandbyPool *) value)->media);
+  g_mutex_unlock (&priv->medias_lock);
+  *constructed = g_atomic_int_get (&priv->n_constructed);
+}
+
+/* the histogram of the prepare times of the media of @factory, valid as long
+ * as @factory */
+GstRTSPHistogram *
+gst_rtsp_media_factory_get_prepare_histogram (GstRTSPMediaFactory * factory)
+{
+  return factory->priv->prepare_latency;
+}
@@ -153,6 +153,22 @@ void                  gst_rtsp_media_factory_set_transport_mode (GstRTSPMediaFac
                                                                  GstRTSPTransportMode mode);
 GstRTSPTransportMode  gst_rtsp_media_factory_get_transport_mode (GstRTSPMediaFactory *factory);
 
+void                  gst_rtsp_media_factory_set_udp_send_mode (GstRTSPMediaFactory *factory,
+                                                                GstRTSPUdpSendMode mode);
+GstRTSPUdpSendMode    gst_rtsp_media_factory_get_udp_send_mode (GstRTSPMediaFactory *factory);
+
+void                  gst_rtsp_media_factory_set_gop_cache (GstRTSPMediaFactory *factory,
+                                                            gboolean gop_cache);
+gboolean              gst_rtsp_media_factory_get_gop_cache (GstRTSPMediaFactory *factory);
+
+void                  gst_rtsp_media_factory_set_connected_udp (GstRTSPMediaFactory *factory,
+                                                                gboolean connected_udp);
+gboolean              gst_rtsp_media_factory_get_connected_udp (GstRTSPMediaFactory *factory);
+
+void                  gst_rtsp_media_factory_set_standby_pool_size (GstRTSPMediaFactory *factory,
+                                                                    guint size);
+guint                 gst_rtsp_media_factory_get_standby_pool_size (GstRTSPMediaFactory *factory);
+
 void                  gst_rtsp_media_factory_set_media_gtype  (GstRTSPMediaFactory * factory,
                                                                GType media_gtype);
 GType                 gst_rtsp_media_factory_get_media_gtype  (GstRTSPMediaFactory * factory);
@@ -80,6 +80,7 @@
 #define HMAC_80_KEY_LEN 10
 
 #include "rtsp-media.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_MEDIA_GET_PRIVATE(obj)  \
      (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_MEDIA, GstRTSPMediaPrivate))
@@ -108,7 +109,13 @@ struct _GstRTSPMediaPrivate
   GPtrArray *streams;           /* protected by lock */
   GList *dynamic;               /* protected by lock */
   GstRTSPMediaStatus status;    /* protected by lock */
+  GList *prepare_watches;       /* protected by lock */
+  gint64 prepare_start;         /* protected by lock */
+  GstClockTime prepare_latency; /* protected by lock */
   gint prepare_count;
+  /* prepared in advance by the factory, the next prepare takes over the
+   * prepare count of the factory */
+  gboolean standby;
   gint n_active;
   gboolean adding;
 
@@ -138,6 +145,12 @@ struct _GstRTSPMediaPrivate
   GList *payloads;              /* protected by lock */
   GstClockTime rtx_time;        /* protected by lock */
   guint latency;                /* protected by lock */
+  GstRTSPUdpSendMode udp_send_mode;     /* protected by lock */
+  gboolean gop_cache;           /* protected by lock */
+  gboolean connected_udp;       /* protected by lock */
+
+  /* SDP text per server address */
+  GHashTable *sdp_cache;        /* protected by lock */
 };
 
 #define DEFAULT_SHARED          FALSE
@@ -151,6 +164,17 @@ struct _GstRTSPMediaPrivate
 #define DEFAULT_TIME_PROVIDER   FALSE
 #define DEFAULT_LATENCY         200
 #define DEFAULT_TRANSPORT_MODE  GST_RTSP_TRANSPORT_MODE_PLAY
+#define DEFAULT_UDP_SEND_MODE   GST_RTSP_UDP_SEND_MODE_SINK
+#define DEFAULT_GOP_CACHE       FALSE
+#define DEFAULT_CONNECTED_UDP   FALSE
+
+/* called when the media is done preparing */
+typedef struct
+{
+  GstRTSPMediaPrepareFunc func;
+  gpointer user_data;
+  GDestroyNotify notify;
+} PrepareWatch;
 
 /* define to dump received RTCP packets */
 #undef DUMP_STATS
@@ -169,6 +193,9 @@ enum
   PROP_TIME_PROVIDER,
   PROP_LATENCY,
   PROP_TRANSPORT_MODE,
+  PROP_UDP_SEND_MODE,
+  PROP_GOP_CACHE,
+  PROP_CONNECTED_UDP,
   PROP_LAST
 };
 
@@ -329,6 +356,22 @@ gst_rtsp_media_class_init (GstRTSPMediaClass * klass)
           GST_TYPE_RTSP_TRANSPORT_MODE, DEFAULT_TRANSPORT_MODE,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  g_object_class_install_property (gobject_class, PROP_UDP_SEND_MODE,
+      g_param_spec_enum ("udp-send-mode", "UDP Send Mode",
+          "How packets are sent to UDP unicast destinations",
+          GST_TYPE_RTSP_UDP_SEND_MODE, DEFAULT_UDP_SEND_MODE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_GOP_CACHE,
+      g_param_spec_boolean ("gop-cache", "GOP Cache",
+          "Send the packets since the last keyframe to new clients",
+          DEFAULT_GOP_CACHE, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
+  g_object_class_install_property (gobject_class, PROP_CONNECTED_UDP,
+      g_param_spec_boolean ("connected-udp", "Connected UDP",
+          "Receive from each UDP unicast client on its own connected socket",
+          DEFAULT_CONNECTED_UDP, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   gst_rtsp_media_signals[SIGNAL_NEW_STREAM] =
       g_signal_new ("new-stream", G_TYPE_FROM_CLASS (klass), G_SIGNAL_RUN_LAST,
       G_STRUCT_OFFSET (GstRTSPMediaClass, new_stream), NULL, NULL,
@@ -396,6 +439,33 @@ gst_rtsp_media_init (GstRTSPMedia * media)
   priv->buffer_size = DEFAULT_BUFFER_SIZE;
   priv->time_provider = DEFAULT_TIME_PROVIDER;
   priv->transport_mode = DEFAULT_TRANSPORT_MODE;
+  priv->udp_send_mode = DEFAULT_UDP_SEND_MODE;
+  priv->gop_cache = DEFAULT_GOP_CACHE;
+  priv->connected_udp = DEFAULT_CONNECTED_UDP;
+  priv->prepare_latency = GST_CLOCK_TIME_NONE;
+}
+
+static void
+prepare_watch_free (PrepareWatch * watch)
+{
+  if (watch->notify)
+    watch->notify (watch->user_data);
+  g_slice_free (PrepareWatch, watch);
+}
+
+/* call and free the watches that were taken from prepare_watches */
+static void
+prepare_watches_dispatch (GstRTSPMedia * media, GList * watches)
+{
+  GList *walk;
+
+  for (walk = watches; walk; walk = g_list_next (walk)) {
+    PrepareWatch *watch = walk->data;
+
+    watch->func (media, watch->user_data);
+    prepare_watch_free (watch);
+  }
+  g_list_free (watches);
 }
 
 static void
@@ -425,6 +495,9 @@ gst_rtsp_media_finalize (GObject * obj)
     g_object_unref (priv->pool);
   if (priv->payloads)
     g_list_free (priv->payloads);
+  g_list_free_full (priv->prepare_watches, (GDestroyNotify) prepare_watch_free);
+  if (priv->sdp_cache)
+    g_hash_table_unref (priv->sdp_cache);
   g_mutex_clear (&priv->lock);
   g_cond_clear (&priv->cond);
   g_rec_mutex_clear (&priv->state_lock);
@@ -472,6 +545,15 @@ gst_rtsp_media_get_property (GObject * object, guint propid,
     case PROP_TRANSPORT_MODE:
       g_value_set_flags (value, gst_rtsp_media_get_transport_mode (media));
       break;
+    case PROP_UDP_SEND_MODE:
+      g_value_set_enum (value, gst_rtsp_media_get_udp_send_mode (media));
+      break;
+    case PROP_GOP_CACHE:
+      g_value_set_boolean (value, gst_rtsp_media_get_gop_cache (media));
+      break;
+    case PROP_CONNECTED_UDP:
+      g_value_set_boolean (value, gst_rtsp_media_get_connected_udp (media));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -518,6 +600,15 @@ gst_rtsp_media_set_property (GObject * object, guint propid,
     case PROP_TRANSPORT_MODE:
       gst_rtsp_media_set_transport_mode (media, g_value_get_flags (value));
       break;
+    case PROP_UDP_SEND_MODE:
+      gst_rtsp_media_set_udp_send_mode (media, g_value_get_enum (value));
+      break;
+    case PROP_GOP_CACHE:
+      gst_rtsp_media_set_gop_cache (media, g_value_get_boolean (value));
+      break;
+    case PROP_CONNECTED_UDP:
+      gst_rtsp_media_set_connected_udp (media, g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -1560,6 +1651,9 @@ gst_rtsp_media_create_stream (GstRTSPMedia * media, GstElement * payloader,
   gst_rtsp_stream_set_profiles (stream, priv->profiles);
   gst_rtsp_stream_set_protocols (stream, priv->protocols);
   gst_rtsp_stream_set_retransmission_time (stream, priv->rtx_time);
+  gst_rtsp_stream_set_udp_send_mode (stream, priv->udp_send_mode);
+  gst_rtsp_stream_set_gop_cache (stream, priv->gop_cache);
+  gst_rtsp_stream_set_connected_udp (stream, priv->connected_udp);
 
   g_ptr_array_add (priv->streams, stream);
 
@@ -1713,6 +1807,53 @@ gst_rtsp_media_find_stream (GstRTSPMedia * media, const gchar * control)
   return res;
 }
 
+/* append the stats of the transports of all streams of @media to @array */
+void
+gst_rtsp_media_collect_transport_stats (GstRTSPMedia * media, GArray * array)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GPtrArray *streams;
+  gint i;
+
+  /* don't collect with the lock, the streams take their own lock */
+  g_mutex_lock (&priv->lock);
+  streams = g_ptr_array_new_with_free_func (g_object_unref);
+  for (i = 0; i < priv->streams->len; i++)
+    g_ptr_array_add (streams,
+        g_object_ref (g_ptr_array_index (priv->streams, i)));
+  g_mutex_unlock (&priv->lock);
+
+  for (i = 0; i < streams->len; i++)
+    gst_rtsp_stream_collect_transport_stats (g_ptr_array_index (streams, i),
+        array);
+  g_ptr_array_unref (streams);
+}
+
+/**
+ * gst_rtsp_media_get_transport_stats:
+ * @media: a #GstRTSPMedia
+ *
+ * Get a snapshot of the statistics of the transports of all streams in
+ * @media.
+ *
+ * Returns: (transfer full) (element-type GstRTSPStreamTransportStats): a
+ * #GArray of #GstRTSPStreamTransportStats. g_array_unref() after usage.
+ *
+ * Since: 1.6
+ */
+GArray *
+gst_rtsp_media_get_transport_stats (GstRTSPMedia * media)
+{
+  GArray *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), NULL);
+
+  result = gst_rtsp_stream_transport_stats_array_new ();
+  gst_rtsp_media_collect_transport_stats (media, result);
+
+  return result;
+}
+
 /* called with state-lock */
 static gboolean
 default_convert_range (GstRTSPMedia * media, GstRTSPTimeRange * range,
@@ -1808,12 +1949,27 @@ static void
 gst_rtsp_media_set_status (GstRTSPMedia * media, GstRTSPMediaStatus status)
 {
   GstRTSPMediaPrivate *priv = media->priv;
+  GList *watches = NULL;
 
   g_mutex_lock (&priv->lock);
   priv->status = status;
   GST_DEBUG ("setting new status to %d", status);
+  if (status == GST_RTSP_MEDIA_STATUS_PREPARING) {
+    priv->prepare_start = g_get_monotonic_time ();
+  } else if (priv->prepare_start != 0) {
+    if (status == GST_RTSP_MEDIA_STATUS_PREPARED)
+      priv->prepare_latency =
+          (g_get_monotonic_time () - priv->prepare_start) * GST_USECOND;
+    priv->prepare_start = 0;
+  }
   g_cond_broadcast (&priv->cond);
+  if (status != GST_RTSP_MEDIA_STATUS_PREPARING) {
+    watches = priv->prepare_watches;
+    priv->prepare_watches = NULL;
+  }
   g_mutex_unlock (&priv->lock);
+
+  prepare_watches_dispatch (media, watches);
 }
 
 /**
@@ -1830,6 +1986,7 @@ gst_rtsp_media_get_status (GstRTSPMedia * media)
 {
   GstRTSPMediaPrivate *priv = media->priv;
   GstRTSPMediaStatus result;
+  GList *watches = NULL;
   gint64 end_time;
 
   g_mutex_lock (&priv->lock);
@@ -1840,6 +1997,8 @@ gst_rtsp_media_get_status (GstRTSPMedia * media)
     if (!g_cond_wait_until (&priv->cond, &priv->lock, end_time)) {
       GST_DEBUG ("timeout, assuming error status");
       priv->status = GST_RTSP_MEDIA_STATUS_ERROR;
+      watches = priv->prepare_watches;
+      priv->prepare_watches = NULL;
     }
   }
   /* could be success or error */
@@ -1847,6 +2006,8 @@ gst_rtsp_media_get_status (GstRTSPMedia * media)
   GST_DEBUG ("got status %d", result);
   g_mutex_unlock (&priv->lock);
 
+  prepare_watches_dispatch (media, watches);
+
   return result;
 }
 
@@ -2436,15 +2597,22 @@ state_failed:
 static gboolean
 wait_preroll (GstRTSPMedia * media)
 {
+  GstRTSPContext *ctx;
   GstRTSPMediaStatus status;
+  guint span;
 
   GST_DEBUG ("wait to preroll pipeline");
 
+  ctx = gst_rtsp_context_get_current ();
+  span = gst_rtsp_context_trace_begin (ctx, "wait-preroll");
+
   /* wait until pipeline is prerolled */
   status = gst_rtsp_media_get_status (media);
   if (status == GST_RTSP_MEDIA_STATUS_ERROR)
     goto preroll_failed;
 
+  gst_rtsp_context_trace_end (ctx, span);
+
   return TRUE;
 
 preroll_failed:
@@ -2617,33 +2785,21 @@ no_rtpbin:
   }
 }
 
-/**
- * gst_rtsp_media_prepare:
- * @media: a #GstRTSPMedia
- * @thread: (transfer full) (allow-none): a #GstRTSPThread to run the
- *   bus handler or %NULL
- *
- * Prepare @media for streaming. This function will create the objects
- * to manage the streaming. A pipeline must have been set on @media with
- * gst_rtsp_media_take_pipeline().
- *
- * It will preroll the pipeline and collect vital information about the streams
- * such as the duration.
- *
- * Returns: %TRUE on success.
- */
-gboolean
-gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
+/* start preparing @media without waiting for the preroll. @prepared is set
+ * to %TRUE when @media was already prepared and there is nothing to wait
+ * for. */
+static gboolean
+begin_prepare (GstRTSPMedia * media, GstRTSPThread * thread,
+    gboolean * prepared)
 {
-  GstRTSPMediaPrivate *priv;
+  GstRTSPMediaPrivate *priv = media->priv;
   GstRTSPMediaClass *klass;
 
-  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
-
-  priv = media->priv;
-
   g_rec_mutex_lock (&priv->state_lock);
-  priv->prepare_count++;
+  if (priv->standby)
+    priv->standby = FALSE;
+  else
+    priv->prepare_count++;
 
   if (priv->status == GST_RTSP_MEDIA_STATUS_PREPARED ||
       priv->status == GST_RTSP_MEDIA_STATUS_SUSPENDED)
@@ -2676,15 +2832,7 @@ gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
 
 wait_status:
   g_rec_mutex_unlock (&priv->state_lock);
-
-  /* now wait for all pads to be prerolled, FIXME, we should somehow be
-   * able to do this async so that we don't block the server thread. */
-  if (!wait_preroll (media))
-    goto preroll_failed;
-
-  g_signal_emit (media, gst_rtsp_media_signals[SIGNAL_PREPARED], 0, NULL);
-
-  GST_INFO ("object %p is prerolled", media);
+  *prepared = FALSE;
 
   return TRUE;
 
@@ -2703,6 +2851,7 @@ was_prepared:
     if (thread)
       gst_rtsp_thread_stop (thread);
     g_rec_mutex_unlock (&priv->state_lock);
+    *prepared = TRUE;
     return TRUE;
   }
   /* ERRORS */
@@ -2736,6 +2885,40 @@ prepare_failed:
     GST_ERROR ("failed to prepare media");
     return FALSE;
   }
+}
+
+/* complete the prepare started with begin_prepare(). When @wait is %FALSE,
+ * a media that is still prerolling is considered failed. */
+static gboolean
+finish_prepare (GstRTSPMedia * media, gboolean wait)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstRTSPMediaStatus status;
+
+  if (wait) {
+    if (!wait_preroll (media))
+      goto preroll_failed;
+  } else {
+    g_mutex_lock (&priv->lock);
+    status = priv->status;
+    g_mutex_unlock (&priv->lock);
+
+    if (status == GST_RTSP_MEDIA_STATUS_PREPARING) {
+      GST_WARNING ("media %p did not preroll in time", media);
+      gst_rtsp_media_set_status (media, GST_RTSP_MEDIA_STATUS_ERROR);
+      status = GST_RTSP_MEDIA_STATUS_ERROR;
+    }
+    if (status == GST_RTSP_MEDIA_STATUS_ERROR)
+      goto preroll_failed;
+  }
+
+  g_signal_emit (media, gst_rtsp_media_signals[SIGNAL_PREPARED], 0, NULL);
+
+  GST_INFO ("object %p is prerolled", media);
+
+  return TRUE;
+
+  /* ERRORS */
 preroll_failed:
   {
     GST_WARNING ("failed to preroll pipeline");
@@ -2744,6 +2927,110 @@ preroll_failed:
   }
 }
 
+/**
+ * gst_rtsp_media_prepare:
+ * @media: a #GstRTSPMedia
+ * @thread: (transfer full) (allow-none): a #GstRTSPThread to run the
+ *   bus handler or %NULL
+ *
+ * Prepare @media for streaming. This function will create the objects
+ * to manage the streaming. A pipeline must have been set on @media with
+ * gst_rtsp_media_take_pipeline().
+ *
+ * It will preroll the pipeline and collect vital information about the streams
+ * such as the duration.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+gst_rtsp_media_prepare (GstRTSPMedia * media, GstRTSPThread * thread)
+{
+  gboolean prepared;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  if (!begin_prepare (media, thread, &prepared))
+    return FALSE;
+
+  if (prepared)
+    return TRUE;
+
+  /* now wait for all pads to be prerolled */
+  return finish_prepare (media, TRUE);
+}
+
+/* Start preparing @media like gst_rtsp_media_prepare() but without waiting
+ * for the pipeline to preroll. When @prepared is set to %FALSE, the prepare
+ * must be completed with gst_rtsp_media_prepare_finish(), for example after
+ * the watch installed with gst_rtsp_media_add_prepare_watch() was called. */
+gboolean
+gst_rtsp_media_prepare_start (GstRTSPMedia * media, GstRTSPThread * thread,
+    gboolean * prepared)
+{
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+  g_return_val_if_fail (prepared != NULL, FALSE);
+
+  return begin_prepare (media, thread, prepared);
+}
+
+/* Complete the prepare started with gst_rtsp_media_prepare_start(). This
+ * does not block, a media that is still prerolling is considered failed
+ * and unprepared. */
+gboolean
+gst_rtsp_media_prepare_finish (GstRTSPMedia * media)
+{
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  return finish_prepare (media, FALSE);
+}
+
+/* Get the time the last prepare of @media took, only once. Returns
+ * #GST_CLOCK_TIME_NONE when there is no new value. */
+GstClockTime
+gst_rtsp_media_take_prepare_latency (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  GstClockTime result;
+
+  g_mutex_lock (&priv->lock);
+  result = priv->prepare_latency;
+  priv->prepare_latency = GST_CLOCK_TIME_NONE;
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+/* Call @func once when @media is no longer preparing, right away when it is
+ * not preparing now. @func is called from the thread that changes the status
+ * of @media, usually the media thread. */
+void
+gst_rtsp_media_add_prepare_watch (GstRTSPMedia * media,
+    GstRTSPMediaPrepareFunc func, gpointer user_data, GDestroyNotify notify)
+{
+  GstRTSPMediaPrivate *priv;
+  PrepareWatch *watch;
+  gboolean preparing;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+  g_return_if_fail (func != NULL);
+
+  priv = media->priv;
+
+  watch = g_slice_new (PrepareWatch);
+  watch->func = func;
+  watch->user_data = user_data;
+  watch->notify = notify;
+
+  g_mutex_lock (&priv->lock);
+  preparing = priv->status == GST_RTSP_MEDIA_STATUS_PREPARING;
+  if (preparing)
+    priv->prepare_watches = g_list_append (priv->prepare_watches, watch);
+  g_mutex_unlock (&priv->lock);
+
+  if (!preparing)
+    prepare_watches_dispatch (media, g_list_prepend (NULL, watch));
+}
+
 /* must be called with state-lock */
 static void
 finish_unprepare (GstRTSPMedia * media)
@@ -2860,6 +3147,8 @@ gst_rtsp_media_unprepare (GstRTSPMedia * media)
   if (priv->status == GST_RTSP_MEDIA_STATUS_UNPREPARED)
     goto was_unprepared;
 
+  /* this releases the prepare count of the factory too */
+  priv->standby = FALSE;
   priv->prepare_count--;
   if (priv->prepare_count > 0)
     goto is_busy;
@@ -2897,6 +3186,52 @@ is_busy:
   }
 }
 
+/* hand over the prepare count of a media that was prepared in advance by the
+ * factory, the next gst_rtsp_media_prepare() takes it over without preparing
+ * again. Until then, the media stays prepared once. Returns FALSE when the
+ * media is no longer usable, the caller then still owns the prepare count. */
+gboolean
+gst_rtsp_media_claim_standby (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  res = priv->status == GST_RTSP_MEDIA_STATUS_PREPARED &&
+      priv->prepare_count == 1 && !priv->standby;
+  if (res)
+    priv->standby = TRUE;
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  return res;
+}
+
+/* release a media that was claimed with gst_rtsp_media_claim_standby() but
+ * will not be prepared, it is unprepared. Does nothing when the media was
+ * not from the standby pool or was prepared since. */
+void
+gst_rtsp_media_release_standby (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean standby;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  priv = media->priv;
+
+  g_rec_mutex_lock (&priv->state_lock);
+  standby = priv->standby;
+  priv->standby = FALSE;
+  g_rec_mutex_unlock (&priv->state_lock);
+
+  if (standby)
+    gst_rtsp_media_unprepare (media);
+}
+
 /* should be called with state-lock */
 static GstClock *
 get_clock_unlocked (GstRTSPMedia * media)
@@ -4117,3 +4452,377 @@ gst_rtsp_media_get_transport_mode (GstRTSPMedia * media)
 
   return res;
 }
+
+/**
+ * gst_rtsp_media_set_udp_send_mode:
+ * @media: a #GstRTSPMedia
+ * @mode: a #GstRTSPUdpSendMode
+ *
+ * Configure how the streams of @media send packets to UDP unicast
+ * destinations. This should be set before the media is prepared.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_set_udp_send_mode (GstRTSPMedia * media,
+    GstRTSPUdpSendMode mode)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  GST_LOG_OBJECT (media, "set udp send mode %d", mode);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->udp_send_mode = mode;
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    gst_rtsp_stream_set_udp_send_mode (stream, mode);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_udp_send_mode:
+ * @media: a #GstRTSPMedia
+ *
+ * Get how the streams of @media send packets to UDP unicast destinations.
+ *
+ * Returns: the #GstRTSPUdpSendMode of @media.
+ *
+ * Since: 1.6
+ */
+GstRTSPUdpSendMode
+gst_rtsp_media_get_udp_send_mode (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  GstRTSPUdpSendMode res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media),
+      GST_RTSP_UDP_SEND_MODE_SINK);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->udp_send_mode;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_set_gop_cache:
+ * @media: a #GstRTSPMedia
+ * @gop_cache: if the last GOP should be cached
+ *
+ * Configure the streams of @media to send the packets since the last keyframe
+ * to clients that start playing a shared media that is already playing. This
+ * should be set before the media is prepared.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_set_gop_cache (GstRTSPMedia * media, gboolean gop_cache)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  GST_LOG_OBJECT (media, "set gop cache %d", gop_cache);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->gop_cache = gop_cache;
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    gst_rtsp_stream_set_gop_cache (stream, gop_cache);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_gop_cache:
+ * @media: a #GstRTSPMedia
+ *
+ * Check if the streams of @media cache the packets since the last keyframe.
+ *
+ * Returns: %TRUE if @media has a GOP cache.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_media_get_gop_cache (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->gop_cache;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/**
+ * gst_rtsp_media_set_connected_udp:
+ * @media: a #GstRTSPMedia
+ * @connected_udp: if clients get their own connected sockets
+ *
+ * Configure the streams of @media to receive from each UDP unicast client on
+ * its own connected socket, see gst_rtsp_stream_set_connected_udp(). This
+ * should be set before the media is prepared.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_media_set_connected_udp (GstRTSPMedia * media, gboolean connected_udp)
+{
+  GstRTSPMediaPrivate *priv;
+  guint i;
+
+  g_return_if_fail (GST_IS_RTSP_MEDIA (media));
+
+  GST_LOG_OBJECT (media, "set connected udp %d", connected_udp);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->connected_udp = connected_udp;
+  for (i = 0; i < priv->streams->len; i++) {
+    GstRTSPStream *stream = g_ptr_array_index (priv->streams, i);
+
+    gst_rtsp_stream_set_connected_udp (stream, connected_udp);
+  }
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_media_get_connected_udp:
+ * @media: a #GstRTSPMedia
+ *
+ * Check if the UDP unicast clients of @media get their own connected sockets.
+ *
+ * Returns: %TRUE if @media uses connected sockets.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_media_get_connected_udp (GstRTSPMedia * media)
+{
+  GstRTSPMediaPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_MEDIA (media), FALSE);
+
+  priv = media->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->connected_udp;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
+/* The SDP of a shared media is the same for all clients that connect to the
+ * same server address, except for the session id in the origin. The text is
+ * cached together with a fingerprint of the things that go into the SDP and
+ * can change: the range, the caps and the tags of the streams. */
+struct _GstRTSPSdpFingerprint
+{
+  gchar *range;
+  GPtrArray *refs;              /* caps and tag events of the streams */
+};
+
+typedef struct
+{
+  GstRTSPSdpFingerprint *fp;
+  gchar *text;
+  gsize id_offset;              /* the session id in the origin */
+  gsize id_len;
+} SdpCacheEntry;
+
+static void
+unref_mini_object (gpointer data)
+{
+  if (data)
+    gst_mini_object_unref (data);
+}
+
+static gboolean
+collect_tag_events (GstPad * pad, GstEvent ** event, gpointer user_data)
+{
+  GPtrArray *refs = user_data;
+
+  if (GST_EVENT_TYPE (*event) == GST_EVENT_TAG)
+    g_ptr_array_add (refs, gst_event_ref (*event));
+
+  return TRUE;
+}
+
+/* check if the SDP of @stream carries an SRTP key. The key-mgmt attribute
+ * with the MIKEY message has a timestamp and random data that must be new in
+ * every SDP */
+static gboolean
+stream_has_sdp_key (GstRTSPStream * stream, GstCaps * caps)
+{
+  GstStructure *s;
+
+  if (!(gst_rtsp_stream_get_profiles (stream) & (GST_RTSP_PROFILE_SAVP |
+              GST_RTSP_PROFILE_SAVPF)))
+    return FALSE;
+
+  if (caps == NULL || gst_caps_get_size (caps) == 0)
+    return FALSE;
+
+  s = gst_caps_get_structure (caps, 0);
+
+  return gst_structure_has_field (s, "srtp-key");
+}
+
+/* take a fingerprint of what can change in the SDP of @media, NULL when the
+ * SDP of @media can't be cached */
+GstRTSPSdpFingerprint *
+gst_rtsp_media_sdp_fingerprint_new (GstRTSPMedia * media)
+{
+  GstRTSPSdpFingerprint *fp;
+  guint i, n_streams;
+
+  fp = g_slice_new (GstRTSPSdpFingerprint);
+  fp->range =
+      gst_rtsp_media_get_range_string (media, FALSE, GST_RTSP_RANGE_NPT);
+  fp->refs = g_ptr_array_new_with_free_func (unref_mini_object);
+
+  n_streams = gst_rtsp_media_n_streams (media);
+  for (i = 0; i < n_streams; i++) {
+    GstRTSPStream *stream = gst_rtsp_media_get_stream (media, i);
+    GstCaps *caps;
+    GstPad *pad;
+
+    caps = gst_rtsp_stream_get_caps (stream);
+    g_ptr_array_add (fp->refs, caps);
+
+    if (stream_has_sdp_key (stream, caps))
+      goto has_key;
+
+    if ((pad = gst_rtsp_stream_get_srcpad (stream))) {
+      gst_pad_sticky_events_foreach (pad, collect_tag_events, fp->refs);
+      gst_object_unref (pad);
+    }
+  }
+  return fp;
+
+  /* ERRORS */
+has_key:
+  {
+    GST_DEBUG_OBJECT (media, "SDP has SRTP keys, not caching");
+    gst_rtsp_media_sdp_fingerprint_free (fp);
+    return NULL;
+  }
+}
+
+void
+gst_rtsp_media_sdp_fingerprint_free (GstRTSPSdpFingerprint * fp)
+{
+  g_free (fp->range);
+  g_ptr_array_unref (fp->refs);
+  g_slice_free (GstRTSPSdpFingerprint, fp);
+}
+
+static gboolean
+sdp_fingerprint_equal (GstRTSPSdpFingerprint * fp1,
+    GstRTSPSdpFingerprint * fp2)
+{
+  guint i;
+
+  if (g_strcmp0 (fp1->range, fp2->range) != 0)
+    return FALSE;
+  if (fp1->refs->len != fp2->refs->len)
+    return FALSE;
+
+  /* we keep a ref on the caps and events so a new object can't have the same
+   * address */
+  for (i = 0; i < fp1->refs->len; i++) {
+    if (g_ptr_array_index (fp1->refs, i) != g_ptr_array_index (fp2->refs, i))
+      return FALSE;
+  }
+  return TRUE;
+}
+
+static void
+sdp_cache_entry_free (SdpCacheEntry * entry)
+{
+  gst_rtsp_media_sdp_fingerprint_free (entry->fp);
+  g_free (entry->text);
+  g_slice_free (SdpCacheEntry, entry);
+}
+
+/* Get a copy of the SDP text cached for @key and the position of the session
+ * id in it. Returns %NULL when nothing is cached or when @fp changed. */
+gchar *
+gst_rtsp_media_lookup_sdp (GstRTSPMedia * media, const gchar * key,
+    GstRTSPSdpFingerprint * fp, gsize * id_offset, gsize * id_len)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  SdpCacheEntry *entry;
+  gchar *result = NULL;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->sdp_cache && (entry = g_hash_table_lookup (priv->sdp_cache, key))
+      && sdp_fingerprint_equal (entry->fp, fp)) {
+    result = g_strdup (entry->text);
+    *id_offset = entry->id_offset;
+    *id_len = entry->id_len;
+  }
+  g_mutex_unlock (&priv->lock);
+
+  return result;
+}
+
+/* cache the SDP @text for @key, takes ownership of @fp */
+void
+gst_rtsp_media_cache_sdp (GstRTSPMedia * media, const gchar * key,
+    GstRTSPSdpFingerprint * fp, const gchar * text)
+{
+  GstRTSPMediaPrivate *priv = media->priv;
+  SdpCacheEntry *entry;
+  const gchar *origin, *id;
+
+  /* find the session id, the second field of the origin line */
+  if (!(origin = strstr (text, "\no=")) || !(id = strchr (origin, ' ')))
+    goto no_origin;
+  id++;
+
+  entry = g_slice_new (SdpCacheEntry);
+  entry->fp = fp;
+  entry->text = g_strdup (text);
+  entry->id_offset = id - text;
+  entry->id_len = strcspn (id, " \r\n");
+
+  g_mutex_lock (&priv->lock);
+  if (priv->sdp_cache == NULL)
+    priv->sdp_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free,
+        (GDestroyNotify) sdp_cache_entry_free);
+  g_hash_table_insert (priv->sdp_cache, g_strdup (key), entry);
+  g_mutex_unlock (&priv->lock);
+
+  return;
+
+  /* ERRORS */
+no_origin:
+  {
+    GST_WARNING ("no origin in SDP, not caching");
+    gst_rtsp_media_sdp_fingerprint_free (fp);
+    return;
+  }
+}
@@ -213,6 +213,15 @@ GstClockTime          gst_rtsp_media_get_retransmission_time  (GstRTSPMedia *med
 void                  gst_rtsp_media_set_latency      (GstRTSPMedia *media, guint latency);
 guint                 gst_rtsp_media_get_latency      (GstRTSPMedia *media);
 
+void                  gst_rtsp_media_set_udp_send_mode  (GstRTSPMedia *media, GstRTSPUdpSendMode mode);
+GstRTSPUdpSendMode    gst_rtsp_media_get_udp_send_mode  (GstRTSPMedia *media);
+
+void                  gst_rtsp_media_set_gop_cache    (GstRTSPMedia *media, gboolean gop_cache);
+gboolean              gst_rtsp_media_get_gop_cache    (GstRTSPMedia *media);
+
+void                  gst_rtsp_media_set_connected_udp (GstRTSPMedia *media, gboolean connected_udp);
+gboolean              gst_rtsp_media_get_connected_udp (GstRTSPMedia *media);
+
 void                  gst_rtsp_media_use_time_provider (GstRTSPMedia *media, gboolean time_provider);
 gboolean              gst_rtsp_media_is_time_provider  (GstRTSPMedia *media);
 GstNetTimeProvider *  gst_rtsp_media_get_time_provider (GstRTSPMedia *media,
@@ -247,6 +256,7 @@ GstClockTime          gst_rtsp_media_get_base_time    (GstRTSPMedia *media);
 guint                 gst_rtsp_media_n_streams        (GstRTSPMedia *media);
 GstRTSPStream *       gst_rtsp_media_get_stream       (GstRTSPMedia *media, guint idx);
 GstRTSPStream *       gst_rtsp_media_find_stream      (GstRTSPMedia *media, const gchar * control);
+GArray *              gst_rtsp_media_get_transport_stats (GstRTSPMedia *media);
 
 gboolean              gst_rtsp_media_seek             (GstRTSPMedia *media, GstRTSPTimeRange *range);
 gchar *               gst_rtsp_media_get_range_string (GstRTSPMedia *media,
@@ -0,0 +1,329 @@
+/* GStreamer
+ * Copyright (C) 2015 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/*
+ * Helpers to collect latency histograms and to write metrics in the
+ * Prometheus text exposition format.
+ *
+ * Histograms have fixed buckets and are updated with atomic operations only,
+ * so that they can be updated from any thread without a lock. The buckets are
+ * made cumulative when the histogram is written.
+ */
+
+#include "rtsp-metrics.h"
+
+/* upper bounds of the histogram buckets, in microseconds */
+static const gint64 bucket_bounds[] = {
+  1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000,
+  1000000, 2500000, 5000000, 10000000
+};
+
+#define N_BUCKETS G_N_ELEMENTS (bucket_bounds)
+
+struct _GstRTSPHistogram
+{
+  /* the last bucket counts the values above all bounds */
+  volatile gint counts[N_BUCKETS + 1];
+  /* sum of all values in microseconds */
+  volatile gsize sum;
+};
+
+/* make a new empty latency histogram, free with gst_rtsp_histogram_free() */
+GstRTSPHistogram *
+gst_rtsp_histogram_new (void)
+{
+  return g_slice_new0 (GstRTSPHistogram);
+}
+
+void
+gst_rtsp_histogram_free (GstRTSPHistogram * hist)
+{
+  g_slice_free (GstRTSPHistogram, hist);
+}
+
+/* count @value in @hist, can be called from any thread */
+void
+gst_rtsp_histogram_observe (GstRTSPHistogram * hist, GstClockTime value)
+{
+  gint64 usec;
+  guint i;
+
+  g_return_if_fail (hist != NULL);
+
+  if (!GST_CLOCK_TIME_IS_VALID (value))
+    return;
+
+  usec = GST_TIME_AS_USECONDS (value);
+  for (i = 0; i < N_BUCKETS; i++) {
+    if (usec <= bucket_bounds[i])
+      break;
+  }
+  g_atomic_int_inc (&hist->counts[i]);
+  g_atomic_pointer_add (&hist->sum, usec);
+}
+
+/* request latency per method bit, up to GST_RTSP_POST */
+#define N_REQUEST_METHODS 13
+
+struct _GstRTSPRequestMetrics
+{
+  gint refcount;
+  GstRTSPHistogram *latency[N_REQUEST_METHODS];
+};
+
+/* make new request latency histograms, shared by the clients of one server */
+GstRTSPRequestMetrics *
+gst_rtsp_request_metrics_new (void)
+{
+  GstRTSPRequestMetrics *metrics;
+  gint i;
+
+  metrics = g_slice_new (GstRTSPRequestMetrics);
+  metrics->refcount = 1;
+  for (i = 0; i < N_REQUEST_METHODS; i++)
+    metrics->latency[i] = gst_rtsp_histogram_new ();
+
+  return metrics;
+}
+
+GstRTSPRequestMetrics *
+gst_rtsp_request_metrics_ref (GstRTSPRequestMetrics * metrics)
+{
+  g_atomic_int_inc (&metrics->refcount);
+  return metrics;
+}
+
+void
+gst_rtsp_request_metrics_unref (GstRTSPRequestMetrics * metrics)
+{
+  gint i;
+
+  if (!g_atomic_int_dec_and_test (&metrics->refcount))
+    return;
+
+  for (i = 0; i < N_REQUEST_METHODS; i++)
+    gst_rtsp_histogram_free (metrics->latency[i]);
+  g_slice_free (GstRTSPRequestMetrics, metrics);
+}
+
+/* count a request of @method that took @value, can be called from any
+ * thread */
+void
+gst_rtsp_request_metrics_observe (GstRTSPRequestMetrics * metrics,
+    GstRTSPMethod method, GstClockTime value)
+{
+  gint bit = g_bit_nth_lsf (method, -1);
+
+  if (bit >= 0 && bit < N_REQUEST_METHODS)
+    gst_rtsp_histogram_observe (metrics->latency[bit], value);
+}
+
+struct _GstRTSPCopyMetrics
+{
+  gint refcount;
+  GMutex lock;
+  guint64 packets;              /* protected by lock */
+  guint64 bytes;                /* protected by lock */
+};
+
+/* make new counters of the packets that were copied for one client, shared by
+ * the clients and transports of one server */
+GstRTSPCopyMetrics *
+gst_rtsp_copy_metrics_new (void)
+{
+  GstRTSPCopyMetrics *metrics;
+
+  metrics = g_slice_new0 (GstRTSPCopyMetrics);
+  metrics->refcount = 1;
+  g_mutex_init (&metrics->lock);
+
+  return metrics;
+}
+
+GstRTSPCopyMetrics *
+gst_rtsp_copy_metrics_ref (GstRTSPCopyMetrics * metrics)
+{
+  g_atomic_int_inc (&metrics->refcount);
+  return metrics;
+}
+
+void
+gst_rtsp_copy_metrics_unref (GstRTSPCopyMetrics * metrics)
+{
+  if (!g_atomic_int_dec_and_test (&metrics->refcount))
+    return;
+
+  g_mutex_clear (&metrics->lock);
+  g_slice_free (GstRTSPCopyMetrics, metrics);
+}
+
+/* count @packets with @bytes of RTP or RTCP data that were copied for one
+ * client, can be called from any thread */
+void
+gst_rtsp_copy_metrics_count (GstRTSPCopyMetrics * metrics, guint packets,
+    gsize bytes)
+{
+  g_mutex_lock (&metrics->lock);
+  metrics->packets += packets;
+  metrics->bytes += bytes;
+  g_mutex_unlock (&metrics->lock);
+}
+
+/* write the HELP and TYPE lines of metric @name */
+void
+gst_rtsp_metrics_append_header (GString * out, const gchar * name,
+    const gchar * type, const gchar * help)
+{
+  g_string_append_printf (out, "# HELP %s %s\n", name, help);
+  g_string_append_printf (out, "# TYPE %s %s\n", name, type);
+}
+
+/* add label @name with @value to @labels, escaping @value as needed */
+void
+gst_rtsp_metrics_append_label (GString * labels, const gchar * name,
+    const gchar * value)
+{
+  const gchar *p;
+
+  if (labels->len > 0)
+    g_string_append_c (labels, ',');
+
+  g_string_append_printf (labels, "%s=\"", name);
+  for (p = value; *p; p++) {
+    switch (*p) {
+      case '\\':
+        g_string_append (labels, "\\\\");
+        break;
+      case '"':
+        g_string_append (labels, "\\\"");
+        break;
+      case '\n':
+        g_string_append (labels, "\\n");
+        break;
+      default:
+        g_string_append_c (labels, *p);
+        break;
+    }
+  }
+  g_string_append_c (labels, '"');
+}
+
+static void
+append_sample (GString * out, const gchar * name, const gchar * suffix,
+    const gchar * labels, const gchar * extra, gdouble value)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE];
+  gboolean have_labels = labels && *labels;
+
+  g_string_append (out, name);
+  if (suffix)
+    g_string_append (out, suffix);
+
+  if (have_labels || extra) {
+    g_string_append_c (out, '{');
+    if (have_labels)
+      g_string_append (out, labels);
+    if (have_labels && extra)
+      g_string_append_c (out, ',');
+    if (extra)
+      g_string_append (out, extra);
+    g_string_append_c (out, '}');
+  }
+  /* always with a '.' as decimal separator */
+  g_string_append_printf (out, " %s\n", g_ascii_dtostr (buf, sizeof (buf),
+          value));
+}
+
+/* write one sample of metric @name, @labels can be %NULL */
+void
+gst_rtsp_metrics_append_value (GString * out, const gchar * name,
+    const gchar * labels, gdouble value)
+{
+  append_sample (out, name, NULL, labels, NULL, value);
+}
+
+/* write the buckets, the sum and the count of @hist in seconds */
+void
+gst_rtsp_metrics_append_histogram (GString * out, const gchar * name,
+    const gchar * labels, GstRTSPHistogram * hist)
+{
+  gchar buf[G_ASCII_DTOSTR_BUF_SIZE], *le;
+  guint64 count = 0;
+  guint i;
+
+  for (i = 0; i <= N_BUCKETS; i++) {
+    count += (guint) g_atomic_int_get (&hist->counts[i]);
+
+    if (i < N_BUCKETS)
+      le = g_strdup_printf ("le=\"%s\"", g_ascii_dtostr (buf, sizeof (buf),
+              bucket_bounds[i] / (gdouble) G_USEC_PER_SEC));
+    else
+      le = g_strdup ("le=\"+Inf\"");
+
+    append_sample (out, name, "_bucket", labels, le, count);
+    g_free (le);
+  }
+  append_sample (out, name, "_sum", labels, NULL,
+      GPOINTER_TO_SIZE (g_atomic_pointer_get (&hist->sum)) /
+      (gdouble) G_USEC_PER_SEC);
+  append_sample (out, name, "_count", labels, NULL, count);
+}
+
+/* write the request latency histograms of @metrics */
+void
+gst_rtsp_request_metrics_append (GstRTSPRequestMetrics * metrics,
+    GString * out)
+{
+  GString *labels;
+  gint i;
+
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_request_duration_seconds",
+      "histogram", "Time to handle an RTSP request, per method");
+
+  labels = g_string_new (NULL);
+  for (i = 0; i < N_REQUEST_METHODS; i++) {
+    g_string_truncate (labels, 0);
+    gst_rtsp_metrics_append_label (labels, "method",
+        gst_rtsp_method_as_text (1 << i));
+    gst_rtsp_metrics_append_histogram (out,
+        "gst_rtsp_request_duration_seconds", labels->str,
+        metrics->latency[i]);
+  }
+  g_string_free (labels, TRUE);
+}
+
+/* write the number of packets and bytes in @metrics */
+void
+gst_rtsp_copy_metrics_append (GstRTSPCopyMetrics * metrics, GString * out)
+{
+  guint64 packets, bytes;
+
+  g_mutex_lock (&metrics->lock);
+  packets = metrics->packets;
+  bytes = metrics->bytes;
+  g_mutex_unlock (&metrics->lock);
+
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_copied_packets_total",
+      "counter", "Number of RTP and RTCP packets copied for one client");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_copied_packets_total", NULL,
+      packets);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_copied_bytes_total",
+      "counter", "Number of RTP and RTCP bytes copied for one client");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_copied_bytes_total", NULL,
+      bytes);
+}
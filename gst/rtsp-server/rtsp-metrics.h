@@ -0,0 +1,86 @@
+/* GStreamer
+ * Copyright (C) 2015 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+#include <gst/rtsp/gstrtspdefs.h>
+
+#ifndef __GST_RTSP_METRICS_H__
+#define __GST_RTSP_METRICS_H__
+
+G_BEGIN_DECLS
+
+typedef struct _GstRTSPHistogram GstRTSPHistogram;
+typedef struct _GstRTSPRequestMetrics GstRTSPRequestMetrics;
+typedef struct _GstRTSPCopyMetrics GstRTSPCopyMetrics;
+
+G_GNUC_INTERNAL
+GstRTSPHistogram *  gst_rtsp_histogram_new          (void);
+G_GNUC_INTERNAL
+void                gst_rtsp_histogram_free         (GstRTSPHistogram *hist);
+G_GNUC_INTERNAL
+void                gst_rtsp_histogram_observe      (GstRTSPHistogram *hist,
+                                                     GstClockTime value);
+
+G_GNUC_INTERNAL
+GstRTSPRequestMetrics * gst_rtsp_request_metrics_new    (void);
+G_GNUC_INTERNAL
+GstRTSPRequestMetrics * gst_rtsp_request_metrics_ref    (GstRTSPRequestMetrics *metrics);
+G_GNUC_INTERNAL
+void                gst_rtsp_request_metrics_unref  (GstRTSPRequestMetrics *metrics);
+G_GNUC_INTERNAL
+void                gst_rtsp_request_metrics_observe (GstRTSPRequestMetrics *metrics,
+                                                     GstRTSPMethod method,
+                                                     GstClockTime value);
+G_GNUC_INTERNAL
+void                gst_rtsp_request_metrics_append (GstRTSPRequestMetrics *metrics,
+                                                     GString *out);
+
+G_GNUC_INTERNAL
+GstRTSPCopyMetrics * gst_rtsp_copy_metrics_new      (void);
+G_GNUC_INTERNAL
+GstRTSPCopyMetrics * gst_rtsp_copy_metrics_ref      (GstRTSPCopyMetrics *metrics);
+G_GNUC_INTERNAL
+void                gst_rtsp_copy_metrics_unref     (GstRTSPCopyMetrics *metrics);
+G_GNUC_INTERNAL
+void                gst_rtsp_copy_metrics_count     (GstRTSPCopyMetrics *metrics,
+                                                     guint packets,
+                                                     gsize bytes);
+G_GNUC_INTERNAL
+void                gst_rtsp_copy_metrics_append    (GstRTSPCopyMetrics *metrics,
+                                                     GString *out);
+
+G_GNUC_INTERNAL
+void                gst_rtsp_metrics_append_header  (GString *out, const gchar *name,
+                                                     const gchar *type,
+                                                     const gchar *help);
+G_GNUC_INTERNAL
+void                gst_rtsp_metrics_append_label   (GString *labels, const gchar *name,
+                                                     const gchar *value);
+G_GNUC_INTERNAL
+void                gst_rtsp_metrics_append_value   (GString *out, const gchar *name,
+                                                     const gchar *labels,
+                                                     gdouble value);
+G_GNUC_INTERNAL
+void                gst_rtsp_metrics_append_histogram (GString *out, const gchar *name,
+                                                     const gchar *labels,
+                                                     GstRTSPHistogram *hist);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_METRICS_H__ */
@@ -32,69 +32,411 @@
  * With gst_rtsp_mount_points_match() you can find the #GstRTSPMediaFactory
  * object that completely matches the given path.
  *
+ * Changes to the mount points are published as a new version of the mount
+ * points, gst_rtsp_mount_points_match() never blocks on changes made from
+ * other threads. Many changes can be published at once by making them between
+ * gst_rtsp_mount_points_begin_update() and
+ * gst_rtsp_mount_points_commit_update() from one thread.
+ *
  * Last reviewed on 2013-07-11 (1.0.0)
  */
 #include <string.h>
 
 #include "rtsp-mount-points.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_MOUNT_POINTS_GET_PRIVATE(obj)  \
        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_MOUNT_POINTS, GstRTSPMountPointsPrivate))
 
-typedef struct
+/* The mount points are kept in a tree with one node per '/' separated segment
+ * of the path so that the longest match of a path can be found by walking
+ * the segments of the path once. The children of a node are kept in a
+ * balanced binary tree sorted on the segment.
+ *
+ * A published tree is never modified. Updates are made on a draft that shares
+ * all unmodified nodes with the published tree, nodes are copied when they
+ * are modified and still shared, like a #GstMiniObject that is made
+ * writable. Adding or removing a mount point only copies the nodes on the
+ * path to it, not the siblings of those nodes. */
+typedef struct _MountNode MountNode;
+typedef struct _ChildNode ChildNode;
+
+struct _MountNode
+{
+  gint refcount;                /* protected by the lock of the mount points */
+  ChildNode *children;          /* NULL when there are no children */
+  gchar *path;                  /* the mount point of this node */
+  gint len;                     /* length of the mount point */
+  GstRTSPMediaFactory *factory; /* NULL when not a mount point */
+};
+
+/* an AVL tree node, one child of a MountNode */
+struct _ChildNode
+{
+  gint refcount;                /* protected by the lock of the mount points */
+  gchar *segment;
+  MountNode *mount;
+  ChildNode *left;
+  ChildNode *right;
+  gint height;
+};
+
+static void mount_node_unref (MountNode * node);
+
+static ChildNode *
+child_ref (ChildNode * child)
+{
+  if (child)
+    child->refcount++;
+  return child;
+}
+
+static void
+child_unref (ChildNode * child)
+{
+  if (child == NULL || --child->refcount > 0)
+    return;
+
+  child_unref (child->left);
+  child_unref (child->right);
+  mount_node_unref (child->mount);
+  g_free (child->segment);
+  g_slice_free (ChildNode, child);
+}
+
+static gint
+child_height (ChildNode * child)
+{
+  return child ? child->height : 0;
+}
+
+/* takes ownership of @mount, @left and @right */
+static ChildNode *
+child_new (const gchar * segment, MountNode * mount, ChildNode * left,
+    ChildNode * right)
+{
+  ChildNode *child;
+
+  child = g_slice_new (ChildNode);
+  child->refcount = 1;
+  child->segment = g_strdup (segment);
+  child->mount = mount;
+  child->left = left;
+  child->right = right;
+  child->height = MAX (child_height (left), child_height (right)) + 1;
+
+  return child;
+}
+
+static MountNode *
+mount_node_ref (MountNode * node)
+{
+  node->refcount++;
+  return node;
+}
+
+/* make a node for @segment with @left and @right, rotating when the heights
+ * differ by more than one. Takes ownership of @mount, @left and @right */
+static ChildNode *
+child_balance (const gchar * segment, MountNode * mount, ChildNode * left,
+    ChildNode * right)
+{
+  ChildNode *l = left, *r = right, *result;
+
+  if (child_height (l) > child_height (r) + 1) {
+    if (child_height (l->left) >= child_height (l->right)) {
+      result = child_new (l->segment, mount_node_ref (l->mount),
+          child_ref (l->left), child_new (segment, mount,
+              child_ref (l->right), r));
+    } else {
+      ChildNode *lr = l->right;
+
+      result = child_new (lr->segment, mount_node_ref (lr->mount),
+          child_new (l->segment, mount_node_ref (l->mount),
+              child_ref (l->left), child_ref (lr->left)),
+          child_new (segment, mount, child_ref (lr->right), r));
+    }
+    child_unref (l);
+  } else if (child_height (r) > child_height (l) + 1) {
+    if (child_height (r->right) >= child_height (r->left)) {
+      result = child_new (r->segment, mount_node_ref (r->mount),
+          child_new (segment, mount, l, child_ref (r->left)),
+          child_ref (r->right));
+    } else {
+      ChildNode *rl = r->left;
+
+      result = child_new (rl->segment, mount_node_ref (rl->mount),
+          child_new (segment, mount, l, child_ref (rl->left)),
+          child_new (r->segment, mount_node_ref (r->mount),
+              child_ref (rl->right), child_ref (r->right)));
+    }
+    child_unref (r);
+  } else {
+    result = child_new (segment, mount, l, r);
+  }
+  return result;
+}
+
+static ChildNode *
+child_lookup (ChildNode * child, const gchar * segment)
+{
+  while (child) {
+    gint cmp = strcmp (segment, child->segment);
+
+    if (cmp == 0)
+      break;
+    child = cmp < 0 ? child->left : child->right;
+  }
+  return child;
+}
+
+/* make a new version of @child with @mount for @segment, @child is not
+ * modified. Takes ownership of @mount */
+static ChildNode *
+child_insert (ChildNode * child, const gchar * segment, MountNode * mount)
 {
-  gchar *path;
-  gint len;
-  GstRTSPMediaFactory *factory;
-} DataItem;
+  gint cmp;
+
+  if (child == NULL)
+    return child_new (segment, mount, NULL, NULL);
+
+  cmp = strcmp (segment, child->segment);
+  if (cmp == 0)
+    return child_new (segment, mount, child_ref (child->left),
+        child_ref (child->right));
+  else if (cmp < 0)
+    return child_balance (child->segment, mount_node_ref (child->mount),
+        child_insert (child->left, segment, mount), child_ref (child->right));
+  else
+    return child_balance (child->segment, mount_node_ref (child->mount),
+        child_ref (child->left), child_insert (child->right, segment, mount));
+}
+
+static ChildNode *
+child_remove_min (ChildNode * child, ChildNode ** min)
+{
+  if (child->left == NULL) {
+    *min = child;
+    return child_ref (child->right);
+  }
+  return child_balance (child->segment, mount_node_ref (child->mount),
+      child_remove_min (child->left, min), child_ref (child->right));
+}
 
-static DataItem *
-data_item_new (gchar * path, gint len, GstRTSPMediaFactory * factory)
+/* make a new version of @child without @segment, @child is not modified */
+static ChildNode *
+child_remove (ChildNode * child, const gchar * segment)
 {
-  DataItem *item;
+  ChildNode *min, *right;
+  gint cmp;
+
+  if (child == NULL)
+    return NULL;
+
+  cmp = strcmp (segment, child->segment);
+  if (cmp < 0)
+    return child_balance (child->segment, mount_node_ref (child->mount),
+        child_remove (child->left, segment), child_ref (child->right));
+  else if (cmp > 0)
+    return child_balance (child->segment, mount_node_ref (child->mount),
+        child_ref (child->left), child_remove (child->right, segment));
+
+  if (child->left == NULL)
+    return child_ref (child->right);
+  if (child->right == NULL)
+    return child_ref (child->left);
+
+  right = child_remove_min (child->right, &min);
+  return child_balance (min->segment, mount_node_ref (min->mount),
+      child_ref (child->left), right);
+}
+
+static MountNode *
+mount_node_new (const gchar * path, gint len)
+{
+  MountNode *node;
 
-  item = g_slice_alloc (sizeof (DataItem));
-  item->path = path;
-  item->len = len;
-  item->factory = factory;
+  node = g_slice_new0 (MountNode);
+  node->refcount = 1;
+  node->path = g_strndup (path, len);
+  node->len = len;
 
-  return item;
+  return node;
 }
 
 static void
-data_item_free (gpointer data)
+mount_node_unref (MountNode * node)
 {
-  DataItem *item = data;
+  if (--node->refcount > 0)
+    return;
+
+  child_unref (node->children);
+  if (node->factory)
+    g_object_unref (node->factory);
+  g_free (node->path);
+  g_slice_free (MountNode, node);
+}
 
-  g_free (item->path);
-  g_object_unref (item->factory);
-  g_slice_free1 (sizeof (DataItem), item);
+static void
+mount_node_set_child (MountNode * node, const gchar * segment,
+    MountNode * child)
+{
+  ChildNode *old = node->children;
+
+  node->children = child_insert (old, segment, child);
+  child_unref (old);
 }
 
 static void
-data_item_dump (gconstpointer a, gconstpointer prefix)
+mount_node_remove_child (MountNode * node, const gchar * segment)
 {
-  const DataItem *item = a;
+  ChildNode *old = node->children;
 
-  GST_DEBUG ("%s%s %p", (gchar *) prefix, item->path, item->factory);
+  node->children = child_remove (old, segment);
+  child_unref (old);
 }
 
-static gint
-data_item_compare (gconstpointer a, gconstpointer b, gpointer user_data)
+/* make a copy of @node that shares the children with @node */
+static MountNode *
+mount_node_copy (MountNode * node)
 {
-  const DataItem *item1 = a, *item2 = b;
-  gint res;
+  MountNode *copy;
 
-  res = g_strcmp0 (item1->path, item2->path);
+  copy = mount_node_new (node->path, node->len);
+  if (node->factory)
+    copy->factory = g_object_ref (node->factory);
+  copy->children = child_ref (node->children);
 
-  return res;
+  return copy;
+}
+
+static MountNode *
+mount_node_get_child (MountNode * node, const gchar * segment)
+{
+  ChildNode *child;
+
+  if (!(child = child_lookup (node->children, segment)))
+    return NULL;
+
+  return child->mount;
+}
+
+/* get the child for @segment of the writable @node so that it can be
+ * modified. The tree nodes on the way to it and the child itself are copied
+ * when they are shared */
+static MountNode *
+mount_node_get_writable_child (MountNode * node, const gchar * segment)
+{
+  ChildNode **walk = &node->children;
+
+  while (*walk) {
+    ChildNode *child = *walk;
+    gint cmp;
+
+    if (child->refcount > 1) {
+      child = child_new (child->segment, mount_node_ref (child->mount),
+          child_ref (child->left), child_ref (child->right));
+      child_unref (*walk);
+      *walk = child;
+    }
+
+    cmp = strcmp (segment, child->segment);
+    if (cmp == 0) {
+      if (child->mount->refcount > 1) {
+        MountNode *copy = mount_node_copy (child->mount);
+
+        mount_node_unref (child->mount);
+        child->mount = copy;
+      }
+      return child->mount;
+    }
+    walk = cmp < 0 ? &child->left : &child->right;
+  }
+  return NULL;
+}
+
+/* find the node for @path. When @best is not %NULL, it will contain the node
+ * of the longest mount point that is a prefix of @path. */
+static MountNode *
+mount_node_lookup (MountNode * root, const gchar * path, MountNode ** best)
+{
+  MountNode *node = root;
+  gchar *segments, *seg, *end;
+
+  if (best)
+    *best = NULL;
+
+  /* split the path in segments in place */
+  segments = g_strdup (path);
+  seg = segments;
+  for (;;) {
+    end = strchr (seg, '/');
+    if (end)
+      *end = '\0';
+
+    node = mount_node_get_child (node, seg);
+    if (node == NULL)
+      break;
+
+    if (best && node->factory)
+      *best = node;
+
+    if (end == NULL)
+      break;
+    seg = end + 1;
+  }
+  g_free (segments);
+
+  return node;
+}
+
+/* set @factory on the mount point for @path below the writable @node, @seg
+ * points to the next segment of @path in @segments. Nodes that are shared with
+ * a published tree are copied and nodes that are no longer needed are
+ * removed. */
+static void
+mount_node_update (MountNode * node, const gchar * path, gchar * segments,
+    gchar * seg, GstRTSPMediaFactory * factory)
+{
+  MountNode *child;
+  gchar *end;
+
+  end = strchr (seg, '/');
+  if (end)
+    *end = '\0';
+
+  if (mount_node_get_child (node, seg) == NULL) {
+    /* nothing to remove */
+    if (factory == NULL)
+      return;
+    child = mount_node_new (path, end ? end - segments : strlen (path));
+    mount_node_set_child (node, seg, child);
+  } else {
+    child = mount_node_get_writable_child (node, seg);
+  }
+
+  if (end == NULL) {
+    if (child->factory)
+      g_object_unref (child->factory);
+    child->factory = factory ? g_object_ref (factory) : NULL;
+  } else {
+    mount_node_update (child, path, segments, end + 1, factory);
+  }
+
+  if (child->factory == NULL && child->children == NULL)
+    mount_node_remove_child (node, seg);
 }
 
 struct _GstRTSPMountPointsPrivate
 {
-  GMutex lock;
-  GSequence *mounts;            /* protected by lock */
-  gboolean dirty;
+  GRecMutex lock;               /* serializes updates */
+  MountNode *root;              /* the published tree, atomic */
+  MountNode *draft;             /* protected by lock */
+  guint update_depth;           /* protected by lock */
+
+  /* readers of the published tree, counted per epoch */
+  gint epoch;                   /* atomic */
+  gint readers[2];              /* atomic */
 };
 
 G_DEFINE_TYPE (GstRTSPMountPoints, gst_rtsp_mount_points, G_TYPE_OBJECT);
@@ -132,9 +474,8 @@ gst_rtsp_mount_points_init (GstRTSPMountPoints * mounts)
 
   mounts->priv = priv;
 
-  g_mutex_init (&priv->lock);
-  priv->mounts = g_sequence_new (data_item_free);
-  priv->dirty = FALSE;
+  g_rec_mutex_init (&priv->lock);
+  priv->root = mount_node_new ("", 0);
 }
 
 static void
@@ -145,8 +486,10 @@ gst_rtsp_mount_points_finalize (GObject * obj)
 
   GST_DEBUG_OBJECT (mounts, "finalized");
 
-  g_sequence_free (priv->mounts);
-  g_mutex_clear (&priv->lock);
+  mount_node_unref (priv->root);
+  if (priv->draft)
+    mount_node_unref (priv->draft);
+  g_rec_mutex_clear (&priv->lock);
 
   G_OBJECT_CLASS (gst_rtsp_mount_points_parent_class)->finalize (obj);
 }
@@ -203,18 +546,92 @@ gst_rtsp_mount_points_make_path (GstRTSPMountPoints * mounts,
   return result;
 }
 
-static gboolean
-has_prefix (DataItem * str, DataItem * prefix)
+/* get the published tree, it remains valid until reader_leave() */
+static MountNode *
+reader_enter (GstRTSPMountPointsPrivate * priv, gint * epoch)
 {
-  /* prefix needs to be smaller than str */
-  if (str->len < prefix->len)
-    return FALSE;
+  gint e;
+
+  for (;;) {
+    e = g_atomic_int_get (&priv->epoch);
+    g_atomic_int_inc (&priv->readers[e]);
+    /* when the epoch changed, we might have registered after the updater
+     * checked our epoch, try again */
+    if (G_LIKELY (g_atomic_int_get (&priv->epoch) == e))
+      break;
+    g_atomic_int_add (&priv->readers[e], -1);
+  }
+  *epoch = e;
 
-  /* if str is larger, it there should be a / following the prefix */
-  if (str->len > prefix->len && str->path[prefix->len] != '/')
-    return FALSE;
+  return g_atomic_pointer_get (&priv->root);
+}
 
-  return strncmp (str->path, prefix->path, prefix->len) == 0;
+static void
+reader_leave (GstRTSPMountPointsPrivate * priv, gint epoch)
+{
+  g_atomic_int_add (&priv->readers[epoch], -1);
+}
+
+/* get the draft to update, must be called with the lock */
+static MountNode *
+get_draft (GstRTSPMountPointsPrivate * priv)
+{
+  if (priv->draft == NULL)
+    priv->draft = mount_node_copy (priv->root);
+
+  return priv->draft;
+}
+
+/* make the draft the published tree and release the old tree after all
+ * readers that could use it are done. Must be called with the lock */
+static void
+publish_draft (GstRTSPMountPointsPrivate * priv)
+{
+  MountNode *old;
+  gint epoch;
+
+  if (priv->draft == NULL)
+    return;
+
+  old = priv->root;
+  g_atomic_pointer_set (&priv->root, priv->draft);
+  priv->draft = NULL;
+
+  /* new readers register in the other epoch and get the new tree */
+  epoch = g_atomic_int_get (&priv->epoch);
+  g_atomic_int_set (&priv->epoch, !epoch);
+  while (g_atomic_int_get (&priv->readers[epoch]) > 0)
+    g_thread_yield ();
+
+  mount_node_unref (old);
+}
+
+static void
+update_factory (GstRTSPMountPointsPrivate * priv, const gchar * path,
+    GstRTSPMediaFactory * factory)
+{
+  gchar *segments;
+
+  g_rec_mutex_lock (&priv->lock);
+  /* don't make a new version when removing something that is not there */
+  if (factory == NULL) {
+    MountNode *node;
+
+    node = mount_node_lookup (priv->draft ? priv->draft : priv->root, path,
+        NULL);
+    if (node == NULL || node->factory == NULL)
+      goto done;
+  }
+
+  segments = g_strdup (path);
+  mount_node_update (get_draft (priv), path, segments, segments, factory);
+  g_free (segments);
+
+  if (priv->update_depth == 0)
+    publish_draft (priv);
+
+done:
+  g_rec_mutex_unlock (&priv->lock);
 }
 
 /**
@@ -237,59 +654,28 @@ gst_rtsp_mount_points_match (GstRTSPMountPoints * mounts,
 {
   GstRTSPMountPointsPrivate *priv;
   GstRTSPMediaFactory *result = NULL;
-  GSequenceIter *iter, *best;
-  DataItem item, *ritem;
+  MountNode *root, *best;
+  gint epoch;
 
   g_return_val_if_fail (GST_IS_RTSP_MOUNT_POINTS (mounts), NULL);
   g_return_val_if_fail (path != NULL, NULL);
 
   priv = mounts->priv;
 
-  item.path = (gchar *) path;
-  item.len = strlen (path);
-
-  g_mutex_lock (&priv->lock);
-  if (priv->dirty) {
-    g_sequence_sort (priv->mounts, data_item_compare, mounts);
-    g_sequence_foreach (priv->mounts, (GFunc) data_item_dump,
-        (gpointer) "sort :");
-    priv->dirty = FALSE;
-  }
-
-  /* find the location of the media in the hashtable we only use the absolute
+  /* find the location of the media in the tree, we only use the absolute
    * path of the uri to find a media factory. If the factory depends on other
    * properties found in the url, this method should be overridden. */
-  iter = g_sequence_get_begin_iter (priv->mounts);
-  best = NULL;
-  while (!g_sequence_iter_is_end (iter)) {
-    ritem = g_sequence_get (iter);
-
-    data_item_dump (ritem, "inspect: ");
-
-    if (best == NULL) {
-      if (has_prefix (&item, ritem)) {
-        data_item_dump (ritem, "prefix: ");
-        best = iter;
-      }
-    } else {
-      if (!has_prefix (&item, ritem))
-        break;
-
-      best = iter;
-      data_item_dump (ritem, "new best: ");
-    }
-    iter = g_sequence_iter_next (iter);
-  }
+  root = reader_enter (priv, &epoch);
+  mount_node_lookup (root, path, &best);
   if (best) {
-    ritem = g_sequence_get (best);
-    data_item_dump (ritem, "result: ");
-    if (matched || ritem->len == item.len) {
-      result = g_object_ref (ritem->factory);
+    GST_DEBUG ("result: %s %p", best->path, best->factory);
+    if (matched || best->len == (gint) strlen (path)) {
+      result = g_object_ref (best->factory);
       if (matched)
-        *matched = ritem->len;
+        *matched = best->len;
     }
   }
-  g_mutex_unlock (&priv->lock);
+  reader_leave (priv, epoch);
 
   GST_INFO ("found media factory %p for path %s", result, path);
 
@@ -313,23 +699,14 @@ void
 gst_rtsp_mount_points_add_factory (GstRTSPMountPoints * mounts,
     const gchar * path, GstRTSPMediaFactory * factory)
 {
-  GstRTSPMountPointsPrivate *priv;
-  DataItem *item;
-
   g_return_if_fail (GST_IS_RTSP_MOUNT_POINTS (mounts));
   g_return_if_fail (GST_IS_RTSP_MEDIA_FACTORY (factory));
   g_return_if_fail (path != NULL);
 
-  priv = mounts->priv;
-
-  item = data_item_new (g_strdup (path), strlen (path), factory);
-
   GST_INFO ("adding media factory %p for path %s", factory, path);
 
-  g_mutex_lock (&priv->lock);
-  g_sequence_append (priv->mounts, item);
-  priv->dirty = TRUE;
-  g_mutex_unlock (&priv->lock);
+  update_factory (mounts->priv, path, factory);
+  g_object_unref (factory);
 }
 
 /**
@@ -342,29 +719,139 @@ gst_rtsp_mount_points_add_factory (GstRTSPMountPoints * mounts,
 void
 gst_rtsp_mount_points_remove_factory (GstRTSPMountPoints * mounts,
     const gchar * path)
+{
+  g_return_if_fail (GST_IS_RTSP_MOUNT_POINTS (mounts));
+  g_return_if_fail (path != NULL);
+
+  GST_INFO ("removing media factory for path %s", path);
+
+  update_factory (mounts->priv, path, NULL);
+}
+
+/**
+ * gst_rtsp_mount_points_begin_update:
+ * @mounts: a #GstRTSPMountPoints
+ *
+ * Start a batch of changes to @mounts. Factories added and removed with
+ * gst_rtsp_mount_points_add_factory() and
+ * gst_rtsp_mount_points_remove_factory() from this thread will not be
+ * visible to gst_rtsp_mount_points_match() until
+ * gst_rtsp_mount_points_commit_update() is called, after which they are all
+ * visible at once.
+ *
+ * The lock that serializes changes to @mounts is held from this call until
+ * the matching gst_rtsp_mount_points_commit_update(), which must be called
+ * from the same thread. Changes from other threads block until the batch is
+ * committed, so don't wait for other threads that change @mounts in between.
+ * gst_rtsp_mount_points_match() is never blocked by a batch.
+ *
+ * Calls to this function can be nested, the changes are published when the
+ * outermost batch is committed.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_mount_points_begin_update (GstRTSPMountPoints * mounts)
 {
   GstRTSPMountPointsPrivate *priv;
-  DataItem item;
-  GSequenceIter *iter;
 
   g_return_if_fail (GST_IS_RTSP_MOUNT_POINTS (mounts));
-  g_return_if_fail (path != NULL);
 
   priv = mounts->priv;
 
-  item.path = (gchar *) path;
+  g_rec_mutex_lock (&priv->lock);
+  priv->update_depth++;
+  GST_DEBUG_OBJECT (mounts, "begin update %u", priv->update_depth);
+}
 
-  GST_INFO ("removing media factory for path %s", path);
+/**
+ * gst_rtsp_mount_points_commit_update:
+ * @mounts: a #GstRTSPMountPoints
+ *
+ * Publish the changes made to @mounts since the matching call to
+ * gst_rtsp_mount_points_begin_update(). This must be called from the thread
+ * that called gst_rtsp_mount_points_begin_update().
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_mount_points_commit_update (GstRTSPMountPoints * mounts)
+{
+  GstRTSPMountPointsPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_MOUNT_POINTS (mounts));
+
+  priv = mounts->priv;
 
-  g_mutex_lock (&priv->lock);
-  if (priv->dirty) {
-    g_sequence_sort (priv->mounts, data_item_compare, mounts);
-    priv->dirty = FALSE;
+  g_rec_mutex_lock (&priv->lock);
+  if (priv->update_depth == 0)
+    goto not_updating;
+
+  GST_DEBUG_OBJECT (mounts, "commit update %u", priv->update_depth);
+  if (--priv->update_depth == 0)
+    publish_draft (priv);
+  g_rec_mutex_unlock (&priv->lock);
+  /* release the lock taken in begin_update */
+  g_rec_mutex_unlock (&priv->lock);
+
+  return;
+
+  /* ERRORS */
+not_updating:
+  {
+    g_rec_mutex_unlock (&priv->lock);
+    g_critical ("commit_update called without begin_update");
+    return;
   }
-  iter = g_sequence_lookup (priv->mounts, &item, data_item_compare, mounts);
-  if (iter) {
-    g_sequence_remove (iter);
-    priv->dirty = TRUE;
+}
+
+static void collect_children (ChildNode * child, GPtrArray * paths,
+    GPtrArray * factories);
+
+static void
+collect_mounts (MountNode * node, GPtrArray * paths, GPtrArray * factories)
+{
+  if (node->factory) {
+    g_ptr_array_add (paths, g_strdup (node->path));
+    g_ptr_array_add (factories, g_object_ref (node->factory));
   }
-  g_mutex_unlock (&priv->lock);
+  collect_children (node->children, paths, factories);
+}
+
+static void
+collect_children (ChildNode * child, GPtrArray * paths, GPtrArray * factories)
+{
+  if (child == NULL)
+    return;
+
+  collect_children (child->left, paths, factories);
+  collect_mounts (child->mount, paths, factories);
+  collect_children (child->right, paths, factories);
+}
+
+/* call @func for each mount point of @mounts. @func is called without holding
+ * on to the published tree so it can take its time. */
+void
+gst_rtsp_mount_points_foreach (GstRTSPMountPoints * mounts,
+    GstRTSPMountPointsFunc func, gpointer user_data)
+{
+  GstRTSPMountPointsPrivate *priv = mounts->priv;
+  GPtrArray *paths, *factories;
+  MountNode *root;
+  gint epoch;
+  guint i;
+
+  paths = g_ptr_array_new_with_free_func (g_free);
+  factories = g_ptr_array_new_with_free_func (g_object_unref);
+
+  root = reader_enter (priv, &epoch);
+  collect_mounts (root, paths, factories);
+  reader_leave (priv, epoch);
+
+  for (i = 0; i < paths->len; i++)
+    func (g_ptr_array_index (paths, i), g_ptr_array_index (factories, i),
+        user_data);
+
+  g_ptr_array_unref (paths);
+  g_ptr_array_unref (factories);
 }
@@ -85,6 +85,9 @@ void                  gst_rtsp_mount_points_add_factory    (GstRTSPMountPoints *
                                                             GstRTSPMediaFactory *factory);
 void                  gst_rtsp_mount_points_remove_factory (GstRTSPMountPoints *mounts,
                                                             const gchar *path);
+/* updating many mount points at once */
+void                  gst_rtsp_mount_points_begin_update   (GstRTSPMountPoints *mounts);
+void                  gst_rtsp_mount_points_commit_update  (GstRTSPMountPoints *mounts);
 
 G_END_DECLS
 
@@ -0,0 +1,191 @@
+/* GStreamer
+ * Copyright (C) 2015 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+
+#ifndef __GST_RTSP_SERVER_INTERNAL_H__
+#define __GST_RTSP_SERVER_INTERNAL_H__
+
+G_BEGIN_DECLS
+
+#include "rtsp-media.h"
+#include "rtsp-media-factory.h"
+#include "rtsp-mount-points.h"
+#include "rtsp-session-pool.h"
+#include "rtsp-thread-pool.h"
+#include "rtsp-client.h"
+#include "rtsp-auth.h"
+#include "rtsp-metrics.h"
+
+/* media */
+typedef void (*GstRTSPMediaPrepareFunc) (GstRTSPMedia *media, gpointer user_data);
+
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_media_claim_standby     (GstRTSPMedia *media);
+G_GNUC_INTERNAL
+void                gst_rtsp_media_release_standby   (GstRTSPMedia *media);
+
+typedef struct _GstRTSPSdpFingerprint GstRTSPSdpFingerprint;
+
+G_GNUC_INTERNAL
+GstRTSPSdpFingerprint * gst_rtsp_media_sdp_fingerprint_new (GstRTSPMedia *media);
+G_GNUC_INTERNAL
+void                gst_rtsp_media_sdp_fingerprint_free (GstRTSPSdpFingerprint *fp);
+G_GNUC_INTERNAL
+gchar *             gst_rtsp_media_lookup_sdp        (GstRTSPMedia *media,
+                                                      const gchar *key,
+                                                      GstRTSPSdpFingerprint *fp,
+                                                      gsize *id_offset,
+                                                      gsize *id_len);
+G_GNUC_INTERNAL
+void                gst_rtsp_media_cache_sdp         (GstRTSPMedia *media,
+                                                      const gchar *key,
+                                                      GstRTSPSdpFingerprint *fp,
+                                                      const gchar *text);
+
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_media_prepare_start     (GstRTSPMedia *media,
+                                                      GstRTSPThread *thread,
+                                                      gboolean *prepared);
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_media_prepare_finish    (GstRTSPMedia *media);
+G_GNUC_INTERNAL
+void                gst_rtsp_media_add_prepare_watch (GstRTSPMedia *media,
+                                                      GstRTSPMediaPrepareFunc func,
+                                                      gpointer user_data,
+                                                      GDestroyNotify notify);
+
+/* stream transport */
+typedef enum {
+  GST_RTSP_TRANSPORT_STAT_RTP_PACKETS,
+  GST_RTSP_TRANSPORT_STAT_RTP_BYTES,
+  GST_RTSP_TRANSPORT_STAT_RTCP_PACKETS,
+  GST_RTSP_TRANSPORT_STAT_RTCP_BYTES,
+  GST_RTSP_TRANSPORT_STAT_DROPPED,
+  GST_RTSP_TRANSPORT_STAT_LAST
+} GstRTSPTransportStat;
+
+G_GNUC_INTERNAL
+gsize               gst_rtsp_buffer_list_get_size    (GstBufferList *buffer_list);
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_transport_set_udp_stats (GstRTSPStreamTransport *trans,
+                                                      const guint64 *udp,
+                                                      gboolean active);
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_transport_set_receiver_report (GstRTSPStreamTransport *trans,
+                                                      guint fraction_lost,
+                                                      gint packets_lost,
+                                                      guint jitter,
+                                                      guint round_trip);
+G_GNUC_INTERNAL
+GArray *            gst_rtsp_stream_transport_stats_array_new (void);
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_stream_transport_has_crypto (GstRTSPStreamTransport *trans);
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_transport_set_copy_metrics (GstRTSPStreamTransport *trans,
+                                                      GstRTSPCopyMetrics *metrics);
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_transport_send_udp (GstRTSPStreamTransport *trans,
+                                                      gboolean is_rtp,
+                                                      GstBufferList *buffer_list,
+                                                      GSocket *socket_v4,
+                                                      GSocket *socket_v6);
+
+/* stream */
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_get_alloc_time   (GstRTSPStream *stream,
+                                                      gint64 *start,
+                                                      gint64 *end);
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_get_udp_stats    (GstRTSPStream *stream,
+                                                      GstRTSPStreamTransport *trans,
+                                                      guint64 *udp);
+G_GNUC_INTERNAL
+void                gst_rtsp_stream_collect_transport_stats (GstRTSPStream *stream,
+                                                      GArray *array);
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_stream_get_transport_rtpinfo (GstRTSPStream *stream,
+                                                      GstRTSPStreamTransport *trans,
+                                                      guint *rtptime, guint *seq,
+                                                      guint *clock_rate,
+                                                      GstClockTime *running_time);
+
+/* media */
+G_GNUC_INTERNAL
+void                gst_rtsp_media_collect_transport_stats (GstRTSPMedia *media,
+                                                      GArray *array);
+G_GNUC_INTERNAL
+GstClockTime        gst_rtsp_media_take_prepare_latency (GstRTSPMedia *media);
+
+/* media factory */
+G_GNUC_INTERNAL
+void                gst_rtsp_media_factory_get_counters (GstRTSPMediaFactory *factory,
+                                                      guint *media,
+                                                      guint *standby,
+                                                      guint *constructed);
+G_GNUC_INTERNAL
+GstRTSPHistogram *  gst_rtsp_media_factory_get_prepare_histogram (GstRTSPMediaFactory *factory);
+
+/* mount points */
+typedef void (*GstRTSPMountPointsFunc) (const gchar *path,
+                                        GstRTSPMediaFactory *factory,
+                                        gpointer user_data);
+
+G_GNUC_INTERNAL
+void                gst_rtsp_mount_points_foreach    (GstRTSPMountPoints *mounts,
+                                                      GstRTSPMountPointsFunc func,
+                                                      gpointer user_data);
+
+/* session pool */
+G_GNUC_INTERNAL
+void                gst_rtsp_session_pool_get_counters (GstRTSPSessionPool *pool,
+                                                      guint *created,
+                                                      guint *expired);
+
+/* thread pool */
+G_GNUC_INTERNAL
+void                gst_rtsp_thread_pool_append_metrics (GstRTSPThreadPool *pool,
+                                                      GString *out);
+
+/* client */
+G_GNUC_INTERNAL
+void                gst_rtsp_client_get_send_queue_depth (GstRTSPClient *client,
+                                                      guint *packets,
+                                                      guint *bytes);
+G_GNUC_INTERNAL
+void                gst_rtsp_client_set_request_metrics (GstRTSPClient *client,
+                                                      GstRTSPRequestMetrics *metrics);
+G_GNUC_INTERNAL
+void                gst_rtsp_client_set_copy_metrics (GstRTSPClient *client,
+                                                      GstRTSPCopyMetrics *metrics);
+
+/* context */
+G_GNUC_INTERNAL
+void                gst_rtsp_context_trace_add       (GstRTSPContext *ctx,
+                                                      const gchar *name,
+                                                      gint64 start,
+                                                      gint64 end);
+
+/* auth */
+G_GNUC_INTERNAL
+GstRTSPMethod       gst_rtsp_auth_get_unchecked_methods (GstRTSPAuth *auth);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_SERVER_INTERNAL_H__ */
@@ -50,13 +50,28 @@
  * The server uses the configured #GstRTSPThreadPool object to handle the
  * remainder of the communication with this client.
  *
+ * On systems that support SO_REUSEPORT, gst_rtsp_server_set_acceptors() can be
+ * used to listen on the port with multiple sockets. The kernel then spreads
+ * new connections over the sockets and each extra socket accepts connections
+ * from its own #GstRTSPThreadPool thread.
+ *
  * Last reviewed on 2013-07-11 (1.0.0)
  */
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
 #include <stdlib.h>
 #include <string.h>
 
 #include "rtsp-server.h"
+
+#ifdef G_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
 #include "rtsp-client.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_SERVER_GET_PRIVATE(obj)  \
        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_SERVER, GstRTSPServerPrivate))
@@ -73,8 +88,18 @@ struct _GstRTSPServerPrivate
   gchar *address;
   gchar *service;
   gint backlog;
+  gint acceptors;
 
   GSocket *socket;
+  /* extra SO_REUSEPORT listeners */
+  GList *acceptor_list;
+
+  /* metrics endpoint */
+  gchar *metrics_address;
+  gchar *metrics_service;
+  GSocket *metrics_socket;
+  GSource *metrics_source;
+  GstRTSPThread *metrics_thread;
 
   /* sessions on this server */
   GstRTSPSessionPool *session_pool;
@@ -91,6 +116,13 @@ struct _GstRTSPServerPrivate
   /* the clients that are connected */
   GList *clients;
   guint clients_cookie;
+  /* total number of accepted clients */
+  guint n_accepted;
+  /* request latency of the clients of this server */
+  GstRTSPRequestMetrics *request_metrics;
+  GstRTSPCopyMetrics *copy_metrics;
+  /* open connections on the metrics endpoint */
+  gint n_metrics_requests;
 };
 
 #define DEFAULT_ADDRESS         "0.0.0.0"
@@ -98,6 +130,20 @@ struct _GstRTSPServerPrivate
 /* #define DEFAULT_ADDRESS         "::0" */
 #define DEFAULT_SERVICE         "8554"
 #define DEFAULT_BACKLOG         5
+#define DEFAULT_ACCEPTORS       1
+#define DEFAULT_METRICS_ADDRESS "127.0.0.1"
+#define DEFAULT_METRICS_SERVICE NULL
+
+/* maximum size of a request on the metrics endpoint, the time to wait for
+ * it or for the response to be sent and the maximum number of open
+ * connections */
+#define METRICS_MAX_REQUEST     4096
+#define METRICS_TIMEOUT         5
+#define METRICS_MAX_CONNECTIONS 4
+
+/* maximum number of connections accepted in one dispatch of a listening
+ * socket */
+#define ACCEPT_BATCH            32
 
 /* Define to use the SO_LINGER option so that the server sockets can be resused
  * sooner. Disabled for now because it is not very well implemented by various
@@ -111,6 +157,9 @@ enum
   PROP_SERVICE,
   PROP_BOUND_PORT,
   PROP_BACKLOG,
+  PROP_ACCEPTORS,
+  PROP_METRICS_ADDRESS,
+  PROP_METRICS_SERVICE,
 
   PROP_SESSION_POOL,
   PROP_MOUNT_POINTS,
@@ -129,6 +178,8 @@ GST_DEBUG_CATEGORY_STATIC (rtsp_server_debug);
 #define GST_CAT_DEFAULT rtsp_server_debug
 
 typedef struct _ClientContext ClientContext;
+typedef struct _Acceptor Acceptor;
+typedef struct _MetricsRequest MetricsRequest;
 
 static guint gst_rtsp_server_signals[SIGNAL_LAST] = { 0 };
 
@@ -138,6 +189,10 @@ static void gst_rtsp_server_set_property (GObject * object, guint propid,
     const GValue * value, GParamSpec * pspec);
 static void gst_rtsp_server_finalize (GObject * object);
 
+static GSocket *create_socket (GstRTSPServer * server,
+    GCancellable * cancellable, gboolean reuse_port, gboolean metrics,
+    GError ** error);
+
 static GstRTSPClient *default_create_client (GstRTSPServer * server);
 
 static void
@@ -199,6 +254,44 @@ gst_rtsp_server_class_init (GstRTSPServerClass * klass)
           "The maximum length to which the queue "
           "of pending connections may grow", 0, G_MAXINT, DEFAULT_BACKLOG,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPServer::acceptors:
+   *
+   * The number of sockets listening on the server port. When larger than 1,
+   * the sockets are opened with SO_REUSEPORT and all but the first one are
+   * dispatched from a client thread of the thread pool.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_ACCEPTORS,
+      g_param_spec_int ("acceptors", "Acceptors",
+          "The number of sockets listening for connections", 1, G_MAXINT,
+          DEFAULT_ACCEPTORS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPServer::metrics-address:
+   *
+   * The address the metrics endpoint listens on.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_METRICS_ADDRESS,
+      g_param_spec_string ("metrics-address", "Metrics Address",
+          "The address the metrics endpoint listens on",
+          DEFAULT_METRICS_ADDRESS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+  /**
+   * GstRTSPServer::metrics-service:
+   *
+   * The service or port number the metrics endpoint listens on. The endpoint
+   * is disabled when this is %NULL. After the server is attached, this
+   * contains the actual port when "0" was configured.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_METRICS_SERVICE,
+      g_param_spec_string ("metrics-service", "Metrics Service",
+          "The service or port number the metrics endpoint listens on "
+          "(NULL = disabled)", DEFAULT_METRICS_SERVICE,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
   /**
    * GstRTSPServer::session-pool:
    *
@@ -246,9 +339,14 @@ gst_rtsp_server_init (GstRTSPServer * server)
   priv->service = g_strdup (DEFAULT_SERVICE);
   priv->socket = NULL;
   priv->backlog = DEFAULT_BACKLOG;
+  priv->acceptors = DEFAULT_ACCEPTORS;
+  priv->metrics_address = g_strdup (DEFAULT_METRICS_ADDRESS);
+  priv->metrics_service = g_strdup (DEFAULT_METRICS_SERVICE);
   priv->session_pool = gst_rtsp_session_pool_new ();
   priv->mount_points = gst_rtsp_mount_points_new ();
   priv->thread_pool = gst_rtsp_thread_pool_new ();
+  priv->request_metrics = gst_rtsp_request_metrics_new ();
+  priv->copy_metrics = gst_rtsp_copy_metrics_new ();
 }
 
 static void
@@ -261,6 +359,8 @@ gst_rtsp_server_finalize (GObject * object)
 
   g_free (priv->address);
   g_free (priv->service);
+  g_free (priv->metrics_address);
+  g_free (priv->metrics_service);
 
   if (priv->socket)
     g_object_unref (priv->socket);
@@ -275,6 +375,9 @@ gst_rtsp_server_finalize (GObject * object)
   if (priv->auth)
     g_object_unref (priv->auth);
 
+  gst_rtsp_request_metrics_unref (priv->request_metrics);
+  gst_rtsp_copy_metrics_unref (priv->copy_metrics);
+
   g_mutex_clear (&priv->lock);
 
   G_OBJECT_CLASS (gst_rtsp_server_parent_class)->finalize (object);
@@ -485,6 +588,186 @@ gst_rtsp_server_get_backlog (GstRTSPServer * server)
   return result;
 }
 
+/**
+ * gst_rtsp_server_set_acceptors:
+ * @server: a #GstRTSPServer
+ * @acceptors: the number of listening sockets
+ *
+ * Configure the number of sockets that listen for connections on the server
+ * port. When @acceptors is larger than 1, all sockets are bound with
+ * SO_REUSEPORT so that the kernel distributes new connections over them. The
+ * first socket is dispatched from the #GMainContext the server is attached to,
+ * the others each from a client thread of the #GstRTSPThreadPool. The
+ * thread pool should be allowed to create at least @acceptors - 1 threads
+ * for the sockets to be dispatched in parallel.
+ *
+ * On systems without SO_REUSEPORT, only one socket is created.
+ *
+ * This function must be called before the server is bound.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_server_set_acceptors (GstRTSPServer * server, gint acceptors)
+{
+  GstRTSPServerPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_SERVER (server));
+  g_return_if_fail (acceptors > 0);
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  priv->acceptors = acceptors;
+  GST_RTSP_SERVER_UNLOCK (server);
+}
+
+/**
+ * gst_rtsp_server_get_acceptors:
+ * @server: a #GstRTSPServer
+ *
+ * Get the number of sockets that listen for connections on the server port.
+ *
+ * Returns: the number of listening sockets.
+ *
+ * Since: 1.6
+ */
+gint
+gst_rtsp_server_get_acceptors (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv;
+  gint result;
+
+  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), -1);
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  result = priv->acceptors;
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_server_set_metrics_address:
+ * @server: a #GstRTSPServer
+ * @address: the address
+ *
+ * Configure @server to serve its metrics on @address. The default is
+ * 127.0.0.1 so that the metrics are only visible on the local host.
+ *
+ * This function must be called before the server is bound.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_server_set_metrics_address (GstRTSPServer * server,
+    const gchar * address)
+{
+  GstRTSPServerPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_SERVER (server));
+  g_return_if_fail (address != NULL);
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  g_free (priv->metrics_address);
+  priv->metrics_address = g_strdup (address);
+  GST_RTSP_SERVER_UNLOCK (server);
+}
+
+/**
+ * gst_rtsp_server_get_metrics_address:
+ * @server: a #GstRTSPServer
+ *
+ * Get the address on which the metrics of @server are served.
+ *
+ * Returns: (transfer full): the metrics address. g_free() after usage.
+ *
+ * Since: 1.6
+ */
+gchar *
+gst_rtsp_server_get_metrics_address (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv;
+  gchar *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  result = g_strdup (priv->metrics_address);
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  return result;
+}
+
+/**
+ * gst_rtsp_server_set_metrics_service:
+ * @server: a #GstRTSPServer
+ * @service: (allow-none): the service
+ *
+ * Configure @server to serve its metrics on the port @service. @service should
+ * be a string containing the service name (see services(5)) or a string
+ * containing a port number between 1 and 65535. When @service is set to "0",
+ * a random port is used. When @service is %NULL, no metrics are served.
+ *
+ * The metrics are served over HTTP in the Prometheus text format, see
+ * gst_rtsp_server_get_metrics(). The listening socket is dispatched from a
+ * thread of the #GstRTSPThreadPool so that scraping the metrics does not
+ * block the main loop of the server.
+ *
+ * This function must be called before the server is bound.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_server_set_metrics_service (GstRTSPServer * server,
+    const gchar * service)
+{
+  GstRTSPServerPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_SERVER (server));
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  g_free (priv->metrics_service);
+  priv->metrics_service = g_strdup (service);
+  GST_RTSP_SERVER_UNLOCK (server);
+}
+
+/**
+ * gst_rtsp_server_get_metrics_service:
+ * @server: a #GstRTSPServer
+ *
+ * Get the service on which the metrics of @server are served.
+ *
+ * Returns: (transfer full): the metrics service or %NULL when no metrics are
+ * served. g_free() after usage.
+ *
+ * Since: 1.6
+ */
+gchar *
+gst_rtsp_server_get_metrics_service (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv;
+  gchar *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  result = g_strdup (priv->metrics_service);
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  return result;
+}
+
 /**
  * gst_rtsp_server_set_session_pool:
  * @server: a #GstRTSPServer
@@ -733,6 +1016,15 @@ gst_rtsp_server_get_property (GObject * object, guint propid,
     case PROP_BACKLOG:
       g_value_set_int (value, gst_rtsp_server_get_backlog (server));
       break;
+    case PROP_ACCEPTORS:
+      g_value_set_int (value, gst_rtsp_server_get_acceptors (server));
+      break;
+    case PROP_METRICS_ADDRESS:
+      g_value_take_string (value, gst_rtsp_server_get_metrics_address (server));
+      break;
+    case PROP_METRICS_SERVICE:
+      g_value_take_string (value, gst_rtsp_server_get_metrics_service (server));
+      break;
     case PROP_SESSION_POOL:
       g_value_take_object (value, gst_rtsp_server_get_session_pool (server));
       break;
@@ -760,6 +1052,15 @@ gst_rtsp_server_set_property (GObject * object, guint propid,
     case PROP_BACKLOG:
       gst_rtsp_server_set_backlog (server, g_value_get_int (value));
       break;
+    case PROP_ACCEPTORS:
+      gst_rtsp_server_set_acceptors (server, g_value_get_int (value));
+      break;
+    case PROP_METRICS_ADDRESS:
+      gst_rtsp_server_set_metrics_address (server, g_value_get_string (value));
+      break;
+    case PROP_METRICS_SERVICE:
+      gst_rtsp_server_set_metrics_service (server, g_value_get_string (value));
+      break;
     case PROP_SESSION_POOL:
       gst_rtsp_server_set_session_pool (server, g_value_get_object (value));
       break;
@@ -786,8 +1087,32 @@ gst_rtsp_server_set_property (GObject * object, guint propid,
 GSocket *
 gst_rtsp_server_create_socket (GstRTSPServer * server,
     GCancellable * cancellable, GError ** error)
+{
+  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
+
+  return create_socket (server, cancellable, FALSE, FALSE, error);
+}
+
+static gboolean
+set_reuse_port (GSocket * socket)
+{
+#ifdef SO_REUSEPORT
+  gint val = 1;
+
+  return setsockopt (g_socket_get_fd (socket), SOL_SOCKET, SO_REUSEPORT,
+      (void *) &val, sizeof (val)) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+static GSocket *
+create_socket (GstRTSPServer * server, GCancellable * cancellable,
+    gboolean reuse_port, gboolean metrics, GError ** error)
 {
   GstRTSPServerPrivate *priv;
+  const gchar *address;
+  gchar **service;
   GSocketConnectable *conn;
   GSocketAddressEnumerator *enumerator;
   GSocket *socket = NULL;
@@ -798,20 +1123,26 @@ gst_rtsp_server_create_socket (GstRTSPServer * server,
   GError *bind_error = NULL;
   guint16 port;
 
-  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
-
   priv = server->priv;
 
   GST_RTSP_SERVER_LOCK (server);
-  GST_DEBUG_OBJECT (server, "getting address info of %s/%s", priv->address,
-      priv->service);
+  /* the metrics endpoint has its own address and service */
+  if (metrics) {
+    address = priv->metrics_address;
+    service = &priv->metrics_service;
+  } else {
+    address = priv->address;
+    service = &priv->service;
+  }
+  GST_DEBUG_OBJECT (server, "getting address info of %s/%s", address,
+      *service);
 
   /* resolve the server IP address */
-  port = atoi (priv->service);
-  if (port != 0 || !strcmp (priv->service, "0"))
-    conn = g_network_address_new (priv->address, port);
+  port = atoi (*service);
+  if (port != 0 || !strcmp (*service, "0"))
+    conn = g_network_address_new (address, port);
   else
-    conn = g_network_service_new (priv->service, "tcp", priv->address);
+    conn = g_network_service_new (*service, "tcp", address);
 
   enumerator = g_socket_connectable_enumerate (conn);
   g_object_unref (conn);
@@ -845,9 +1176,13 @@ gst_rtsp_server_create_socket (GstRTSPServer * server,
       continue;
     }
 
+    /* must be set on all the sockets before they are bound */
+    if (reuse_port && !set_reuse_port (socket))
+      GST_WARNING_OBJECT (server, "failed to set SO_REUSEPORT");
+
     if (g_socket_bind (socket, sockaddr, TRUE, bind_error ? NULL : &bind_error)) {
       /* ask what port the socket has been bound to */
-      if (port == 0 || !strcmp (priv->service, "0")) {
+      if (port == 0 || !strcmp (*service, "0")) {
         GError *addr_error = NULL;
 
         g_object_unref (sockaddr);
@@ -864,8 +1199,8 @@ gst_rtsp_server_create_socket (GstRTSPServer * server,
             g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (sockaddr));
 
         if (port != 0) {
-          g_free (priv->service);
-          priv->service = g_strdup_printf ("%d", port);
+          g_free (*service);
+          *service = g_strdup_printf ("%d", port);
         } else {
           GST_DEBUG_OBJECT (server, "failed to get the port of a bound socket");
         }
@@ -1039,6 +1374,9 @@ manage_client (GstRTSPServer * server, GstRTSPClient * client)
   ctx.server = server;
   ctx.client = client;
 
+  gst_rtsp_client_set_request_metrics (client, priv->request_metrics);
+  gst_rtsp_client_set_copy_metrics (client, priv->copy_metrics);
+
   cctx->thread = gst_rtsp_thread_pool_get_thread (priv->thread_pool,
       GST_RTSP_THREAD_TYPE_CLIENT, &ctx);
   if (cctx->thread)
@@ -1053,6 +1391,7 @@ manage_client (GstRTSPServer * server, GstRTSPClient * client)
   g_signal_connect (client, "closed", (GCallback) unmanage_client, cctx);
   priv->clients = g_list_prepend (priv->clients, cctx);
   priv->clients_cookie++;
+  priv->n_accepted++;
 
   gst_rtsp_client_attach (client, mainctx);
 
@@ -1142,20 +1481,10 @@ no_connection:
   }
 }
 
-/**
- * gst_rtsp_server_io_func:
- * @socket: a #GSocket
- * @condition: the condition on @source
- * @server: (transfer none): a #GstRTSPServer
- *
- * A default #GSocketSourceFunc that creates a new #GstRTSPClient to accept and handle a
- * new connection on @socket or @server.
- *
- * Returns: TRUE if the source could be connected, FALSE if an error occurred.
- */
-gboolean
-gst_rtsp_server_io_func (GSocket * socket, GIOCondition condition,
-    GstRTSPServer * server)
+/* accept one new connection on @socket, returns FALSE when no connection
+ * could be accepted */
+static gboolean
+accept_client (GstRTSPServer * server, GSocket * socket)
 {
   GstRTSPServerPrivate *priv = server->priv;
   GstRTSPClient *client = NULL;
@@ -1164,38 +1493,35 @@ gst_rtsp_server_io_func (GSocket * socket, GIOCondition condition,
   GstRTSPConnection *conn = NULL;
   GstRTSPContext ctx = { NULL };
 
-  if (condition & G_IO_IN) {
-    /* a new client connected. */
-    GST_RTSP_CHECK (gst_rtsp_connection_accept (socket, &conn, NULL),
-        accept_failed);
-
-    ctx.server = server;
-    ctx.conn = conn;
-    ctx.auth = priv->auth;
-    gst_rtsp_context_push_current (&ctx);
-
-    if (!gst_rtsp_auth_check (GST_RTSP_AUTH_CHECK_CONNECT))
-      goto connection_refused;
-
-    klass = GST_RTSP_SERVER_GET_CLASS (server);
-    /* a new client connected, create a client object to handle the client. */
-    if (klass->create_client)
-      client = klass->create_client (server);
-    if (client == NULL)
-      goto client_failed;
-
-    /* set connection on the client now */
-    gst_rtsp_client_set_connection (client, conn);
-
-    /* manage the client connection */
-    manage_client (server, client);
-  } else {
-    GST_WARNING_OBJECT (server, "received unknown event %08x", condition);
-  }
+  /* a new client connected. */
+  GST_RTSP_CHECK (gst_rtsp_connection_accept (socket, &conn, NULL),
+      accept_failed);
+
+  ctx.server = server;
+  ctx.conn = conn;
+  ctx.auth = priv->auth;
+  gst_rtsp_context_push_current (&ctx);
+
+  if (!gst_rtsp_auth_check (GST_RTSP_AUTH_CHECK_CONNECT))
+    goto connection_refused;
+
+  klass = GST_RTSP_SERVER_GET_CLASS (server);
+  /* a new client connected, create a client object to handle the client. */
+  if (klass->create_client)
+    client = klass->create_client (server);
+  if (client == NULL)
+    goto client_failed;
+
+  /* set connection on the client now */
+  gst_rtsp_client_set_connection (client, conn);
+
+  /* manage the client connection */
+  manage_client (server, client);
+
 exit:
   gst_rtsp_context_pop_current (&ctx);
 
-  return G_SOURCE_CONTINUE;
+  return TRUE;
 
   /* ERRORS */
 accept_failed:
@@ -1204,7 +1530,7 @@ accept_failed:
     GST_ERROR_OBJECT (server, "Could not accept client on socket %p: %s",
         socket, str);
     g_free (str);
-    goto exit;
+    return FALSE;
   }
 connection_refused:
   {
@@ -1220,26 +1546,464 @@ client_failed:
   }
 }
 
+/**
+ * gst_rtsp_server_io_func:
+ * @socket: a #GSocket
+ * @condition: the condition on @source
+ * @server: (transfer none): a #GstRTSPServer
+ *
+ * A default #GSocketSourceFunc that creates a new #GstRTSPClient to accept and handle a
+ * new connection on @socket or @server. All connections that are pending on
+ * @socket are accepted, up to a maximum per call.
+ *
+ * Returns: TRUE if the source could be connected, FALSE if an error occurred.
+ */
+gboolean
+gst_rtsp_server_io_func (GSocket * socket, GIOCondition condition,
+    GstRTSPServer * server)
+{
+  gint i;
+
+  if (condition & G_IO_IN) {
+    /* accept the connections that are queued on the socket in one go. The
+     * socket is nonblocking, we stop when no more connections are pending */
+    for (i = 0; i < ACCEPT_BATCH; i++) {
+      if (i > 0 && !(g_socket_condition_check (socket, G_IO_IN) & G_IO_IN))
+        break;
+      if (!accept_client (server, socket))
+        break;
+    }
+  } else {
+    GST_WARNING_OBJECT (server, "received unknown event %08x", condition);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+struct _Acceptor
+{
+  GSocket *socket;
+  GSource *source;
+  GstRTSPThread *thread;
+};
+
 static void
-watch_destroyed (GstRTSPServer * server)
+stop_acceptors (GstRTSPServer * server)
 {
   GstRTSPServerPrivate *priv = server->priv;
+  GList *acceptors, *walk;
 
-  GST_DEBUG_OBJECT (server, "source destroyed");
+  GST_RTSP_SERVER_LOCK (server);
+  acceptors = priv->acceptor_list;
+  priv->acceptor_list = NULL;
+  GST_RTSP_SERVER_UNLOCK (server);
 
-  g_object_unref (priv->socket);
-  priv->socket = NULL;
-  g_object_unref (server);
+  for (walk = acceptors; walk; walk = g_list_next (walk)) {
+    Acceptor *acceptor = walk->data;
+
+    g_source_destroy (acceptor->source);
+    g_source_unref (acceptor->source);
+    gst_rtsp_thread_stop (acceptor->thread);
+    g_object_unref (acceptor->socket);
+    g_slice_free (Acceptor, acceptor);
+  }
+  g_list_free (acceptors);
 }
 
-/**
- * gst_rtsp_server_create_source:
- * @server: a #GstRTSPServer
- * @cancellable: (allow-none): a #GCancellable or %NULL.
- * @error: (out): a #GError
- *
- * Create a #GSource for @server. The new source will have a default
- * #GSocketSourceFunc of gst_rtsp_server_io_func().
+/* open an extra listening socket on the port of the server and dispatch it
+ * from a thread of the thread pool */
+static gboolean
+start_acceptor (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv = server->priv;
+  Acceptor *acceptor;
+  GstRTSPThread *thread;
+  GstRTSPContext ctx = { NULL };
+  GSocket *socket;
+  GSource *source;
+  GError *error = NULL;
+
+  socket = create_socket (server, NULL, TRUE, FALSE, &error);
+  if (socket == NULL)
+    goto no_socket;
+
+  ctx.server = server;
+
+  GST_RTSP_SERVER_LOCK (server);
+  thread = gst_rtsp_thread_pool_get_thread (priv->thread_pool,
+      GST_RTSP_THREAD_TYPE_CLIENT, &ctx);
+  GST_RTSP_SERVER_UNLOCK (server);
+  if (thread == NULL)
+    goto no_thread;
+
+  source = g_socket_create_source (socket, G_IO_IN |
+      G_IO_ERR | G_IO_HUP | G_IO_NVAL, NULL);
+  g_source_set_callback (source,
+      (GSourceFunc) gst_rtsp_server_io_func, g_object_ref (server),
+      (GDestroyNotify) g_object_unref);
+
+  acceptor = g_slice_new (Acceptor);
+  acceptor->socket = socket;
+  acceptor->source = source;
+  acceptor->thread = thread;
+
+  GST_RTSP_SERVER_LOCK (server);
+  priv->acceptor_list = g_list_prepend (priv->acceptor_list, acceptor);
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  g_source_attach (source, thread->context);
+
+  GST_DEBUG_OBJECT (server, "started acceptor on socket %p", socket);
+
+  return TRUE;
+
+  /* ERRORS */
+no_socket:
+  {
+    GST_WARNING_OBJECT (server, "failed to create acceptor socket: %s",
+        error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+no_thread:
+  {
+    GST_WARNING_OBJECT (server, "no thread for acceptor");
+    g_object_unref (socket);
+    return FALSE;
+  }
+}
+
+struct _MetricsRequest
+{
+  GstRTSPServer *server;
+  GSocket *socket;
+  /* the request while it is read, then the response */
+  GString *data;
+  gsize offset;
+};
+
+static MetricsRequest *
+new_metrics_request (GstRTSPServer * server, GSocket * socket, GString * data)
+{
+  MetricsRequest *req;
+
+  g_atomic_int_inc (&server->priv->n_metrics_requests);
+
+  req = g_slice_new (MetricsRequest);
+  req->server = g_object_ref (server);
+  req->socket = g_object_ref (socket);
+  req->data = data;
+  req->offset = 0;
+
+  return req;
+}
+
+static void
+free_metrics_request (MetricsRequest * req)
+{
+  g_atomic_int_add (&req->server->priv->n_metrics_requests, -1);
+
+  g_object_unref (req->socket);
+  g_object_unref (req->server);
+  g_string_free (req->data, TRUE);
+  g_slice_free (MetricsRequest, req);
+}
+
+/* make the response for the request in @data, only GET of / or /metrics is
+ * supported */
+static GString *
+make_metrics_response (GstRTSPServer * server, GString * data)
+{
+  gchar **request_line, *body = NULL;
+  const gchar *status;
+  GString *response;
+
+  request_line = g_strsplit_set (data->str, " \r\n", 3);
+
+  if (g_strv_length (request_line) < 2 || strcmp (request_line[0], "GET"))
+    status = "405 Method Not Allowed";
+  else if (strcmp (request_line[1], "/metrics")
+      && strcmp (request_line[1], "/"))
+    status = "404 Not Found";
+  else {
+    status = "200 OK";
+    body = gst_rtsp_server_get_metrics (server);
+  }
+  g_strfreev (request_line);
+
+  GST_DEBUG_OBJECT (server, "metrics request: %s", status);
+
+  response = g_string_new (NULL);
+  g_string_append_printf (response, "HTTP/1.0 %s\r\n"
+      "Content-Type: text/plain; version=0.0.4\r\n"
+      "Content-Length: %" G_GSIZE_FORMAT "\r\n"
+      "Connection: close\r\n\r\n", status, body ? strlen (body) : 0);
+  if (body)
+    g_string_append (response, body);
+  g_free (body);
+
+  return response;
+}
+
+/* write the response in @req as the socket accepts it */
+static gboolean
+metrics_response_io (GSocket * socket, GIOCondition condition,
+    MetricsRequest * req)
+{
+  gssize sent;
+  GError *error = NULL;
+
+  if (!(condition & G_IO_OUT))
+    return G_SOURCE_REMOVE;
+
+  sent = g_socket_send (socket, req->data->str + req->offset,
+      req->data->len - req->offset, NULL, &error);
+  if (sent < 0)
+    goto send_error;
+
+  req->offset += sent;
+  if (req->offset < req->data->len)
+    return G_SOURCE_CONTINUE;
+
+  return G_SOURCE_REMOVE;
+
+  /* ERRORS */
+send_error:
+  {
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free (error);
+      return G_SOURCE_CONTINUE;
+    }
+    /* also when the timeout of the socket expired */
+    GST_WARNING_OBJECT (req->server, "failed to send metrics: %s",
+        error->message);
+    g_error_free (error);
+    return G_SOURCE_REMOVE;
+  }
+}
+
+static gboolean
+metrics_request_io (GSocket * socket, GIOCondition condition,
+    MetricsRequest * req)
+{
+  gchar buffer[1024];
+  gssize len;
+  GError *error = NULL;
+
+  if (!(condition & G_IO_IN))
+    return G_SOURCE_REMOVE;
+
+  len = g_socket_receive (socket, buffer, sizeof (buffer), NULL, &error);
+  if (len < 0)
+    goto read_error;
+  if (len == 0)
+    return G_SOURCE_REMOVE;
+
+  g_string_append_len (req->data, buffer, len);
+
+  /* wait for the end of the request headers */
+  if (strstr (req->data->str, "\r\n\r\n")
+      || strstr (req->data->str, "\n\n")) {
+    MetricsRequest *resp;
+    GSource *source;
+
+    /* the response is written from the same context without blocking it */
+    resp = new_metrics_request (req->server, socket,
+        make_metrics_response (req->server, req->data));
+
+    source = g_socket_create_source (socket, G_IO_OUT |
+        G_IO_ERR | G_IO_HUP | G_IO_NVAL, NULL);
+    g_source_set_callback (source, (GSourceFunc) metrics_response_io, resp,
+        (GDestroyNotify) free_metrics_request);
+    g_source_attach (source, g_source_get_context (g_main_current_source ()));
+    g_source_unref (source);
+
+    return G_SOURCE_REMOVE;
+  }
+  if (req->data->len > METRICS_MAX_REQUEST)
+    goto too_large;
+
+  return G_SOURCE_CONTINUE;
+
+  /* ERRORS */
+read_error:
+  {
+    if (g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK)) {
+      g_error_free (error);
+      return G_SOURCE_CONTINUE;
+    }
+    /* also when the timeout of the socket expired */
+    GST_DEBUG_OBJECT (req->server, "failed to read metrics request: %s",
+        error->message);
+    g_error_free (error);
+    return G_SOURCE_REMOVE;
+  }
+too_large:
+  {
+    GST_WARNING_OBJECT (req->server, "metrics request too large");
+    return G_SOURCE_REMOVE;
+  }
+}
+
+static gboolean
+metrics_io_func (GSocket * socket, GIOCondition condition,
+    GstRTSPServer * server)
+{
+  GMainContext *context;
+  gint i;
+
+  if (!(condition & G_IO_IN)) {
+    GST_WARNING_OBJECT (server, "received unknown event %08x", condition);
+    return G_SOURCE_CONTINUE;
+  }
+
+  /* handle the requests in the context of the listening socket */
+  context = g_source_get_context (g_main_current_source ());
+
+  for (i = 0; i < ACCEPT_BATCH; i++) {
+    MetricsRequest *req;
+    GSocket *client;
+    GSource *source;
+    GError *error = NULL;
+
+    client = g_socket_accept (socket, NULL, &error);
+    if (client == NULL) {
+      if (!g_error_matches (error, G_IO_ERROR, G_IO_ERROR_WOULD_BLOCK))
+        GST_WARNING_OBJECT (server, "failed to accept metrics connection: %s",
+            error->message);
+      g_error_free (error);
+      break;
+    }
+
+    /* the thread is shared with RTSP clients, don't let scrapers pile up */
+    if (g_atomic_int_get (&server->priv->n_metrics_requests) >=
+        METRICS_MAX_CONNECTIONS) {
+      GST_WARNING_OBJECT (server, "too many metrics connections");
+      g_object_unref (client);
+      continue;
+    }
+
+    g_socket_set_blocking (client, FALSE);
+    g_socket_set_timeout (client, METRICS_TIMEOUT);
+
+    req = new_metrics_request (server, client, g_string_new (NULL));
+    g_object_unref (client);
+
+    source = g_socket_create_source (req->socket, G_IO_IN |
+        G_IO_ERR | G_IO_HUP | G_IO_NVAL, NULL);
+    g_source_set_callback (source, (GSourceFunc) metrics_request_io, req,
+        (GDestroyNotify) free_metrics_request);
+    g_source_attach (source, context);
+    g_source_unref (source);
+  }
+  return G_SOURCE_CONTINUE;
+}
+
+static void
+stop_metrics (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv = server->priv;
+  GSocket *socket;
+  GSource *source;
+  GstRTSPThread *thread;
+
+  GST_RTSP_SERVER_LOCK (server);
+  socket = priv->metrics_socket;
+  source = priv->metrics_source;
+  thread = priv->metrics_thread;
+  priv->metrics_socket = NULL;
+  priv->metrics_source = NULL;
+  priv->metrics_thread = NULL;
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  if (source == NULL)
+    return;
+
+  g_source_destroy (source);
+  g_source_unref (source);
+  gst_rtsp_thread_stop (thread);
+  g_object_unref (socket);
+}
+
+/* open the metrics socket and dispatch it from a thread of the thread pool */
+static gboolean
+start_metrics (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv = server->priv;
+  GstRTSPThread *thread;
+  GstRTSPContext ctx = { NULL };
+  GSocket *socket;
+  GSource *source;
+  GError *error = NULL;
+
+  socket = create_socket (server, NULL, FALSE, TRUE, &error);
+  if (socket == NULL)
+    goto no_socket;
+
+  ctx.server = server;
+
+  GST_RTSP_SERVER_LOCK (server);
+  thread = gst_rtsp_thread_pool_get_thread (priv->thread_pool,
+      GST_RTSP_THREAD_TYPE_CLIENT, &ctx);
+  GST_RTSP_SERVER_UNLOCK (server);
+  if (thread == NULL)
+    goto no_thread;
+
+  source = g_socket_create_source (socket, G_IO_IN |
+      G_IO_ERR | G_IO_HUP | G_IO_NVAL, NULL);
+  g_source_set_callback (source, (GSourceFunc) metrics_io_func,
+      g_object_ref (server), (GDestroyNotify) g_object_unref);
+
+  GST_RTSP_SERVER_LOCK (server);
+  priv->metrics_socket = socket;
+  priv->metrics_source = source;
+  priv->metrics_thread = thread;
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  g_source_attach (source, thread->context);
+
+  GST_DEBUG_OBJECT (server, "serving metrics on socket %p", socket);
+
+  return TRUE;
+
+  /* ERRORS */
+no_socket:
+  {
+    GST_WARNING_OBJECT (server, "failed to create metrics socket: %s",
+        error->message);
+    g_error_free (error);
+    return FALSE;
+  }
+no_thread:
+  {
+    GST_WARNING_OBJECT (server, "no thread for metrics");
+    g_object_unref (socket);
+    return FALSE;
+  }
+}
+
+static void
+watch_destroyed (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv = server->priv;
+
+  GST_DEBUG_OBJECT (server, "source destroyed");
+
+  stop_acceptors (server);
+  stop_metrics (server);
+
+  g_object_unref (priv->socket);
+  priv->socket = NULL;
+  g_object_unref (server);
+}
+
+/**
+ * gst_rtsp_server_create_source:
+ * @server: a #GstRTSPServer
+ * @cancellable: (allow-none): a #GCancellable or %NULL.
+ * @error: (out): a #GError
+ *
+ * Create a #GSource for @server. The new source will have a default
+ * #GSocketSourceFunc of gst_rtsp_server_io_func().
  *
  * @cancellable if not %NULL can be used to cancel the source, which will cause
  * the source to trigger, reporting the current condition (which is likely 0
@@ -1248,6 +2012,12 @@ watch_destroyed (GstRTSPServer * server)
  *
  * This takes a reference on @server until @source is destroyed.
  *
+ * When more than one acceptor was configured with
+ * gst_rtsp_server_set_acceptors(), the extra listening sockets are created and
+ * attached to thread pool threads here. The same is done for the metrics
+ * endpoint when gst_rtsp_server_set_metrics_service() was called. They are
+ * removed again when @source is destroyed.
+ *
  * Returns: (transfer full): the #GSource for @server or %NULL when an error
  * occurred. Free with g_source_unref ()
  */
@@ -1258,12 +2028,26 @@ gst_rtsp_server_create_source (GstRTSPServer * server,
   GstRTSPServerPrivate *priv;
   GSocket *socket, *old;
   GSource *source;
+  gint acceptors;
+  gboolean metrics;
 
   g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
 
   priv = server->priv;
 
-  socket = gst_rtsp_server_create_socket (server, NULL, error);
+  GST_RTSP_SERVER_LOCK (server);
+  acceptors = priv->acceptors;
+  metrics = priv->metrics_service != NULL;
+  GST_RTSP_SERVER_UNLOCK (server);
+
+#ifndef SO_REUSEPORT
+  if (acceptors > 1) {
+    GST_WARNING_OBJECT (server, "SO_REUSEPORT not supported, using 1 acceptor");
+    acceptors = 1;
+  }
+#endif
+
+  socket = create_socket (server, NULL, acceptors > 1, FALSE, error);
   if (socket == NULL)
     goto no_socket;
 
@@ -1285,6 +2069,14 @@ gst_rtsp_server_create_source (GstRTSPServer * server,
       (GSourceFunc) gst_rtsp_server_io_func, g_object_ref (server),
       (GDestroyNotify) watch_destroyed);
 
+  while (--acceptors > 0) {
+    if (!start_acceptor (server))
+      break;
+  }
+
+  if (metrics)
+    start_metrics (server);
+
   return source;
 
 no_socket:
@@ -1436,3 +2228,245 @@ restart:
 
   return result;
 }
+
+/**
+ * gst_rtsp_server_get_transport_stats:
+ * @server: a #GstRTSPServer
+ *
+ * Get a snapshot of the statistics of the transports of all media in the
+ * sessions of @server. Media that are shared between sessions are only
+ * reported once.
+ *
+ * Returns: (transfer full) (element-type GstRTSPStreamTransportStats): a
+ * #GArray of #GstRTSPStreamTransportStats. g_array_unref() after usage.
+ *
+ * Since: 1.6
+ */
+GArray *
+gst_rtsp_server_get_transport_stats (GstRTSPServer * server)
+{
+  GstRTSPSessionPool *pool;
+  GList *sessions, *walk;
+  GHashTable *visited;
+  GArray *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
+
+  result = gst_rtsp_stream_transport_stats_array_new ();
+
+  if (!(pool = gst_rtsp_server_get_session_pool (server)))
+    return result;
+
+  visited = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+
+  sessions = gst_rtsp_session_pool_filter (pool, NULL, NULL);
+  for (walk = sessions; walk; walk = g_list_next (walk)) {
+    GstRTSPSession *session = walk->data;
+    GList *medias, *mwalk;
+
+    medias = gst_rtsp_session_filter (session, NULL, NULL);
+    for (mwalk = medias; mwalk; mwalk = g_list_next (mwalk)) {
+      GstRTSPMedia *media;
+
+      media = gst_rtsp_session_media_get_media (mwalk->data);
+      if (g_hash_table_contains (visited, media))
+        continue;
+
+      g_hash_table_add (visited, g_object_ref (media));
+      gst_rtsp_media_collect_transport_stats (media, result);
+    }
+    g_list_free_full (medias, g_object_unref);
+  }
+  g_list_free_full (sessions, g_object_unref);
+
+  g_hash_table_unref (visited);
+  g_object_unref (pool);
+
+  return result;
+}
+
+typedef struct
+{
+  gchar *labels;
+  GstRTSPMediaFactory *factory;
+  guint media;
+  guint standby;
+  guint constructed;
+} FactoryMetrics;
+
+static void
+collect_factory_metrics (const gchar * path, GstRTSPMediaFactory * factory,
+    GArray * array)
+{
+  FactoryMetrics fm;
+  GString *labels;
+
+  labels = g_string_new (NULL);
+  gst_rtsp_metrics_append_label (labels, "path", path);
+  fm.labels = g_string_free (labels, FALSE);
+  fm.factory = g_object_ref (factory);
+  gst_rtsp_media_factory_get_counters (factory, &fm.media, &fm.standby,
+      &fm.constructed);
+
+  g_array_append_val (array, fm);
+}
+
+static void
+append_factory_metrics (GString * out, GstRTSPMountPoints * mounts)
+{
+  GArray *array;
+  guint i;
+
+  array = g_array_new (FALSE, FALSE, sizeof (FactoryMetrics));
+  gst_rtsp_mount_points_foreach (mounts,
+      (GstRTSPMountPointsFunc) collect_factory_metrics, array);
+
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_factory_media", "gauge",
+      "Number of media of a factory");
+  for (i = 0; i < array->len; i++) {
+    FactoryMetrics *fm = &g_array_index (array, FactoryMetrics, i);
+    gst_rtsp_metrics_append_value (out, "gst_rtsp_factory_media", fm->labels,
+        fm->media);
+  }
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_factory_standby_media",
+      "gauge", "Number of prepared media waiting for a client");
+  for (i = 0; i < array->len; i++) {
+    FactoryMetrics *fm = &g_array_index (array, FactoryMetrics, i);
+    gst_rtsp_metrics_append_value (out, "gst_rtsp_factory_standby_media",
+        fm->labels, fm->standby);
+  }
+  gst_rtsp_metrics_append_header (out,
+      "gst_rtsp_factory_media_constructed_total", "counter",
+      "Number of media constructed by a factory");
+  for (i = 0; i < array->len; i++) {
+    FactoryMetrics *fm = &g_array_index (array, FactoryMetrics, i);
+    gst_rtsp_metrics_append_value (out,
+        "gst_rtsp_factory_media_constructed_total", fm->labels,
+        fm->constructed);
+  }
+  gst_rtsp_metrics_append_header (out,
+      "gst_rtsp_media_prepare_duration_seconds", "histogram",
+      "Time to prepare a media");
+  for (i = 0; i < array->len; i++) {
+    FactoryMetrics *fm = &g_array_index (array, FactoryMetrics, i);
+    gst_rtsp_metrics_append_histogram (out,
+        "gst_rtsp_media_prepare_duration_seconds", fm->labels,
+        gst_rtsp_media_factory_get_prepare_histogram (fm->factory));
+  }
+
+  for (i = 0; i < array->len; i++) {
+    FactoryMetrics *fm = &g_array_index (array, FactoryMetrics, i);
+    g_free (fm->labels);
+    g_object_unref (fm->factory);
+  }
+  g_array_free (array, TRUE);
+}
+
+/**
+ * gst_rtsp_server_get_metrics:
+ * @server: a #GstRTSPServer
+ *
+ * Get the current metrics of @server in the Prometheus text exposition
+ * format. This contains the number of clients and sessions, the media of
+ * each mount point, the time it took to handle requests and to prepare
+ * media, the depth of the send queues of the clients and the utilization of
+ * the threads of the #GstRTSPThreadPool.
+ *
+ * The same text is served over HTTP when a metrics service was configured
+ * with gst_rtsp_server_set_metrics_service().
+ *
+ * Returns: (transfer full): the metrics of @server. g_free() after usage.
+ *
+ * Since: 1.6
+ */
+gchar *
+gst_rtsp_server_get_metrics (GstRTSPServer * server)
+{
+  GstRTSPServerPrivate *priv;
+  GstRTSPSessionPool *pool;
+  GstRTSPMountPoints *mounts;
+  GstRTSPThreadPool *thread_pool;
+  GList *clients, *walk;
+  guint n_clients, n_accepted;
+  guint created = 0, expired = 0, n_sessions = 0;
+  guint total_packets = 0, total_bytes = 0, max_bytes = 0;
+  GString *out;
+
+  g_return_val_if_fail (GST_IS_RTSP_SERVER (server), NULL);
+
+  priv = server->priv;
+
+  GST_RTSP_SERVER_LOCK (server);
+  n_clients = g_list_length (priv->clients);
+  n_accepted = priv->n_accepted;
+  pool = priv->session_pool ? g_object_ref (priv->session_pool) : NULL;
+  mounts = priv->mount_points ? g_object_ref (priv->mount_points) : NULL;
+  thread_pool = priv->thread_pool ? g_object_ref (priv->thread_pool) : NULL;
+  GST_RTSP_SERVER_UNLOCK (server);
+
+  out = g_string_new (NULL);
+
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_clients", "gauge",
+      "Number of connected clients");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_clients", NULL, n_clients);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_clients_accepted_total",
+      "counter", "Number of accepted clients");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_clients_accepted_total", NULL,
+      n_accepted);
+
+  if (pool) {
+    n_sessions = gst_rtsp_session_pool_get_n_sessions (pool);
+    gst_rtsp_session_pool_get_counters (pool, &created, &expired);
+    g_object_unref (pool);
+  }
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_sessions", "gauge",
+      "Number of active sessions");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_sessions", NULL, n_sessions);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_sessions_created_total",
+      "counter", "Number of created sessions");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_sessions_created_total", NULL,
+      created);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_sessions_expired_total",
+      "counter", "Number of sessions that timed out");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_sessions_expired_total", NULL,
+      expired);
+
+  if (mounts) {
+    append_factory_metrics (out, mounts);
+    g_object_unref (mounts);
+  }
+
+  gst_rtsp_request_metrics_append (priv->request_metrics, out);
+  gst_rtsp_copy_metrics_append (priv->copy_metrics, out);
+
+  clients = gst_rtsp_server_client_filter (server, NULL, NULL);
+  for (walk = clients; walk; walk = g_list_next (walk)) {
+    guint packets, bytes;
+
+    gst_rtsp_client_get_send_queue_depth (walk->data, &packets, &bytes);
+    total_packets += packets;
+    total_bytes += bytes;
+    max_bytes = MAX (max_bytes, bytes);
+  }
+  g_list_free_full (clients, g_object_unref);
+
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_send_queue_messages", "gauge",
+      "Number of messages queued for sending, over all clients");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_send_queue_messages", NULL,
+      total_packets);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_send_queue_bytes", "gauge",
+      "Number of bytes queued for sending, over all clients");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_send_queue_bytes", NULL,
+      total_bytes);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_send_queue_max_bytes",
+      "gauge", "Largest number of bytes queued for sending to one client");
+  gst_rtsp_metrics_append_value (out, "gst_rtsp_send_queue_max_bytes", NULL,
+      max_bytes);
+
+  if (thread_pool) {
+    gst_rtsp_thread_pool_append_metrics (thread_pool, out);
+    g_object_unref (thread_pool);
+  }
+
+  return g_string_free (out, FALSE);
+}
@@ -106,6 +106,15 @@ gchar *               gst_rtsp_server_get_service          (GstRTSPServer *serve
 void                  gst_rtsp_server_set_backlog          (GstRTSPServer *server, gint backlog);
 gint                  gst_rtsp_server_get_backlog          (GstRTSPServer *server);
 
+void                  gst_rtsp_server_set_acceptors        (GstRTSPServer *server, gint acceptors);
+gint                  gst_rtsp_server_get_acceptors        (GstRTSPServer *server);
+
+void                  gst_rtsp_server_set_metrics_address  (GstRTSPServer *server, const gchar *address);
+gchar *               gst_rtsp_server_get_metrics_address  (GstRTSPServer *server);
+
+void                  gst_rtsp_server_set_metrics_service  (GstRTSPServer *server, const gchar *service);
+gchar *               gst_rtsp_server_get_metrics_service  (GstRTSPServer *server);
+
 int                   gst_rtsp_server_get_bound_port       (GstRTSPServer *server);
 
 void                  gst_rtsp_server_set_session_pool     (GstRTSPServer *server, GstRTSPSessionPool *pool);
@@ -164,6 +173,10 @@ GList *                gst_rtsp_server_client_filter    (GstRTSPServer *server,
                                                          GstRTSPServerClientFilterFunc func,
                                                          gpointer user_data);
 
+GArray *               gst_rtsp_server_get_transport_stats (GstRTSPServer *server);
+
+gchar *                gst_rtsp_server_get_metrics      (GstRTSPServer *server);
+
 G_END_DECLS
 
 #endif /* __GST_RTSP_SERVER_H__ */
@@ -38,6 +38,7 @@
 #include <string.h>
 
 #include "rtsp-session.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_SESSION_MEDIA_GET_PRIVATE(obj)  \
     (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_SESSION_MEDIA, GstRTSPSessionMediaPrivate))
@@ -281,7 +282,8 @@ gst_rtsp_session_media_get_rtpinfo (GstRTSPSessionMedia * media)
     }
 
     stream = gst_rtsp_stream_transport_get_stream (transport);
-    if (!gst_rtsp_stream_get_rtpinfo (stream, NULL, NULL, NULL, &running_time))
+    if (!gst_rtsp_stream_get_transport_rtpinfo (stream, transport, NULL, NULL,
+            NULL, &running_time))
       continue;
 
     GST_LOG_OBJECT (media, "running time of %d stream: %" GST_TIME_FORMAT, i,
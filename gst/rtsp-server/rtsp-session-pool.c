@@ -33,6 +33,15 @@
  *
  * All sessions can be iterated with gst_rtsp_session_pool_filter().
  *
+ * The sessions are spread over a number of shards, based on the hash of their
+ * id, that each have their own lock so that lookups and creation of sessions
+ * from many clients don't contend on one lock. The number of shards can be
+ * configured with the #GstRTSPSessionPool:n-shards property.
+ *
+ * Session expiry is tracked with a timer wheel, the cost of computing the next
+ * timeout and of collecting the expired sessions does not depend on the total
+ * number of sessions in the pool.
+ *
  * Run gst_rtsp_session_pool_cleanup() periodically to remove timed out sessions
  * or use gst_rtsp_session_pool_create_watch() to be notified when session
  * cleanup should be performed.
@@ -41,24 +50,56 @@
  */
 
 #include "rtsp-session-pool.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_SESSION_POOL_GET_PRIVATE(obj)  \
          (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_SESSION_POOL, GstRTSPSessionPoolPrivate))
 
-struct _GstRTSPSessionPoolPrivate
+typedef struct
 {
   GMutex lock;                  /* protects everything in this struct */
-  guint max_sessions;
   GHashTable *sessions;
   guint sessions_cookie;
+} GstRTSPSessionShard;
+
+/* the timer wheel has one slot per second. Sessions that expire further away
+ * than the wheel span are put in the last slot and rescheduled when that slot
+ * is reached */
+#define WHEEL_SLOTS       256
+#define WHEEL_RESOLUTION  G_USEC_PER_SEC
+
+typedef struct
+{
+  GstRTSPSession *session;      /* no ref, the session is owned by the shard */
+  GQueue *queue;                /* the wheel slot or the expired queue */
+  GList link;
+} GstRTSPSessionTimer;
+
+struct _GstRTSPSessionPoolPrivate
+{
+  gint max_sessions;            /* atomic */
+  gint n_sessions;              /* atomic */
+  gint n_created;               /* atomic */
+  gint n_expired;               /* atomic */
+
+  GstRTSPSessionShard *shards;
+  guint n_shards;
+
+  GMutex wheel_lock;            /* protects the timers */
+  GHashTable *timers;           /* GstRTSPSession -> GstRTSPSessionTimer */
+  GQueue wheel[WHEEL_SLOTS];
+  GQueue expired;
+  gint64 wheel_tick;            /* last processed tick */
 };
 
 #define DEFAULT_MAX_SESSIONS 0
+#define DEFAULT_N_SHARDS     16
 
 enum
 {
   PROP_0,
   PROP_MAX_SESSIONS,
+  PROP_N_SHARDS,
   PROP_LAST
 };
 
@@ -85,6 +126,7 @@ static void gst_rtsp_session_pool_get_property (GObject * object, guint propid,
     GValue * value, GParamSpec * pspec);
 static void gst_rtsp_session_pool_set_property (GObject * object, guint propid,
     const GValue * value, GParamSpec * pspec);
+static void gst_rtsp_session_pool_constructed (GObject * object);
 static void gst_rtsp_session_pool_finalize (GObject * object);
 
 static gchar *create_session_id (GstRTSPSessionPool * pool);
@@ -104,6 +146,7 @@ gst_rtsp_session_pool_class_init (GstRTSPSessionPoolClass * klass)
 
   gobject_class->get_property = gst_rtsp_session_pool_get_property;
   gobject_class->set_property = gst_rtsp_session_pool_set_property;
+  gobject_class->constructed = gst_rtsp_session_pool_constructed;
   gobject_class->finalize = gst_rtsp_session_pool_finalize;
 
   g_object_class_install_property (gobject_class, PROP_MAX_SESSIONS,
@@ -112,6 +155,22 @@ gst_rtsp_session_pool_class_init (GstRTSPSessionPoolClass * klass)
           0, G_MAXUINT, DEFAULT_MAX_SESSIONS,
           G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTSPSessionPool:n-shards:
+   *
+   * The number of shards the sessions are spread over. Each shard has its own
+   * lock, more shards reduce lock contention when many clients create and
+   * look up sessions at the same time.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_N_SHARDS,
+      g_param_spec_uint ("n-shards", "N Shards",
+          "the number of independently locked shards for the sessions",
+          1, 1024, DEFAULT_N_SHARDS,
+          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY |
+          G_PARAM_STATIC_STRINGS));
+
   gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED] =
       g_signal_new ("session-removed", G_TYPE_FROM_CLASS (klass),
       G_SIGNAL_RUN_LAST, G_STRUCT_OFFSET (GstRTSPSessionPoolClass,
@@ -129,13 +188,177 @@ static void
 gst_rtsp_session_pool_init (GstRTSPSessionPool * pool)
 {
   GstRTSPSessionPoolPrivate *priv = GST_RTSP_SESSION_POOL_GET_PRIVATE (pool);
+  guint i;
 
   pool->priv = priv;
 
-  g_mutex_init (&priv->lock);
-  priv->sessions = g_hash_table_new_full (g_str_hash, g_str_equal,
-      NULL, g_object_unref);
   priv->max_sessions = DEFAULT_MAX_SESSIONS;
+  priv->n_shards = DEFAULT_N_SHARDS;
+
+  g_mutex_init (&priv->wheel_lock);
+  priv->timers = g_hash_table_new (NULL, NULL);
+  for (i = 0; i < WHEEL_SLOTS; i++)
+    g_queue_init (&priv->wheel[i]);
+  g_queue_init (&priv->expired);
+  priv->wheel_tick = g_get_monotonic_time () / WHEEL_RESOLUTION;
+}
+
+static void
+gst_rtsp_session_pool_constructed (GObject * object)
+{
+  GstRTSPSessionPool *pool = GST_RTSP_SESSION_POOL (object);
+  GstRTSPSessionPoolPrivate *priv = pool->priv;
+  guint i;
+
+  G_OBJECT_CLASS (gst_rtsp_session_pool_parent_class)->constructed (object);
+
+  priv->shards = g_new0 (GstRTSPSessionShard, priv->n_shards);
+  for (i = 0; i < priv->n_shards; i++) {
+    GstRTSPSessionShard *shard = &priv->shards[i];
+
+    g_mutex_init (&shard->lock);
+    shard->sessions = g_hash_table_new_full (g_str_hash, g_str_equal,
+        NULL, g_object_unref);
+  }
+}
+
+static GstRTSPSessionShard *
+get_shard (GstRTSPSessionPoolPrivate * priv, const gchar * sessionid)
+{
+  return &priv->shards[g_str_hash (sessionid) % priv->n_shards];
+}
+
+/* put @timer in the slot of the next timeout of its session or in the
+ * expired queue. Must be called with the wheel_lock */
+static void
+schedule_timer (GstRTSPSessionPoolPrivate * priv, GstRTSPSessionTimer * timer,
+    gint64 now)
+{
+  gint timeout;
+  gint64 tick;
+
+  if (timer->queue)
+    g_queue_unlink (timer->queue, &timer->link);
+
+  timeout = gst_rtsp_session_next_timeout_usec (timer->session, now);
+  if (timeout == 0) {
+    timer->queue = &priv->expired;
+  } else {
+    /* round up so that the slot is never processed before the timeout */
+    tick = (now + timeout * G_GINT64_CONSTANT (1000) + WHEEL_RESOLUTION - 1) /
+        WHEEL_RESOLUTION;
+    tick = CLAMP (tick, priv->wheel_tick + 1, priv->wheel_tick + WHEEL_SLOTS);
+    timer->queue = &priv->wheel[tick % WHEEL_SLOTS];
+  }
+  g_queue_push_tail_link (timer->queue, &timer->link);
+}
+
+/* the timeout of the session changed, it might expire sooner than the slot
+ * it is in now */
+static void
+session_timeout_changed (GstRTSPSession * sess, GParamSpec * pspec,
+    GstRTSPSessionPool * pool)
+{
+  GstRTSPSessionPoolPrivate *priv = pool->priv;
+  GstRTSPSessionTimer *timer;
+
+  g_mutex_lock (&priv->wheel_lock);
+  timer = g_hash_table_lookup (priv->timers, sess);
+  if (timer)
+    schedule_timer (priv, timer, g_get_monotonic_time ());
+  g_mutex_unlock (&priv->wheel_lock);
+}
+
+/* must be called with the shard lock of @sess */
+static void
+add_timer (GstRTSPSessionPool * pool, GstRTSPSession * sess)
+{
+  GstRTSPSessionPoolPrivate *priv = pool->priv;
+  GstRTSPSessionTimer *timer;
+
+  timer = g_slice_new0 (GstRTSPSessionTimer);
+  timer->session = sess;
+  timer->link.data = timer;
+
+  g_mutex_lock (&priv->wheel_lock);
+  g_hash_table_insert (priv->timers, sess, timer);
+  schedule_timer (priv, timer, g_get_monotonic_time ());
+  g_signal_connect (sess, "notify::timeout",
+      G_CALLBACK (session_timeout_changed), pool);
+  g_mutex_unlock (&priv->wheel_lock);
+}
+
+/* must be called with the shard lock of @sess */
+static void
+remove_timer (GstRTSPSessionPool * pool, GstRTSPSession * sess)
+{
+  GstRTSPSessionPoolPrivate *priv = pool->priv;
+  GstRTSPSessionTimer *timer;
+
+  g_mutex_lock (&priv->wheel_lock);
+  timer = g_hash_table_lookup (priv->timers, sess);
+  if (timer) {
+    g_queue_unlink (timer->queue, &timer->link);
+    g_hash_table_remove (priv->timers, sess);
+    g_slice_free (GstRTSPSessionTimer, timer);
+    g_signal_handlers_disconnect_by_func (sess, session_timeout_changed, pool);
+  }
+  g_mutex_unlock (&priv->wheel_lock);
+}
+
+/* process all the slots up to @now. The sessions in those slots are either
+ * expired or were touched and are rescheduled. Must be called with the
+ * wheel_lock */
+static void
+advance_wheel (GstRTSPSessionPoolPrivate * priv, gint64 now)
+{
+  gint64 now_tick = now / WHEEL_RESOLUTION;
+
+  while (priv->wheel_tick < now_tick) {
+    GQueue *slot, due;
+    GList *link;
+
+    /* after a full turn all slots were visited, skip ahead */
+    if (now_tick - priv->wheel_tick > WHEEL_SLOTS)
+      priv->wheel_tick = now_tick - WHEEL_SLOTS;
+    priv->wheel_tick++;
+
+    slot = &priv->wheel[priv->wheel_tick % WHEEL_SLOTS];
+    if (g_queue_is_empty (slot))
+      continue;
+
+    /* take the due timers, rescheduling can put them in this slot again */
+    due = *slot;
+    g_queue_init (slot);
+
+    while ((link = due.head)) {
+      GstRTSPSessionTimer *timer = link->data;
+
+      g_queue_unlink (&due, link);
+      timer->queue = NULL;
+      schedule_timer (priv, timer, now);
+    }
+  }
+}
+
+/* get the time in milliseconds until the next timer in the wheel, 0 when there
+ * are expired sessions and -1 when there are no sessions. Must be called with
+ * the wheel_lock */
+static gint
+next_wheel_timeout (GstRTSPSessionPoolPrivate * priv, gint64 now)
+{
+  guint i;
+
+  if (!g_queue_is_empty (&priv->expired))
+    return 0;
+
+  for (i = 1; i <= WHEEL_SLOTS; i++) {
+    gint64 tick = priv->wheel_tick + i;
+
+    if (!g_queue_is_empty (&priv->wheel[tick % WHEEL_SLOTS]))
+      return (gint) MAX (0, (tick * WHEEL_RESOLUTION - now + 999) / 1000);
+  }
+  return -1;
 }
 
 static GstRTSPFilterResult
@@ -150,10 +373,16 @@ gst_rtsp_session_pool_finalize (GObject * object)
 {
   GstRTSPSessionPool *pool = GST_RTSP_SESSION_POOL (object);
   GstRTSPSessionPoolPrivate *priv = pool->priv;
+  guint i;
 
   gst_rtsp_session_pool_filter (pool, remove_sessions_func, NULL);
-  g_hash_table_unref (priv->sessions);
-  g_mutex_clear (&priv->lock);
+  for (i = 0; i < priv->n_shards; i++) {
+    g_hash_table_unref (priv->shards[i].sessions);
+    g_mutex_clear (&priv->shards[i].lock);
+  }
+  g_free (priv->shards);
+  g_hash_table_unref (priv->timers);
+  g_mutex_clear (&priv->wheel_lock);
 
   G_OBJECT_CLASS (gst_rtsp_session_pool_parent_class)->finalize (object);
 }
@@ -168,6 +397,9 @@ gst_rtsp_session_pool_get_property (GObject * object, guint propid,
     case PROP_MAX_SESSIONS:
       g_value_set_uint (value, gst_rtsp_session_pool_get_max_sessions (pool));
       break;
+    case PROP_N_SHARDS:
+      g_value_set_uint (value, pool->priv->n_shards);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
       break;
@@ -184,6 +416,9 @@ gst_rtsp_session_pool_set_property (GObject * object, guint propid,
     case PROP_MAX_SESSIONS:
       gst_rtsp_session_pool_set_max_sessions (pool, g_value_get_uint (value));
       break;
+    case PROP_N_SHARDS:
+      pool->priv->n_shards = g_value_get_uint (value);
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
       break;
@@ -225,9 +460,7 @@ gst_rtsp_session_pool_set_max_sessions (GstRTSPSessionPool * pool, guint max)
 
   priv = pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  priv->max_sessions = max;
-  g_mutex_unlock (&priv->lock);
+  g_atomic_int_set (&priv->max_sessions, max);
 }
 
 /**
@@ -249,9 +482,7 @@ gst_rtsp_session_pool_get_max_sessions (GstRTSPSessionPool * pool)
 
   priv = pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  result = priv->max_sessions;
-  g_mutex_unlock (&priv->lock);
+  result = g_atomic_int_get (&priv->max_sessions);
 
   return result;
 }
@@ -274,9 +505,7 @@ gst_rtsp_session_pool_get_n_sessions (GstRTSPSessionPool * pool)
 
   priv = pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  result = g_hash_table_size (priv->sessions);
-  g_mutex_unlock (&priv->lock);
+  result = g_atomic_int_get (&priv->n_sessions);
 
   return result;
 }
@@ -295,21 +524,21 @@ gst_rtsp_session_pool_get_n_sessions (GstRTSPSessionPool * pool)
 GstRTSPSession *
 gst_rtsp_session_pool_find (GstRTSPSessionPool * pool, const gchar * sessionid)
 {
-  GstRTSPSessionPoolPrivate *priv;
+  GstRTSPSessionShard *shard;
   GstRTSPSession *result;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), NULL);
   g_return_val_if_fail (sessionid != NULL, NULL);
 
-  priv = pool->priv;
+  shard = get_shard (pool->priv, sessionid);
 
-  g_mutex_lock (&priv->lock);
-  result = g_hash_table_lookup (priv->sessions, sessionid);
+  g_mutex_lock (&shard->lock);
+  result = g_hash_table_lookup (shard->sessions, sessionid);
   if (result) {
     g_object_ref (result);
     gst_rtsp_session_touch (result);
   }
-  g_mutex_unlock (&priv->lock);
+  g_mutex_unlock (&shard->lock);
 
   return result;
 }
@@ -335,6 +564,25 @@ create_session (GstRTSPSessionPool * pool, const gchar * id)
   return gst_rtsp_session_new (id);
 }
 
+/* reserve a place for a new session, fails when the pool is full */
+static gboolean
+reserve_session (GstRTSPSessionPoolPrivate * priv)
+{
+  gint n_sessions;
+  guint max_sessions;
+
+  do {
+    n_sessions = g_atomic_int_get (&priv->n_sessions);
+    max_sessions = g_atomic_int_get (&priv->max_sessions);
+
+    if (max_sessions > 0 && (guint) n_sessions >= max_sessions)
+      return FALSE;
+  } while (!g_atomic_int_compare_and_exchange (&priv->n_sessions, n_sessions,
+          n_sessions + 1));
+
+  return TRUE;
+}
+
 /**
  * gst_rtsp_session_pool_create:
  * @pool: a #GstRTSPSessionPool
@@ -347,6 +595,7 @@ GstRTSPSession *
 gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
 {
   GstRTSPSessionPoolPrivate *priv;
+  GstRTSPSessionShard *shard;
   GstRTSPSession *result = NULL;
   GstRTSPSessionPoolClass *klass;
   gchar *id = NULL;
@@ -358,6 +607,10 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
 
   klass = GST_RTSP_SESSION_POOL_GET_CLASS (pool);
 
+  /* check session limit */
+  if (!reserve_session (priv))
+    goto too_many_sessions;
+
   retry = 0;
   do {
     /* start by creating a new random session id, we assume that this is random
@@ -370,14 +623,11 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
     if (id == NULL)
       goto no_session;
 
-    g_mutex_lock (&priv->lock);
-    /* check session limit */
-    if (priv->max_sessions > 0) {
-      if (g_hash_table_size (priv->sessions) >= priv->max_sessions)
-        goto too_many_sessions;
-    }
+    shard = get_shard (priv, id);
+
+    g_mutex_lock (&shard->lock);
     /* check if the sessionid existed */
-    result = g_hash_table_lookup (priv->sessions, id);
+    result = g_hash_table_lookup (shard->sessions, id);
     if (result) {
       /* found, retry with a different session id */
       result = NULL;
@@ -389,14 +639,16 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
       if (klass->create_session)
         result = create_session (pool, id);
       if (result == NULL)
-        goto too_many_sessions;
+        goto no_session_object;
       /* take additional ref for the pool */
       g_object_ref (result);
-      g_hash_table_insert (priv->sessions,
+      g_hash_table_insert (shard->sessions,
           (gchar *) gst_rtsp_session_get_sessionid (result), result);
-      priv->sessions_cookie++;
+      shard->sessions_cookie++;
+      add_timer (pool, result);
+      g_atomic_int_inc (&priv->n_created);
     }
-    g_mutex_unlock (&priv->lock);
+    g_mutex_unlock (&shard->lock);
 
     g_free (id);
   } while (result == NULL);
@@ -404,27 +656,37 @@ gst_rtsp_session_pool_create (GstRTSPSessionPool * pool)
   return result;
 
   /* ERRORS */
+too_many_sessions:
+  {
+    GST_WARNING ("session pool reached max sessions of %d",
+        g_atomic_int_get (&priv->max_sessions));
+    return NULL;
+  }
 no_function:
   {
     GST_WARNING ("no create_session_id vmethod in GstRTSPSessionPool %p", pool);
+    g_atomic_int_add (&priv->n_sessions, -1);
     return NULL;
   }
 no_session:
   {
     GST_WARNING ("can't create session id with GstRTSPSessionPool %p", pool);
+    g_atomic_int_add (&priv->n_sessions, -1);
     return NULL;
   }
 collision:
   {
     GST_WARNING ("can't find unique sessionid for GstRTSPSessionPool %p", pool);
-    g_mutex_unlock (&priv->lock);
+    g_mutex_unlock (&shard->lock);
+    g_atomic_int_add (&priv->n_sessions, -1);
     g_free (id);
     return NULL;
   }
-too_many_sessions:
+no_session_object:
   {
-    GST_WARNING ("session pool reached max sessions of %d", priv->max_sessions);
-    g_mutex_unlock (&priv->lock);
+    GST_WARNING ("can't create session with GstRTSPSessionPool %p", pool);
+    g_mutex_unlock (&shard->lock);
+    g_atomic_int_add (&priv->n_sessions, -1);
     g_free (id);
     return NULL;
   }
@@ -443,21 +705,26 @@ gboolean
 gst_rtsp_session_pool_remove (GstRTSPSessionPool * pool, GstRTSPSession * sess)
 {
   GstRTSPSessionPoolPrivate *priv;
+  GstRTSPSessionShard *shard;
+  const gchar *sessionid;
   gboolean found;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), FALSE);
   g_return_val_if_fail (GST_IS_RTSP_SESSION (sess), FALSE);
 
   priv = pool->priv;
+  sessionid = gst_rtsp_session_get_sessionid (sess);
+  shard = get_shard (priv, sessionid);
 
-  g_mutex_lock (&priv->lock);
+  g_mutex_lock (&shard->lock);
   g_object_ref (sess);
-  found =
-      g_hash_table_remove (priv->sessions,
-      gst_rtsp_session_get_sessionid (sess));
-  if (found)
-    priv->sessions_cookie++;
-  g_mutex_unlock (&priv->lock);
+  found = g_hash_table_remove (shard->sessions, sessionid);
+  if (found) {
+    remove_timer (pool, sess);
+    shard->sessions_cookie++;
+    g_atomic_int_add (&priv->n_sessions, -1);
+  }
+  g_mutex_unlock (&shard->lock);
 
   if (found)
     g_signal_emit (pool, gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED],
@@ -468,28 +735,6 @@ gst_rtsp_session_pool_remove (GstRTSPSessionPool * pool, GstRTSPSession * sess)
   return found;
 }
 
-typedef struct
-{
-  gint64 now_monotonic_time;
-  GstRTSPSessionPool *pool;
-  GList *removed;
-} CleanupData;
-
-static gboolean
-cleanup_func (gchar * sessionid, GstRTSPSession * sess, CleanupData * data)
-{
-  gboolean expired;
-
-  expired = gst_rtsp_session_is_expired_usec (sess, data->now_monotonic_time);
-
-  if (expired) {
-    GST_DEBUG ("session expired");
-    data->removed = g_list_prepend (data->removed, g_object_ref (sess));
-  }
-
-  return expired;
-}
-
 /**
  * gst_rtsp_session_pool_cleanup:
  * @pool: a #GstRTSPSessionPool
@@ -504,88 +749,82 @@ gst_rtsp_session_pool_cleanup (GstRTSPSessionPool * pool)
 {
   GstRTSPSessionPoolPrivate *priv;
   guint result;
-  CleanupData data;
-  GList *walk;
+  gint64 now;
+  GList *expired, *walk;
 
   g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), 0);
 
   priv = pool->priv;
 
-  data.now_monotonic_time = g_get_monotonic_time ();
+  now = g_get_monotonic_time ();
 
-  data.pool = pool;
-  data.removed = NULL;
+  /* collect the sessions that timed out since the last time */
+  expired = NULL;
+  g_mutex_lock (&priv->wheel_lock);
+  advance_wheel (priv, now);
+  for (walk = priv->expired.head; walk; walk = walk->next) {
+    GstRTSPSessionTimer *timer = walk->data;
 
-  g_mutex_lock (&priv->lock);
-  result =
-      g_hash_table_foreach_remove (priv->sessions, (GHRFunc) cleanup_func,
-      &data);
-  if (result > 0)
-    priv->sessions_cookie++;
-  g_mutex_unlock (&priv->lock);
+    expired = g_list_prepend (expired, g_object_ref (timer->session));
+  }
+  g_mutex_unlock (&priv->wheel_lock);
 
-  for (walk = data.removed; walk; walk = walk->next) {
+  result = 0;
+  for (walk = expired; walk; walk = walk->next) {
     GstRTSPSession *sess = walk->data;
+    GstRTSPSessionShard *shard;
+    const gchar *sessionid;
+    gboolean removed = FALSE;
+
+    sessionid = gst_rtsp_session_get_sessionid (sess);
+    shard = get_shard (priv, sessionid);
+
+    g_mutex_lock (&shard->lock);
+    /* the session can be removed or touched in the meantime */
+    if (g_hash_table_lookup (shard->sessions, sessionid) == sess) {
+      if (gst_rtsp_session_is_expired_usec (sess, now)) {
+        GST_DEBUG ("session expired");
+        remove_timer (pool, sess);
+        g_hash_table_remove (shard->sessions, sessionid);
+        shard->sessions_cookie++;
+        g_atomic_int_add (&priv->n_sessions, -1);
+        g_atomic_int_inc (&priv->n_expired);
+        removed = TRUE;
+      } else {
+        g_mutex_lock (&priv->wheel_lock);
+        schedule_timer (priv, g_hash_table_lookup (priv->timers, sess), now);
+        g_mutex_unlock (&priv->wheel_lock);
+      }
+    }
+    g_mutex_unlock (&shard->lock);
 
-    g_signal_emit (pool,
-        gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED], 0, sess);
-
+    if (removed) {
+      g_signal_emit (pool,
+          gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED], 0, sess);
+      result++;
+    }
     g_object_unref (sess);
   }
-  g_list_free (data.removed);
+  g_list_free (expired);
 
   return result;
 }
 
-/**
- * gst_rtsp_session_pool_filter:
- * @pool: a #GstRTSPSessionPool
- * @func: (scope call) (allow-none): a callback
- * @user_data: (closure): user data passed to @func
- *
- * Call @func for each session in @pool. The result value of @func determines
- * what happens to the session. @func will be called with the session pool
- * locked so no further actions on @pool can be performed from @func.
- *
- * If @func returns #GST_RTSP_FILTER_REMOVE, the session will be set to the
- * expired state with gst_rtsp_session_set_expired() and removed from
- * @pool.
- *
- * If @func returns #GST_RTSP_FILTER_KEEP, the session will remain in @pool.
- *
- * If @func returns #GST_RTSP_FILTER_REF, the session will remain in @pool but
- * will also be added with an additional ref to the result GList of this
- * function..
- *
- * When @func is %NULL, #GST_RTSP_FILTER_REF will be assumed for all sessions.
- *
- * Returns: (element-type GstRTSPSession) (transfer full): a GList with all
- * sessions for which @func returned #GST_RTSP_FILTER_REF. After usage, each
- * element in the GList should be unreffed before the list is freed.
- */
-GList *
-gst_rtsp_session_pool_filter (GstRTSPSessionPool * pool,
-    GstRTSPSessionPoolFilterFunc func, gpointer user_data)
+/* call @func for all sessions in @shard. Must be called with the shard lock,
+ * which is released while calling @func */
+static GList *
+filter_shard (GstRTSPSessionPool * pool, GstRTSPSessionShard * shard,
+    GstRTSPSessionPoolFilterFunc func, gpointer user_data,
+    GHashTable * visited, GList * result)
 {
-  GstRTSPSessionPoolPrivate *priv;
+  GstRTSPSessionPoolPrivate *priv = pool->priv;
   GHashTableIter iter;
   gpointer key, value;
-  GList *result;
-  GHashTable *visited;
   guint cookie;
 
-  g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), NULL);
-
-  priv = pool->priv;
-
-  result = NULL;
-  if (func)
-    visited = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
-
-  g_mutex_lock (&priv->lock);
 restart:
-  g_hash_table_iter_init (&iter, priv->sessions);
-  cookie = priv->sessions_cookie;
+  g_hash_table_iter_init (&iter, shard->sessions);
+  cookie = shard->sessions_cookie;
   while (g_hash_table_iter_next (&iter, &key, &value)) {
     GstRTSPSession *session = value;
     GstRTSPFilterResult res;
@@ -597,15 +836,15 @@ restart:
         continue;
 
       g_hash_table_add (visited, g_object_ref (session));
-      g_mutex_unlock (&priv->lock);
+      g_mutex_unlock (&shard->lock);
 
       res = func (pool, session, user_data);
 
-      g_mutex_lock (&priv->lock);
+      g_mutex_lock (&shard->lock);
     } else
       res = GST_RTSP_FILTER_REF;
 
-    changed = (cookie != priv->sessions_cookie);
+    changed = (cookie != shard->sessions_cookie);
 
     switch (res) {
       case GST_RTSP_FILTER_REMOVE:
@@ -614,23 +853,25 @@ restart:
 
         if (changed)
           /* something changed, check if we still have the session */
-          removed = g_hash_table_remove (priv->sessions, key);
+          removed = g_hash_table_remove (shard->sessions, key);
         else
           g_hash_table_iter_remove (&iter);
 
         if (removed) {
+          remove_timer (pool, session);
           /* if we managed to remove the session, update the cookie and
            * signal */
-          cookie = ++priv->sessions_cookie;
-          g_mutex_unlock (&priv->lock);
+          cookie = ++shard->sessions_cookie;
+          g_atomic_int_add (&priv->n_sessions, -1);
+          g_mutex_unlock (&shard->lock);
 
           g_signal_emit (pool,
               gst_rtsp_session_pool_signals[SIGNAL_SESSION_REMOVED], 0,
               session);
 
-          g_mutex_lock (&priv->lock);
+          g_mutex_lock (&shard->lock);
           /* cookie could have changed again, make sure we restart */
-          changed |= (cookie != priv->sessions_cookie);
+          changed |= (cookie != shard->sessions_cookie);
         }
         break;
       }
@@ -645,7 +886,62 @@ restart:
     if (changed)
       goto restart;
   }
-  g_mutex_unlock (&priv->lock);
+  return result;
+}
+
+/**
+ * gst_rtsp_session_pool_filter:
+ * @pool: a #GstRTSPSessionPool
+ * @func: (scope call) (allow-none): a callback
+ * @user_data: (closure): user data passed to @func
+ *
+ * Call @func for each session in @pool. The result value of @func determines
+ * what happens to the session. @func will be called with the session pool
+ * locked so no further actions on @pool can be performed from @func.
+ *
+ * If @func returns #GST_RTSP_FILTER_REMOVE, the session will be set to the
+ * expired state with gst_rtsp_session_set_expired() and removed from
+ * @pool.
+ *
+ * If @func returns #GST_RTSP_FILTER_KEEP, the session will remain in @pool.
+ *
+ * If @func returns #GST_RTSP_FILTER_REF, the session will remain in @pool but
+ * will also be added with an additional ref to the result GList of this
+ * function..
+ *
+ * When @func is %NULL, #GST_RTSP_FILTER_REF will be assumed for all sessions.
+ *
+ * The sessions are visited shard by shard, only one shard of @pool is locked
+ * at a time.
+ *
+ * Returns: (element-type GstRTSPSession) (transfer full): a GList with all
+ * sessions for which @func returned #GST_RTSP_FILTER_REF. After usage, each
+ * element in the GList should be unreffed before the list is freed.
+ */
+GList *
+gst_rtsp_session_pool_filter (GstRTSPSessionPool * pool,
+    GstRTSPSessionPoolFilterFunc func, gpointer user_data)
+{
+  GstRTSPSessionPoolPrivate *priv;
+  GList *result;
+  GHashTable *visited = NULL;
+  guint i;
+
+  g_return_val_if_fail (GST_IS_RTSP_SESSION_POOL (pool), NULL);
+
+  priv = pool->priv;
+
+  result = NULL;
+  if (func)
+    visited = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+
+  for (i = 0; i < priv->n_shards; i++) {
+    GstRTSPSessionShard *shard = &priv->shards[i];
+
+    g_mutex_lock (&shard->lock);
+    result = filter_shard (pool, shard, func, user_data, visited, result);
+    g_mutex_unlock (&shard->lock);
+  }
 
   if (func)
     g_hash_table_unref (visited);
@@ -660,35 +956,23 @@ typedef struct
   gint timeout;
 } GstPoolSource;
 
-static void
-collect_timeout (gchar * sessionid, GstRTSPSession * sess, GstPoolSource * psrc)
-{
-  gint timeout;
-  gint64 now_monotonic_time;
-
-  now_monotonic_time = g_get_monotonic_time ();
-
-  timeout = gst_rtsp_session_next_timeout_usec (sess, now_monotonic_time);
-
-  GST_INFO ("%p: next timeout: %d", sess, timeout);
-  if (psrc->timeout == -1 || timeout < psrc->timeout)
-    psrc->timeout = timeout;
-}
-
 static gboolean
 gst_pool_source_prepare (GSource * source, gint * timeout)
 {
   GstRTSPSessionPoolPrivate *priv;
   GstPoolSource *psrc;
   gboolean result;
+  gint64 now;
 
   psrc = (GstPoolSource *) source;
-  psrc->timeout = -1;
   priv = psrc->pool->priv;
 
-  g_mutex_lock (&priv->lock);
-  g_hash_table_foreach (priv->sessions, (GHFunc) collect_timeout, psrc);
-  g_mutex_unlock (&priv->lock);
+  now = g_get_monotonic_time ();
+
+  g_mutex_lock (&priv->wheel_lock);
+  advance_wheel (priv, now);
+  psrc->timeout = next_wheel_timeout (priv, now);
+  g_mutex_unlock (&priv->wheel_lock);
 
   if (timeout)
     *timeout = psrc->timeout;
@@ -766,3 +1050,15 @@ gst_rtsp_session_pool_create_watch (GstRTSPSessionPool * pool)
 
   return (GSource *) source;
 }
+
+/* get the number of sessions created in @pool and the number of sessions
+ * that were removed because they timed out */
+void
+gst_rtsp_session_pool_get_counters (GstRTSPSessionPool * pool,
+    guint * created, guint * expired)
+{
+  GstRTSPSessionPoolPrivate *priv = pool->priv;
+
+  *created = g_atomic_int_get (&priv->n_created);
+  *expired = g_atomic_int_get (&priv->n_expired);
+}
@@ -44,6 +44,7 @@
  */
 
 #include <string.h>
+#include <time.h>
 
 #include "rtsp-session.h"
 
@@ -57,9 +58,11 @@ struct _GstRTSPSessionPrivate
 
   guint timeout;
   gboolean timeout_always_visible;
-  GMutex last_access_lock;
-  gint64 last_access_monotonic_time;
-  gint64 last_access_real_time;
+  /* monotonic and real time when the session was created, the real time of
+   * the last access is calculated from the monotonic time when needed */
+  gint64 create_monotonic_time;
+  gint64 real_time_offset;
+  gint last_access;             /* atomic, msecs since create_monotonic_time */
   gint expire_count;
 
   GList *medias;
@@ -91,6 +94,55 @@ static void gst_rtsp_session_finalize (GObject * obj);
 
 G_DEFINE_TYPE (GstRTSPSession, gst_rtsp_session, G_TYPE_OBJECT);
 
+/* a cheap monotonic clock with a resolution of a few milliseconds, which is
+ * plenty for tracking the last access of a session */
+static gint64
+get_coarse_monotonic_time (void)
+{
+#ifdef CLOCK_MONOTONIC_COARSE
+  struct timespec ts;
+
+  if (clock_gettime (CLOCK_MONOTONIC_COARSE, &ts) == 0)
+    return ((gint64) ts.tv_sec) * G_USEC_PER_SEC + ts.tv_nsec / 1000;
+#endif
+  return g_get_monotonic_time ();
+}
+
+static void
+touch_at (GstRTSPSessionPrivate * priv, gint64 now)
+{
+  gint last_access;
+
+  last_access = (guint) ((now - priv->create_monotonic_time) / 1000);
+
+  /* avoid dirtying the cacheline when touched many times per msec */
+  if (g_atomic_int_get (&priv->last_access) != last_access)
+    g_atomic_int_set (&priv->last_access, last_access);
+}
+
+/* get the monotonic time of the last access. The access time is stored in a
+ * 32 bits msec counter that can wrap around, it is resolved relative to @now,
+ * which works as long as the session is checked at least every 24 days */
+static gint64
+get_last_access (GstRTSPSessionPrivate * priv, gint64 now)
+{
+  guint now_msecs;
+  gint elapsed;
+
+  if (g_atomic_int_get (&priv->expire_count) != 0) {
+    /* touch session when the expire count is not 0 */
+    touch_at (priv, get_coarse_monotonic_time ());
+  }
+
+  now_msecs = (guint) ((now - priv->create_monotonic_time) / 1000);
+  elapsed = (gint) (now_msecs - (guint) g_atomic_int_get (&priv->last_access));
+  /* touched after @now was taken */
+  if (elapsed < 0)
+    elapsed = 0;
+
+  return now - ((gint64) elapsed) * 1000;
+}
+
 static void
 gst_rtsp_session_class_init (GstRTSPSessionClass * klass)
 {
@@ -133,8 +185,9 @@ gst_rtsp_session_init (GstRTSPSession * session)
   GST_INFO ("init session %p", session);
 
   g_mutex_init (&priv->lock);
-  g_mutex_init (&priv->last_access_lock);
   priv->timeout = DEFAULT_TIMEOUT;
+  priv->create_monotonic_time = get_coarse_monotonic_time ();
+  priv->real_time_offset = g_get_real_time () - g_get_monotonic_time ();
 
   gst_rtsp_session_touch (session);
 }
@@ -155,7 +208,6 @@ gst_rtsp_session_finalize (GObject * obj)
 
   /* free session id */
   g_free (priv->sessionid);
-  g_mutex_clear (&priv->last_access_lock);
   g_mutex_clear (&priv->lock);
 
   G_OBJECT_CLASS (gst_rtsp_session_parent_class)->finalize (obj);
@@ -516,6 +568,8 @@ gst_rtsp_session_set_timeout (GstRTSPSession * session, guint timeout)
   g_mutex_lock (&priv->lock);
   priv->timeout = timeout;
   g_mutex_unlock (&priv->lock);
+
+  g_object_notify (G_OBJECT (session), "timeout");
 }
 
 /**
@@ -558,10 +612,7 @@ gst_rtsp_session_touch (GstRTSPSession * session)
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->last_access_lock);
-  priv->last_access_monotonic_time = g_get_monotonic_time ();
-  priv->last_access_real_time = g_get_real_time ();
-  g_mutex_unlock (&priv->last_access_lock);
+  touch_at (priv, get_coarse_monotonic_time ());
 }
 
 /**
@@ -611,18 +662,10 @@ gst_rtsp_session_next_timeout_usec (GstRTSPSession * session, gint64 now)
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->last_access_lock);
-  if (g_atomic_int_get (&priv->expire_count) != 0) {
-    /* touch session when the expire count is not 0 */
-    priv->last_access_monotonic_time = g_get_monotonic_time ();
-    priv->last_access_real_time = g_get_real_time ();
-  }
-
-  last_access = GST_USECOND * (priv->last_access_monotonic_time);
+  last_access = GST_USECOND * get_last_access (priv, now);
 
   /* add timeout allow for 5 seconds of extra time */
   last_access += priv->timeout * GST_SECOND + (5 * GST_SECOND);
-  g_mutex_unlock (&priv->last_access_lock);
 
   now_ns = GST_USECOND * now;
 
@@ -662,18 +705,11 @@ gst_rtsp_session_next_timeout (GstRTSPSession * session, GTimeVal * now)
 
   priv = session->priv;
 
-  g_mutex_lock (&priv->last_access_lock);
-  if (g_atomic_int_get (&priv->expire_count) != 0) {
-    /* touch session when the expire count is not 0 */
-    priv->last_access_monotonic_time = g_get_monotonic_time ();
-    priv->last_access_real_time = g_get_real_time ();
-  }
-
-  last_access = GST_USECOND * (priv->last_access_real_time);
+  last_access = GST_USECOND * (get_last_access (priv, g_get_monotonic_time ())
+      + priv->real_time_offset);
 
   /* add timeout allow for 5 seconds of extra time */
   last_access += priv->timeout * GST_SECOND + (5 * GST_SECOND);
-  g_mutex_unlock (&priv->last_access_lock);
 
   now_ns = GST_TIMEVAL_TO_TIME (*now);
 
@@ -42,6 +42,7 @@
 #include <stdlib.h>
 
 #include "rtsp-stream-transport.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_STREAM_TRANSPORT_GET_PRIVATE(obj)  \
        (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_STREAM_TRANSPORT, GstRTSPStreamTransportPrivate))
@@ -55,6 +56,11 @@ struct _GstRTSPStreamTransportPrivate
   gpointer user_data;
   GDestroyNotify notify;
 
+  GstRTSPSendListFunc send_rtp_list;
+  GstRTSPSendListFunc send_rtcp_list;
+  gpointer list_user_data;
+  GDestroyNotify list_notify;
+
   GstRTSPKeepAliveFunc keep_alive;
   gpointer ka_user_data;
   GDestroyNotify ka_notify;
@@ -65,6 +71,33 @@ struct _GstRTSPStreamTransportPrivate
   GstRTSPUrl *url;
 
   GObject *rtpsource;
+
+  GMutex stats_lock;
+  /* counters of the data sent with the callbacks from the streaming threads */
+  guint64 counters[GST_RTSP_TRANSPORT_STAT_LAST];
+  /* stream UDP counters when the transport was added to the stream and the
+   * UDP data sent while the transport was added before */
+  gboolean udp_active;
+  guint64 udp_base[GST_RTSP_TRANSPORT_STAT_LAST];
+  guint64 udp_sent[GST_RTSP_TRANSPORT_STAT_LAST];
+  /* last receiver report of the client */
+  gboolean have_rb;
+  guint rb_fraction_lost;
+  gint rb_packets_lost;
+  guint rb_jitter;
+  guint rb_round_trip;
+
+  /* our own SRTP encoder for the packets sent to this transport, with pads to
+   * push the packets through it. Protected by crypto_lock */
+  GMutex crypto_lock;
+  GstCaps *crypto;
+  GstElement *srtpenc;
+  GstPad *crypto_src[2];
+  GstPad *crypto_sink[2];
+  GstBufferList *crypto_out;
+  GSocketAddress *udp_addr[2];
+  /* counters of the server for the packets encrypted for this transport only */
+  GstRTSPCopyMetrics *copy_metrics;
 };
 
 enum
@@ -77,6 +110,8 @@ GST_DEBUG_CATEGORY_STATIC (rtsp_stream_transport_debug);
 #define GST_CAT_DEFAULT rtsp_stream_transport_debug
 
 static void gst_rtsp_stream_transport_finalize (GObject * obj);
+static void clear_crypto (GstRTSPStreamTransportPrivate * priv);
+static void clear_udp_address (GstRTSPStreamTransportPrivate * priv);
 
 G_DEFINE_TYPE (GstRTSPStreamTransport, gst_rtsp_stream_transport,
     G_TYPE_OBJECT);
@@ -103,6 +138,9 @@ gst_rtsp_stream_transport_init (GstRTSPStreamTransport * trans)
       GST_RTSP_STREAM_TRANSPORT_GET_PRIVATE (trans);
 
   trans->priv = priv;
+
+  g_mutex_init (&priv->stats_lock);
+  g_mutex_init (&priv->crypto_lock);
 }
 
 static void
@@ -116,6 +154,7 @@ gst_rtsp_stream_transport_finalize (GObject * obj)
 
   /* remove callbacks now */
   gst_rtsp_stream_transport_set_callbacks (trans, NULL, NULL, NULL, NULL);
+  gst_rtsp_stream_transport_set_list_callbacks (trans, NULL, NULL, NULL, NULL);
   gst_rtsp_stream_transport_set_keepalive (trans, NULL, NULL, NULL);
 
   if (priv->stream)
@@ -127,6 +166,16 @@ gst_rtsp_stream_transport_finalize (GObject * obj)
   if (priv->url)
     gst_rtsp_url_free (priv->url);
 
+  clear_crypto (priv);
+  clear_udp_address (priv);
+  if (priv->crypto)
+    gst_caps_unref (priv->crypto);
+  if (priv->copy_metrics)
+    gst_rtsp_copy_metrics_unref (priv->copy_metrics);
+
+  g_mutex_clear (&priv->crypto_lock);
+  g_mutex_clear (&priv->stats_lock);
+
   G_OBJECT_CLASS (gst_rtsp_stream_transport_parent_class)->finalize (obj);
 }
 
@@ -204,6 +253,41 @@ gst_rtsp_stream_transport_set_callbacks (GstRTSPStreamTransport * trans,
   priv->notify = notify;
 }
 
+/**
+ * gst_rtsp_stream_transport_set_list_callbacks:
+ * @trans: a #GstRTSPStreamTransport
+ * @send_rtp_list: (scope notified): a callback called when RTP should be sent
+ * @send_rtcp_list: (scope notified): a callback called when RTCP should be sent
+ * @user_data: (closure): user data passed to callbacks
+ * @notify: (allow-none): called with the user_data when no longer needed.
+ *
+ * Install callbacks that will be called when a list of packets for a stream
+ * should be sent to a client. This allows sending all packets of the list at
+ * once. When no list callbacks are installed, the callbacks installed with
+ * gst_rtsp_stream_transport_set_callbacks() are called for each buffer of the
+ * list.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_stream_transport_set_list_callbacks (GstRTSPStreamTransport * trans,
+    GstRTSPSendListFunc send_rtp_list, GstRTSPSendListFunc send_rtcp_list,
+    gpointer user_data, GDestroyNotify notify)
+{
+  GstRTSPStreamTransportPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans));
+
+  priv = trans->priv;
+
+  priv->send_rtp_list = send_rtp_list;
+  priv->send_rtcp_list = send_rtcp_list;
+  if (priv->list_notify)
+    priv->list_notify (priv->list_user_data);
+  priv->list_user_data = user_data;
+  priv->list_notify = notify;
+}
+
 /**
  * gst_rtsp_stream_transport_set_keepalive:
  * @trans: a #GstRTSPStreamTransport
@@ -255,6 +339,10 @@ gst_rtsp_stream_transport_set_transport (GstRTSPStreamTransport * trans,
   if (priv->transport)
     gst_rtsp_transport_free (priv->transport);
   priv->transport = tr;
+
+  g_mutex_lock (&priv->crypto_lock);
+  clear_udp_address (priv);
+  g_mutex_unlock (&priv->crypto_lock);
 }
 
 /**
@@ -339,8 +427,8 @@ gst_rtsp_stream_transport_get_rtpinfo (GstRTSPStreamTransport * trans,
 
   priv = trans->priv;
 
-  if (!gst_rtsp_stream_get_rtpinfo (priv->stream, &rtptime, &seq, &clock_rate,
-          &running_time))
+  if (!gst_rtsp_stream_get_transport_rtpinfo (priv->stream, trans, &rtptime,
+          &seq, &clock_rate, &running_time))
     return NULL;
 
   GST_DEBUG ("RTP time %u, seq %u, rate %u, running-time %" GST_TIME_FORMAT,
@@ -437,6 +525,589 @@ gst_rtsp_stream_transport_is_timed_out (GstRTSPStreamTransport * trans)
   return trans->priv->timed_out;
 }
 
+/* count packets that were handed to the send callbacks, a failed send counts
+ * as dropped */
+static void
+count_sent (GstRTSPStreamTransportPrivate * priv, gboolean is_rtp,
+    gboolean sent, guint packets, gsize bytes)
+{
+  g_mutex_lock (&priv->stats_lock);
+  if (!sent) {
+    priv->counters[GST_RTSP_TRANSPORT_STAT_DROPPED] += packets;
+  } else if (is_rtp) {
+    priv->counters[GST_RTSP_TRANSPORT_STAT_RTP_PACKETS] += packets;
+    priv->counters[GST_RTSP_TRANSPORT_STAT_RTP_BYTES] += bytes;
+  } else {
+    priv->counters[GST_RTSP_TRANSPORT_STAT_RTCP_PACKETS] += packets;
+    priv->counters[GST_RTSP_TRANSPORT_STAT_RTCP_BYTES] += bytes;
+  }
+  g_mutex_unlock (&priv->stats_lock);
+}
+
+static gboolean
+add_buffer_size (GstBuffer ** buffer, guint idx, gsize * size)
+{
+  *size += gst_buffer_get_size (*buffer);
+  return TRUE;
+}
+
+/* the total size of the buffers in @buffer_list */
+gsize
+gst_rtsp_buffer_list_get_size (GstBufferList * buffer_list)
+{
+  gsize size = 0;
+
+  gst_buffer_list_foreach (buffer_list, (GstBufferListFunc) add_buffer_size,
+      &size);
+
+  return size;
+}
+
+static GstFlowReturn
+crypto_chain (GstPad * pad, GstObject * parent, GstBuffer * buffer)
+{
+  GstRTSPStreamTransportPrivate *priv = gst_pad_get_element_private (pad);
+
+  gst_buffer_list_add (priv->crypto_out, buffer);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+collect_crypto_buffer (GstBuffer ** buffer, guint idx, GstBufferList * out)
+{
+  gst_buffer_list_add (out, gst_buffer_ref (*buffer));
+  return TRUE;
+}
+
+static GstFlowReturn
+crypto_chain_list (GstPad * pad, GstObject * parent, GstBufferList * list)
+{
+  GstRTSPStreamTransportPrivate *priv = gst_pad_get_element_private (pad);
+
+  gst_buffer_list_foreach (list, (GstBufferListFunc) collect_crypto_buffer,
+      priv->crypto_out);
+  gst_buffer_list_unref (list);
+
+  return GST_FLOW_OK;
+}
+
+static gboolean
+crypto_event (GstPad * pad, GstObject * parent, GstEvent * event)
+{
+  gst_event_unref (event);
+  return TRUE;
+}
+
+static void
+set_srtp_param (GstElement * srtpenc, const gchar * property,
+    const GstStructure * s, const gchar * field)
+{
+  const gchar *value;
+
+  if ((value = gst_structure_get_string (s, field)))
+    gst_util_set_object_arg (G_OBJECT (srtpenc), property, value);
+}
+
+/* must be called with the crypto_lock */
+static void
+clear_crypto (GstRTSPStreamTransportPrivate * priv)
+{
+  gint i;
+
+  if (priv->srtpenc == NULL)
+    return;
+
+  gst_element_set_state (priv->srtpenc, GST_STATE_NULL);
+
+  for (i = 0; i < 2; i++) {
+    GstPad *peer;
+
+    if ((peer = gst_pad_get_peer (priv->crypto_src[i]))) {
+      gst_pad_unlink (priv->crypto_src[i], peer);
+      gst_object_unref (peer);
+    }
+    if ((peer = gst_pad_get_peer (priv->crypto_sink[i]))) {
+      gst_pad_unlink (peer, priv->crypto_sink[i]);
+      gst_object_unref (peer);
+    }
+    gst_pad_set_active (priv->crypto_src[i], FALSE);
+    gst_pad_set_active (priv->crypto_sink[i], FALSE);
+    gst_object_unref (priv->crypto_src[i]);
+    gst_object_unref (priv->crypto_sink[i]);
+    priv->crypto_src[i] = NULL;
+    priv->crypto_sink[i] = NULL;
+  }
+  gst_object_unref (priv->srtpenc);
+  priv->srtpenc = NULL;
+}
+
+/* make an SRTP encoder with the key in @crypto, must be called with the
+ * crypto_lock */
+static gboolean
+make_crypto (GstRTSPStreamTransportPrivate * priv, GstCaps * crypto)
+{
+  static const gchar *names[] = { "rtp", "rtcp" };
+  const GstStructure *s;
+  GstBuffer *key;
+  gchar *stream_id;
+  GstSegment segment;
+  gint i;
+
+  s = gst_caps_get_structure (crypto, 0);
+  if (!gst_structure_get (s, "srtp-key", GST_TYPE_BUFFER, &key, NULL))
+    goto no_key;
+
+  if (!(priv->srtpenc = gst_element_factory_make ("srtpenc", NULL)))
+    goto no_srtpenc;
+  gst_object_ref_sink (priv->srtpenc);
+
+  g_object_set (priv->srtpenc, "key", key, NULL);
+  gst_buffer_unref (key);
+  set_srtp_param (priv->srtpenc, "rtp-cipher", s, "srtp-cipher");
+  set_srtp_param (priv->srtpenc, "rtp-auth", s, "srtp-auth");
+  set_srtp_param (priv->srtpenc, "rtcp-cipher", s, "srtcp-cipher");
+  set_srtp_param (priv->srtpenc, "rtcp-auth", s, "srtcp-auth");
+  /* packets of the GOP cache can be sent again with the same index */
+  if (g_object_class_find_property (G_OBJECT_GET_CLASS (priv->srtpenc),
+          "allow-repeat-tx"))
+    g_object_set (priv->srtpenc, "allow-repeat-tx", TRUE, NULL);
+
+  for (i = 0; i < 2; i++) {
+    GstPad *pad;
+    gchar *name;
+
+    priv->crypto_src[i] = gst_pad_new (NULL, GST_PAD_SRC);
+    priv->crypto_sink[i] = gst_pad_new (NULL, GST_PAD_SINK);
+    gst_pad_set_element_private (priv->crypto_sink[i], priv);
+    gst_pad_set_chain_function (priv->crypto_sink[i], crypto_chain);
+    gst_pad_set_chain_list_function (priv->crypto_sink[i], crypto_chain_list);
+    gst_pad_set_event_function (priv->crypto_sink[i], crypto_event);
+
+    name = g_strdup_printf ("%s_sink_0", names[i]);
+    pad = gst_element_get_request_pad (priv->srtpenc, name);
+    g_free (name);
+    gst_pad_link (priv->crypto_src[i], pad);
+    gst_object_unref (pad);
+
+    name = g_strdup_printf ("%s_src_0", names[i]);
+    pad = gst_element_get_static_pad (priv->srtpenc, name);
+    g_free (name);
+    gst_pad_link (pad, priv->crypto_sink[i]);
+    gst_object_unref (pad);
+
+    gst_pad_set_active (priv->crypto_sink[i], TRUE);
+    gst_pad_set_active (priv->crypto_src[i], TRUE);
+  }
+
+  if (gst_element_set_state (priv->srtpenc, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE)
+    goto state_failed;
+
+  stream_id = g_strdup_printf ("rtsp-srtp-%p", priv);
+  gst_segment_init (&segment, GST_FORMAT_TIME);
+  for (i = 0; i < 2; i++) {
+    gst_pad_push_event (priv->crypto_src[i],
+        gst_event_new_stream_start (stream_id));
+    gst_pad_push_event (priv->crypto_src[i],
+        gst_event_new_caps (gst_caps_new_empty_simple (i == 0 ?
+                "application/x-rtp" : "application/x-rtcp")));
+    gst_pad_push_event (priv->crypto_src[i], gst_event_new_segment (&segment));
+  }
+  g_free (stream_id);
+
+  return TRUE;
+
+  /* ERRORS */
+no_key:
+  {
+    GST_WARNING ("no srtp-key in %" GST_PTR_FORMAT, crypto);
+    return FALSE;
+  }
+no_srtpenc:
+  {
+    GST_WARNING ("no srtpenc element available");
+    gst_buffer_unref (key);
+    return FALSE;
+  }
+state_failed:
+  {
+    GST_WARNING ("failed to start srtpenc");
+    clear_crypto (priv);
+    return FALSE;
+  }
+}
+
+/**
+ * gst_rtsp_stream_transport_set_crypto:
+ * @trans: a #GstRTSPStreamTransport
+ * @crypto: (transfer none) (allow-none): a #GstCaps with crypto info
+ *
+ * Encrypt the RTP and RTCP packets sent to @trans with the SRTP master key and
+ * ciphers in @crypto, given in the same fields as for
+ * gst_rtsp_stream_update_crypto(). The stream should not encrypt the packets
+ * itself, see gst_rtsp_stream_set_per_transport_keys(). With %NULL, the
+ * packets are sent unencrypted.
+ *
+ * This is only possible for TCP and UDP unicast transports that are not
+ * active. When no encoder could be made for @crypto, the packets for @trans
+ * are dropped.
+ *
+ * Returns: %TRUE if @crypto could be used.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_transport_set_crypto (GstRTSPStreamTransport * trans,
+    GstCaps * crypto)
+{
+  GstRTSPStreamTransportPrivate *priv;
+  gboolean res = TRUE;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans), FALSE);
+  g_return_val_if_fail (crypto == NULL || GST_IS_CAPS (crypto), FALSE);
+
+  priv = trans->priv;
+
+  if (priv->active)
+    goto is_active;
+
+  if (crypto
+      && priv->transport->lower_transport == GST_RTSP_LOWER_TRANS_UDP_MCAST)
+    goto multicast;
+
+  g_mutex_lock (&priv->crypto_lock);
+  clear_crypto (priv);
+  gst_caps_replace (&priv->crypto, crypto);
+  if (crypto)
+    res = make_crypto (priv, crypto);
+  g_mutex_unlock (&priv->crypto_lock);
+
+  return res;
+
+  /* ERRORS */
+is_active:
+  {
+    GST_WARNING ("can't change the key of an active transport");
+    return FALSE;
+  }
+multicast:
+  {
+    GST_WARNING ("can't use a key for one multicast transport");
+    return FALSE;
+  }
+}
+
+/**
+ * gst_rtsp_stream_transport_get_crypto:
+ * @trans: a #GstRTSPStreamTransport
+ *
+ * Get the crypto info used for the packets sent to @trans.
+ *
+ * Returns: (transfer full) (nullable): the #GstCaps with crypto info or %NULL
+ * when the packets are not encrypted for @trans. gst_caps_unref() after usage.
+ *
+ * Since: 1.6
+ */
+GstCaps *
+gst_rtsp_stream_transport_get_crypto (GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamTransportPrivate *priv;
+  GstCaps *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans), NULL);
+
+  priv = trans->priv;
+
+  g_mutex_lock (&priv->crypto_lock);
+  if ((result = priv->crypto))
+    gst_caps_ref (result);
+  g_mutex_unlock (&priv->crypto_lock);
+
+  return result;
+}
+
+/* check if the packets to @trans are encrypted by @trans. The crypto can only
+ * change when @trans is not active so this can be called from the streaming
+ * threads without lock */
+gboolean
+gst_rtsp_stream_transport_has_crypto (GstRTSPStreamTransport * trans)
+{
+  return trans->priv->crypto != NULL;
+}
+
+/* count the packets that @trans encrypts for itself in @metrics */
+void
+gst_rtsp_stream_transport_set_copy_metrics (GstRTSPStreamTransport * trans,
+    GstRTSPCopyMetrics * metrics)
+{
+  GstRTSPStreamTransportPrivate *priv = trans->priv;
+
+  g_mutex_lock (&priv->crypto_lock);
+  if (priv->copy_metrics)
+    gst_rtsp_copy_metrics_unref (priv->copy_metrics);
+  priv->copy_metrics = metrics ? gst_rtsp_copy_metrics_ref (metrics) : NULL;
+  g_mutex_unlock (&priv->crypto_lock);
+}
+
+/* encrypt all packets of @buffer_list in one go, the encoder handles the list
+ * at once. Returns a new list or %NULL when the packets could not be
+ * encrypted */
+static GstBufferList *
+encrypt_list (GstRTSPStreamTransportPrivate * priv, gboolean is_rtp,
+    GstBufferList * buffer_list)
+{
+  GstBufferList *result;
+  GstFlowReturn ret;
+
+  g_mutex_lock (&priv->crypto_lock);
+  if (priv->srtpenc == NULL)
+    goto no_encoder;
+
+  priv->crypto_out =
+      gst_buffer_list_new_sized (gst_buffer_list_length (buffer_list));
+  ret = gst_pad_push_list (priv->crypto_src[is_rtp ? 0 : 1],
+      gst_buffer_list_ref (buffer_list));
+  result = priv->crypto_out;
+  priv->crypto_out = NULL;
+
+  if (ret != GST_FLOW_OK)
+    goto encrypt_failed;
+
+  /* the encoder made a copy of the packets for this transport only */
+  if (priv->copy_metrics)
+    gst_rtsp_copy_metrics_count (priv->copy_metrics,
+        gst_buffer_list_length (buffer_list),
+        gst_rtsp_buffer_list_get_size (buffer_list));
+  g_mutex_unlock (&priv->crypto_lock);
+
+  return result;
+
+  /* ERRORS */
+no_encoder:
+  {
+    g_mutex_unlock (&priv->crypto_lock);
+    return NULL;
+  }
+encrypt_failed:
+  {
+    g_mutex_unlock (&priv->crypto_lock);
+    GST_WARNING ("failed to encrypt packets: %s", gst_flow_get_name (ret));
+    gst_buffer_list_unref (result);
+    return NULL;
+  }
+}
+
+/* must be called with the crypto_lock */
+static void
+clear_udp_address (GstRTSPStreamTransportPrivate * priv)
+{
+  gint i;
+
+  for (i = 0; i < 2; i++) {
+    if (priv->udp_addr[i])
+      g_object_unref (priv->udp_addr[i]);
+    priv->udp_addr[i] = NULL;
+  }
+}
+
+/* get the client address for RTP or RTCP, made once per transport */
+static GSocketAddress *
+get_udp_address (GstRTSPStreamTransportPrivate * priv, gboolean is_rtp)
+{
+  GSocketAddress *addr;
+  gint idx = is_rtp ? 0 : 1;
+
+  g_mutex_lock (&priv->crypto_lock);
+  if (priv->udp_addr[idx] == NULL) {
+    const GstRTSPTransport *tr = priv->transport;
+    GInetAddress *iaddr;
+
+    if ((iaddr = g_inet_address_new_from_string (tr->destination))) {
+      priv->udp_addr[idx] = g_inet_socket_address_new (iaddr,
+          is_rtp ? tr->client_port.min : tr->client_port.max);
+      g_object_unref (iaddr);
+    }
+  }
+  if ((addr = priv->udp_addr[idx]))
+    g_object_ref (addr);
+  g_mutex_unlock (&priv->crypto_lock);
+
+  return addr;
+}
+
+/* called by the stream to send @buffer_list to the UDP client port of @trans
+ * when the packets are encrypted for @trans and can't go through the udpsink */
+void
+gst_rtsp_stream_transport_send_udp (GstRTSPStreamTransport * trans,
+    gboolean is_rtp, GstBufferList * buffer_list, GSocket * socket_v4,
+    GSocket * socket_v6)
+{
+  GstRTSPStreamTransportPrivate *priv = trans->priv;
+  GstBufferList *encrypted;
+  GSocketAddress *addr;
+  GSocket *socket;
+  guint i, len, sent = 0;
+  gsize bytes = 0;
+
+  len = gst_buffer_list_length (buffer_list);
+
+  if (!(addr = get_udp_address (priv, is_rtp)))
+    goto dropped;
+
+  if (g_socket_address_get_family (addr) == G_SOCKET_FAMILY_IPV6)
+    socket = socket_v6;
+  else
+    socket = socket_v4;
+
+  if (socket == NULL)
+    goto no_socket;
+
+  if (!(encrypted = encrypt_list (priv, is_rtp, buffer_list)))
+    goto no_socket;
+
+  len = gst_buffer_list_length (encrypted);
+  for (i = 0; i < len; i++) {
+    GstBuffer *buffer = gst_buffer_list_get (encrypted, i);
+    GstMapInfo map;
+    GError *err = NULL;
+
+    if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+      continue;
+
+    if (g_socket_send_to (socket, addr, (const gchar *) map.data, map.size,
+            NULL, &err) < 0) {
+      GST_LOG ("failed to send to %s: %s", priv->transport->destination,
+          err->message);
+      g_clear_error (&err);
+    } else {
+      sent++;
+      bytes += map.size;
+    }
+    gst_buffer_unmap (buffer, &map);
+  }
+  gst_buffer_list_unref (encrypted);
+  g_object_unref (addr);
+
+  count_sent (priv, is_rtp, TRUE, sent, bytes);
+  if (sent < len)
+    count_sent (priv, is_rtp, FALSE, len - sent, 0);
+  return;
+
+  /* ERRORS */
+no_socket:
+  g_object_unref (addr);
+dropped:
+  count_sent (priv, is_rtp, FALSE, len, 0);
+}
+
+typedef struct
+{
+  GstRTSPSendFunc func;
+  guint8 channel;
+  gpointer user_data;
+  gboolean res;
+} SendListData;
+
+static gboolean
+send_list_item (GstBuffer ** buffer, guint idx, SendListData * data)
+{
+  data->res = data->func (*buffer, data->channel, data->user_data);
+
+  return data->res;
+}
+
+/* send all buffers of @buffer_list with @func, one by one */
+static gboolean
+send_list_fallback (GstRTSPSendFunc func, GstBufferList * buffer_list,
+    guint8 channel, gpointer user_data)
+{
+  SendListData data;
+
+  data.func = func;
+  data.channel = channel;
+  data.user_data = user_data;
+  data.res = TRUE;
+
+  gst_buffer_list_foreach (buffer_list, (GstBufferListFunc) send_list_item,
+      &data);
+
+  return data.res;
+}
+
+/* send all buffers of @buffer_list to the list callback or, when there is
+ * none, one by one to the callback of RTP or RTCP */
+static gboolean
+send_list (GstRTSPStreamTransport * trans, gboolean is_rtp,
+    GstBufferList * buffer_list)
+{
+  GstRTSPStreamTransportPrivate *priv = trans->priv;
+  GstRTSPSendListFunc list_func;
+  GstRTSPSendFunc func;
+  guint8 channel;
+  gboolean res;
+
+  if (is_rtp) {
+    list_func = priv->send_rtp_list;
+    func = priv->send_rtp;
+    channel = priv->transport->interleaved.min;
+  } else {
+    list_func = priv->send_rtcp_list;
+    func = priv->send_rtcp;
+    channel = priv->transport->interleaved.max;
+  }
+
+  if (list_func)
+    res = list_func (buffer_list, channel, priv->list_user_data);
+  else if (func)
+    res = send_list_fallback (func, buffer_list, channel, priv->user_data);
+  else
+    return FALSE;
+
+  count_sent (priv, is_rtp, res, gst_buffer_list_length (buffer_list),
+      gst_rtsp_buffer_list_get_size (buffer_list));
+
+  if (res)
+    gst_rtsp_stream_transport_keep_alive (trans);
+
+  return res;
+}
+
+/* encrypt @buffer or all buffers of @buffer_list with the key of @trans and
+ * send them as one list */
+static gboolean
+send_encrypted (GstRTSPStreamTransport * trans, gboolean is_rtp,
+    GstBuffer * buffer, GstBufferList * buffer_list)
+{
+  GstRTSPStreamTransportPrivate *priv = trans->priv;
+  GstBufferList *encrypted;
+  gboolean res;
+
+  /* UDP transports have no callbacks, don't encrypt for nothing */
+  if (is_rtp && !priv->send_rtp_list && !priv->send_rtp)
+    return FALSE;
+  if (!is_rtp && !priv->send_rtcp_list && !priv->send_rtcp)
+    return FALSE;
+
+  if (buffer) {
+    buffer_list = gst_buffer_list_new_sized (1);
+    gst_buffer_list_add (buffer_list, gst_buffer_ref (buffer));
+  } else {
+    gst_buffer_list_ref (buffer_list);
+  }
+
+  if ((encrypted = encrypt_list (priv, is_rtp, buffer_list))) {
+    res = send_list (trans, is_rtp, encrypted);
+    gst_buffer_list_unref (encrypted);
+  } else {
+    count_sent (priv, is_rtp, FALSE, gst_buffer_list_length (buffer_list), 0);
+    res = FALSE;
+  }
+  gst_buffer_list_unref (buffer_list);
+
+  return res;
+}
+
 /**
  * gst_rtsp_stream_transport_send_rtp:
  * @trans: a #GstRTSPStreamTransport
@@ -455,10 +1126,15 @@ gst_rtsp_stream_transport_send_rtp (GstRTSPStreamTransport * trans,
 
   priv = trans->priv;
 
-  if (priv->send_rtp)
+  if (priv->crypto)
+    return send_encrypted (trans, TRUE, buffer, NULL);
+
+  if (priv->send_rtp) {
     res =
         priv->send_rtp (buffer, priv->transport->interleaved.min,
         priv->user_data);
+    count_sent (priv, TRUE, res, 1, gst_buffer_get_size (buffer));
+  }
 
   if (res)
     gst_rtsp_stream_transport_keep_alive (trans);
@@ -484,10 +1160,15 @@ gst_rtsp_stream_transport_send_rtcp (GstRTSPStreamTransport * trans,
 
   priv = trans->priv;
 
-  if (priv->send_rtcp)
+  if (priv->crypto)
+    return send_encrypted (trans, FALSE, buffer, NULL);
+
+  if (priv->send_rtcp) {
     res =
         priv->send_rtcp (buffer, priv->transport->interleaved.max,
         priv->user_data);
+    count_sent (priv, FALSE, res, 1, gst_buffer_get_size (buffer));
+  }
 
   if (res)
     gst_rtsp_stream_transport_keep_alive (trans);
@@ -495,6 +1176,52 @@ gst_rtsp_stream_transport_send_rtcp (GstRTSPStreamTransport * trans,
   return res;
 }
 
+/**
+ * gst_rtsp_stream_transport_send_rtp_list:
+ * @trans: a #GstRTSPStreamTransport
+ * @buffer_list: (transfer none): a #GstBufferList
+ *
+ * Send all buffers of @buffer_list to the installed RTP list callback for
+ * @trans. When no list callback was installed, each buffer is sent to the
+ * RTP callback.
+ *
+ * Returns: %TRUE on success
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_transport_send_rtp_list (GstRTSPStreamTransport * trans,
+    GstBufferList * buffer_list)
+{
+  if (trans->priv->crypto)
+    return send_encrypted (trans, TRUE, NULL, buffer_list);
+
+  return send_list (trans, TRUE, buffer_list);
+}
+
+/**
+ * gst_rtsp_stream_transport_send_rtcp_list:
+ * @trans: a #GstRTSPStreamTransport
+ * @buffer_list: (transfer none): a #GstBufferList
+ *
+ * Send all buffers of @buffer_list to the installed RTCP list callback for
+ * @trans. When no list callback was installed, each buffer is sent to the
+ * RTCP callback.
+ *
+ * Returns: %TRUE on success
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_transport_send_rtcp_list (GstRTSPStreamTransport * trans,
+    GstBufferList * buffer_list)
+{
+  if (trans->priv->crypto)
+    return send_encrypted (trans, FALSE, NULL, buffer_list);
+
+  return send_list (trans, FALSE, buffer_list);
+}
+
 /**
  * gst_rtsp_stream_transport_keep_alive:
  * @trans: a #GstRTSPStreamTransport
@@ -543,3 +1270,120 @@ gst_rtsp_stream_transport_recv_data (GstRTSPStreamTransport * trans,
   }
   return res;
 }
+
+/* called by the stream when @trans is added to (@active) or removed from the
+ * UDP sinks. @udp contains the current UDP counters of the stream, the packets
+ * dropped for this transport are absolute. */
+void
+gst_rtsp_stream_transport_set_udp_stats (GstRTSPStreamTransport * trans,
+    const guint64 * udp, gboolean active)
+{
+  GstRTSPStreamTransportPrivate *priv = trans->priv;
+  gint i;
+
+  g_mutex_lock (&priv->stats_lock);
+  if (active) {
+    for (i = 0; i < GST_RTSP_TRANSPORT_STAT_DROPPED; i++)
+      priv->udp_base[i] = udp[i];
+    priv->udp_base[GST_RTSP_TRANSPORT_STAT_DROPPED] = 0;
+    priv->udp_active = TRUE;
+  } else if (priv->udp_active) {
+    for (i = 0; i < GST_RTSP_TRANSPORT_STAT_LAST; i++)
+      priv->udp_sent[i] += udp[i] - priv->udp_base[i];
+    priv->udp_active = FALSE;
+  }
+  g_mutex_unlock (&priv->stats_lock);
+}
+
+/* called by the stream with the last receiver report of the client */
+void
+gst_rtsp_stream_transport_set_receiver_report (GstRTSPStreamTransport * trans,
+    guint fraction_lost, gint packets_lost, guint jitter, guint round_trip)
+{
+  GstRTSPStreamTransportPrivate *priv = trans->priv;
+
+  g_mutex_lock (&priv->stats_lock);
+  priv->have_rb = TRUE;
+  priv->rb_fraction_lost = fraction_lost;
+  priv->rb_packets_lost = packets_lost;
+  priv->rb_jitter = jitter;
+  priv->rb_round_trip = round_trip;
+  g_mutex_unlock (&priv->stats_lock);
+}
+
+/**
+ * gst_rtsp_stream_transport_get_stats:
+ * @trans: a #GstRTSPStreamTransport
+ * @stats: (out caller-allocates): a #GstRTSPStreamTransportStats
+ *
+ * Fill @stats with the current statistics of @trans. The transport field of
+ * @stats is set to @trans without taking a reference.
+ *
+ * This only reads counters that are updated while sending and is cheap
+ * enough to be called periodically for many transports.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_stream_transport_get_stats (GstRTSPStreamTransport * trans,
+    GstRTSPStreamTransportStats * stats)
+{
+  GstRTSPStreamTransportPrivate *priv;
+  guint64 counters[GST_RTSP_TRANSPORT_STAT_LAST];
+  guint64 udp[GST_RTSP_TRANSPORT_STAT_LAST];
+  gboolean is_udp;
+  gint i;
+
+  g_return_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans));
+  g_return_if_fail (stats != NULL);
+
+  priv = trans->priv;
+
+  /* UDP data is counted once for the stream, get the current counters before
+   * taking our lock, the stream calls us with its lock */
+  is_udp = priv->transport->lower_transport != GST_RTSP_LOWER_TRANS_TCP;
+  if (is_udp)
+    gst_rtsp_stream_get_udp_stats (priv->stream, trans, udp);
+
+  g_mutex_lock (&priv->stats_lock);
+  for (i = 0; i < GST_RTSP_TRANSPORT_STAT_LAST; i++) {
+    counters[i] = priv->counters[i] + priv->udp_sent[i];
+    /* the transport could have been added after we got the counters */
+    if (is_udp && priv->udp_active && udp[i] > priv->udp_base[i])
+      counters[i] += udp[i] - priv->udp_base[i];
+  }
+  stats->have_rb = priv->have_rb;
+  stats->fraction_lost = priv->rb_fraction_lost;
+  stats->packets_lost = priv->rb_packets_lost;
+  stats->jitter = priv->rb_jitter;
+  stats->round_trip =
+      gst_util_uint64_scale (priv->rb_round_trip, GST_SECOND, 65536);
+  g_mutex_unlock (&priv->stats_lock);
+
+  stats->transport = trans;
+  stats->rtp_packets = counters[GST_RTSP_TRANSPORT_STAT_RTP_PACKETS];
+  stats->rtp_bytes = counters[GST_RTSP_TRANSPORT_STAT_RTP_BYTES];
+  stats->rtcp_packets = counters[GST_RTSP_TRANSPORT_STAT_RTCP_PACKETS];
+  stats->rtcp_bytes = counters[GST_RTSP_TRANSPORT_STAT_RTCP_BYTES];
+  stats->dropped = counters[GST_RTSP_TRANSPORT_STAT_DROPPED];
+}
+
+static void
+clear_transport_stats (GstRTSPStreamTransportStats * stats)
+{
+  if (stats->transport)
+    g_object_unref (stats->transport);
+}
+
+/* make an array for GstRTSPStreamTransportStats that holds a ref to the
+ * transport of each element */
+GArray *
+gst_rtsp_stream_transport_stats_array_new (void)
+{
+  GArray *array;
+
+  array = g_array_new (FALSE, TRUE, sizeof (GstRTSPStreamTransportStats));
+  g_array_set_clear_func (array, (GDestroyNotify) clear_transport_stats);
+
+  return array;
+}
@@ -51,9 +51,27 @@ typedef struct _GstRTSPStreamTransportPrivate GstRTSPStreamTransportPrivate;
  * Function registered with gst_rtsp_stream_transport_set_callbacks() and
  * called when @buffer must be sent on @channel.
  *
+ * @buffer is shared with all other transports of the stream. It must not be
+ * modified, which would copy it for each transport.
+ *
  * Returns: %TRUE on success
  */
 typedef gboolean (*GstRTSPSendFunc)      (GstBuffer *buffer, guint8 channel, gpointer user_data);
+/**
+ * GstRTSPSendListFunc:
+ * @buffer_list: a #GstBufferList
+ * @channel: a channel
+ * @user_data: user data
+ *
+ * Function registered with gst_rtsp_stream_transport_set_list_callbacks() and
+ * called when all buffers of @buffer_list must be sent on @channel. Like with
+ * #GstRTSPSendFunc, the buffers are shared and must not be modified.
+ *
+ * Returns: %TRUE on success
+ *
+ * Since: 1.6
+ */
+typedef gboolean (*GstRTSPSendListFunc)  (GstBufferList *buffer_list, guint8 channel, gpointer user_data);
 /**
  * GstRTSPKeepAliveFunc:
  * @user_data: user data
@@ -63,6 +81,44 @@ typedef gboolean (*GstRTSPSendFunc)      (GstBuffer *buffer, guint8 channel, gpo
  */
 typedef void     (*GstRTSPKeepAliveFunc) (gpointer user_data);
 
+/**
+ * GstRTSPStreamTransportStats:
+ * @transport: the #GstRTSPStreamTransport
+ * @rtp_packets: RTP packets sent
+ * @rtp_bytes: RTP bytes sent
+ * @rtcp_packets: RTCP packets sent
+ * @rtcp_bytes: RTCP bytes sent
+ * @dropped: packets that could not be sent
+ * @have_rb: if a receiver report of the client was received
+ * @fraction_lost: fraction of packets lost, from the last receiver report
+ * @packets_lost: cumulative number of packets lost, from the last receiver
+ *    report
+ * @jitter: interarrival jitter in clock rate units, from the last receiver
+ *    report
+ * @round_trip: the round trip time, from the last receiver report
+ *
+ * Statistics of a #GstRTSPStreamTransport. For UDP transports, the sent
+ * packets include the packets sent while the transport was active.
+ *
+ * Since: 1.6
+ */
+typedef struct {
+  GstRTSPStreamTransport *transport;
+  guint64 rtp_packets;
+  guint64 rtp_bytes;
+  guint64 rtcp_packets;
+  guint64 rtcp_bytes;
+  guint64 dropped;
+  gboolean have_rb;
+  guint fraction_lost;
+  gint packets_lost;
+  guint jitter;
+  GstClockTime round_trip;
+
+  /*< private >*/
+  gpointer _gst_reserved[GST_PADDING];
+} GstRTSPStreamTransportStats;
+
 /**
  * GstRTSPStreamTransport:
  * @parent: parent instance
@@ -108,6 +164,11 @@ void                     gst_rtsp_stream_transport_set_callbacks (GstRTSPStreamT
                                                                   GstRTSPSendFunc send_rtcp,
                                                                   gpointer user_data,
                                                                   GDestroyNotify  notify);
+void                     gst_rtsp_stream_transport_set_list_callbacks (GstRTSPStreamTransport *trans,
+                                                                  GstRTSPSendListFunc send_rtp_list,
+                                                                  GstRTSPSendListFunc send_rtcp_list,
+                                                                  gpointer user_data,
+                                                                  GDestroyNotify  notify);
 void                     gst_rtsp_stream_transport_set_keepalive (GstRTSPStreamTransport *trans,
                                                                   GstRTSPKeepAliveFunc keep_alive,
                                                                   gpointer user_data,
@@ -121,16 +182,27 @@ void                     gst_rtsp_stream_transport_set_timed_out (GstRTSPStreamT
                                                                   gboolean timedout);
 gboolean                 gst_rtsp_stream_transport_is_timed_out  (GstRTSPStreamTransport *trans);
 
+gboolean                 gst_rtsp_stream_transport_set_crypto    (GstRTSPStreamTransport *trans,
+                                                                  GstCaps *crypto);
+GstCaps *                gst_rtsp_stream_transport_get_crypto    (GstRTSPStreamTransport *trans);
+
 
 
 gboolean                 gst_rtsp_stream_transport_send_rtp      (GstRTSPStreamTransport *trans,
                                                                   GstBuffer *buffer);
 gboolean                 gst_rtsp_stream_transport_send_rtcp     (GstRTSPStreamTransport *trans,
                                                                   GstBuffer *buffer);
+gboolean                 gst_rtsp_stream_transport_send_rtp_list (GstRTSPStreamTransport *trans,
+                                                                  GstBufferList *buffer_list);
+gboolean                 gst_rtsp_stream_transport_send_rtcp_list (GstRTSPStreamTransport *trans,
+                                                                  GstBufferList *buffer_list);
 
 GstFlowReturn            gst_rtsp_stream_transport_recv_data     (GstRTSPStreamTransport *trans,
                                                                   guint channel, GstBuffer *buffer);
 
+void                     gst_rtsp_stream_transport_get_stats     (GstRTSPStreamTransport *trans,
+                                                                  GstRTSPStreamTransportStats *stats);
+
 G_END_DECLS
 
 #endif /* __GST_RTSP_STREAM_TRANSPORT_H__ */
@@ -52,16 +52,24 @@
 
 #include <gio/gio.h>
 
+#ifdef G_OS_UNIX
+#include <sys/types.h>
+#include <sys/socket.h>
+#endif
+
 #include <gst/app/gstappsrc.h>
 #include <gst/app/gstappsink.h>
 
 #include <gst/rtp/gstrtpbuffer.h>
 
 #include "rtsp-stream.h"
+#include "rtsp-udp-fanout.h"
+#include "rtsp-server-internal.h"
 
 #define GST_RTSP_STREAM_GET_PRIVATE(obj)  \
      (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_STREAM, GstRTSPStreamPrivate))
 
+/* the UDP sources for one multicast or connected UDP unicast transport */
 typedef struct
 {
   GstRTSPStreamTransport *transport;
@@ -69,7 +77,20 @@ typedef struct
   /* RTP and RTCP source */
   GstElement *udpsrc[2];
   GstPad *selpad[2];
-} GstRTSPMulticastTransportSource;
+} GstRTSPTransportSource;
+
+/* An immutable array of the transports we stream to. A new snapshot is
+ * published when the transports change so that the streaming threads can
+ * send to all transports without taking the lock.
+ *
+ * The RTP and RTCP streaming threads each announce the snapshot they use in
+ * a hazard pointer. A replaced snapshot is retired and only freed when no
+ * hazard pointer refers to it anymore. */
+typedef struct
+{
+  guint n_transports;
+  GstRTSPStreamTransport *transports[1];
+} GstRTSPTransportSnapshot;
 
 struct _GstRTSPStreamPrivate
 {
@@ -81,6 +102,8 @@ struct _GstRTSPStreamPrivate
   guint buffer_size;
   gboolean is_joined;
   gchar *control;
+  /* when the ports were allocated, for tracing the requests */
+  gint64 alloc_start, alloc_end;
 
   GstRTSPProfile profiles;
   GstRTSPLowerTrans protocols;
@@ -98,6 +121,8 @@ struct _GstRTSPStreamPrivate
   GstElement *srtpenc;
   GstElement *srtpdec;
   GHashTable *keys;
+  /* packets are encrypted by the transports, with the key of each client */
+  gboolean per_transport_keys;
 
   /* sinks used for sending and receiving RTP and RTCP over ipv4, they share
    * sockets */
@@ -110,6 +135,10 @@ struct _GstRTSPStreamPrivate
   GstElement *udpqueue[2];
   GstElement *udpsink[2];
 
+  /* batched sending to UDP unicast destinations, replaces udpsink for those */
+  GstRTSPUdpSendMode udp_send_mode;
+  GstRTSPUdpFanout *fanout[2];
+
   /* for TCP transport */
   GstElement *appsrc[2];
   GstClockTime appsrc_base_time[2];
@@ -144,17 +173,26 @@ struct _GstRTSPStreamPrivate
   GstCaps *caps;
 
   /* transports we stream to */
-  guint n_active;
   GList *transports;
   guint transports_cookie;
-  GList *tr_cache_rtp;
-  GList *tr_cache_rtcp;
-  guint tr_cache_cookie_rtp;
-  guint tr_cache_cookie_rtcp;
-
-
-  /* UDP sources for UDP multicast transports */
+  /* "address:port" of the unicast client ports -> transport, to map
+   * the origin of RTCP packets to transports. Holds a ref on the
+   * transports */
+  GHashTable *transport_index;
+  /* RTP and RTCP data that went to the udpsinks */
+  GMutex udp_stats_lock;
+  guint64 udp_counters[GST_RTSP_TRANSPORT_STAT_DROPPED];
+  GstRTSPTransportSnapshot *tr_snapshot;        /* atomic */
+  GstRTSPTransportSnapshot *tr_hazard[4];       /* atomic */
+  GList *tr_retired;
+
+
+  /* UDP sources for UDP multicast and connected UDP unicast transports */
   GList *transport_sources;
+  /* sources of removed transports, stopped when the lock is released */
+  GList *removed_sources;
+  /* receive from each UDP unicast client on its own connected socket */
+  gboolean connected_udp;
 
   gint dscp_qos;
 
@@ -164,12 +202,68 @@ struct _GstRTSPStreamPrivate
 
   /* pt->caps map for RECORD streams */
   GHashTable *ptmap;
+
+  /* GopBurst of the transports that are not added yet */
+  GList *gop_bursts;
+
+  /* RTP packets since the last keyframe, for bursting to new transports.
+   * Everything below gop_cache is protected by gop_lock */
+  gboolean gop_cache;
+  GMutex gop_lock;
+  GstPad *gop_pad;
+  gulong gop_probe[2];
+  gboolean gop_keyframe;
+  gboolean gop_valid;
+  GQueue gop;
+  gsize gop_bytes;
+  GstClockTime gop_running_time;
 };
 
 #define DEFAULT_CONTROL         NULL
 #define DEFAULT_PROFILES        GST_RTSP_PROFILE_AVP
 #define DEFAULT_PROTOCOLS       GST_RTSP_LOWER_TRANS_UDP | GST_RTSP_LOWER_TRANS_UDP_MCAST | \
                                         GST_RTSP_LOWER_TRANS_TCP
+#define DEFAULT_UDP_SEND_MODE   GST_RTSP_UDP_SEND_MODE_SINK
+#define DEFAULT_GOP_CACHE       FALSE
+#define DEFAULT_PER_TRANSPORT_KEYS FALSE
+#define DEFAULT_CONNECTED_UDP   FALSE
+
+/* a GOP larger than this is not cached */
+#define GOP_CACHE_MAX_BYTES     (4 * 1024 * 1024)
+/* the cached GOP is sent to new transports every GOP_BURST_INTERVAL
+ * milliseconds, at no more than GOP_BURST_RATE bytes per second */
+#define GOP_BURST_INTERVAL      5
+#define GOP_BURST_RATE          (10 * 1024 * 1024)
+/* the transport is added once no more than GOP_BURST_CHUNK packets were cached
+ * while sending the previous ones, or after GOP_BURST_ROUNDS of them */
+#define GOP_BURST_CHUNK         64
+#define GOP_BURST_ROUNDS        4
+
+/* the cached GOP as it was when the RTP-Info of a transport was made */
+typedef struct
+{
+  gint refcount;
+  GstRTSPStreamTransport *trans;
+  GstBufferList *list;
+  guint seq;
+  guint rtptime;
+  GstClockTime running_time;
+
+  /* set when the transport is added, the packets are then sent from source,
+   * which holds a ref on the burst */
+  GstRTSPStream *stream;
+  GSource *source;
+  gboolean encrypted;
+  GSocket *socket_v4;
+  GSocket *socket_v6;
+  GSocket *socket;
+  GSocketAddress *addr;
+  guint pos;
+  guint rounds;
+  gboolean added;
+  gint64 start;
+  guint64 bytes;
+} GopBurst;
 
 enum
 {
@@ -191,6 +285,8 @@ GST_DEBUG_CATEGORY_STATIC (rtsp_stream_debug);
 #define GST_CAT_DEFAULT rtsp_stream_debug
 
 static GQuark ssrc_stream_map_key;
+static GQuark ssrc_miss_key;
+static GQuark index_keys_key;
 
 static void gst_rtsp_stream_get_property (GObject * object, guint propid,
     GValue * value, GParamSpec * pspec);
@@ -201,6 +297,29 @@ static void gst_rtsp_stream_finalize (GObject * obj);
 
 static guint gst_rtsp_stream_signals[SIGNAL_LAST] = { 0 };
 
+#define C_ENUM(v) ((gint) v)
+
+GType
+gst_rtsp_udp_send_mode_get_type (void)
+{
+  static gsize id = 0;
+  static const GEnumValue values[] = {
+    {C_ENUM (GST_RTSP_UDP_SEND_MODE_SINK), "GST_RTSP_UDP_SEND_MODE_SINK",
+        "sink"},
+    {C_ENUM (GST_RTSP_UDP_SEND_MODE_FANOUT), "GST_RTSP_UDP_SEND_MODE_FANOUT",
+        "fanout"},
+    {C_ENUM (GST_RTSP_UDP_SEND_MODE_FANOUT_GSO),
+        "GST_RTSP_UDP_SEND_MODE_FANOUT_GSO", "fanout-gso"},
+    {0, NULL, NULL}
+  };
+
+  if (g_once_init_enter (&id)) {
+    GType tmp = g_enum_register_static ("GstRTSPUdpSendMode", values);
+    g_once_init_leave (&id, tmp);
+  }
+  return (GType) id;
+}
+
 G_DEFINE_TYPE (GstRTSPStream, gst_rtsp_stream, G_TYPE_OBJECT);
 
 static void
@@ -244,6 +363,8 @@ gst_rtsp_stream_class_init (GstRTSPStreamClass * klass)
   GST_DEBUG_CATEGORY_INIT (rtsp_stream_debug, "rtspstream", 0, "GstRTSPStream");
 
   ssrc_stream_map_key = g_quark_from_static_string ("GstRTSPServer.stream");
+  ssrc_miss_key = g_quark_from_static_string ("GstRTSPServer.stream.miss");
+  index_keys_key = g_quark_from_static_string ("GstRTSPServer.stream.keys");
 }
 
 static void
@@ -259,13 +380,59 @@ gst_rtsp_stream_init (GstRTSPStream * stream)
   priv->control = g_strdup (DEFAULT_CONTROL);
   priv->profiles = DEFAULT_PROFILES;
   priv->protocols = DEFAULT_PROTOCOLS;
+  priv->udp_send_mode = DEFAULT_UDP_SEND_MODE;
+  priv->gop_cache = DEFAULT_GOP_CACHE;
+  priv->per_transport_keys = DEFAULT_PER_TRANSPORT_KEYS;
+  priv->connected_udp = DEFAULT_CONNECTED_UDP;
 
   g_mutex_init (&priv->lock);
+  g_mutex_init (&priv->gop_lock);
+  g_mutex_init (&priv->udp_stats_lock);
+  g_queue_init (&priv->gop);
 
   priv->keys = g_hash_table_new_full (g_direct_hash, g_direct_equal,
       NULL, (GDestroyNotify) gst_caps_unref);
   priv->ptmap = g_hash_table_new_full (NULL, NULL, NULL,
       (GDestroyNotify) gst_caps_unref);
+  priv->transport_index = g_hash_table_new_full (g_str_hash, g_str_equal,
+      g_free, g_object_unref);
+}
+
+static GopBurst *
+gop_burst_ref (GopBurst * burst)
+{
+  g_atomic_int_inc (&burst->refcount);
+  return burst;
+}
+
+static void
+gop_burst_unref (GopBurst * burst)
+{
+  if (!g_atomic_int_dec_and_test (&burst->refcount))
+    return;
+
+  g_object_unref (burst->trans);
+  gst_buffer_list_unref (burst->list);
+  if (burst->stream)
+    g_object_unref (burst->stream);
+  if (burst->source)
+    g_source_unref (burst->source);
+  if (burst->addr)
+    g_object_unref (burst->addr);
+  if (burst->socket_v4)
+    g_object_unref (burst->socket_v4);
+  if (burst->socket_v6)
+    g_object_unref (burst->socket_v6);
+  g_free (burst);
+}
+
+/* stop the source that sends @burst and drop it from the list */
+static void
+cancel_gop_burst (GopBurst * burst)
+{
+  if (burst->source)
+    g_source_destroy (burst->source);
+  gop_burst_unref (burst);
 }
 
 static void
@@ -301,10 +468,16 @@ gst_rtsp_stream_finalize (GObject * obj)
   if (priv->sinkpad)
     gst_object_unref (priv->sinkpad);
   g_free (priv->control);
+  g_list_free_full (priv->gop_bursts, (GDestroyNotify) gop_burst_unref);
+  g_queue_foreach (&priv->gop, (GFunc) gst_buffer_unref, NULL);
+  g_queue_clear (&priv->gop);
+  g_mutex_clear (&priv->udp_stats_lock);
+  g_mutex_clear (&priv->gop_lock);
   g_mutex_clear (&priv->lock);
 
   g_hash_table_unref (priv->keys);
   g_hash_table_destroy (priv->ptmap);
+  g_hash_table_destroy (priv->transport_index);
 
   G_OBJECT_CLASS (gst_rtsp_stream_parent_class)->finalize (obj);
 }
@@ -1016,6 +1189,37 @@ different_address:
   }
 }
 
+/* let other sockets bind to the address of @socket. The kernel delivers the
+ * packets from a peer to the socket that is connected to it */
+static gboolean
+set_reuse_port (GSocket * socket)
+{
+#ifdef SO_REUSEPORT
+  gint val = 1;
+
+  return setsockopt (g_socket_get_fd (socket), SOL_SOCKET, SO_REUSEPORT,
+      (gpointer) & val, sizeof (val)) == 0;
+#else
+  return FALSE;
+#endif
+}
+
+/* bind @socket to @addr. With @reuse_port, the connected sockets of the clients
+ * can later be bound to the same port. SO_REUSEPORT is only set once @socket
+ * holds the port, so that the bind fails when another socket already has it,
+ * and no other stream can bind to the port in between */
+static gboolean
+bind_socket (GSocket * socket, GSocketAddress * addr, gboolean reuse_port)
+{
+  if (!g_socket_bind (socket, addr, FALSE, NULL))
+    return FALSE;
+
+  if (reuse_port && !set_reuse_port (socket))
+    GST_WARNING ("no SO_REUSEPORT, clients can't have connected sockets");
+
+  return TRUE;
+}
+
 static gboolean
 alloc_ports_one_family (GstRTSPStream * stream, GstRTSPAddressPool * pool,
     gint buffer_size, GSocketFamily family, GstElement * udpsrc_out[2],
@@ -1027,7 +1231,8 @@ alloc_ports_one_family (GstRTSPStream * stream, GstRTSPAddressPool * pool,
   GstElement *udpsrc0, *udpsrc1;
   GstElement *udpsink0, *udpsink1;
   GSocket *rtp_socket = NULL;
-  GSocket *rtcp_socket;
+  GSocket *rtcp_socket = NULL;
+  GstRTSPAddressFlags flags;
   gint tmp_rtp, tmp_rtcp;
   guint count;
   gint rtpport, rtcpport;
@@ -1052,14 +1257,32 @@ alloc_ports_one_family (GstRTSPStream * stream, GstRTSPAddressPool * pool,
   /* Start with random port */
   tmp_rtp = 0;
 
+  if (*server_addr_out)
+    gst_rtsp_address_free (*server_addr_out);
+
+  flags = GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST;
+  if (family == G_SOCKET_FAMILY_IPV6)
+    flags |= GST_RTSP_ADDRESS_FLAG_IPV6;
+  else
+    flags |= GST_RTSP_ADDRESS_FLAG_IPV4;
+
+  /* take sockets that the pool already bound, they can't be used when we need
+   * SO_REUSEPORT */
+  if (pool && !priv->connected_udp) {
+    addr = gst_rtsp_address_pool_acquire_sockets (pool, flags, &rtp_socket,
+        &rtcp_socket);
+    if (addr) {
+      tmp_rtp = addr->port;
+      tmp_rtcp = tmp_rtp + 1;
+      goto bound;
+    }
+  }
+
   rtcp_socket = g_socket_new (family, G_SOCKET_TYPE_DATAGRAM,
       G_SOCKET_PROTOCOL_UDP, NULL);
   if (!rtcp_socket)
     goto no_udp_protocol;
 
-  if (*server_addr_out)
-    gst_rtsp_address_free (*server_addr_out);
-
   /* try to allocate 2 UDP ports, the RTP port should be an even
    * number and the RTCP port should be the next (uneven) port */
 again:
@@ -1072,17 +1295,9 @@ again:
   }
 
   if (pool && gst_rtsp_address_pool_has_unicast_addresses (pool)) {
-    GstRTSPAddressFlags flags;
-
     if (addr)
       rejected_addresses = g_list_prepend (rejected_addresses, addr);
 
-    flags = GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST;
-    if (family == G_SOCKET_FAMILY_IPV6)
-      flags |= GST_RTSP_ADDRESS_FLAG_IPV6;
-    else
-      flags |= GST_RTSP_ADDRESS_FLAG_IPV4;
-
     addr = gst_rtsp_address_pool_acquire_address (pool, flags, 2);
 
     if (addr == NULL)
@@ -1104,7 +1319,7 @@ again:
   }
 
   rtp_sockaddr = g_inet_socket_address_new (inetaddr, tmp_rtp);
-  if (!g_socket_bind (rtp_socket, rtp_sockaddr, FALSE, NULL)) {
+  if (!bind_socket (rtp_socket, rtp_sockaddr, priv->connected_udp)) {
     g_object_unref (rtp_sockaddr);
     goto again;
   }
@@ -1132,7 +1347,7 @@ again:
   tmp_rtcp = tmp_rtp + 1;
 
   rtcp_sockaddr = g_inet_socket_address_new (inetaddr, tmp_rtcp);
-  if (!g_socket_bind (rtcp_socket, rtcp_sockaddr, FALSE, NULL)) {
+  if (!bind_socket (rtcp_socket, rtcp_sockaddr, priv->connected_udp)) {
     g_object_unref (rtcp_sockaddr);
     g_clear_object (&rtp_socket);
     goto again;
@@ -1141,6 +1356,7 @@ again:
 
   g_clear_object (&inetaddr);
 
+bound:
   udpsrc0 = gst_element_factory_make ("udpsrc", NULL);
   udpsrc1 = gst_element_factory_make ("udpsrc", NULL);
 
@@ -1410,6 +1626,260 @@ gst_rtsp_stream_get_retransmission_time (GstRTSPStream * stream)
   return ret;
 }
 
+/**
+ * gst_rtsp_stream_set_udp_send_mode:
+ * @stream: a #GstRTSPStream
+ * @mode: a #GstRTSPUdpSendMode
+ *
+ * Configure how packets are sent to UDP unicast destinations. This only
+ * has an effect when it is set before the stream joins the bin.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_stream_set_udp_send_mode (GstRTSPStream * stream,
+    GstRTSPUdpSendMode mode)
+{
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  GST_DEBUG_OBJECT (stream, "set udp send mode %d", mode);
+
+  g_mutex_lock (&stream->priv->lock);
+  stream->priv->udp_send_mode = mode;
+  g_mutex_unlock (&stream->priv->lock);
+}
+
+/**
+ * gst_rtsp_stream_get_udp_send_mode:
+ * @stream: a #GstRTSPStream
+ *
+ * Get how packets are sent to UDP unicast destinations.
+ *
+ * Returns: the #GstRTSPUdpSendMode of @stream.
+ *
+ * Since: 1.6
+ */
+GstRTSPUdpSendMode
+gst_rtsp_stream_get_udp_send_mode (GstRTSPStream * stream)
+{
+  GstRTSPUdpSendMode ret;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream),
+      GST_RTSP_UDP_SEND_MODE_SINK);
+
+  g_mutex_lock (&stream->priv->lock);
+  ret = stream->priv->udp_send_mode;
+  g_mutex_unlock (&stream->priv->lock);
+
+  return ret;
+}
+
+/**
+ * gst_rtsp_stream_set_gop_cache:
+ * @stream: a #GstRTSPStream
+ * @gop_cache: if the last GOP should be cached
+ *
+ * Keep the RTP packets since the last keyframe so that a transport that is
+ * added while the stream is playing first gets those packets and can start
+ * decoding right away instead of waiting for the next keyframe. This is meant
+ * for video streams and only has an effect when it is set before the stream
+ * joins the bin.
+ *
+ * Multicast transports are not sent the cached packets.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_stream_set_gop_cache (GstRTSPStream * stream, gboolean gop_cache)
+{
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  GST_DEBUG_OBJECT (stream, "set gop cache %d", gop_cache);
+
+  g_mutex_lock (&stream->priv->lock);
+  stream->priv->gop_cache = gop_cache;
+  g_mutex_unlock (&stream->priv->lock);
+}
+
+/**
+ * gst_rtsp_stream_get_gop_cache:
+ * @stream: a #GstRTSPStream
+ *
+ * Check if @stream caches the packets since the last keyframe.
+ *
+ * Returns: %TRUE if @stream has a GOP cache.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_get_gop_cache (GstRTSPStream * stream)
+{
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+
+  g_mutex_lock (&stream->priv->lock);
+  ret = stream->priv->gop_cache;
+  g_mutex_unlock (&stream->priv->lock);
+
+  return ret;
+}
+
+/**
+ * gst_rtsp_stream_set_per_transport_keys:
+ * @stream: a #GstRTSPStream
+ * @per_transport_keys: if the packets are encrypted for each transport
+ *
+ * Don't encrypt the packets of @stream once for all clients with a key of the
+ * server but encrypt them for each transport with the key that its client
+ * sent in the KeyMgmt header of the SETUP request, see
+ * gst_rtsp_stream_transport_set_crypto(). Clients of a secure profile then
+ * need to send a key and can't use multicast. This only has an effect when it
+ * is set before the stream joins the bin.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_stream_set_per_transport_keys (GstRTSPStream * stream,
+    gboolean per_transport_keys)
+{
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  GST_DEBUG_OBJECT (stream, "set per transport keys %d", per_transport_keys);
+
+  g_mutex_lock (&stream->priv->lock);
+  stream->priv->per_transport_keys = per_transport_keys;
+  g_mutex_unlock (&stream->priv->lock);
+}
+
+/**
+ * gst_rtsp_stream_get_per_transport_keys:
+ * @stream: a #GstRTSPStream
+ *
+ * Check if the packets of @stream are encrypted for each transport.
+ *
+ * Returns: %TRUE if the transports of @stream encrypt the packets.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_get_per_transport_keys (GstRTSPStream * stream)
+{
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+
+  g_mutex_lock (&stream->priv->lock);
+  ret = stream->priv->per_transport_keys;
+  g_mutex_unlock (&stream->priv->lock);
+
+  return ret;
+}
+
+/**
+ * gst_rtsp_stream_set_connected_udp:
+ * @stream: a #GstRTSPStream
+ * @connected_udp: if clients get their own connected sockets
+ *
+ * Receive the packets of each UDP unicast client on its own socket that is
+ * connected to the client and bound to the server ports with SO_REUSEPORT.
+ * The kernel then demuxes the clients and their RTCP is read by a thread per
+ * client instead of the single thread of the shared socket. This only has an
+ * effect when it is set before the stream joins the bin and on systems that
+ * deliver packets to connected sockets first, like Linux.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_stream_set_connected_udp (GstRTSPStream * stream,
+    gboolean connected_udp)
+{
+  g_return_if_fail (GST_IS_RTSP_STREAM (stream));
+
+  GST_DEBUG_OBJECT (stream, "set connected udp %d", connected_udp);
+
+  g_mutex_lock (&stream->priv->lock);
+  stream->priv->connected_udp = connected_udp;
+  g_mutex_unlock (&stream->priv->lock);
+}
+
+/**
+ * gst_rtsp_stream_get_connected_udp:
+ * @stream: a #GstRTSPStream
+ *
+ * Check if the UDP unicast clients of @stream get their own connected sockets.
+ *
+ * Returns: %TRUE if @stream uses connected sockets.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_get_connected_udp (GstRTSPStream * stream)
+{
+  gboolean ret;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+
+  g_mutex_lock (&stream->priv->lock);
+  ret = stream->priv->connected_udp;
+  g_mutex_unlock (&stream->priv->lock);
+
+  return ret;
+}
+
+/**
+ * gst_rtsp_stream_get_udp_dropped:
+ * @stream: a #GstRTSPStream
+ * @trans: a UDP unicast #GstRTSPStreamTransport of @stream
+ * @rtp_dropped: (out) (allow-none): dropped RTP packets
+ * @rtcp_dropped: (out) (allow-none): dropped RTCP packets
+ *
+ * Get the number of packets that could not be sent to the destination of
+ * @trans because the socket was full or sending failed.
+ *
+ * This is only available when the stream uses one of the fanout
+ * #GstRTSPUdpSendMode.
+ *
+ * Returns: %TRUE if the counters could be retrieved.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_stream_get_udp_dropped (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, guint64 * rtp_dropped,
+    guint64 * rtcp_dropped)
+{
+  GstRTSPStreamPrivate *priv;
+  const GstRTSPTransport *tr;
+  guint64 dropped[2] = { 0, 0 };
+  gboolean res = FALSE;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+  g_return_val_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans), FALSE);
+
+  priv = stream->priv;
+  tr = gst_rtsp_stream_transport_get_transport (trans);
+
+  if (tr->lower_transport != GST_RTSP_LOWER_TRANS_UDP)
+    return FALSE;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->fanout[0] && priv->fanout[1]) {
+    res = gst_rtsp_udp_fanout_get_dropped (priv->fanout[0], tr->destination,
+        tr->client_port.min, &dropped[0]);
+    res &= gst_rtsp_udp_fanout_get_dropped (priv->fanout[1], tr->destination,
+        tr->client_port.max, &dropped[1]);
+  }
+  g_mutex_unlock (&priv->lock);
+
+  if (rtp_dropped)
+    *rtp_dropped = dropped[0];
+  if (rtcp_dropped)
+    *rtcp_dropped = dropped[1];
+
+  return res;
+}
+
 void
 gst_rtsp_stream_set_retransmission_pt (GstRTSPStream * stream, guint rtx_pt)
 {
@@ -1471,6 +1941,9 @@ dump_structure (const GstStructure * s)
 {
   gchar *sstr;
 
+  if (gst_debug_category_get_threshold (rtsp_stream_debug) < GST_LEVEL_INFO)
+    return;
+
   sstr = gst_structure_to_string (s);
   GST_INFO ("structure: %s", sstr);
   g_free (sstr);
@@ -1480,59 +1953,47 @@ static GstRTSPStreamTransport *
 find_transport (GstRTSPStream * stream, const gchar * rtcp_from)
 {
   GstRTSPStreamPrivate *priv = stream->priv;
-  GList *walk;
-  GstRTSPStreamTransport *result = NULL;
-  const gchar *tmp;
-  gchar *dest;
-  guint port;
+  GstRTSPStreamTransport *result;
 
   if (rtcp_from == NULL)
     return NULL;
 
-  tmp = g_strrstr (rtcp_from, ":");
-  if (tmp == NULL)
-    return NULL;
-
-  port = atoi (tmp + 1);
-  dest = g_strndup (rtcp_from, tmp - rtcp_from);
-
   g_mutex_lock (&priv->lock);
-  GST_INFO ("finding %s:%d in %d transports", dest, port,
-      g_list_length (priv->transports));
-
-  for (walk = priv->transports; walk; walk = g_list_next (walk)) {
-    GstRTSPStreamTransport *trans = walk->data;
-    const GstRTSPTransport *tr;
-    gint min, max;
-
-    tr = gst_rtsp_stream_transport_get_transport (trans);
-
-    min = tr->client_port.min;
-    max = tr->client_port.max;
+  GST_INFO ("finding %s in %d transports", rtcp_from,
+      g_hash_table_size (priv->transport_index));
 
-    if ((strcmp (tr->destination, dest) == 0) && (min == port || max == port)) {
-      result = trans;
-      break;
-    }
-  }
-  if (result)
+  /* the index uses the same address:port format as rtcp-from */
+  if ((result = g_hash_table_lookup (priv->transport_index, rtcp_from)))
     g_object_ref (result);
   g_mutex_unlock (&priv->lock);
 
-  g_free (dest);
-
   return result;
 }
 
 static GstRTSPStreamTransport *
 check_transport (GObject * source, GstRTSPStream * stream)
 {
+  GstRTSPStreamPrivate *priv = stream->priv;
   GstStructure *stats;
   GstRTSPStreamTransport *trans;
+  guint cookie;
+  gboolean empty;
 
   /* see if we have a stream to match with the origin of the RTCP packet */
   trans = g_object_get_qdata (source, ssrc_stream_map_key);
   if (trans == NULL) {
+    g_mutex_lock (&priv->lock);
+    cookie = priv->transports_cookie;
+    empty = g_hash_table_size (priv->transport_index) == 0;
+    g_mutex_unlock (&priv->lock);
+
+    /* nothing to match with or the lookup for this source failed and the
+     * transports did not change since then */
+    if (empty ||
+        GPOINTER_TO_UINT (g_object_get_qdata (source, ssrc_miss_key)) ==
+        cookie + 1)
+      return NULL;
+
     g_object_get (source, "stats", &stats, NULL);
     if (stats) {
       const gchar *rtcp_from;
@@ -1545,6 +2006,9 @@ check_transport (GObject * source, GstRTSPStream * stream)
             source);
         g_object_set_qdata_full (source, ssrc_stream_map_key, trans,
             g_object_unref);
+      } else if (rtcp_from) {
+        g_object_set_qdata (source, ssrc_miss_key,
+            GUINT_TO_POINTER (cookie + 1));
       }
       gst_structure_free (stats);
     }
@@ -1552,7 +2016,6 @@ check_transport (GObject * source, GstRTSPStream * stream)
   return trans;
 }
 
-
 static void
 on_new_ssrc (GObject * session, GObject * source, GstRTSPStream * stream)
 {
@@ -1580,19 +2043,31 @@ on_ssrc_active (GObject * session, GObject * source, GstRTSPStream * stream)
   trans = check_transport (source, stream);
 
   if (trans) {
+    GstStructure *stats;
+    gboolean have_rb = FALSE;
+
     GST_INFO ("%p: source %p in transport %p is active", stream, source, trans);
     gst_rtsp_stream_transport_keep_alive (trans);
-  }
-#ifdef DUMP_STATS
-  {
-    GstStructure *stats;
+
+    /* keep the last receiver report of the client with the transport */
     g_object_get (source, "stats", &stats, NULL);
     if (stats) {
+      guint fraction_lost, jitter, round_trip;
+      gint packets_lost;
+
+#ifdef DUMP_STATS
       dump_structure (stats);
+#endif
+      if (gst_structure_get_boolean (stats, "have-rb", &have_rb) && have_rb &&
+          gst_structure_get_uint (stats, "rb-fractionlost", &fraction_lost) &&
+          gst_structure_get_int (stats, "rb-packetslost", &packets_lost) &&
+          gst_structure_get_uint (stats, "rb-jitter", &jitter) &&
+          gst_structure_get_uint (stats, "rb-round-trip", &round_trip))
+        gst_rtsp_stream_transport_set_receiver_report (trans, fraction_lost,
+            packets_lost, jitter, round_trip);
       gst_structure_free (stats);
     }
   }
-#endif
 }
 
 static void
@@ -1628,24 +2103,155 @@ on_timeout (GObject * session, GObject * source, GstRTSPStream * stream)
 }
 
 static void
-clear_tr_cache (GstRTSPStreamPrivate * priv, gboolean is_rtp)
+free_snapshot (GstRTSPTransportSnapshot * snapshot)
 {
-  if (is_rtp) {
-    g_list_foreach (priv->tr_cache_rtp, (GFunc) g_object_unref, NULL);
-    g_list_free (priv->tr_cache_rtp);
-    priv->tr_cache_rtp = NULL;
-  } else {
-    g_list_foreach (priv->tr_cache_rtcp, (GFunc) g_object_unref, NULL);
-    g_list_free (priv->tr_cache_rtcp);
-    priv->tr_cache_rtcp = NULL;
+  guint i;
+
+  for (i = 0; i < snapshot->n_transports; i++)
+    g_object_unref (snapshot->transports[i]);
+  g_free (snapshot);
+}
+
+static gboolean
+snapshot_in_use (GstRTSPStreamPrivate * priv,
+    GstRTSPTransportSnapshot * snapshot)
+{
+  guint i;
+
+  for (i = 0; i < G_N_ELEMENTS (priv->tr_hazard); i++) {
+    if (g_atomic_pointer_get (&priv->tr_hazard[i]) == snapshot)
+      return TRUE;
+  }
+  return FALSE;
+}
+
+/* free the retired snapshots that are not used by a streaming thread
+ * anymore. With @force, all retired snapshots are freed, this can only be
+ * done when the streaming threads are stopped. Must be called with the
+ * lock. */
+static void
+reclaim_snapshots (GstRTSPStreamPrivate * priv, gboolean force)
+{
+  GList *walk, *next;
+
+  for (walk = priv->tr_retired; walk; walk = next) {
+    GstRTSPTransportSnapshot *snapshot = walk->data;
+
+    next = g_list_next (walk);
+
+    if (!force && snapshot_in_use (priv, snapshot))
+      continue;
+
+    free_snapshot (snapshot);
+    priv->tr_retired = g_list_delete_link (priv->tr_retired, walk);
+  }
+}
+
+/* replace the current snapshot with @snapshot. Must be called with the
+ * lock */
+static void
+replace_snapshot (GstRTSPStreamPrivate * priv,
+    GstRTSPTransportSnapshot * snapshot)
+{
+  GstRTSPTransportSnapshot *old;
+
+  old = g_atomic_pointer_get (&priv->tr_snapshot);
+  g_atomic_pointer_set (&priv->tr_snapshot, snapshot);
+
+  if (old)
+    priv->tr_retired = g_list_prepend (priv->tr_retired, old);
+
+  reclaim_snapshots (priv, FALSE);
+}
+
+/* publish a new snapshot of the transports. Must be called with the lock */
+static void
+update_snapshot (GstRTSPStreamPrivate * priv)
+{
+  GstRTSPTransportSnapshot *snapshot;
+  GList *walk;
+  guint n;
+
+  n = g_list_length (priv->transports);
+
+  snapshot = g_malloc (sizeof (GstRTSPTransportSnapshot) +
+      n * sizeof (GstRTSPStreamTransport *));
+  snapshot->n_transports = 0;
+
+  for (walk = priv->transports; walk; walk = g_list_next (walk)) {
+    GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
+
+    snapshot->transports[snapshot->n_transports++] = g_object_ref (tr);
+  }
+
+  replace_snapshot (priv, snapshot);
+}
+
+/* get the current snapshot for the streaming thread @idx, 0 for RTP and 1
+ * for RTCP of the appsink, 2 for RTP and 3 for RTCP of the udpsinks. Release
+ * with release_snapshot() */
+static GstRTSPTransportSnapshot *
+acquire_snapshot (GstRTSPStreamPrivate * priv, gint idx)
+{
+  GstRTSPTransportSnapshot *snapshot;
+
+  /* announce the snapshot we are going to use and check that it was not
+   * replaced in the meantime, else it might have been freed already */
+  do {
+    snapshot = g_atomic_pointer_get (&priv->tr_snapshot);
+    g_atomic_pointer_set (&priv->tr_hazard[idx], snapshot);
+  } while (snapshot != g_atomic_pointer_get (&priv->tr_snapshot));
+
+  return snapshot;
+}
+
+static void
+release_snapshot (GstRTSPStreamPrivate * priv, gint idx)
+{
+  g_atomic_pointer_set (&priv->tr_hazard[idx], NULL);
+}
+
+/* send @buffer or @buffer_list to all transports, called from the streaming
+ * thread of the appsink */
+static void
+send_to_transports (GstRTSPStream * stream, gboolean is_rtp,
+    GstBuffer * buffer, GstBufferList * buffer_list)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstRTSPTransportSnapshot *snapshot;
+  gint idx;
+  guint i;
+
+  idx = is_rtp ? 0 : 1;
+
+  snapshot = acquire_snapshot (priv, idx);
+  if (snapshot == NULL)
+    goto done;
+
+  for (i = 0; i < snapshot->n_transports; i++) {
+    GstRTSPStreamTransport *tr = snapshot->transports[i];
+
+    if (is_rtp) {
+      if (buffer)
+        gst_rtsp_stream_transport_send_rtp (tr, buffer);
+      else
+        gst_rtsp_stream_transport_send_rtp_list (tr, buffer_list);
+    } else {
+      if (buffer)
+        gst_rtsp_stream_transport_send_rtcp (tr, buffer);
+      else
+        gst_rtsp_stream_transport_send_rtcp_list (tr, buffer_list);
+    }
   }
+
+done:
+  release_snapshot (priv, idx);
 }
 
 static GstFlowReturn
 handle_new_sample (GstAppSink * sink, gpointer user_data)
 {
   GstRTSPStreamPrivate *priv;
-  GList *walk;
   GstSample *sample;
   GstBuffer *buffer;
   GstRTSPStream *stream;
@@ -1661,44 +2267,441 @@ handle_new_sample (GstAppSink * sink, gpointer user_data)
 
   is_rtp = GST_ELEMENT_CAST (sink) == priv->appsink[0];
 
-  g_mutex_lock (&priv->lock);
-  if (is_rtp) {
-    if (priv->tr_cache_cookie_rtp != priv->transports_cookie) {
-      clear_tr_cache (priv, is_rtp);
-      for (walk = priv->transports; walk; walk = g_list_next (walk)) {
-        GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
-        priv->tr_cache_rtp =
-            g_list_prepend (priv->tr_cache_rtp, g_object_ref (tr));
-      }
-      priv->tr_cache_cookie_rtp = priv->transports_cookie;
-    }
+  send_to_transports (stream, is_rtp, buffer, NULL);
+
+  gst_sample_unref (sample);
+
+  return GST_FLOW_OK;
+}
+
+/* appsink splits buffer lists into one sample per buffer. Catch the lists
+ * before they reach the appsink so that the transports can send all packets
+ * of the list in one go. */
+static GstPadProbeReturn
+handle_buffer_list (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstRTSPStream *stream = user_data;
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstElement *sink;
+  gboolean is_rtp;
+
+  sink = GST_ELEMENT_CAST (GST_OBJECT_PARENT (pad));
+
+  /* let the appsink handle prerolling */
+  if (GST_STATE (sink) != GST_STATE_PLAYING)
+    return GST_PAD_PROBE_OK;
+
+  is_rtp = sink == priv->appsink[0];
+
+  send_to_transports (stream, is_rtp, NULL,
+      GST_PAD_PROBE_INFO_BUFFER_LIST (info));
+
+  /* the list is consumed now */
+  return GST_PAD_PROBE_DROP;
+}
+
+/* count the data that goes to the UDP destinations. All UDP transports of the
+ * stream get the same data, the transports keep the counters of when they
+ * were added. */
+static GstPadProbeReturn
+handle_udp_stats (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstRTSPStream *stream = user_data;
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gsize packets, bytes;
+  gint idx;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    packets = 1;
+    bytes = gst_buffer_get_size (GST_PAD_PROBE_INFO_BUFFER (info));
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    packets = gst_buffer_list_length (list);
+    bytes = gst_rtsp_buffer_list_get_size (list);
   } else {
-    if (priv->tr_cache_cookie_rtcp != priv->transports_cookie) {
-      clear_tr_cache (priv, is_rtp);
-      for (walk = priv->transports; walk; walk = g_list_next (walk)) {
-        GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
-        priv->tr_cache_rtcp =
-            g_list_prepend (priv->tr_cache_rtcp, g_object_ref (tr));
-      }
-      priv->tr_cache_cookie_rtcp = priv->transports_cookie;
-    }
+    return GST_PAD_PROBE_OK;
   }
+
+  if (GST_ELEMENT_CAST (GST_PAD_PARENT (pad)) == priv->udpsink[0])
+    idx = GST_RTSP_TRANSPORT_STAT_RTP_PACKETS;
+  else
+    idx = GST_RTSP_TRANSPORT_STAT_RTCP_PACKETS;
+
+  /* the bytes counter follows the packets counter */
+  g_mutex_lock (&priv->udp_stats_lock);
+  priv->udp_counters[idx] += packets;
+  priv->udp_counters[idx + 1] += bytes;
+  g_mutex_unlock (&priv->udp_stats_lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* get the UDP counters of the stream and the packets dropped for @trans.
+ * Must be called with the lock */
+static void
+get_udp_stats (GstRTSPStreamPrivate * priv, GstRTSPStreamTransport * trans,
+    guint64 * udp)
+{
+  const GstRTSPTransport *tr;
+  guint64 dropped;
+  gint i;
+
+  g_mutex_lock (&priv->udp_stats_lock);
+  for (i = 0; i < GST_RTSP_TRANSPORT_STAT_DROPPED; i++)
+    udp[i] = priv->udp_counters[i];
+  g_mutex_unlock (&priv->udp_stats_lock);
+  udp[GST_RTSP_TRANSPORT_STAT_DROPPED] = 0;
+
+  tr = gst_rtsp_stream_transport_get_transport (trans);
+  if (tr->lower_transport != GST_RTSP_LOWER_TRANS_UDP || !priv->fanout[0])
+    return;
+
+  if (gst_rtsp_udp_fanout_get_dropped (priv->fanout[0], tr->destination,
+          tr->client_port.min, &dropped))
+    udp[GST_RTSP_TRANSPORT_STAT_DROPPED] += dropped;
+  if (gst_rtsp_udp_fanout_get_dropped (priv->fanout[1], tr->destination,
+          tr->client_port.max, &dropped))
+    udp[GST_RTSP_TRANSPORT_STAT_DROPPED] += dropped;
+}
+
+/* get when the ports of @stream were allocated, @start is 0 when the stream
+ * was not joined yet */
+void
+gst_rtsp_stream_get_alloc_time (GstRTSPStream * stream, gint64 * start,
+    gint64 * end)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  *start = priv->alloc_start;
+  *end = priv->alloc_end;
+  g_mutex_unlock (&priv->lock);
+}
+
+void
+gst_rtsp_stream_get_udp_stats (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, guint64 * udp)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  get_udp_stats (priv, trans, udp);
   g_mutex_unlock (&priv->lock);
+}
+
+typedef struct
+{
+  GstBuffer **buffers;
+  guint n_buffers;
+} FanoutListData;
+
+static gboolean
+collect_fanout_buffer (GstBuffer ** buffer, guint idx, FanoutListData * data)
+{
+  data->buffers[data->n_buffers++] = *buffer;
+  return TRUE;
+}
+
+/* send the data arriving at the udpsink to the UDP unicast destinations of the
+ * fanout. The data continues to the udpsink for the multicast destinations.
+ * Because the sink synchronizes the previous buffer before we get the next
+ * one, the fanout is paced like the udpsink, at most one buffer early. */
+static GstPadProbeReturn
+handle_fanout (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstRTSPUdpFanout *fanout = user_data;
+
+  /* destinations are only added for active transports so we can also send the
+   * preroll buffer */
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    gst_rtsp_udp_fanout_send (fanout, &buffer, 1);
+  } else if (info->type & GST_PAD_PROBE_TYPE_BUFFER_LIST) {
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+    FanoutListData data;
+
+    data.buffers = g_newa (GstBuffer *, gst_buffer_list_length (list));
+    data.n_buffers = 0;
+    gst_buffer_list_foreach (list, (GstBufferListFunc) collect_fanout_buffer,
+        &data);
+    gst_rtsp_udp_fanout_send (fanout, data.buffers, data.n_buffers);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+/* make fanouts that send on the sockets of the udpsinks, must be called with
+ * the lock */
+static void
+make_fanouts (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gint i;
+
+  if (priv->udp_send_mode == GST_RTSP_UDP_SEND_MODE_SINK)
+    return;
+
+  for (i = 0; i < 2; i++) {
+    GSocket *socket_v4 = NULL, *socket_v6 = NULL;
+    GstPad *pad;
+
+    if (priv->have_ipv4)
+      g_object_get (priv->udpsink[i], "socket", &socket_v4, NULL);
+    if (priv->have_ipv6)
+      g_object_get (priv->udpsink[i], "socket-v6", &socket_v6, NULL);
+
+    priv->fanout[i] = gst_rtsp_udp_fanout_new (socket_v4, socket_v6);
+    gst_rtsp_udp_fanout_set_gso (priv->fanout[i],
+        priv->udp_send_mode == GST_RTSP_UDP_SEND_MODE_FANOUT_GSO);
+
+    if (socket_v4)
+      g_object_unref (socket_v4);
+    if (socket_v6)
+      g_object_unref (socket_v6);
+
+    pad = gst_element_get_static_pad (priv->udpsink[i], "sink");
+    gst_pad_add_probe (pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        handle_fanout, priv->fanout[i], NULL);
+    gst_object_unref (pad);
+  }
+}
+
+typedef struct
+{
+  GstRTSPStreamPrivate *priv;
+  gint idx;
+  GSocket *socket_v4;
+  GSocket *socket_v6;
+} CryptoProbeData;
+
+static void
+free_crypto_probe_data (CryptoProbeData * data)
+{
+  if (data->socket_v4)
+    g_object_unref (data->socket_v4);
+  if (data->socket_v6)
+    g_object_unref (data->socket_v6);
+  g_slice_free (CryptoProbeData, data);
+}
+
+/* send the data arriving at the udpsink to the UDP unicast transports that
+ * encrypt the packets themselves. They are not added to the udpsink or the
+ * fanout. */
+static GstPadProbeReturn
+handle_transport_crypto (GstPad * pad, GstPadProbeInfo * info,
+    gpointer user_data)
+{
+  CryptoProbeData *data = user_data;
+  GstRTSPStreamPrivate *priv = data->priv;
+  GstRTSPTransportSnapshot *snapshot;
+  GstBufferList *list;
+  guint i;
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    list = gst_buffer_list_new_sized (1);
+    gst_buffer_list_add (list,
+        gst_buffer_ref (GST_PAD_PROBE_INFO_BUFFER (info)));
+  } else {
+    list = gst_buffer_list_ref (GST_PAD_PROBE_INFO_BUFFER_LIST (info));
+  }
+
+  snapshot = acquire_snapshot (priv, data->idx + 2);
+  for (i = 0; snapshot && i < snapshot->n_transports; i++) {
+    GstRTSPStreamTransport *tr = snapshot->transports[i];
+
+    if (gst_rtsp_stream_transport_get_transport (tr)->lower_transport !=
+        GST_RTSP_LOWER_TRANS_UDP || !gst_rtsp_stream_transport_has_crypto (tr))
+      continue;
+
+    gst_rtsp_stream_transport_send_udp (tr, data->idx == 0, list,
+        data->socket_v4, data->socket_v6);
+  }
+  release_snapshot (priv, data->idx + 2);
+  gst_buffer_list_unref (list);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* send the packets of the udpsinks to the transports with their own key, must
+ * be called with the lock */
+static void
+add_crypto_probes (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  gint i;
+
+  if (!priv->per_transport_keys)
+    return;
+
+  for (i = 0; i < 2; i++) {
+    CryptoProbeData *data;
+    GstPad *pad;
+
+    data = g_slice_new0 (CryptoProbeData);
+    data->priv = priv;
+    data->idx = i;
+    if (priv->have_ipv4)
+      g_object_get (priv->udpsink[i], "socket", &data->socket_v4, NULL);
+    if (priv->have_ipv6)
+      g_object_get (priv->udpsink[i], "socket-v6", &data->socket_v6, NULL);
+
+    pad = gst_element_get_static_pad (priv->udpsink[i], "sink");
+    gst_pad_add_probe (pad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        handle_transport_crypto, data,
+        (GDestroyNotify) free_crypto_probe_data);
+    gst_object_unref (pad);
+  }
+}
+
+/* must be called with the gop_lock */
+static void
+clear_gop (GstRTSPStreamPrivate * priv)
+{
+  GstBuffer *buffer;
+
+  while ((buffer = g_queue_pop_head (&priv->gop)))
+    gst_buffer_unref (buffer);
+  priv->gop_bytes = 0;
+}
+
+/* remember that the payloader got a keyframe, the next RTP packet starts a new
+ * GOP */
+static GstPadProbeReturn
+handle_gop_input (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstRTSPStreamPrivate *priv = user_data;
+  GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+  if (!GST_BUFFER_FLAG_IS_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT)) {
+    g_mutex_lock (&priv->gop_lock);
+    priv->gop_keyframe = TRUE;
+    g_mutex_unlock (&priv->gop_lock);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+cache_gop_buffer (GstBuffer ** buffer, guint idx, GstRTSPStreamPrivate * priv)
+{
+  priv->gop_bytes += gst_buffer_get_size (*buffer);
+  g_queue_push_tail (&priv->gop, gst_buffer_ref (*buffer));
+  return TRUE;
+}
 
-  if (is_rtp) {
-    for (walk = priv->tr_cache_rtp; walk; walk = g_list_next (walk)) {
-      GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
-      gst_rtsp_stream_transport_send_rtp (tr, buffer);
+/* collect the RTP packets from the session since the last keyframe */
+static GstPadProbeReturn
+handle_gop_output (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  GstRTSPStreamPrivate *priv = user_data;
+  GstBuffer *first;
+
+  if (info->type & GST_PAD_PROBE_TYPE_EVENT_FLUSH) {
+    if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) ==
+        GST_EVENT_FLUSH_STOP) {
+      g_mutex_lock (&priv->gop_lock);
+      clear_gop (priv);
+      priv->gop_valid = FALSE;
+      g_mutex_unlock (&priv->gop_lock);
     }
+    return GST_PAD_PROBE_OK;
+  }
+
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    first = GST_PAD_PROBE_INFO_BUFFER (info);
   } else {
-    for (walk = priv->tr_cache_rtcp; walk; walk = g_list_next (walk)) {
-      GstRTSPStreamTransport *tr = (GstRTSPStreamTransport *) walk->data;
-      gst_rtsp_stream_transport_send_rtcp (tr, buffer);
+    GstBufferList *list = GST_PAD_PROBE_INFO_BUFFER_LIST (info);
+
+    if (gst_buffer_list_length (list) == 0)
+      return GST_PAD_PROBE_OK;
+    first = gst_buffer_list_get (list, 0);
+  }
+
+  g_mutex_lock (&priv->gop_lock);
+  if (priv->gop_keyframe) {
+    GstEvent *event;
+
+    clear_gop (priv);
+    priv->gop_keyframe = FALSE;
+    priv->gop_valid = TRUE;
+    priv->gop_running_time = GST_CLOCK_TIME_NONE;
+
+    if ((event = gst_pad_get_sticky_event (pad, GST_EVENT_SEGMENT, 0))) {
+      GstSegment segment;
+
+      gst_event_copy_segment (event, &segment);
+      if (segment.format == GST_FORMAT_TIME)
+        priv->gop_running_time = gst_segment_to_running_time (&segment,
+            GST_FORMAT_TIME, GST_BUFFER_TIMESTAMP (first));
+      gst_event_unref (event);
     }
   }
-  gst_sample_unref (sample);
 
-  return GST_FLOW_OK;
+  if (priv->gop_valid) {
+    if (info->type & GST_PAD_PROBE_TYPE_BUFFER)
+      cache_gop_buffer (&first, 0, priv);
+    else
+      gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+          (GstBufferListFunc) cache_gop_buffer, priv);
+
+    if (priv->gop_bytes > GOP_CACHE_MAX_BYTES) {
+      GST_DEBUG ("GOP larger than %u bytes, not caching",
+          GOP_CACHE_MAX_BYTES);
+      clear_gop (priv);
+      priv->gop_valid = FALSE;
+    }
+  }
+  g_mutex_unlock (&priv->gop_lock);
+
+  return GST_PAD_PROBE_OK;
+}
+
+/* watch the keyframes going into the payloader and the packets coming out of
+ * the session, must be called with the lock */
+static void
+add_gop_probes (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  if (!priv->gop_cache || priv->srcpad == NULL)
+    return;
+
+  if (!(priv->gop_pad = gst_element_get_static_pad (priv->payloader, "sink"))) {
+    GST_WARNING ("payloader has no sink pad, can't find keyframes");
+    return;
+  }
+
+  priv->gop_probe[0] = gst_pad_add_probe (priv->gop_pad,
+      GST_PAD_PROBE_TYPE_BUFFER, handle_gop_input, priv, NULL);
+  priv->gop_probe[1] = gst_pad_add_probe (priv->send_src[0],
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST |
+      GST_PAD_PROBE_TYPE_EVENT_FLUSH, handle_gop_output, priv, NULL);
+}
+
+/* must be called with the lock */
+static void
+remove_gop_probes (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+
+  if (priv->gop_pad == NULL)
+    return;
+
+  gst_pad_remove_probe (priv->gop_pad, priv->gop_probe[0]);
+  gst_pad_remove_probe (priv->send_src[0], priv->gop_probe[1]);
+  gst_object_unref (priv->gop_pad);
+  priv->gop_pad = NULL;
+
+  g_mutex_lock (&priv->gop_lock);
+  clear_gop (priv);
+  priv->gop_keyframe = FALSE;
+  priv->gop_valid = FALSE;
+  g_mutex_unlock (&priv->gop_lock);
+
+  g_list_free_full (priv->gop_bursts, (GDestroyNotify) cancel_gop_burst);
+  priv->gop_bursts = NULL;
 }
 
 static GstAppSinkCallbacks sink_cb = {
@@ -2006,19 +3009,27 @@ gst_rtsp_stream_join_bin (GstRTSPStream * stream, GstBin * bin,
 
   GST_INFO ("stream %p joining bin as session %u", stream, idx);
 
+  priv->alloc_start = g_get_monotonic_time ();
+  priv->alloc_end = 0;
   if (!alloc_ports (stream))
     goto no_ports;
+  priv->alloc_end = g_get_monotonic_time ();
 
   /* update the dscp qos field in the sinks */
   update_dscp_qos (stream);
 
+  make_fanouts (stream);
+  add_crypto_probes (stream);
+
   if (priv->profiles & GST_RTSP_PROFILE_SAVP
       || priv->profiles & GST_RTSP_PROFILE_SAVPF) {
-    /* For SRTP */
-    g_signal_connect (rtpbin, "request-rtp-encoder",
-        (GCallback) request_rtp_encoder, stream);
-    g_signal_connect (rtpbin, "request-rtcp-encoder",
-        (GCallback) request_rtcp_encoder, stream);
+    /* For SRTP, the transports encrypt with per transport keys */
+    if (!priv->per_transport_keys) {
+      g_signal_connect (rtpbin, "request-rtp-encoder",
+          (GCallback) request_rtp_encoder, stream);
+      g_signal_connect (rtpbin, "request-rtcp-encoder",
+          (GCallback) request_rtcp_encoder, stream);
+    }
     g_signal_connect (rtpbin, "request-rtp-decoder",
         (GCallback) request_rtp_rtcp_decoder, stream);
     g_signal_connect (rtpbin, "request-rtcp-decoder",
@@ -2103,6 +3114,9 @@ gst_rtsp_stream_join_bin (GstRTSPStream * stream, GstBin * bin,
     /* add udpsink */
     gst_bin_add (bin, priv->udpsink[i]);
     sinkpad = gst_element_get_static_pad (priv->udpsink[i], "sink");
+    gst_pad_add_probe (sinkpad,
+        GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+        handle_udp_stats, stream, NULL);
 
     if (priv->protocols & GST_RTSP_LOWER_TRANS_TCP) {
       /* make tee for RTP/RTCP */
@@ -2152,6 +3166,8 @@ gst_rtsp_stream_join_bin (GstRTSPStream * stream, GstBin * bin,
       /* and link to queue */
       queuepad = gst_element_get_static_pad (priv->appqueue[i], "src");
       pad = gst_element_get_static_pad (priv->appsink[i], "sink");
+      gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER_LIST,
+          handle_buffer_list, stream, NULL);
       gst_pad_link (queuepad, pad);
       gst_object_unref (pad);
       gst_object_unref (queuepad);
@@ -2248,6 +3264,8 @@ gst_rtsp_stream_join_bin (GstRTSPStream * stream, GstBin * bin,
     }
   }
 
+  add_gop_probes (stream);
+
   /* be notified of caps changes */
   priv->caps_sig = g_signal_connect (priv->send_src[0], "notify::caps",
       (GCallback) caps_notify, stream);
@@ -2311,9 +3329,6 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
   if (priv->transports != NULL)
     goto transports_not_removed;
 
-  clear_tr_cache (priv, TRUE);
-  clear_tr_cache (priv, FALSE);
-
   GST_INFO ("stream %p leaving bin", stream);
 
   if (priv->srcpad) {
@@ -2324,6 +3339,7 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
     priv->recv_rtp_src = NULL;
   }
   g_signal_handler_disconnect (priv->send_src[0], priv->caps_sig);
+  remove_gop_probes (stream);
   gst_element_release_request_pad (rtpbin, priv->send_rtp_sink);
   gst_object_unref (priv->send_rtp_sink);
   priv->send_rtp_sink = NULL;
@@ -2358,7 +3374,7 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
     }
 
     for (l = priv->transport_sources; l; l = l->next) {
-      GstRTSPMulticastTransportSource *s = l->data;
+      GstRTSPTransportSource *s = l->data;
 
       if (!s->udpsrc[i])
         continue;
@@ -2367,6 +3383,12 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
       gst_element_set_state (s->udpsrc[i], GST_STATE_NULL);
       gst_bin_remove (bin, s->udpsrc[i]);
     }
+    for (l = priv->removed_sources; l; l = l->next) {
+      GstRTSPTransportSource *s = l->data;
+
+      gst_element_set_state (s->udpsrc[i], GST_STATE_NULL);
+      gst_bin_remove (bin, s->udpsrc[i]);
+    }
 
     if (priv->udpsink[i])
       gst_bin_remove (bin, priv->udpsink[i]);
@@ -2398,12 +3420,28 @@ gst_rtsp_stream_leave_bin (GstRTSPStream * stream, GstBin * bin,
     priv->funnel[i] = NULL;
   }
 
+  /* the streaming threads are stopped now, free all snapshots */
+  replace_snapshot (priv, NULL);
+  reclaim_snapshots (priv, TRUE);
+
+  for (i = 0; i < 2; i++) {
+    if (priv->fanout[i])
+      gst_rtsp_udp_fanout_free (priv->fanout[i]);
+    priv->fanout[i] = NULL;
+  }
+
   for (l = priv->transport_sources; l; l = l->next) {
-    GstRTSPMulticastTransportSource *s = l->data;
-    g_slice_free (GstRTSPMulticastTransportSource, s);
+    GstRTSPTransportSource *s = l->data;
+    g_slice_free (GstRTSPTransportSource, s);
   }
   g_list_free (priv->transport_sources);
   priv->transport_sources = NULL;
+  for (l = priv->removed_sources; l; l = l->next) {
+    GstRTSPTransportSource *s = l->data;
+    g_slice_free (GstRTSPTransportSource, s);
+  }
+  g_list_free (priv->removed_sources);
+  priv->removed_sources = NULL;
 
   gst_object_unref (priv->send_src[0]);
   priv->send_src[0] = NULL;
@@ -2441,8 +3479,76 @@ transports_not_removed:
   }
 }
 
-/**
- * gst_rtsp_stream_get_rtpinfo:
+/* the other receivers of a multicast group would get the cached packets
+ * again, only unicast transports get the cached GOP */
+static gboolean
+transport_wants_gop (GstRTSPStreamTransport * trans)
+{
+  const GstRTSPTransport *tr = gst_rtsp_stream_transport_get_transport (trans);
+
+  return tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP ||
+      tr->lower_transport == GST_RTSP_LOWER_TRANS_TCP;
+}
+
+static GopBurst *
+find_gop_burst (GstRTSPStreamPrivate * priv, GstRTSPStreamTransport * trans)
+{
+  GList *walk;
+
+  for (walk = priv->gop_bursts; walk; walk = g_list_next (walk)) {
+    GopBurst *burst = walk->data;
+
+    if (burst->trans == trans)
+      return burst;
+  }
+  return NULL;
+}
+
+/* take the cached GOP for @trans if it isn't added yet. The RTP-Info of @trans
+ * and the packets that are sent to it when it is added both start with the
+ * first packet of it. must be called with the lock */
+static GopBurst *
+get_gop_burst (GstRTSPStreamPrivate * priv, GstRTSPStreamTransport * trans)
+{
+  GstRTPBuffer rtp_buffer = GST_RTP_BUFFER_INIT;
+  GopBurst *burst;
+  GstBuffer *head;
+  GList *l;
+
+  if ((burst = find_gop_burst (priv, trans)))
+    return burst;
+
+  if (priv->gop_pad == NULL || !transport_wants_gop (trans) ||
+      g_list_find (priv->transports, trans))
+    return NULL;
+
+  g_mutex_lock (&priv->gop_lock);
+  head = g_queue_peek_head (&priv->gop);
+  if (head == NULL || !gst_rtp_buffer_map (head, GST_MAP_READ, &rtp_buffer)) {
+    g_mutex_unlock (&priv->gop_lock);
+    return NULL;
+  }
+
+  burst = g_new0 (GopBurst, 1);
+  burst->refcount = 1;
+  burst->trans = g_object_ref (trans);
+  burst->seq = gst_rtp_buffer_get_seq (&rtp_buffer);
+  burst->rtptime = gst_rtp_buffer_get_timestamp (&rtp_buffer);
+  burst->running_time = priv->gop_running_time;
+  gst_rtp_buffer_unmap (&rtp_buffer);
+
+  burst->list = gst_buffer_list_new_sized (priv->gop.length);
+  for (l = priv->gop.head; l; l = l->next)
+    gst_buffer_list_add (burst->list, gst_buffer_ref (l->data));
+  g_mutex_unlock (&priv->gop_lock);
+
+  priv->gop_bursts = g_list_prepend (priv->gop_bursts, burst);
+
+  return burst;
+}
+
+/**
+ * gst_rtsp_stream_get_rtpinfo:
  * @stream: a #GstRTSPStream
  * @rtptime: (allow-none): result RTP timestamp
  * @seq: (allow-none): result RTP seqnum
@@ -2576,6 +3682,47 @@ no_stats:
   }
 }
 
+/* like gst_rtsp_stream_get_rtpinfo() but for the packets that are sent to
+ * @trans, which start with the cached GOP when @trans is added later */
+gboolean
+gst_rtsp_stream_get_transport_rtpinfo (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans, guint * rtptime, guint * seq,
+    guint * clock_rate, GstClockTime * running_time)
+{
+  GstRTSPStreamPrivate *priv;
+  GopBurst *burst = NULL;
+  gint rate = 0;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
+  g_return_val_if_fail (GST_IS_RTSP_STREAM_TRANSPORT (trans), FALSE);
+
+  priv = stream->priv;
+
+  g_mutex_lock (&priv->lock);
+  if (priv->caps)
+    gst_structure_get_int (gst_caps_get_structure (priv->caps, 0),
+        "clock-rate", &rate);
+  if (rate != 0)
+    burst = get_gop_burst (priv, trans);
+  if (burst == NULL) {
+    g_mutex_unlock (&priv->lock);
+    return gst_rtsp_stream_get_rtpinfo (stream, rtptime, seq, clock_rate,
+        running_time);
+  }
+
+  if (rtptime)
+    *rtptime = burst->rtptime;
+  if (seq)
+    *seq = burst->seq;
+  if (clock_rate)
+    *clock_rate = rate;
+  if (running_time)
+    *running_time = burst->running_time;
+  g_mutex_unlock (&priv->lock);
+
+  return TRUE;
+}
+
 /**
  * gst_rtsp_stream_get_caps:
  * @stream: a #GstRTSPStream
@@ -2737,6 +3884,303 @@ gst_rtsp_stream_recv_rtcp (GstRTSPStream * stream, GstBuffer * buffer)
   return ret;
 }
 
+/* add @trans to or remove it from the RTCP origin index after it was added
+ * to or removed from the list of transports. The keys that were inserted
+ * are kept on @trans, its client ports can change with a new SETUP while it
+ * is added. Must be called with lock */
+static void
+index_transport (GstRTSPStreamPrivate * priv, GstRTSPStreamTransport * trans,
+    gboolean add)
+{
+  gchar **keys;
+  gint i;
+
+  if (add) {
+    const GstRTSPTransport *tr;
+
+    tr = gst_rtsp_stream_transport_get_transport (trans);
+    if (tr->destination == NULL)
+      return;
+
+    keys = g_new0 (gchar *, 3);
+    keys[0] = g_strdup_printf ("%s:%d", tr->destination, tr->client_port.min);
+    keys[1] = g_strdup_printf ("%s:%d", tr->destination, tr->client_port.max);
+
+    /* the newest transport wins, like the lookup in the list used to */
+    for (i = 0; i < 2; i++)
+      g_hash_table_insert (priv->transport_index, g_strdup (keys[i]),
+          g_object_ref (trans));
+
+    g_object_set_qdata_full (G_OBJECT (trans), index_keys_key, keys,
+        (GDestroyNotify) g_strfreev);
+    return;
+  }
+
+  keys = g_object_steal_qdata (G_OBJECT (trans), index_keys_key);
+  if (keys == NULL)
+    return;
+
+  for (i = 0; keys[i]; i++) {
+    GList *walk;
+
+    if (g_hash_table_lookup (priv->transport_index, keys[i]) != trans)
+      continue;
+
+    g_hash_table_remove (priv->transport_index, keys[i]);
+
+    /* another transport could use the same address and port */
+    for (walk = priv->transports; walk; walk = g_list_next (walk)) {
+      GstRTSPStreamTransport *other = walk->data;
+      gchar **other_keys;
+
+      other_keys = g_object_get_qdata (G_OBJECT (other), index_keys_key);
+      if (other_keys && (!strcmp (other_keys[0], keys[i]) ||
+              !strcmp (other_keys[1], keys[i]))) {
+        g_hash_table_insert (priv->transport_index, g_strdup (keys[i]),
+            g_object_ref (other));
+        break;
+      }
+    }
+  }
+  g_strfreev (keys);
+}
+
+/* the packets that were cached after @last, all of the cached GOP when a new
+ * one started since. must be called with the gop_lock */
+static GstBufferList *
+get_gop_since (GstRTSPStreamPrivate * priv, GstBuffer * last)
+{
+  GstBufferList *list;
+  GList *l;
+
+  for (l = priv->gop.tail; l; l = l->prev) {
+    if (l->data == last)
+      break;
+  }
+  l = l ? l->next : priv->gop.head;
+
+  list = gst_buffer_list_new ();
+  for (; l; l = l->next)
+    gst_buffer_list_add (list, gst_buffer_ref (l->data));
+
+  return list;
+}
+
+/* receive the packets of @trans with the elements in @udpsrc, must be called
+ * with the lock */
+static void
+add_transport_source (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
+    GstElement * udpsrc[2])
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstRTSPTransportSource *source;
+  GstBin *bin;
+  GstPad *selpad, *pad;
+  gint i;
+
+  bin = GST_BIN (gst_object_get_parent (GST_OBJECT (priv->funnel[0])));
+
+  source = g_slice_new0 (GstRTSPTransportSource);
+  source->transport = trans;
+
+  for (i = 0; i < 2; i++) {
+    source->udpsrc[i] = udpsrc[i];
+
+    if (priv->srcpad) {
+      /* we set and keep these to playing so that they don't cause NO_PREROLL return
+       * values. This is only relevant for PLAY pipelines */
+      gst_element_set_state (source->udpsrc[i], GST_STATE_PLAYING);
+      gst_element_set_locked_state (source->udpsrc[i], TRUE);
+    }
+    /* add udpsrc */
+    gst_bin_add (bin, source->udpsrc[i]);
+    if (!priv->srcpad)
+      gst_element_sync_state_with_parent (source->udpsrc[i]);
+
+    /* and link to the funnel */
+    source->selpad[i] = selpad =
+        gst_element_get_request_pad (priv->funnel[i], "sink_%u");
+    pad = gst_element_get_static_pad (source->udpsrc[i], "src");
+    gst_pad_link (pad, selpad);
+    gst_object_unref (pad);
+    gst_object_unref (selpad);
+  }
+  gst_object_unref (bin);
+
+  priv->transport_sources = g_list_prepend (priv->transport_sources, source);
+}
+
+/* take the sources of @trans out of the list of sources. Setting a udpsrc
+ * to NULL waits for its streaming thread, which can need the lock for the
+ * RTCP it received, so they are stopped in free_removed_sources() after the
+ * lock is released. Must be called with the lock */
+static void
+remove_transport_source (GstRTSPStream * stream,
+    GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GList *l;
+
+  for (l = priv->transport_sources; l; l = l->next) {
+    GstRTSPTransportSource *source = l->data;
+
+    if (source->transport == trans) {
+      priv->transport_sources = g_list_remove_link (priv->transport_sources, l);
+      priv->removed_sources = g_list_concat (l, priv->removed_sources);
+      break;
+    }
+  }
+}
+
+/* stop and remove the sources taken out by remove_transport_source(), must
+ * be called without the lock */
+static void
+free_removed_sources (GstRTSPStream * stream)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstElement *funnel[2] = { NULL, NULL };
+  GstBin *bin = NULL;
+  GList *sources, *l;
+  gint i;
+
+  g_mutex_lock (&priv->lock);
+  sources = priv->removed_sources;
+  priv->removed_sources = NULL;
+  if (sources) {
+    bin = GST_BIN (gst_object_get_parent (GST_OBJECT (priv->funnel[0])));
+    for (i = 0; i < 2; i++)
+      funnel[i] = gst_object_ref (priv->funnel[i]);
+  }
+  g_mutex_unlock (&priv->lock);
+
+  if (sources == NULL)
+    return;
+
+  for (l = sources; l; l = l->next) {
+    GstRTSPTransportSource *source = l->data;
+
+    for (i = 0; i < 2; i++) {
+      gst_element_set_state (source->udpsrc[i], GST_STATE_NULL);
+      /* Will automatically unlink everything */
+      gst_bin_remove (bin, source->udpsrc[i]);
+
+      gst_element_release_request_pad (funnel[i], source->selpad[i]);
+    }
+    g_slice_free (GstRTSPTransportSource, source);
+  }
+  g_list_free (sources);
+
+  for (i = 0; i < 2; i++)
+    gst_object_unref (funnel[i]);
+  gst_object_unref (bin);
+}
+
+/* make a socket on the address of @shared that is connected to @iaddr:@port */
+static GSocket *
+make_connected_socket (GSocket * shared, GInetAddress * iaddr, gint port)
+{
+  GSocket *socket = NULL;
+  GSocketAddress *local = NULL, *remote;
+  GError *err = NULL;
+
+  remote = g_inet_socket_address_new (iaddr, port);
+
+  if (!(local = g_socket_get_local_address (shared, &err)))
+    goto failed;
+
+  socket = g_socket_new (g_socket_get_family (shared), G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, &err);
+  if (socket == NULL)
+    goto failed;
+
+  if (!set_reuse_port (socket))
+    goto failed;
+
+  if (!g_socket_bind (socket, local, FALSE, &err))
+    goto failed;
+
+  if (!g_socket_connect (socket, remote, NULL, &err))
+    goto failed;
+
+  g_object_unref (local);
+  g_object_unref (remote);
+
+  return socket;
+
+  /* ERRORS */
+failed:
+  {
+    GST_WARNING ("could not make a connected socket: %s",
+        err ? err->message : "no SO_REUSEPORT");
+    g_clear_error (&err);
+    if (socket)
+      g_object_unref (socket);
+    if (local)
+      g_object_unref (local);
+    g_object_unref (remote);
+    return NULL;
+  }
+}
+
+/* receive from the client of a UDP unicast transport on connected sockets, so
+ * that the kernel demuxes the clients and each one is handled by the thread of
+ * its own udpsrc. When this is not possible, the packets keep arriving on the
+ * shared sockets. Must be called with the lock */
+static void
+add_connected_source (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstRTSPTransport *tr;
+  GstElement *udpsrc[2] = { NULL, NULL };
+  GInetAddress *iaddr;
+  gint i;
+
+  tr = gst_rtsp_stream_transport_get_transport (trans);
+
+  if (!(iaddr = g_inet_address_new_from_string (tr->destination)))
+    return;
+
+  for (i = 0; i < 2; i++) {
+    GstElement *shared_src;
+    GSocket *shared = NULL, *socket = NULL;
+
+    if (g_inet_address_get_family (iaddr) == G_SOCKET_FAMILY_IPV6)
+      shared_src = priv->udpsrc_v6[i];
+    else
+      shared_src = priv->udpsrc_v4[i];
+
+    if (shared_src)
+      g_object_get (shared_src, "socket", &shared, NULL);
+    if (shared) {
+      socket = make_connected_socket (shared, iaddr,
+          i == 0 ? tr->client_port.min : tr->client_port.max);
+      g_object_unref (shared);
+    }
+    if (socket == NULL)
+      goto no_socket;
+
+    udpsrc[i] = gst_element_factory_make ("udpsrc", NULL);
+    g_object_set (udpsrc[i], "socket", socket, NULL);
+    g_object_unref (socket);
+  }
+  g_object_unref (iaddr);
+
+  GST_INFO ("receiving from %s:%d-%d on connected sockets", tr->destination,
+      tr->client_port.min, tr->client_port.max);
+  add_transport_source (stream, trans, udpsrc);
+
+  return;
+
+  /* ERRORS */
+no_socket:
+  {
+    if (udpsrc[0])
+      gst_object_unref (gst_object_ref_sink (udpsrc[0]));
+    g_object_unref (iaddr);
+    return;
+  }
+}
+
 /* must be called with lock */
 static gboolean
 update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
@@ -2750,78 +4194,21 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
   switch (tr->lower_transport) {
     case GST_RTSP_LOWER_TRANS_UDP_MCAST:
     {
-      GstRTSPMulticastTransportSource *source;
-      GstBin *bin;
-
-      bin = GST_BIN (gst_object_get_parent (GST_OBJECT (priv->funnel[0])));
-
       if (add) {
+        GstElement *udpsrc[2];
         gchar *host;
         gint i;
-        GstPad *selpad, *pad;
-
-        source = g_slice_new0 (GstRTSPMulticastTransportSource);
-        source->transport = trans;
 
         for (i = 0; i < 2; i++) {
           host =
               g_strdup_printf ("udp://%s:%d", tr->destination,
               (i == 0) ? tr->port.min : tr->port.max);
-          source->udpsrc[i] =
-              gst_element_make_from_uri (GST_URI_SRC, host, NULL, NULL);
+          udpsrc[i] = gst_element_make_from_uri (GST_URI_SRC, host, NULL, NULL);
           g_free (host);
-
-          if (priv->srcpad) {
-            /* we set and keep these to playing so that they don't cause NO_PREROLL return
-             * values. This is only relevant for PLAY pipelines */
-            gst_element_set_state (source->udpsrc[i], GST_STATE_PLAYING);
-            gst_element_set_locked_state (source->udpsrc[i], TRUE);
-          }
-          /* add udpsrc */
-          gst_bin_add (bin, source->udpsrc[i]);
-
-          /* and link to the funnel v4 */
-          source->selpad[i] = selpad =
-              gst_element_get_request_pad (priv->funnel[i], "sink_%u");
-          pad = gst_element_get_static_pad (source->udpsrc[i], "src");
-          gst_pad_link (pad, selpad);
-          gst_object_unref (pad);
-          gst_object_unref (selpad);
         }
-        gst_object_unref (bin);
-
-        priv->transport_sources =
-            g_list_prepend (priv->transport_sources, source);
+        add_transport_source (stream, trans, udpsrc);
       } else {
-        GList *l;
-
-        for (l = priv->transport_sources; l; l = l->next) {
-          source = l->data;
-
-          if (source->transport == trans) {
-            priv->transport_sources =
-                g_list_delete_link (priv->transport_sources, l);
-            break;
-          }
-        }
-
-        if (l != NULL) {
-          gint i;
-
-          for (i = 0; i < 2; i++) {
-            /* Will automatically unlink everything */
-            gst_bin_remove (bin,
-                GST_ELEMENT (gst_object_ref (source->udpsrc[i])));
-
-            gst_element_set_state (source->udpsrc[i], GST_STATE_NULL);
-            gst_object_unref (source->udpsrc[i]);
-
-            gst_element_release_request_pad (priv->funnel[i],
-                source->selpad[i]);
-          }
-
-          g_slice_free (GstRTSPMulticastTransportSource, source);
-        }
+        remove_transport_source (stream, trans);
       }
 
       /* fall through for the generic case */
@@ -2831,6 +4218,16 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
       gchar *dest;
       gint min, max;
       guint ttl = 0;
+      guint64 udp[GST_RTSP_TRANSPORT_STAT_LAST];
+      gboolean own_crypto;
+
+      /* the transport sends the packets that it encrypted itself */
+      own_crypto = priv->per_transport_keys &&
+          tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP &&
+          gst_rtsp_stream_transport_has_crypto (trans);
+
+      /* before the transport is removed from the fanout */
+      get_udp_stats (priv, trans, udp);
 
       dest = tr->destination;
       if (tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP_MCAST) {
@@ -2848,17 +4245,46 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
           g_object_set (G_OBJECT (priv->udpsink[0]), "ttl-mc", ttl, NULL);
           g_object_set (G_OBJECT (priv->udpsink[1]), "ttl-mc", ttl, NULL);
         }
-        GST_INFO ("adding %s:%d-%d", dest, min, max);
-        g_signal_emit_by_name (priv->udpsink[0], "add", dest, min, NULL);
-        g_signal_emit_by_name (priv->udpsink[1], "add", dest, max, NULL);
+        if (priv->connected_udp &&
+            tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP)
+          add_connected_source (stream, trans);
+
+        if (own_crypto) {
+          GST_INFO ("adding %s:%d-%d with own key", dest, min, max);
+        } else if (tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP
+            && priv->fanout[0]
+            && gst_rtsp_udp_fanout_add (priv->fanout[0], dest, min)) {
+          GST_INFO ("adding %s:%d-%d to fanout", dest, min, max);
+          gst_rtsp_udp_fanout_add (priv->fanout[1], dest, max);
+        } else {
+          GST_INFO ("adding %s:%d-%d", dest, min, max);
+          g_signal_emit_by_name (priv->udpsink[0], "add", dest, min, NULL);
+          g_signal_emit_by_name (priv->udpsink[1], "add", dest, max, NULL);
+        }
         priv->transports = g_list_prepend (priv->transports, trans);
       } else {
-        GST_INFO ("removing %s:%d-%d", dest, min, max);
-        g_signal_emit_by_name (priv->udpsink[0], "remove", dest, min, NULL);
-        g_signal_emit_by_name (priv->udpsink[1], "remove", dest, max, NULL);
+        if (tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP)
+          remove_transport_source (stream, trans);
+
+        if (own_crypto) {
+          GST_INFO ("removing %s:%d-%d with own key", dest, min, max);
+        } else if (tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP
+            && priv->fanout[0]
+            && gst_rtsp_udp_fanout_remove (priv->fanout[0], dest, min)) {
+          GST_INFO ("removing %s:%d-%d from fanout", dest, min, max);
+          gst_rtsp_udp_fanout_remove (priv->fanout[1], dest, max);
+        } else {
+          GST_INFO ("removing %s:%d-%d", dest, min, max);
+          g_signal_emit_by_name (priv->udpsink[0], "remove", dest, min, NULL);
+          g_signal_emit_by_name (priv->udpsink[1], "remove", dest, max, NULL);
+        }
         priv->transports = g_list_remove (priv->transports, trans);
       }
+      index_transport (priv, trans, add);
+      if (!own_crypto)
+        gst_rtsp_stream_transport_set_udp_stats (trans, udp, add);
       priv->transports_cookie++;
+      update_snapshot (priv);
       break;
     }
     case GST_RTSP_LOWER_TRANS_TCP:
@@ -2870,6 +4296,7 @@ update_transport (GstRTSPStream * stream, GstRTSPStreamTransport * trans,
         priv->transports = g_list_remove (priv->transports, trans);
       }
       priv->transports_cookie++;
+      update_snapshot (priv);
       break;
     default:
       goto unknown_transport;
@@ -2885,6 +4312,189 @@ unknown_transport:
 }
 
 
+static void
+send_gop_udp (GopBurst * burst, GstBuffer * buffer)
+{
+  GstMapInfo map;
+  GError *err = NULL;
+
+  if (burst->encrypted) {
+    GstBufferList *list = gst_buffer_list_new_sized (1);
+
+    gst_buffer_list_add (list, gst_buffer_ref (buffer));
+    gst_rtsp_stream_transport_send_udp (burst->trans, TRUE, list,
+        burst->socket_v4, burst->socket_v6);
+    gst_buffer_list_unref (list);
+    return;
+  }
+
+  if (!gst_buffer_map (buffer, &map, GST_MAP_READ))
+    return;
+
+  if (g_socket_send_to (burst->socket, burst->addr, (const gchar *) map.data,
+          map.size, NULL, &err) < 0) {
+    GST_LOG ("failed to send GOP packet: %s", err->message);
+    g_clear_error (&err);
+  }
+  gst_buffer_unmap (buffer, &map);
+}
+
+/* send the packets of @burst that GOP_BURST_RATE allows for by now, at least
+ * one of them, and never more than the UDP socket takes without blocking.
+ * Returns TRUE when all of them were sent */
+static gboolean
+send_gop (GopBurst * burst)
+{
+  GstBufferList *chunk = NULL;
+  guint64 budget;
+  guint n = 0, len;
+
+  len = gst_buffer_list_length (burst->list);
+  budget = gst_util_uint64_scale (g_get_monotonic_time () - burst->start,
+      GOP_BURST_RATE, G_USEC_PER_SEC);
+
+  while (burst->pos < len) {
+    GstBuffer *buffer = gst_buffer_list_get (burst->list, burst->pos);
+    gsize size = gst_buffer_get_size (buffer);
+
+    if (n > 0 && burst->bytes + size > budget)
+      break;
+
+    if (burst->socket) {
+      if (!g_socket_condition_check (burst->socket, G_IO_OUT))
+        break;
+      send_gop_udp (burst, buffer);
+    } else {
+      if (chunk == NULL)
+        chunk = gst_buffer_list_new ();
+      gst_buffer_list_add (chunk, gst_buffer_ref (buffer));
+    }
+    burst->bytes += size;
+    burst->pos++;
+    n++;
+  }
+
+  if (chunk) {
+    gst_rtsp_stream_transport_send_rtp_list (burst->trans, chunk);
+    gst_buffer_list_unref (chunk);
+  }
+
+  return burst->pos == len;
+}
+
+/* send the cached GOP to the transport of @burst without the locks, then the
+ * packets that were cached meanwhile. The transport is added with the locks
+ * once only a few of them are left, the packets that are cached from then on
+ * are sent to it with the others */
+static gboolean
+dispatch_gop_burst (GopBurst * burst)
+{
+  GstRTSPStream *stream = burst->stream;
+  GstRTSPStreamPrivate *priv = stream->priv;
+  GstBufferList *list;
+  GstBuffer *last;
+  guint len;
+
+  if (!send_gop (burst))
+    return G_SOURCE_CONTINUE;
+
+  if (burst->added)
+    goto done;
+
+  len = gst_buffer_list_length (burst->list);
+  last = len > 0 ? gst_buffer_list_get (burst->list, len - 1) : NULL;
+
+  g_mutex_lock (&priv->lock);
+  if (g_source_is_destroyed (burst->source)) {
+    g_mutex_unlock (&priv->lock);
+    return G_SOURCE_REMOVE;
+  }
+  g_mutex_lock (&priv->gop_lock);
+  list = get_gop_since (priv, last);
+  if (gst_buffer_list_length (list) <= GOP_BURST_CHUNK ||
+      ++burst->rounds >= GOP_BURST_ROUNDS) {
+    GST_DEBUG ("adding transport, %u cached packets to go",
+        gst_buffer_list_length (list));
+    update_transport (stream, burst->trans, TRUE);
+    burst->added = TRUE;
+  }
+  g_mutex_unlock (&priv->gop_lock);
+  g_mutex_unlock (&priv->lock);
+
+  if (burst->added)
+    free_removed_sources (stream);
+
+  gst_buffer_list_unref (burst->list);
+  burst->list = list;
+  burst->pos = 0;
+
+  if (!send_gop (burst))
+    return G_SOURCE_CONTINUE;
+  if (!burst->added)
+    return G_SOURCE_CONTINUE;
+
+done:
+  g_mutex_lock (&priv->lock);
+  if (g_list_find (priv->gop_bursts, burst)) {
+    priv->gop_bursts = g_list_remove (priv->gop_bursts, burst);
+    gop_burst_unref (burst);
+  }
+  g_mutex_unlock (&priv->lock);
+
+  return G_SOURCE_REMOVE;
+}
+
+/* start sending the cached GOP of @burst from the main context of the caller,
+ * must be called with the lock */
+static gboolean
+start_gop_burst (GstRTSPStream * stream, GopBurst * burst)
+{
+  GstRTSPStreamPrivate *priv = stream->priv;
+  const GstRTSPTransport *tr;
+  GMainContext *context = NULL;
+  GSource *source;
+
+  tr = gst_rtsp_stream_transport_get_transport (burst->trans);
+  if (tr->lower_transport == GST_RTSP_LOWER_TRANS_UDP) {
+    GInetAddress *iaddr;
+
+    if (!(iaddr = g_inet_address_new_from_string (tr->destination)))
+      return FALSE;
+
+    if (priv->udpsink[0] && priv->have_ipv4)
+      g_object_get (priv->udpsink[0], "socket", &burst->socket_v4, NULL);
+    if (priv->udpsink[0] && priv->have_ipv6)
+      g_object_get (priv->udpsink[0], "socket-v6", &burst->socket_v6, NULL);
+    if (g_inet_address_get_family (iaddr) == G_SOCKET_FAMILY_IPV6)
+      burst->socket = burst->socket_v6;
+    else
+      burst->socket = burst->socket_v4;
+    burst->encrypted = priv->per_transport_keys &&
+        gst_rtsp_stream_transport_has_crypto (burst->trans);
+    if (burst->socket)
+      burst->addr = g_inet_socket_address_new (iaddr, tr->client_port.min);
+    g_object_unref (iaddr);
+
+    if (burst->socket == NULL)
+      return FALSE;
+  }
+
+  GST_DEBUG ("sending %u cached packets to %s",
+      gst_buffer_list_length (burst->list), tr->destination);
+
+  if ((source = g_main_current_source ()))
+    context = g_source_get_context (source);
+
+  burst->stream = g_object_ref (stream);
+  burst->start = g_get_monotonic_time ();
+  burst->source = g_timeout_source_new (GOP_BURST_INTERVAL);
+  g_source_set_callback (burst->source, (GSourceFunc) dispatch_gop_burst,
+      gop_burst_ref (burst), (GDestroyNotify) gop_burst_unref);
+  g_source_attach (burst->source, context);
+
+  return TRUE;
+}
+
 /**
  * gst_rtsp_stream_add_transport:
  * @stream: a #GstRTSPStream
@@ -2893,6 +4503,9 @@ unknown_transport:
  * Add the transport in @trans to @stream. The media of @stream will
  * then also be send to the values configured in @trans.
  *
+ * When @stream caches GOPs, the cached packets are first sent to @trans from
+ * the main context of the caller and @trans is added after them.
+ *
  * @stream must be joined to a bin.
  *
  * @trans must contain a valid #GstRTSPTransport.
@@ -2904,6 +4517,7 @@ gst_rtsp_stream_add_transport (GstRTSPStream * stream,
     GstRTSPStreamTransport * trans)
 {
   GstRTSPStreamPrivate *priv;
+  GopBurst *burst;
   gboolean res;
 
   g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
@@ -2912,9 +4526,21 @@ gst_rtsp_stream_add_transport (GstRTSPStream * stream,
   g_return_val_if_fail (priv->is_joined, FALSE);
 
   g_mutex_lock (&priv->lock);
-  res = update_transport (stream, trans, TRUE);
+  if ((burst = get_gop_burst (priv, trans)) && burst->source == NULL &&
+      start_gop_burst (stream, burst)) {
+    /* @trans is added by the source after the cached GOP */
+    res = TRUE;
+  } else {
+    if (burst && burst->source == NULL) {
+      priv->gop_bursts = g_list_remove (priv->gop_bursts, burst);
+      gop_burst_unref (burst);
+    }
+    res = update_transport (stream, trans, TRUE);
+  }
   g_mutex_unlock (&priv->lock);
 
+  free_removed_sources (stream);
+
   return res;
 }
 
@@ -2937,6 +4563,7 @@ gst_rtsp_stream_remove_transport (GstRTSPStream * stream,
     GstRTSPStreamTransport * trans)
 {
   GstRTSPStreamPrivate *priv;
+  GopBurst *burst;
   gboolean res;
 
   g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), FALSE);
@@ -2945,9 +4572,15 @@ gst_rtsp_stream_remove_transport (GstRTSPStream * stream,
   g_return_val_if_fail (priv->is_joined, FALSE);
 
   g_mutex_lock (&priv->lock);
+  if ((burst = find_gop_burst (priv, trans))) {
+    priv->gop_bursts = g_list_remove (priv->gop_bursts, burst);
+    cancel_gop_burst (burst);
+  }
   res = update_transport (stream, trans, FALSE);
   g_mutex_unlock (&priv->lock);
 
+  free_removed_sources (stream);
+
   return res;
 }
 
@@ -3182,12 +4815,59 @@ restart:
   }
   g_mutex_unlock (&priv->lock);
 
+  free_removed_sources (stream);
+
   if (func)
     g_hash_table_unref (visited);
 
   return result;
 }
 
+/* append the stats of all transports of @stream to @array, the stats keep a
+ * ref to the transport */
+void
+gst_rtsp_stream_collect_transport_stats (GstRTSPStream * stream,
+    GArray * array)
+{
+  GList *transports, *walk;
+
+  transports = gst_rtsp_stream_transport_filter (stream, NULL, NULL);
+  for (walk = transports; walk; walk = g_list_next (walk)) {
+    GstRTSPStreamTransport *trans = walk->data;
+    GstRTSPStreamTransportStats stats;
+
+    gst_rtsp_stream_transport_get_stats (trans, &stats);
+    /* takes the ref of the list */
+    stats.transport = trans;
+    g_array_append_val (array, stats);
+  }
+  g_list_free (transports);
+}
+
+/**
+ * gst_rtsp_stream_get_transport_stats:
+ * @stream: a #GstRTSPStream
+ *
+ * Get a snapshot of the statistics of all transports of @stream.
+ *
+ * Returns: (transfer full) (element-type GstRTSPStreamTransportStats): a
+ * #GArray of #GstRTSPStreamTransportStats. g_array_unref() after usage.
+ *
+ * Since: 1.6
+ */
+GArray *
+gst_rtsp_stream_get_transport_stats (GstRTSPStream * stream)
+{
+  GArray *result;
+
+  g_return_val_if_fail (GST_IS_RTSP_STREAM (stream), NULL);
+
+  result = gst_rtsp_stream_transport_stats_array_new ();
+  gst_rtsp_stream_collect_transport_stats (stream, result);
+
+  return result;
+}
+
 static GstPadProbeReturn
 pad_blocking (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
 {
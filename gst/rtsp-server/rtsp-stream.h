@@ -44,6 +44,28 @@ typedef struct _GstRTSPStreamPrivate GstRTSPStreamPrivate;
 #include "rtsp-address-pool.h"
 #include "rtsp-session.h"
 
+/**
+ * GstRTSPUdpSendMode:
+ * @GST_RTSP_UDP_SEND_MODE_SINK: send to UDP unicast destinations with the
+ *   udpsink, one packet per destination at a time
+ * @GST_RTSP_UDP_SEND_MODE_FANOUT: send to UDP unicast destinations in batches
+ *   of packets and destinations with sendmmsg() where available
+ * @GST_RTSP_UDP_SEND_MODE_FANOUT_GSO: like @GST_RTSP_UDP_SEND_MODE_FANOUT but
+ *   also use UDP generic segmentation offload where available
+ *
+ * How RTP and RTCP packets are sent to UDP unicast destinations.
+ *
+ * Since: 1.6
+ */
+typedef enum {
+  GST_RTSP_UDP_SEND_MODE_SINK       = 0,
+  GST_RTSP_UDP_SEND_MODE_FANOUT     = 1,
+  GST_RTSP_UDP_SEND_MODE_FANOUT_GSO = 2
+} GstRTSPUdpSendMode;
+
+#define GST_TYPE_RTSP_UDP_SEND_MODE (gst_rtsp_udp_send_mode_get_type())
+GType gst_rtsp_udp_send_mode_get_type (void);
+
 /**
  * GstRTSPStream:
  *
@@ -161,6 +183,23 @@ guint             gst_rtsp_stream_get_retransmission_pt       (GstRTSPStream * s
 void              gst_rtsp_stream_set_retransmission_pt       (GstRTSPStream * stream,
                                                                guint rtx_pt);
 
+void              gst_rtsp_stream_set_udp_send_mode           (GstRTSPStream *stream,
+                                                               GstRTSPUdpSendMode mode);
+GstRTSPUdpSendMode gst_rtsp_stream_get_udp_send_mode          (GstRTSPStream *stream);
+void              gst_rtsp_stream_set_gop_cache               (GstRTSPStream *stream,
+                                                               gboolean gop_cache);
+gboolean          gst_rtsp_stream_get_gop_cache               (GstRTSPStream *stream);
+void              gst_rtsp_stream_set_per_transport_keys      (GstRTSPStream *stream,
+                                                               gboolean per_transport_keys);
+gboolean          gst_rtsp_stream_get_per_transport_keys      (GstRTSPStream *stream);
+void              gst_rtsp_stream_set_connected_udp           (GstRTSPStream *stream,
+                                                               gboolean connected_udp);
+gboolean          gst_rtsp_stream_get_connected_udp           (GstRTSPStream *stream);
+gboolean          gst_rtsp_stream_get_udp_dropped             (GstRTSPStream *stream,
+                                                               GstRTSPStreamTransport *trans,
+                                                               guint64 *rtp_dropped,
+                                                               guint64 *rtcp_dropped);
+
 void              gst_rtsp_stream_set_pt_map                 (GstRTSPStream * stream, guint pt, GstCaps * caps);
 GstElement *      gst_rtsp_stream_request_aux_sender         (GstRTSPStream * stream, guint sessid);
 /**
@@ -191,6 +230,8 @@ GList *                gst_rtsp_stream_transport_filter  (GstRTSPStream *stream,
                                                           GstRTSPStreamTransportFilterFunc func,
                                                           gpointer user_data);
 
+GArray *               gst_rtsp_stream_get_transport_stats (GstRTSPStream *stream);
+
 G_END_DECLS
 
 #endif /* __GST_RTSP_STREAM_H__ */
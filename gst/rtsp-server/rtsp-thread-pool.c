@@ -27,7 +27,11 @@
  * Threads of type #GST_RTSP_THREAD_TYPE_CLIENT are used to handle requests from
  * a connected client. With gst_rtsp_thread_pool_get_max_threads() a maximum
  * number of threads can be set after which the pool will start to reuse the
- * same thread for multiple clients.
+ * same thread for multiple clients. New clients then go to the thread with the
+ * lowest load, which is measured from the time the thread spends dispatching
+ * and the number of clients it already serves. With
+ * gst_rtsp_thread_pool_set_pin_threads() the client threads can be pinned to
+ * the available CPUs.
  *
  * Threads of type #GST_RTSP_THREAD_TYPE_MEDIA will be used to perform the state
  * changes of the media pipelines and handle its bus messages.
@@ -47,9 +51,23 @@
  * Last reviewed on 2013-07-11 (1.0.0)
  */
 
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SCHED_SETAFFINITY
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sched.h>
+#include <unistd.h>
+#endif
+
 #include <string.h>
 
 #include "rtsp-thread-pool.h"
+#include "rtsp-server-internal.h"
+#include "rtsp-metrics.h"
 
 typedef struct _GstRTSPThreadImpl
 {
@@ -57,8 +75,26 @@ typedef struct _GstRTSPThreadImpl
 
   gint reused;
   GSource *source;
+  guint id;
+
+  /* load accounting, updated from the thread itself */
+  gint64 window_start;
+  gint64 window_busy;
+  gint64 poll_end;
+  gint dispatching;             /* second the current dispatch started or 0 */
+  gint load;                    /* permille of the time spent dispatching */
 } GstRTSPThreadImpl;
 
+/* the interval over which the load of a thread is measured */
+#define LOAD_INTERVAL           G_TIME_SPAN_SECOND
+/* the load that one client adds to a thread, in permille */
+#define LOAD_PER_CLIENT         50
+
+/* the thread running the current mainloop */
+static GPrivate current_thread;
+/* the id of the next thread, to tell threads apart in the metrics */
+static gint next_thread_id;
+
 GST_DEFINE_MINI_OBJECT_TYPE (GstRTSPThread, gst_rtsp_thread);
 
 static void gst_rtsp_thread_init (GstRTSPThreadImpl * impl);
@@ -116,6 +152,7 @@ gst_rtsp_thread_new (GstRTSPThreadType type)
   impl = g_slice_new0 (GstRTSPThreadImpl);
 
   gst_rtsp_thread_init (impl);
+  impl->id = g_atomic_int_add (&next_thread_id, 1);
   impl->thread.type = type;
   impl->thread.context = g_main_context_new ();
   impl->thread.loop = g_main_loop_new (impl->thread.context, TRUE);
@@ -182,6 +219,65 @@ gst_rtsp_thread_stop (GstRTSPThread * thread)
     gst_rtsp_thread_unref (thread);
 }
 
+/* runs in the thread, the time between two polls is spent dispatching */
+static gint
+load_poll (GPollFD * fds, guint nfds, gint timeout)
+{
+  GstRTSPThreadImpl *impl = g_private_get (&current_thread);
+  gint64 start, end;
+  gint res;
+
+  if (impl == NULL)
+    return g_poll (fds, nfds, timeout);
+
+  start = g_get_monotonic_time ();
+  if (impl->poll_end)
+    impl->window_busy += start - impl->poll_end;
+  g_atomic_int_set (&impl->dispatching, 0);
+
+  res = g_poll (fds, nfds, timeout);
+
+  end = g_get_monotonic_time ();
+  impl->poll_end = end;
+  /* + 1 so that it is never 0 */
+  g_atomic_int_set (&impl->dispatching, end / G_TIME_SPAN_SECOND + 1);
+
+  if (end - impl->window_start >= LOAD_INTERVAL) {
+    gint load, old;
+
+    load = (impl->window_busy * 1000) / (end - impl->window_start);
+    old = g_atomic_int_get (&impl->load);
+    /* smooth over the previous intervals */
+    g_atomic_int_set (&impl->load, (old + load) / 2);
+
+    impl->window_start = end;
+    impl->window_busy = 0;
+  }
+  return res;
+}
+
+/* the permille of the time @impl spends dispatching, a thread that is stuck
+ * in a dispatch for more than a second is fully busy */
+static gint
+thread_get_busy (GstRTSPThreadImpl * impl, gint now)
+{
+  gint since;
+
+  since = g_atomic_int_get (&impl->dispatching);
+  if (since && now - (since - 1) > 1)
+    return 1000;
+
+  return g_atomic_int_get (&impl->load);
+}
+
+/* the load of @impl in permille, including the clients it serves */
+static gint
+thread_get_load (GstRTSPThreadImpl * impl, gint now)
+{
+  return thread_get_busy (impl, now) +
+      g_atomic_int_get (&impl->reused) * LOAD_PER_CLIENT;
+}
+
 #define GST_RTSP_THREAD_POOL_GET_PRIVATE(obj)  \
    (G_TYPE_INSTANCE_GET_PRIVATE ((obj), GST_TYPE_RTSP_THREAD_POOL, GstRTSPThreadPoolPrivate))
 
@@ -190,16 +286,20 @@ struct _GstRTSPThreadPoolPrivate
   GMutex lock;
 
   gint max_threads;
+  gboolean pin_threads;
   /* currently used mainloops */
   GQueue threads;
+  guint n_pinned;
 };
 
 #define DEFAULT_MAX_THREADS 1
+#define DEFAULT_PIN_THREADS FALSE
 
 enum
 {
   PROP_0,
   PROP_MAX_THREADS,
+  PROP_PIN_THREADS,
   PROP_LAST
 };
 
@@ -246,6 +346,18 @@ gst_rtsp_thread_pool_class_init (GstRTSPThreadPoolClass * klass)
           "(0 = only mainloop, -1 = unlimited)", -1, G_MAXINT,
           DEFAULT_MAX_THREADS, G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
 
+  /**
+   * GstRTSPThreadPool::pin-threads:
+   *
+   * Pin each client thread to one of the available CPUs, in turn.
+   *
+   * Since: 1.6
+   */
+  g_object_class_install_property (gobject_class, PROP_PIN_THREADS,
+      g_param_spec_boolean ("pin-threads", "Pin Threads",
+          "Pin client threads to the available CPUs", DEFAULT_PIN_THREADS,
+          G_PARAM_READWRITE | G_PARAM_STATIC_STRINGS));
+
   klass->get_thread = default_get_thread;
 
   GST_DEBUG_CATEGORY_INIT (rtsp_thread_pool_debug, "rtspthreadpool", 0,
@@ -263,6 +375,7 @@ gst_rtsp_thread_pool_init (GstRTSPThreadPool * pool)
 
   g_mutex_init (&priv->lock);
   priv->max_threads = DEFAULT_MAX_THREADS;
+  priv->pin_threads = DEFAULT_PIN_THREADS;
   g_queue_init (&priv->threads);
 }
 
@@ -290,6 +403,9 @@ gst_rtsp_thread_pool_get_property (GObject * object, guint propid,
     case PROP_MAX_THREADS:
       g_value_set_int (value, gst_rtsp_thread_pool_get_max_threads (pool));
       break;
+    case PROP_PIN_THREADS:
+      g_value_set_boolean (value, gst_rtsp_thread_pool_get_pin_threads (pool));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
@@ -305,30 +421,80 @@ gst_rtsp_thread_pool_set_property (GObject * object, guint propid,
     case PROP_MAX_THREADS:
       gst_rtsp_thread_pool_set_max_threads (pool, g_value_get_int (value));
       break;
+    case PROP_PIN_THREADS:
+      gst_rtsp_thread_pool_set_pin_threads (pool,
+          g_value_get_boolean (value));
+      break;
     default:
       G_OBJECT_WARN_INVALID_PROPERTY_ID (object, propid, pspec);
   }
 }
 
+/* pin the calling thread to the next CPU */
+static void
+pin_thread (GstRTSPThreadPool * pool, GstRTSPThread * thread)
+{
+#ifdef HAVE_SCHED_SETAFFINITY
+  GstRTSPThreadPoolPrivate *priv = pool->priv;
+  cpu_set_t set;
+  glong n_cpus;
+  guint cpu;
+
+  n_cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (n_cpus < 1)
+    return;
+
+  g_mutex_lock (&priv->lock);
+  cpu = priv->n_pinned++ % n_cpus;
+  g_mutex_unlock (&priv->lock);
+
+  CPU_ZERO (&set);
+  CPU_SET (cpu, &set);
+  if (sched_setaffinity (0, sizeof (set), &set) < 0)
+    GST_WARNING_OBJECT (pool, "failed to pin thread %p to cpu %u", thread,
+        cpu);
+  else
+    GST_DEBUG_OBJECT (pool, "pinned thread %p to cpu %u", thread, cpu);
+#else
+  GST_WARNING_OBJECT (pool, "pinning threads is not supported");
+#endif
+}
+
 static gpointer
 do_loop (GstRTSPThread * thread)
 {
+  GstRTSPThreadImpl *impl = (GstRTSPThreadImpl *) thread;
   GstRTSPThreadPoolPrivate *priv;
   GstRTSPThreadPoolClass *klass;
   GstRTSPThreadPool *pool;
+  gboolean pin;
 
   pool = gst_mini_object_get_qdata (GST_MINI_OBJECT (thread), thread_pool);
   priv = pool->priv;
 
   klass = GST_RTSP_THREAD_POOL_GET_CLASS (pool);
 
+  g_mutex_lock (&priv->lock);
+  pin = priv->pin_threads;
+  g_mutex_unlock (&priv->lock);
+
+  if (pin && thread->type == GST_RTSP_THREAD_TYPE_CLIENT)
+    pin_thread (pool, thread);
+
   if (klass->thread_enter)
     klass->thread_enter (pool, thread);
 
+  /* measure the load of the thread */
+  impl->window_start = g_get_monotonic_time ();
+  g_private_set (&current_thread, impl);
+  g_main_context_set_poll_func (thread->context, load_poll);
+
   GST_INFO ("enter mainloop of thread %p", thread);
   g_main_loop_run (thread->loop);
   GST_INFO ("exit mainloop of thread %p", thread);
 
+  g_private_set (&current_thread, NULL);
+
   if (klass->thread_leave)
     klass->thread_leave (pool, thread);
 
@@ -408,6 +574,57 @@ gst_rtsp_thread_pool_get_max_threads (GstRTSPThreadPool * pool)
   return res;
 }
 
+/**
+ * gst_rtsp_thread_pool_set_pin_threads:
+ * @pool: a #GstRTSPThreadPool
+ * @pin: if client threads should be pinned
+ *
+ * Pin each new client thread to one of the available CPUs, in turn. This only
+ * affects threads that are started after this call.
+ *
+ * Since: 1.6
+ */
+void
+gst_rtsp_thread_pool_set_pin_threads (GstRTSPThreadPool * pool, gboolean pin)
+{
+  GstRTSPThreadPoolPrivate *priv;
+
+  g_return_if_fail (GST_IS_RTSP_THREAD_POOL (pool));
+
+  priv = pool->priv;
+
+  g_mutex_lock (&priv->lock);
+  priv->pin_threads = pin;
+  g_mutex_unlock (&priv->lock);
+}
+
+/**
+ * gst_rtsp_thread_pool_get_pin_threads:
+ * @pool: a #GstRTSPThreadPool
+ *
+ * Check if client threads are pinned to CPUs.
+ *
+ * Returns: %TRUE if client threads are pinned.
+ *
+ * Since: 1.6
+ */
+gboolean
+gst_rtsp_thread_pool_get_pin_threads (GstRTSPThreadPool * pool)
+{
+  GstRTSPThreadPoolPrivate *priv;
+  gboolean res;
+
+  g_return_val_if_fail (GST_IS_RTSP_THREAD_POOL (pool), FALSE);
+
+  priv = pool->priv;
+
+  g_mutex_lock (&priv->lock);
+  res = priv->pin_threads;
+  g_mutex_unlock (&priv->lock);
+
+  return res;
+}
+
 static GstRTSPThread *
 make_thread (GstRTSPThreadPool * pool, GstRTSPThreadType type,
     GstRTSPContext * ctx)
@@ -429,6 +646,31 @@ make_thread (GstRTSPThreadPool * pool, GstRTSPThreadType type,
   return thread;
 }
 
+/* remove the thread with the lowest load from @threads. Of equally loaded
+ * threads, the one that was used longest ago is taken. */
+static GstRTSPThread *
+pop_least_loaded (GQueue * threads)
+{
+  GList *walk, *best = NULL;
+  gint now, load, best_load = G_MAXINT;
+  GstRTSPThread *thread;
+
+  now = g_get_monotonic_time () / G_TIME_SPAN_SECOND;
+
+  for (walk = threads->head; walk; walk = walk->next) {
+    load = thread_get_load (walk->data, now);
+    GST_LOG ("thread %p load %d", walk->data, load);
+    if (load < best_load) {
+      best = walk;
+      best_load = load;
+    }
+  }
+  thread = best->data;
+  g_queue_delete_link (threads, best);
+
+  return thread;
+}
+
 static GstRTSPThread *
 default_get_thread (GstRTSPThreadPool * pool,
     GstRTSPThreadType type, GstRTSPContext * ctx)
@@ -451,8 +693,8 @@ default_get_thread (GstRTSPThreadPool * pool,
       retry:
         if (priv->max_threads > 0 &&
             g_queue_get_length (&priv->threads) >= priv->max_threads) {
-          /* max threads reached, recycle from queue */
-          thread = g_queue_pop_head (&priv->threads);
+          /* max threads reached, recycle the least loaded thread */
+          thread = pop_least_loaded (&priv->threads);
           GST_DEBUG_OBJECT (pool, "recycle client thread %p", thread);
           if (!gst_rtsp_thread_reuse (thread)) {
             GST_DEBUG_OBJECT (pool, "thread %p stopping, retry", thread);
@@ -560,3 +802,47 @@ gst_rtsp_thread_pool_cleanup (void)
   }
   g_type_class_unref (klass);
 }
+
+/* write the utilization and the number of clients of the client threads of
+ * @pool to @out */
+void
+gst_rtsp_thread_pool_append_metrics (GstRTSPThreadPool * pool, GString * out)
+{
+  GstRTSPThreadPoolPrivate *priv = pool->priv;
+  GString *busy, *clients, *labels;
+  GList *walk;
+  gint now;
+
+  busy = g_string_new (NULL);
+  clients = g_string_new (NULL);
+  labels = g_string_new (NULL);
+  now = g_get_monotonic_time () / G_TIME_SPAN_SECOND;
+
+  g_mutex_lock (&priv->lock);
+  for (walk = priv->threads.head; walk; walk = walk->next) {
+    GstRTSPThreadImpl *impl = walk->data;
+    gchar *id;
+
+    id = g_strdup_printf ("%u", impl->id);
+    g_string_truncate (labels, 0);
+    gst_rtsp_metrics_append_label (labels, "thread", id);
+    g_free (id);
+
+    gst_rtsp_metrics_append_value (busy, "gst_rtsp_thread_utilization",
+        labels->str, thread_get_busy (impl, now) / 1000.0);
+    gst_rtsp_metrics_append_value (clients, "gst_rtsp_thread_clients",
+        labels->str, g_atomic_int_get (&impl->reused));
+  }
+  g_mutex_unlock (&priv->lock);
+
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_thread_utilization", "gauge",
+      "Fraction of the time a client thread spends dispatching");
+  g_string_append_len (out, busy->str, busy->len);
+  gst_rtsp_metrics_append_header (out, "gst_rtsp_thread_clients", "gauge",
+      "Number of clients handled by a client thread");
+  g_string_append_len (out, clients->str, clients->len);
+
+  g_string_free (busy, TRUE);
+  g_string_free (clients, TRUE);
+  g_string_free (labels, TRUE);
+}
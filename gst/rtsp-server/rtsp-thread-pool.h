@@ -170,6 +170,9 @@ GstRTSPThreadPool * gst_rtsp_thread_pool_new             (void);
 void                gst_rtsp_thread_pool_set_max_threads (GstRTSPThreadPool * pool, gint max_threads);
 gint                gst_rtsp_thread_pool_get_max_threads (GstRTSPThreadPool * pool);
 
+void                gst_rtsp_thread_pool_set_pin_threads (GstRTSPThreadPool * pool, gboolean pin);
+gboolean            gst_rtsp_thread_pool_get_pin_threads (GstRTSPThreadPool * pool);
+
 GstRTSPThread *     gst_rtsp_thread_pool_get_thread      (GstRTSPThreadPool *pool,
                                                           GstRTSPThreadType type,
                                                           GstRTSPContext *ctx);
@@ -0,0 +1,667 @@
+/* GStreamer
+ * Copyright (C) 2015 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+/*
+ * GstRTSPUdpFanout sends the same RTP or RTCP packets to many unicast
+ * destinations. Instead of doing one sendto() per packet and destination like
+ * multiudpsink, all packets for all destinations are collected in batches and
+ * written with sendmmsg(). The payload memory is mapped once and shared by all
+ * the messages.
+ *
+ * With GSO enabled, consecutive packets of the same size going to the same
+ * destination are passed to the kernel as one message with a UDP_SEGMENT
+ * control message so that they are segmented in the kernel or the NIC.
+ *
+ * Packets that could not be written because the socket was full are dropped
+ * and counted per destination, the streaming thread never waits for the
+ * socket.
+ */
+
+#ifdef HAVE_CONFIG_H
+#include "config.h"
+#endif
+
+#ifdef HAVE_SENDMMSG
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/uio.h>
+#include <netinet/in.h>
+#include <netinet/udp.h>
+#include <errno.h>
+#endif
+
+#include <string.h>
+
+#include "rtsp-udp-fanout.h"
+
+GST_DEBUG_CATEGORY_STATIC (rtsp_udp_fanout_debug);
+#define GST_CAT_DEFAULT rtsp_udp_fanout_debug
+
+/* max number of messages in one sendmmsg() call */
+#define FANOUT_BATCH_SIZE       64
+/* max number of packets and bytes the kernel accepts in one GSO message */
+#define FANOUT_GSO_MAX_SEGMENTS 64
+#define FANOUT_GSO_MAX_BYTES    65000
+
+#if defined (HAVE_SENDMMSG) && defined (__linux__)
+#ifndef SOL_UDP
+#define SOL_UDP IPPROTO_UDP
+#endif
+#ifndef UDP_SEGMENT
+#define UDP_SEGMENT 103
+#endif
+#define HAVE_UDP_GSO 1
+#endif
+
+typedef struct
+{
+  gchar *host;
+  gint port;
+  guint refcount;
+
+  GSocketFamily family;
+  GSocketAddress *addr;
+#ifdef HAVE_SENDMMSG
+  struct sockaddr_storage native;
+  socklen_t native_len;
+#endif
+
+  guint64 dropped;
+} FanoutDest;
+
+/* a packet, made of one or more consecutive vectors */
+typedef struct
+{
+  guint vec;
+  guint n_vecs;
+  gsize size;
+} FanoutPacket;
+
+/* consecutive packets that are sent in one message. When @segment_size is
+ * not 0, the packets are sent with GSO */
+typedef struct
+{
+  guint packet;
+  guint n_packets;
+  guint n_vecs;
+  guint segment_size;
+} FanoutRun;
+
+struct _GstRTSPUdpFanout
+{
+  GMutex lock;
+
+  GSocket *socket_v4;
+  GSocket *socket_v6;
+  gboolean gso;
+
+  GPtrArray *dests;
+
+  /* scratch space, reused for each send */
+  GArray *maps;
+  GArray *vecs;
+  GArray *packets;
+  GArray *runs;
+};
+
+static void
+dest_free (FanoutDest * dest)
+{
+  g_free (dest->host);
+  g_object_unref (dest->addr);
+  g_slice_free (FanoutDest, dest);
+}
+
+static FanoutDest *
+dest_new (const gchar * host, gint port)
+{
+  FanoutDest *dest;
+  GInetAddress *iaddr;
+
+  if (!(iaddr = g_inet_address_new_from_string (host)))
+    return NULL;
+
+  dest = g_slice_new0 (FanoutDest);
+  dest->host = g_strdup (host);
+  dest->port = port;
+  dest->refcount = 1;
+  dest->family = g_inet_address_get_family (iaddr);
+  dest->addr = g_inet_socket_address_new (iaddr, port);
+  g_object_unref (iaddr);
+
+#ifdef HAVE_SENDMMSG
+  dest->native_len = g_socket_address_get_native_size (dest->addr);
+  if (!g_socket_address_to_native (dest->addr, &dest->native,
+          sizeof (dest->native), NULL)) {
+    dest_free (dest);
+    return NULL;
+  }
+#endif
+
+  return dest;
+}
+
+/* must be called with the lock */
+static FanoutDest *
+find_dest (GstRTSPUdpFanout * fanout, const gchar * host, gint port,
+    guint * index)
+{
+  guint i;
+
+  for (i = 0; i < fanout->dests->len; i++) {
+    FanoutDest *dest = g_ptr_array_index (fanout->dests, i);
+
+    if (dest->port == port && g_str_equal (dest->host, host)) {
+      if (index)
+        *index = i;
+      return dest;
+    }
+  }
+  return NULL;
+}
+
+/* make a new fanout sender that writes on @socket_v4 and @socket_v6, both can
+ * be NULL. Free with gst_rtsp_udp_fanout_free() */
+GstRTSPUdpFanout *
+gst_rtsp_udp_fanout_new (GSocket * socket_v4, GSocket * socket_v6)
+{
+  GstRTSPUdpFanout *fanout;
+  static gsize init = 0;
+
+  if (g_once_init_enter (&init)) {
+    GST_DEBUG_CATEGORY_INIT (rtsp_udp_fanout_debug, "rtspudpfanout", 0,
+        "GstRTSPUdpFanout");
+    g_once_init_leave (&init, 1);
+  }
+
+  fanout = g_slice_new0 (GstRTSPUdpFanout);
+  g_mutex_init (&fanout->lock);
+  if (socket_v4)
+    fanout->socket_v4 = g_object_ref (socket_v4);
+  if (socket_v6)
+    fanout->socket_v6 = g_object_ref (socket_v6);
+  fanout->dests = g_ptr_array_new_with_free_func ((GDestroyNotify) dest_free);
+  fanout->maps = g_array_new (FALSE, FALSE, sizeof (GstMapInfo));
+  fanout->vecs = g_array_new (FALSE, FALSE, sizeof (GOutputVector));
+  fanout->packets = g_array_new (FALSE, FALSE, sizeof (FanoutPacket));
+  fanout->runs = g_array_new (FALSE, FALSE, sizeof (FanoutRun));
+
+  return fanout;
+}
+
+/* free @fanout and all its destinations */
+void
+gst_rtsp_udp_fanout_free (GstRTSPUdpFanout * fanout)
+{
+  g_return_if_fail (fanout != NULL);
+
+  g_ptr_array_unref (fanout->dests);
+  g_array_unref (fanout->maps);
+  g_array_unref (fanout->vecs);
+  g_array_unref (fanout->packets);
+  g_array_unref (fanout->runs);
+  if (fanout->socket_v4)
+    g_object_unref (fanout->socket_v4);
+  if (fanout->socket_v6)
+    g_object_unref (fanout->socket_v6);
+  g_mutex_clear (&fanout->lock);
+  g_slice_free (GstRTSPUdpFanout, fanout);
+}
+
+/* use UDP generic segmentation offload for consecutive packets to the same
+ * destination. This is ignored when the platform does not support it and is
+ * disabled again when the kernel refuses it */
+void
+gst_rtsp_udp_fanout_set_gso (GstRTSPUdpFanout * fanout, gboolean gso)
+{
+  g_return_if_fail (fanout != NULL);
+
+  g_mutex_lock (&fanout->lock);
+#ifdef HAVE_UDP_GSO
+  fanout->gso = gso;
+#else
+  if (gso)
+    GST_WARNING ("UDP GSO is not supported on this platform");
+#endif
+  g_mutex_unlock (&fanout->lock);
+}
+
+/* add @host and @port as a destination, adding the same destination again
+ * only increments its refcount. Returns FALSE when @host is not an IP address
+ * or there is no socket for its family */
+gboolean
+gst_rtsp_udp_fanout_add (GstRTSPUdpFanout * fanout, const gchar * host,
+    gint port)
+{
+  FanoutDest *dest;
+
+  g_return_val_if_fail (fanout != NULL, FALSE);
+  g_return_val_if_fail (host != NULL, FALSE);
+
+  g_mutex_lock (&fanout->lock);
+  if ((dest = find_dest (fanout, host, port, NULL))) {
+    dest->refcount++;
+    g_mutex_unlock (&fanout->lock);
+    return TRUE;
+  }
+
+  if (!(dest = dest_new (host, port)))
+    goto invalid_host;
+
+  if ((dest->family == G_SOCKET_FAMILY_IPV4 && !fanout->socket_v4) ||
+      (dest->family == G_SOCKET_FAMILY_IPV6 && !fanout->socket_v6))
+    goto no_socket;
+
+  GST_DEBUG ("adding destination %s:%d", host, port);
+  g_ptr_array_add (fanout->dests, dest);
+  g_mutex_unlock (&fanout->lock);
+
+  return TRUE;
+
+  /* ERRORS */
+invalid_host:
+  {
+    g_mutex_unlock (&fanout->lock);
+    GST_WARNING ("invalid destination %s", host);
+    return FALSE;
+  }
+no_socket:
+  {
+    g_mutex_unlock (&fanout->lock);
+    GST_WARNING ("no socket for destination %s", host);
+    dest_free (dest);
+    return FALSE;
+  }
+}
+
+/* remove a destination added with gst_rtsp_udp_fanout_add(). Returns FALSE
+ * when it was not found */
+gboolean
+gst_rtsp_udp_fanout_remove (GstRTSPUdpFanout * fanout, const gchar * host,
+    gint port)
+{
+  FanoutDest *dest;
+  guint index;
+
+  g_return_val_if_fail (fanout != NULL, FALSE);
+  g_return_val_if_fail (host != NULL, FALSE);
+
+  g_mutex_lock (&fanout->lock);
+  if (!(dest = find_dest (fanout, host, port, &index))) {
+    g_mutex_unlock (&fanout->lock);
+    return FALSE;
+  }
+
+  if (--dest->refcount == 0) {
+    GST_DEBUG ("removing destination %s:%d, %" G_GUINT64_FORMAT " dropped",
+        host, port, dest->dropped);
+    g_ptr_array_remove_index_fast (fanout->dests, index);
+  }
+  g_mutex_unlock (&fanout->lock);
+
+  return TRUE;
+}
+
+/* get the number of packets that could not be sent to @host and @port.
+ * Returns FALSE when the destination was not found */
+gboolean
+gst_rtsp_udp_fanout_get_dropped (GstRTSPUdpFanout * fanout,
+    const gchar * host, gint port, guint64 * dropped)
+{
+  FanoutDest *dest;
+
+  g_return_val_if_fail (fanout != NULL, FALSE);
+  g_return_val_if_fail (host != NULL, FALSE);
+  g_return_val_if_fail (dropped != NULL, FALSE);
+
+  g_mutex_lock (&fanout->lock);
+  if ((dest = find_dest (fanout, host, port, NULL)))
+    *dropped = dest->dropped;
+  g_mutex_unlock (&fanout->lock);
+
+  return dest != NULL;
+}
+
+/* map all memory of @buffers and describe the packets and runs. Must be called
+ * with the lock */
+static void
+map_packets (GstRTSPUdpFanout * fanout, GstBuffer ** buffers, guint n_buffers)
+{
+  guint i, j;
+
+  for (i = 0; i < n_buffers; i++) {
+    FanoutPacket packet;
+    guint n_mem;
+
+    packet.vec = fanout->vecs->len;
+    packet.n_vecs = 0;
+    packet.size = 0;
+
+    n_mem = gst_buffer_n_memory (buffers[i]);
+    for (j = 0; j < n_mem; j++) {
+      GstMemory *mem = gst_buffer_peek_memory (buffers[i], j);
+      GstMapInfo map;
+      GOutputVector vec;
+
+      if (!gst_memory_map (mem, &map, GST_MAP_READ))
+        continue;
+
+      vec.buffer = map.data;
+      vec.size = map.size;
+      g_array_append_val (fanout->maps, map);
+      g_array_append_val (fanout->vecs, vec);
+      packet.n_vecs++;
+      packet.size += map.size;
+    }
+    g_array_append_val (fanout->packets, packet);
+  }
+
+  /* group packets of the same size for GSO, only the last packet of a run can
+   * be smaller */
+  for (i = 0; i < fanout->packets->len;) {
+    FanoutPacket *first = &g_array_index (fanout->packets, FanoutPacket, i);
+    FanoutRun run;
+    gsize bytes;
+
+    run.packet = i;
+    run.n_packets = 1;
+    run.n_vecs = first->n_vecs;
+    run.segment_size = 0;
+    bytes = first->size;
+
+    if (fanout->gso) {
+      for (j = i + 1; j < fanout->packets->len; j++) {
+        FanoutPacket *next = &g_array_index (fanout->packets, FanoutPacket, j);
+
+        if (next->size > first->size || next->size == 0 ||
+            run.n_packets == FANOUT_GSO_MAX_SEGMENTS ||
+            bytes + next->size > FANOUT_GSO_MAX_BYTES)
+          break;
+
+        run.n_packets++;
+        run.n_vecs += next->n_vecs;
+        bytes += next->size;
+
+        if (next->size < first->size)
+          break;
+      }
+      if (run.n_packets > 1)
+        run.segment_size = first->size;
+    }
+    g_array_append_val (fanout->runs, run);
+    i += run.n_packets;
+  }
+}
+
+/* must be called with the lock */
+static void
+unmap_packets (GstRTSPUdpFanout * fanout)
+{
+  guint i;
+
+  for (i = 0; i < fanout->maps->len; i++) {
+    GstMapInfo *map = &g_array_index (fanout->maps, GstMapInfo, i);
+
+    gst_memory_unmap (map->memory, map);
+  }
+  g_array_set_size (fanout->maps, 0);
+  g_array_set_size (fanout->vecs, 0);
+  g_array_set_size (fanout->packets, 0);
+  g_array_set_size (fanout->runs, 0);
+}
+
+#ifdef HAVE_SENDMMSG
+G_STATIC_ASSERT (sizeof (struct iovec) == sizeof (GOutputVector));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct iovec, iov_base) ==
+    G_STRUCT_OFFSET (GOutputVector, buffer));
+G_STATIC_ASSERT (G_STRUCT_OFFSET (struct iovec, iov_len) ==
+    G_STRUCT_OFFSET (GOutputVector, size));
+
+typedef struct
+{
+  struct mmsghdr msgs[FANOUT_BATCH_SIZE];
+  union
+  {
+    gchar buf[CMSG_SPACE (sizeof (guint16))];
+    struct cmsghdr align;
+  } control[FANOUT_BATCH_SIZE];
+  FanoutDest *dests[FANOUT_BATCH_SIZE];
+  guint packet[FANOUT_BATCH_SIZE];
+  guint n_packets[FANOUT_BATCH_SIZE];
+  guint len;
+} FanoutBatch;
+
+#ifdef HAVE_UDP_GSO
+/* send the packets of the messages from @first on one by one and without
+ * GSO, after the kernel refused it. Must be called with the lock */
+static void
+send_without_gso (GstRTSPUdpFanout * fanout, gint fd, FanoutBatch * batch,
+    guint first)
+{
+  GOutputVector *vecs = (GOutputVector *) fanout->vecs->data;
+  FanoutPacket *packets = (FanoutPacket *) fanout->packets->data;
+  guint i, j;
+
+  for (i = first; i < batch->len; i++) {
+    struct msghdr hdr = batch->msgs[i].msg_hdr;
+
+    hdr.msg_control = NULL;
+    hdr.msg_controllen = 0;
+
+    for (j = batch->packet[i]; j < batch->packet[i] + batch->n_packets[i];
+        j++) {
+      hdr.msg_iov = (struct iovec *) &vecs[packets[j].vec];
+      hdr.msg_iovlen = packets[j].n_vecs;
+
+      if (sendmsg (fd, &hdr, MSG_DONTWAIT) < 0)
+        batch->dests[i]->dropped++;
+    }
+  }
+}
+#endif
+
+/* write all messages in @batch, must be called with the lock */
+static void
+flush_batch (GstRTSPUdpFanout * fanout, GSocket * socket, FanoutBatch * batch)
+{
+  gint fd = g_socket_get_fd (socket);
+  guint sent = 0;
+
+  while (sent < batch->len) {
+    gint ret;
+
+    ret = sendmmsg (fd, batch->msgs + sent, batch->len - sent, MSG_DONTWAIT);
+    if (ret > 0) {
+      sent += ret;
+      continue;
+    }
+    if (ret < 0 && errno == EINTR)
+      continue;
+
+    if (ret < 0 && (errno == EAGAIN || errno == EWOULDBLOCK)) {
+      /* don't block the streaming thread and the other destinations on a
+       * full socket */
+      GST_LOG ("socket full, dropping %u messages", batch->len - sent);
+      for (; sent < batch->len; sent++)
+        batch->dests[sent]->dropped += batch->n_packets[sent];
+      break;
+    }
+#ifdef HAVE_UDP_GSO
+    if (batch->msgs[sent].msg_hdr.msg_controllen > 0 &&
+        (errno == EIO || errno == EINVAL || errno == ENOPROTOOPT)) {
+      GST_WARNING ("UDP GSO failed: %s, disabling", g_strerror (errno));
+      fanout->gso = FALSE;
+      send_without_gso (fanout, fd, batch, sent);
+      break;
+    }
+#endif
+    /* skip the failing message */
+    GST_LOG ("failed to send to %s:%d: %s", batch->dests[sent]->host,
+        batch->dests[sent]->port, g_strerror (errno));
+    batch->dests[sent]->dropped += batch->n_packets[sent];
+    sent++;
+  }
+  batch->len = 0;
+}
+
+/* add a message with @n_packets from @packet on to @dest, segmented in
+ * @segment_size bytes with GSO when not 0. Must be called with the lock */
+static void
+add_message (GstRTSPUdpFanout * fanout, GSocket * socket, FanoutBatch * batch,
+    FanoutDest * dest, guint packet, guint n_packets, guint n_vecs,
+    guint segment_size)
+{
+  GOutputVector *vecs = (GOutputVector *) fanout->vecs->data;
+  FanoutPacket *packets = (FanoutPacket *) fanout->packets->data;
+  struct msghdr *hdr = &batch->msgs[batch->len].msg_hdr;
+
+  hdr->msg_name = &dest->native;
+  hdr->msg_namelen = dest->native_len;
+  hdr->msg_iov = (struct iovec *) &vecs[packets[packet].vec];
+  hdr->msg_iovlen = n_vecs;
+  hdr->msg_control = NULL;
+  hdr->msg_controllen = 0;
+  hdr->msg_flags = 0;
+#ifdef HAVE_UDP_GSO
+  if (segment_size) {
+    struct cmsghdr *cmsg;
+
+    hdr->msg_control = batch->control[batch->len].buf;
+    hdr->msg_controllen = sizeof (batch->control[batch->len].buf);
+    cmsg = CMSG_FIRSTHDR (hdr);
+    cmsg->cmsg_level = SOL_UDP;
+    cmsg->cmsg_type = UDP_SEGMENT;
+    cmsg->cmsg_len = CMSG_LEN (sizeof (guint16));
+    *((guint16 *) CMSG_DATA (cmsg)) = segment_size;
+  }
+#endif
+  batch->dests[batch->len] = dest;
+  batch->packet[batch->len] = packet;
+  batch->n_packets[batch->len] = n_packets;
+
+  if (++batch->len == FANOUT_BATCH_SIZE)
+    flush_batch (fanout, socket, batch);
+}
+
+/* must be called with the lock */
+static void
+send_family (GstRTSPUdpFanout * fanout, GSocketFamily family,
+    GSocket * socket, FanoutBatch * batch)
+{
+  FanoutPacket *packets = (FanoutPacket *) fanout->packets->data;
+  guint i, j, k;
+
+  for (i = 0; i < fanout->dests->len; i++) {
+    FanoutDest *dest = g_ptr_array_index (fanout->dests, i);
+
+    if (dest->family != family)
+      continue;
+
+    for (j = 0; j < fanout->runs->len; j++) {
+      FanoutRun *run = &g_array_index (fanout->runs, FanoutRun, j);
+
+      if (run->segment_size == 0 || fanout->gso) {
+        add_message (fanout, socket, batch, dest, run->packet, run->n_packets,
+            run->n_vecs, run->segment_size);
+        continue;
+      }
+
+      /* GSO was turned off during this send, no control message and one
+       * message per packet */
+      for (k = run->packet; k < run->packet + run->n_packets; k++)
+        add_message (fanout, socket, batch, dest, k, 1, packets[k].n_vecs, 0);
+    }
+  }
+  if (batch->len > 0)
+    flush_batch (fanout, socket, batch);
+}
+#else
+/* must be called with the lock */
+static void
+send_family (GstRTSPUdpFanout * fanout, GSocketFamily family,
+    GSocket * socket, gpointer unused)
+{
+  GOutputVector *vecs = (GOutputVector *) fanout->vecs->data;
+  guint i, j;
+
+  for (i = 0; i < fanout->dests->len; i++) {
+    FanoutDest *dest = g_ptr_array_index (fanout->dests, i);
+
+    if (dest->family != family)
+      continue;
+
+    for (j = 0; j < fanout->packets->len; j++) {
+      FanoutPacket *packet = &g_array_index (fanout->packets, FanoutPacket, j);
+      GError *err = NULL;
+
+      /* the socket can be blocking, don't wait when it is full */
+      if (!(g_socket_condition_check (socket, G_IO_OUT) & G_IO_OUT)) {
+        GST_LOG ("socket full, dropping %u packets to %s:%d",
+            fanout->packets->len - j, dest->host, dest->port);
+        dest->dropped += fanout->packets->len - j;
+        break;
+      }
+
+      if (g_socket_send_message (socket, dest->addr, &vecs[packet->vec],
+              packet->n_vecs, NULL, 0, 0, NULL, &err) < 0) {
+        GST_LOG ("failed to send to %s:%d: %s", dest->host, dest->port,
+            err->message);
+        g_clear_error (&err);
+        dest->dropped++;
+      }
+    }
+  }
+}
+#endif
+
+/* send all @buffers to all destinations of @fanout */
+void
+gst_rtsp_udp_fanout_send (GstRTSPUdpFanout * fanout, GstBuffer ** buffers,
+    guint n_buffers)
+{
+#ifdef HAVE_SENDMMSG
+  FanoutBatch batch;
+#else
+  gpointer batch = NULL;
+#endif
+
+  g_return_if_fail (fanout != NULL);
+  g_return_if_fail (buffers != NULL || n_buffers == 0);
+
+  g_mutex_lock (&fanout->lock);
+  if (fanout->dests->len == 0 || n_buffers == 0)
+    goto done;
+
+  map_packets (fanout, buffers, n_buffers);
+
+#ifdef HAVE_SENDMMSG
+  batch.len = 0;
+#endif
+  if (fanout->socket_v4)
+    send_family (fanout, G_SOCKET_FAMILY_IPV4, fanout->socket_v4, &batch);
+  if (fanout->socket_v6)
+    send_family (fanout, G_SOCKET_FAMILY_IPV6, fanout->socket_v6, &batch);
+
+  unmap_packets (fanout);
+
+done:
+  g_mutex_unlock (&fanout->lock);
+}
@@ -0,0 +1,55 @@
+/* GStreamer
+ * Copyright (C) 2015 The GStreamer developers
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Library General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Library General Public License for more details.
+ *
+ * You should have received a copy of the GNU Library General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 51 Franklin St, Fifth Floor,
+ * Boston, MA 02110-1301, USA.
+ */
+
+#include <gst/gst.h>
+#include <gio/gio.h>
+
+#ifndef __GST_RTSP_UDP_FANOUT_H__
+#define __GST_RTSP_UDP_FANOUT_H__
+
+G_BEGIN_DECLS
+
+typedef struct _GstRTSPUdpFanout GstRTSPUdpFanout;
+
+G_GNUC_INTERNAL
+GstRTSPUdpFanout *  gst_rtsp_udp_fanout_new          (GSocket *socket_v4, GSocket *socket_v6);
+G_GNUC_INTERNAL
+void                gst_rtsp_udp_fanout_free         (GstRTSPUdpFanout *fanout);
+
+G_GNUC_INTERNAL
+void                gst_rtsp_udp_fanout_set_gso      (GstRTSPUdpFanout *fanout, gboolean gso);
+
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_udp_fanout_add          (GstRTSPUdpFanout *fanout,
+                                                      const gchar *host, gint port);
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_udp_fanout_remove       (GstRTSPUdpFanout *fanout,
+                                                      const gchar *host, gint port);
+G_GNUC_INTERNAL
+gboolean            gst_rtsp_udp_fanout_get_dropped  (GstRTSPUdpFanout *fanout,
+                                                      const gchar *host, gint port,
+                                                      guint64 *dropped);
+
+G_GNUC_INTERNAL
+void                gst_rtsp_udp_fanout_send         (GstRTSPUdpFanout *fanout,
+                                                      GstBuffer **buffers, guint n_buffers);
+
+G_END_DECLS
+
+#endif /* __GST_RTSP_UDP_FANOUT_H__ */
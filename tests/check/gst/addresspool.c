@@ -270,6 +270,166 @@ GST_START_TEST (test_pool)
 
 GST_END_TEST;
 
+GST_START_TEST (test_port_bitmap)
+{
+  GstRTSPAddressPool *pool;
+  GstRTSPAddress *addrs[5], *addr;
+  GstRTSPAddressPoolResult res;
+  gint i;
+
+  pool = gst_rtsp_address_pool_new ();
+
+  fail_unless (gst_rtsp_address_pool_add_range (pool,
+          GST_RTSP_ADDRESS_POOL_ANY_IPV4, GST_RTSP_ADDRESS_POOL_ANY_IPV4, 5000,
+          5009, 0));
+
+  for (i = 0; i < 5; i++) {
+    addrs[i] = gst_rtsp_address_pool_acquire_address (pool,
+        GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST, 2);
+    fail_unless (addrs[i] != NULL);
+    fail_unless (addrs[i]->port == 5000 + 2 * i);
+  }
+  fail_unless (gst_rtsp_address_pool_acquire_address (pool,
+          GST_RTSP_ADDRESS_FLAG_UNICAST, 1) == NULL);
+
+  res = gst_rtsp_address_pool_reserve_address (pool, "0.0.0.0", 5005, 1, 0,
+      &addr);
+  fail_unless (res == GST_RTSP_ADDRESS_POOL_ERESERVED);
+  fail_unless (addr == NULL);
+
+  /* the released ports can be acquired and reserved again */
+  gst_rtsp_address_free (addrs[2]);
+  addrs[2] = gst_rtsp_address_pool_acquire_address (pool,
+      GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST, 2);
+  fail_unless (addrs[2] != NULL);
+  fail_unless (addrs[2]->port == 5004);
+
+  gst_rtsp_address_free (addrs[3]);
+  res = gst_rtsp_address_pool_reserve_address (pool, "0.0.0.0", 5007, 1, 0,
+      &addr);
+  fail_unless (res == GST_RTSP_ADDRESS_POOL_OK);
+  fail_unless (addr->port == 5007);
+
+  /* only 5006 is left */
+  fail_unless (gst_rtsp_address_pool_acquire_address (pool,
+          GST_RTSP_ADDRESS_FLAG_UNICAST, 2) == NULL);
+  addrs[3] = gst_rtsp_address_pool_acquire_address (pool,
+      GST_RTSP_ADDRESS_FLAG_UNICAST, 1);
+  fail_unless (addrs[3] != NULL);
+  fail_unless (addrs[3]->port == 5006);
+
+  gst_rtsp_address_free (addr);
+  for (i = 0; i < 5; i++)
+    gst_rtsp_address_free (addrs[i]);
+  gst_rtsp_address_pool_clear (pool);
+
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
+/* the search skips the full last word of a range of more than 64 ports and
+ * then still checks the start of the range */
+GST_START_TEST (test_port_bitmap_wrap)
+{
+  GstRTSPAddressPool *pool;
+  GstRTSPAddress *addrs[50];
+  gint i;
+
+  pool = gst_rtsp_address_pool_new ();
+
+  fail_unless (gst_rtsp_address_pool_add_range (pool,
+          GST_RTSP_ADDRESS_POOL_ANY_IPV4, GST_RTSP_ADDRESS_POOL_ANY_IPV4, 5000,
+          5099, 0));
+
+  for (i = 0; i < 50; i++) {
+    addrs[i] = gst_rtsp_address_pool_acquire_address (pool,
+        GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST, 2);
+    fail_unless (addrs[i] != NULL);
+    fail_unless (addrs[i]->port == 5000 + 2 * i);
+  }
+  fail_unless (gst_rtsp_address_pool_acquire_address (pool,
+          GST_RTSP_ADDRESS_FLAG_UNICAST, 1) == NULL);
+
+  /* move the cursor after 5002 */
+  gst_rtsp_address_free (addrs[1]);
+  addrs[1] = gst_rtsp_address_pool_acquire_address (pool,
+      GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST, 2);
+  fail_unless (addrs[1] != NULL);
+  fail_unless (addrs[1]->port == 5002);
+
+  /* only 5000-5001 is free, before the cursor */
+  gst_rtsp_address_free (addrs[0]);
+  addrs[0] = gst_rtsp_address_pool_acquire_address (pool,
+      GST_RTSP_ADDRESS_FLAG_EVEN_PORT | GST_RTSP_ADDRESS_FLAG_UNICAST, 2);
+  fail_unless (addrs[0] != NULL);
+  fail_unless (addrs[0]->port == 5000);
+
+  for (i = 0; i < 50; i++)
+    gst_rtsp_address_free (addrs[i]);
+  gst_rtsp_address_pool_clear (pool);
+
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_prebound_sockets)
+{
+  GstRTSPAddressPool *pool;
+  GstRTSPAddress *addr;
+  GSocket *rtp_socket = NULL, *rtcp_socket = NULL;
+  GSocketAddress *sockaddr;
+
+  pool = gst_rtsp_address_pool_new ();
+
+  fail_unless (gst_rtsp_address_pool_add_range (pool,
+          "127.0.0.1", "127.0.0.1", 41000, 41099, 0));
+  fail_unless (gst_rtsp_address_pool_get_prebound_pairs (pool) == 0);
+
+  /* nothing is bound yet */
+  addr = gst_rtsp_address_pool_acquire_sockets (pool,
+      GST_RTSP_ADDRESS_FLAG_IPV4, &rtp_socket, &rtcp_socket);
+  fail_unless (addr == NULL);
+
+  gst_rtsp_address_pool_set_prebound_pairs (pool, 2);
+  fail_unless (gst_rtsp_address_pool_get_prebound_pairs (pool) == 2);
+
+  addr = gst_rtsp_address_pool_acquire_sockets (pool,
+      GST_RTSP_ADDRESS_FLAG_IPV6, &rtp_socket, &rtcp_socket);
+  fail_unless (addr == NULL);
+
+  addr = gst_rtsp_address_pool_acquire_sockets (pool,
+      GST_RTSP_ADDRESS_FLAG_IPV4, &rtp_socket, &rtcp_socket);
+  fail_unless (addr != NULL);
+  fail_unless (addr->n_ports == 2);
+  fail_unless ((addr->port & 1) == 0);
+  fail_unless (!strcmp (addr->address, "127.0.0.1"));
+
+  sockaddr = g_socket_get_local_address (rtp_socket, NULL);
+  fail_unless (g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS
+          (sockaddr)) == addr->port);
+  g_object_unref (sockaddr);
+  sockaddr = g_socket_get_local_address (rtcp_socket, NULL);
+  fail_unless (g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS
+          (sockaddr)) == addr->port + 1);
+  g_object_unref (sockaddr);
+
+  /* will fail because an address is allocated */
+  ASSERT_CRITICAL (gst_rtsp_address_pool_clear (pool));
+
+  g_object_unref (rtp_socket);
+  g_object_unref (rtcp_socket);
+  gst_rtsp_address_free (addr);
+
+  /* the ready pairs don't count as allocated */
+  gst_rtsp_address_pool_clear (pool);
+
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspaddresspool_suite (void)
 {
@@ -279,6 +439,9 @@ rtspaddresspool_suite (void)
   suite_add_tcase (s, tc);
   tcase_set_timeout (tc, 20);
   tcase_add_test (tc, test_pool);
+  tcase_add_test (tc, test_port_bitmap);
+  tcase_add_test (tc, test_port_bitmap_wrap);
+  tcase_add_test (tc, test_prebound_sockets);
 
   return s;
 }
@@ -18,6 +18,9 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+
+#include <sys/socket.h>
 
 #include <rtsp-client.h>
 
@@ -1033,6 +1036,566 @@ GST_START_TEST (test_client_sdp_with_no_bitrate_tags)
 
 GST_END_TEST;
 
+static gboolean
+test_setup_response_session (GstRTSPClient * client,
+    GstRTSPMessage * response, gboolean close, gpointer user_data)
+{
+  GstRTSPStatusCode code;
+  gchar *str;
+  gchar **session_hdr_params;
+
+  fail_unless (gst_rtsp_message_parse_response (response, &code, NULL,
+          NULL) == GST_RTSP_OK);
+  fail_unless (code == GST_RTSP_STS_OK);
+
+  fail_unless (gst_rtsp_message_get_header (response, GST_RTSP_HDR_SESSION,
+          &str, 0) == GST_RTSP_OK);
+  session_hdr_params = g_strsplit (str, ";", -1);
+  session_id = g_strdup (session_hdr_params[0]);
+  g_strfreev (session_hdr_params);
+
+  return TRUE;
+}
+
+/* connect two TCP sockets over loopback with small socket buffers so that
+ * the connection is full after a few packets */
+static void
+connect_small_sockets (GSocket ** server, GSocket ** peer)
+{
+  GSocket *listener;
+  GInetAddress *addr;
+  GSocketAddress *sockaddr;
+  gint size = 4096;
+
+  listener = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+      G_SOCKET_PROTOCOL_TCP, NULL);
+  fail_unless (listener != NULL);
+  addr = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  sockaddr = g_inet_socket_address_new (addr, 0);
+  g_object_unref (addr);
+  fail_unless (g_socket_bind (listener, sockaddr, FALSE, NULL));
+  g_object_unref (sockaddr);
+  fail_unless (g_socket_listen (listener, NULL));
+
+  *peer = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_STREAM,
+      G_SOCKET_PROTOCOL_TCP, NULL);
+  fail_unless (*peer != NULL);
+  setsockopt (g_socket_get_fd (*peer), SOL_SOCKET, SO_RCVBUF, &size,
+      sizeof (size));
+  sockaddr = g_socket_get_local_address (listener, NULL);
+  fail_unless (g_socket_connect (*peer, sockaddr, NULL, NULL));
+  g_object_unref (sockaddr);
+
+  *server = g_socket_accept (listener, NULL, NULL);
+  fail_unless (*server != NULL);
+  setsockopt (g_socket_get_fd (*server), SOL_SOCKET, SO_SNDBUF, &size,
+      sizeof (size));
+  g_object_unref (listener);
+}
+
+#define SEND_QUEUE_FILLERS 400
+#define SEND_QUEUE_FIRST_SEQ 1000
+#define SEQ(n) (SEND_QUEUE_FIRST_SEQ + (n))
+
+static void
+send_queue_packet (GstRTSPStreamTransport * trans, guint16 seq,
+    guint32 rtptime, GstClockTime pts, GstBufferFlags flags)
+{
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  GstBuffer *buffer;
+
+  buffer = gst_rtp_buffer_new_allocate (1000, 0, 0);
+  fail_unless (gst_rtp_buffer_map (buffer, GST_MAP_WRITE, &rtp));
+  gst_rtp_buffer_set_payload_type (&rtp, 96);
+  gst_rtp_buffer_set_seq (&rtp, seq);
+  gst_rtp_buffer_set_timestamp (&rtp, rtptime);
+  gst_rtp_buffer_unmap (&rtp);
+  GST_BUFFER_PTS (buffer) = pts;
+  GST_BUFFER_FLAG_SET (buffer, flags);
+
+  fail_unless (gst_rtsp_stream_transport_send_rtp (trans, buffer));
+  gst_buffer_unref (buffer);
+}
+
+static gpointer
+run_loop (GMainLoop * loop)
+{
+  g_main_loop_run (loop);
+  return NULL;
+}
+
+GST_START_TEST (test_client_send_queue)
+{
+  GstRTSPClient *client;
+  GstRTSPConnection *conn, *peer_conn;
+  GSocket *server_sock, *peer_sock;
+  GstRTSPMessage request = { 0, };
+  GstRTSPSessionPool *session_pool;
+  GstRTSPSession *session;
+  GstRTSPSessionMedia *sessmedia;
+  GstRTSPStreamTransport *trans;
+  GMainContext *context;
+  GMainLoop *loop;
+  GThread *thread;
+  GArray *received;
+  guint16 seq = 0;
+  guint32 expected[] = { SEQ (4), SEQ (5), SEQ (6) };
+  gint matched;
+  gchar *str;
+  guint i;
+
+  client = setup_client (NULL);
+  g_object_set (client, "send-queue-max-time", GST_SECOND, NULL);
+
+  connect_small_sockets (&server_sock, &peer_sock);
+  fail_unless (gst_rtsp_connection_create_from_socket (server_sock,
+          "127.0.0.1", 554, NULL, &conn) == GST_RTSP_OK);
+  fail_unless (gst_rtsp_client_set_connection (client, conn));
+  fail_unless (gst_rtsp_connection_create_from_socket (peer_sock,
+          "127.0.0.1", 554, NULL, &peer_conn) == GST_RTSP_OK);
+
+  /* interleaved SETUP, the response is checked before attaching */
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_SETUP,
+          "rtsp://localhost/test/stream=0") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_take_header (&request, GST_RTSP_HDR_CSEQ, str);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_TRANSPORT,
+      "RTP/AVP/TCP;unicast;interleaved=0-1");
+  gst_rtsp_client_set_send_func (client, test_setup_response_session, NULL,
+      NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+  fail_unless (session_id != NULL);
+
+  session_pool = gst_rtsp_client_get_session_pool (client);
+  session = gst_rtsp_session_pool_find (session_pool, session_id);
+  fail_unless (session != NULL);
+  sessmedia = gst_rtsp_session_get_media (session, "/test", &matched);
+  fail_unless (sessmedia != NULL);
+  trans = gst_rtsp_session_media_get_transport (sessmedia, 0);
+  fail_unless (trans != NULL);
+
+  context = g_main_context_new ();
+  loop = g_main_loop_new (context, FALSE);
+  fail_unless (gst_rtsp_client_attach (client, context) > 0);
+  thread = g_thread_new ("send-queue", (GThreadFunc) run_loop, loop);
+
+  /* codec headers are never dropped, they fill the socket and the watch
+   * backlog until packets end up in the send queue */
+  for (i = 0; i < SEND_QUEUE_FILLERS; i++)
+    send_queue_packet (trans, seq++, 0, 0, GST_BUFFER_FLAG_HEADER);
+
+  /* a delta unit, then the first fragment of a keyframe that makes the
+   * queue span more than a second. The delta unit and the fragment are
+   * dropped */
+  send_queue_packet (trans, SEQ (0), 100, GST_SECOND / 2,
+      GST_BUFFER_FLAG_DELTA_UNIT);
+  send_queue_packet (trans, SEQ (1), 200, 2 * GST_SECOND, 0);
+  /* the rest of the damaged keyframe and its delta unit are dropped */
+  send_queue_packet (trans, SEQ (2), 200, 0, 0);
+  send_queue_packet (trans, SEQ (3), 300, 0, GST_BUFFER_FLAG_DELTA_UNIT);
+  /* the next complete keyframe resyncs */
+  send_queue_packet (trans, SEQ (4), 400, 0, 0);
+  send_queue_packet (trans, SEQ (5), 400, 0, 0);
+  send_queue_packet (trans, SEQ (6), 500, 0, GST_BUFFER_FLAG_DELTA_UNIT);
+
+  /* read everything, more headers keep the queue moving */
+  received = g_array_new (FALSE, FALSE, sizeof (guint32));
+  while (received->len == 0 ||
+      g_array_index (received, guint32, received->len - 1) < SEQ (6)) {
+    GTimeVal timeout = { 0, 100000 };
+    GstRTSPResult res;
+    guint8 *data;
+    guint size;
+    guint32 rseq;
+
+    res = gst_rtsp_connection_receive (peer_conn, &request, &timeout);
+    if (res == GST_RTSP_ETIMEOUT) {
+      send_queue_packet (trans, seq++, 0, 0, GST_BUFFER_FLAG_HEADER);
+      fail_unless (seq < SEND_QUEUE_FIRST_SEQ);
+      continue;
+    }
+    fail_unless (res == GST_RTSP_OK);
+    fail_unless (gst_rtsp_message_get_type (&request) ==
+        GST_RTSP_MESSAGE_DATA);
+    gst_rtsp_message_get_body (&request, &data, &size);
+    fail_unless (size >= 12);
+    rseq = GST_READ_UINT16_BE (data + 2);
+    if (rseq >= SEND_QUEUE_FIRST_SEQ)
+      g_array_append_val (received, rseq);
+    gst_rtsp_message_unset (&request);
+  }
+
+  fail_unless_equals_int (received->len, G_N_ELEMENTS (expected));
+  for (i = 0; i < received->len; i++)
+    fail_unless_equals_int (g_array_index (received, guint32, i),
+        expected[i]);
+  g_array_free (received, TRUE);
+
+  g_main_loop_quit (loop);
+  g_thread_join (thread);
+  g_main_loop_unref (loop);
+
+  g_object_unref (sessmedia);
+  g_object_unref (session);
+  g_object_unref (session_pool);
+  g_free (session_id);
+  session_id = NULL;
+
+  gst_rtsp_client_close (client);
+  g_main_context_unref (context);
+  gst_rtsp_connection_free (peer_conn);
+  g_object_unref (server_sock);
+  g_object_unref (peer_sock);
+
+  teardown_client (client);
+}
+
+GST_END_TEST;
+
+static gboolean
+test_response_sdp_store (GstRTSPClient * client, GstRTSPMessage * response,
+    gboolean close, gpointer user_data)
+{
+  gchar **sdp = user_data;
+  guint8 *data;
+  guint size;
+
+  fail_unless (gst_rtsp_message_get_body (response, &data, &size)
+      == GST_RTSP_OK);
+  g_free (*sdp);
+  *sdp = g_strndup ((gchar *) data, size);
+
+  return TRUE;
+}
+
+static void
+describe_shared (GstRTSPClient * client, gchar ** sdp)
+{
+  GstRTSPMessage request = { 0, };
+  gchar *str;
+
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_DESCRIBE,
+          "rtsp://localhost/test") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_CSEQ, str);
+  g_free (str);
+
+  gst_rtsp_client_set_send_func (client, test_response_sdp_store, sdp, NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+}
+
+static gint sdp_cache_hits;
+
+/* the client logs when it answers a DESCRIBE from the SDP cache */
+static void
+count_sdp_cache_hits (GstDebugCategory * category, GstDebugLevel level,
+    const gchar * file, const gchar * function, gint line, GObject * object,
+    GstDebugMessage * message, gpointer user_data)
+{
+  if (g_strcmp0 (gst_debug_category_get_name (category), "rtspclient") == 0
+      && strstr (gst_debug_message_get (message), "using cached SDP"))
+    g_atomic_int_inc (&sdp_cache_hits);
+}
+
+GST_START_TEST (test_client_sdp_cache)
+{
+  GstRTSPClient *client;
+  GstRTSPMountPoints *mount_points;
+  GstRTSPMediaFactory *factory;
+  gchar *sdp1 = NULL, *sdp2 = NULL;
+  GstSDPMessage *msg1, *msg2;
+  gboolean debug_active;
+  GstDebugLevel threshold;
+  GstDebugCategory *category;
+  guint i;
+
+  client = setup_client (NULL);
+  mount_points = gst_rtsp_client_get_mount_points (client);
+  factory = gst_rtsp_mount_points_match (mount_points, "/test", NULL);
+  gst_rtsp_media_factory_set_shared (factory, TRUE);
+  g_object_unref (factory);
+  g_object_unref (mount_points);
+
+  GST_DEBUG_CATEGORY_GET (category, "rtspclient");
+  fail_unless (category != NULL);
+  threshold = gst_debug_category_get_threshold (category);
+  debug_active = gst_debug_is_active ();
+  gst_debug_set_active (TRUE);
+  gst_debug_category_set_threshold (category, GST_LEVEL_DEBUG);
+  gst_debug_add_log_function (count_sdp_cache_hits, NULL, NULL);
+  sdp_cache_hits = 0;
+
+  /* the first DESCRIBE makes the SDP, the second one takes it from the
+   * cache */
+  describe_shared (client, &sdp1);
+  fail_unless_equals_int (g_atomic_int_get (&sdp_cache_hits), 0);
+  describe_shared (client, &sdp2);
+  fail_unless_equals_int (g_atomic_int_get (&sdp_cache_hits), 1);
+  fail_unless (sdp1 != NULL && sdp2 != NULL);
+
+  gst_debug_remove_log_function (count_sdp_cache_hits);
+  gst_debug_category_set_threshold (category, threshold);
+  gst_debug_set_active (debug_active);
+
+  gst_sdp_message_new (&msg1);
+  fail_unless (gst_sdp_message_parse_buffer ((guint8 *) sdp1, strlen (sdp1),
+          msg1) == GST_SDP_OK);
+  gst_sdp_message_new (&msg2);
+  fail_unless (gst_sdp_message_parse_buffer ((guint8 *) sdp2, strlen (sdp2),
+          msg2) == GST_SDP_OK);
+
+  /* the second SDP comes from the cache with a new session id */
+  fail_if (g_strcmp0 (gst_sdp_message_get_origin (msg1)->sess_id,
+          gst_sdp_message_get_origin (msg2)->sess_id) == 0);
+  fail_unless (gst_sdp_message_medias_len (msg1) ==
+      gst_sdp_message_medias_len (msg2));
+  for (i = 0; i < gst_sdp_message_medias_len (msg1); i++) {
+    const GstSDPMedia *m1 = gst_sdp_message_get_media (msg1, i);
+    const GstSDPMedia *m2 = gst_sdp_message_get_media (msg2, i);
+
+    fail_unless (g_strcmp0 (gst_sdp_media_get_media (m1),
+            gst_sdp_media_get_media (m2)) == 0);
+    fail_unless (gst_sdp_media_attributes_len (m1) ==
+        gst_sdp_media_attributes_len (m2));
+  }
+
+  gst_sdp_message_free (msg1);
+  gst_sdp_message_free (msg2);
+  g_free (sdp1);
+  g_free (sdp2);
+
+  teardown_client (client);
+}
+
+GST_END_TEST;
+
+static gboolean
+test_response_200_count (GstRTSPClient * client, GstRTSPMessage * response,
+    gboolean close, gpointer user_data)
+{
+  guint *count = user_data;
+
+  test_response_200 (client, response, close, NULL);
+  (*count)++;
+
+  return TRUE;
+}
+
+static gint url_checks;
+
+/* the auth logs every check it does */
+static void
+count_url_checks (GstDebugCategory * category, GstDebugLevel level,
+    const gchar * file, const gchar * function, gint line, GObject * object,
+    GstDebugMessage * message, gpointer user_data)
+{
+  if (g_strcmp0 (gst_debug_category_get_name (category), "rtspauth") == 0
+      && strstr (gst_debug_message_get (message), GST_RTSP_AUTH_CHECK_URL))
+    g_atomic_int_inc (&url_checks);
+}
+
+static gboolean
+count_emissions (GSignalInvocationHint * ihint, guint n_param_values,
+    const GValue * param_values, gpointer user_data)
+{
+  gint *count = user_data;
+
+  (*count)++;
+
+  return TRUE;
+}
+
+static GstRTSPUrl *keepalive_uri;
+
+static void
+keepalive_options_request (GstRTSPClient * client, GstRTSPContext * ctx,
+    gpointer user_data)
+{
+  keepalive_uri = ctx->uri;
+}
+
+static void
+send_keepalive (GstRTSPClient * client, GstRTSPMethod method,
+    const gchar * url, const gchar * sessid)
+{
+  GstRTSPMessage request = { 0, };
+  gchar *str;
+
+  fail_unless (gst_rtsp_message_init_request (&request, method,
+          url) == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq++);
+  gst_rtsp_message_take_header (&request, GST_RTSP_HDR_CSEQ, str);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_SESSION, sessid);
+
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+}
+
+GST_START_TEST (test_client_keepalive)
+{
+  GstRTSPClient *client;
+  GstRTSPSessionPool *session_pool;
+  GstRTSPSession *session;
+  GstRTSPAuth *auth;
+  GstRTSPMessage request = { 0, };
+  GstRTSPUrl *uri;
+  const gchar *sessid;
+  gboolean debug_active;
+  GstDebugLevel threshold;
+  GstDebugCategory *category;
+  guint signal_id;
+  gulong hook_id;
+  guint count = 0;
+  gint emissions = 0;
+  gint i;
+
+  client = gst_rtsp_client_new ();
+  session_pool = gst_rtsp_session_pool_new ();
+  gst_rtsp_client_set_session_pool (client, session_pool);
+  auth = gst_rtsp_auth_new ();
+  gst_rtsp_client_set_auth (client, auth);
+
+  session = gst_rtsp_session_pool_create (session_pool);
+  sessid = gst_rtsp_session_get_sessionid (session);
+
+  gst_rtsp_client_set_send_func (client, test_response_200_count, &count,
+      NULL);
+
+  GST_DEBUG_CATEGORY_GET (category, "rtspauth");
+  fail_unless (category != NULL);
+  threshold = gst_debug_category_get_threshold (category);
+  debug_active = gst_debug_is_active ();
+  gst_debug_set_active (TRUE);
+  gst_debug_category_set_threshold (category, GST_LEVEL_DEBUG);
+  gst_debug_add_log_function (count_url_checks, NULL, NULL);
+  url_checks = 0;
+
+  signal_id = g_signal_lookup ("options-request", GST_TYPE_RTSP_CLIENT);
+  hook_id = g_signal_add_emission_hook (signal_id, 0, count_emissions,
+      &emissions, NULL);
+
+  for (i = 0; i < 4; i++)
+    send_keepalive (client, i % 2 ? GST_RTSP_OPTIONS : GST_RTSP_GET_PARAMETER,
+        "rtsp://localhost/test", sessid);
+  fail_unless_equals_int (count, 4);
+
+  /* the default auth can't refuse the url of these methods, it is not asked */
+  fail_unless_equals_int (g_atomic_int_get (&url_checks), 0);
+  gst_debug_remove_log_function (count_url_checks);
+  gst_debug_category_set_threshold (category, threshold);
+  gst_debug_set_active (debug_active);
+
+  /* without handlers, the signal is not emitted */
+  fail_unless_equals_int (emissions, 0);
+
+  g_signal_connect (client, "options-request",
+      G_CALLBACK (keepalive_options_request), NULL);
+  send_keepalive (client, GST_RTSP_OPTIONS, "rtsp://localhost/test", sessid);
+  fail_unless_equals_int (emissions, 1);
+  fail_unless (keepalive_uri != NULL);
+
+  /* the same url is not parsed again */
+  uri = keepalive_uri;
+  send_keepalive (client, GST_RTSP_OPTIONS, "rtsp://localhost/test", sessid);
+  fail_unless_equals_int (emissions, 2);
+  fail_unless (keepalive_uri == uri);
+
+  /* another url is */
+  send_keepalive (client, GST_RTSP_OPTIONS, "rtsp://localhost/test2", sessid);
+  fail_unless_equals_int (emissions, 3);
+  fail_unless_equals_string (keepalive_uri->abspath, "/test2");
+  fail_unless_equals_int (count, 7);
+
+  g_signal_remove_emission_hook (signal_id, hook_id);
+
+  /* the cached url must not leak into requests for other urls */
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_OPTIONS,
+          "foopy://padoop/") == GST_RTSP_OK);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_CSEQ, "1");
+  gst_rtsp_client_set_send_func (client, test_response_400, NULL, NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+
+  gst_rtsp_session_pool_remove (session_pool, session);
+  g_object_unref (session);
+  g_object_unref (session_pool);
+  g_object_unref (auth);
+  g_object_unref (client);
+}
+
+GST_END_TEST;
+
+static void
+request_traced (GstRTSPClient * client, GstRTSPContext * ctx,
+    GArray ** spans)
+{
+  /* the trace is only valid during the signal emission */
+  *spans = g_array_new (FALSE, FALSE, sizeof (GstRTSPTraceSpan));
+  g_array_append_vals (*spans, ctx->trace->data, ctx->trace->len);
+}
+
+static gboolean
+has_span (GArray * spans, const gchar * name)
+{
+  guint i;
+
+  for (i = 0; i < spans->len; i++) {
+    GstRTSPTraceSpan *span = &g_array_index (spans, GstRTSPTraceSpan, i);
+
+    if (!strcmp (span->name, name))
+      return span->end >= span->start;
+  }
+  return FALSE;
+}
+
+GST_START_TEST (test_client_request_trace)
+{
+  GstRTSPClient *client;
+  GstRTSPMessage request = { 0, };
+  GstRTSPTraceSpan *span;
+  GArray *spans = NULL;
+  gchar *str;
+
+  client = setup_client (NULL);
+  g_signal_connect (client, "request-traced", G_CALLBACK (request_traced),
+      &spans);
+
+  fail_unless (gst_rtsp_message_init_request (&request, GST_RTSP_DESCRIBE,
+          "rtsp://localhost/test") == GST_RTSP_OK);
+  str = g_strdup_printf ("%d", cseq);
+  gst_rtsp_message_add_header (&request, GST_RTSP_HDR_CSEQ, str);
+  g_free (str);
+
+  gst_rtsp_client_set_send_func (client, test_response_200, NULL, NULL);
+  fail_unless (gst_rtsp_client_handle_message (client,
+          &request) == GST_RTSP_OK);
+  gst_rtsp_message_unset (&request);
+
+  fail_unless (spans != NULL);
+  span = &g_array_index (spans, GstRTSPTraceSpan, 0);
+  fail_unless_equals_string (span->name, "request");
+  fail_unless (span->end >= span->start);
+
+  fail_unless (has_span (spans, "find-factory"));
+  fail_unless (has_span (spans, "construct"));
+  fail_unless (has_span (spans, "prepare"));
+  fail_unless (has_span (spans, "wait-preroll"));
+  fail_unless (has_span (spans, "alloc-ports"));
+  fail_unless (has_span (spans, "sdp"));
+  fail_unless (has_span (spans, "send"));
+  g_array_free (spans, TRUE);
+
+  teardown_client (client);
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspclient_suite (void)
 {
@@ -1054,6 +1617,10 @@ rtspclient_suite (void)
   tcase_add_test (tc, test_client_sdp_with_bitrate_tag);
   tcase_add_test (tc, test_client_sdp_with_max_bitrate_and_bitrate_tags);
   tcase_add_test (tc, test_client_sdp_with_no_bitrate_tags);
+  tcase_add_test (tc, test_client_send_queue);
+  tcase_add_test (tc, test_client_sdp_cache);
+  tcase_add_test (tc, test_client_keepalive);
+  tcase_add_test (tc, test_client_request_trace);
 
   return s;
 }
@@ -314,6 +314,197 @@ GST_START_TEST (test_reset)
 
 GST_END_TEST;
 
+GST_START_TEST (test_udp_send_mode)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media;
+  GstRTSPStream *stream;
+  GstRTSPUrl *url;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_media_factory_get_udp_send_mode (factory) ==
+      GST_RTSP_UDP_SEND_MODE_SINK);
+  gst_rtsp_url_parse ("rtsp://localhost:8554/test", &url);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+  gst_rtsp_media_factory_set_udp_send_mode (factory,
+      GST_RTSP_UDP_SEND_MODE_FANOUT);
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_get_udp_send_mode (media) ==
+      GST_RTSP_UDP_SEND_MODE_FANOUT);
+  fail_unless (gst_rtsp_media_n_streams (media) == 1);
+  stream = gst_rtsp_media_get_stream (media, 0);
+  fail_unless (gst_rtsp_stream_get_udp_send_mode (stream) ==
+      GST_RTSP_UDP_SEND_MODE_FANOUT);
+
+  gst_rtsp_media_set_udp_send_mode (media, GST_RTSP_UDP_SEND_MODE_FANOUT_GSO);
+  fail_unless (gst_rtsp_stream_get_udp_send_mode (stream) ==
+      GST_RTSP_UDP_SEND_MODE_FANOUT_GSO);
+  g_object_unref (media);
+
+  gst_rtsp_url_free (url);
+  g_object_unref (factory);
+}
+
+GST_END_TEST;
+
+static gint standby_prepared;
+static gint standby_unprepared;
+
+static void
+standby_media_prepared (GstRTSPMedia * media, gint * count)
+{
+  g_mutex_lock (&check_mutex);
+  (*count)++;
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+}
+
+static void
+standby_media_configure (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    gpointer user_data)
+{
+  /* after the handler of the factory that puts the media on standby */
+  g_signal_connect_after (media, "prepared",
+      G_CALLBACK (standby_media_prepared), &standby_prepared);
+  g_signal_connect (media, "unprepared",
+      G_CALLBACK (standby_media_prepared), &standby_unprepared);
+}
+
+static void
+wait_standby_count (gint * count, gint value)
+{
+  g_mutex_lock (&check_mutex);
+  while (*count < value)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+}
+
+GST_START_TEST (test_standby_pool)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media, *media2;
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  GstRTSPUrl *url;
+  guint size;
+
+  factory = gst_rtsp_media_factory_new ();
+  fail_unless (gst_rtsp_media_factory_get_standby_pool_size (factory) == 0);
+  gst_rtsp_url_parse ("rtsp://localhost:8554/test", &url);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+  g_signal_connect (factory, "media-configure",
+      G_CALLBACK (standby_media_configure), NULL);
+  g_object_set (factory, "standby-pool-size", 1, NULL);
+  g_object_get (factory, "standby-pool-size", &size, NULL);
+  fail_unless (size == 1);
+
+  /* the first request is not served from the pool */
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (GST_IS_RTSP_MEDIA (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  g_object_unref (media);
+
+  /* the pool prepares a media in the background */
+  wait_standby_count (&standby_prepared, 1);
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+
+  /* preparing takes over the standby media, unprepare really unprepares */
+  pool = gst_rtsp_thread_pool_new ();
+  thread = gst_rtsp_thread_pool_get_thread (pool,
+      GST_RTSP_THREAD_TYPE_MEDIA, NULL);
+  fail_unless (gst_rtsp_media_prepare (media, thread));
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  fail_unless_equals_int (standby_unprepared, 1);
+
+  /* a standby media is handed out prepared once, one unprepare releases it
+   * when it is not used */
+  wait_standby_count (&standby_prepared, 2);
+  media2 = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (media2 != media);
+  fail_unless (gst_rtsp_media_get_status (media2) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+  fail_unless (gst_rtsp_media_unprepare (media2));
+  fail_unless (gst_rtsp_media_get_status (media2) ==
+      GST_RTSP_MEDIA_STATUS_UNPREPARED);
+  fail_unless_equals_int (standby_unprepared, 2);
+  g_object_unref (media2);
+  g_object_unref (media);
+
+  /* the media left on standby is unprepared with the factory */
+  wait_standby_count (&standby_prepared, 3);
+  g_object_unref (factory);
+  wait_standby_count (&standby_unprepared, 3);
+
+  g_object_unref (pool);
+  gst_rtsp_url_free (url);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_standby_pool_keys)
+{
+  GstRTSPMediaFactory *factory;
+  GstRTSPMedia *media, *media2;
+  GstRTSPUrl *url, *url2;
+
+  standby_prepared = standby_unprepared = 0;
+
+  factory = gst_rtsp_media_factory_new ();
+  gst_rtsp_url_parse ("rtsp://localhost:8554/test", &url);
+  gst_rtsp_url_parse ("rtsp://localhost:8554/test2", &url2);
+
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! rtpvrawpay pt=96 name=pay0 )");
+  g_signal_connect (factory, "media-configure",
+      G_CALLBACK (standby_media_configure), NULL);
+  gst_rtsp_media_factory_set_standby_pool_size (factory, 1);
+
+  media = gst_rtsp_media_factory_construct (factory, url);
+  g_object_unref (media);
+  media = gst_rtsp_media_factory_construct (factory, url2);
+  g_object_unref (media);
+
+  /* both urls keep a media on standby */
+  wait_standby_count (&standby_prepared, 2);
+  media = gst_rtsp_media_factory_construct (factory, url);
+  fail_unless (gst_rtsp_media_get_status (media) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+  media2 = gst_rtsp_media_factory_construct (factory, url2);
+  fail_unless (gst_rtsp_media_get_status (media2) ==
+      GST_RTSP_MEDIA_STATUS_PREPARED);
+  fail_unless (media != media2);
+
+  fail_unless (gst_rtsp_media_unprepare (media));
+  fail_unless (gst_rtsp_media_unprepare (media2));
+  g_object_unref (media);
+  g_object_unref (media2);
+
+  /* the refills are unprepared with the factory */
+  wait_standby_count (&standby_prepared, 4);
+  g_object_unref (factory);
+  wait_standby_count (&standby_unprepared, 4);
+
+  gst_rtsp_url_free (url);
+  gst_rtsp_url_free (url2);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspmediafactory_suite (void)
 {
@@ -329,6 +520,9 @@ rtspmediafactory_suite (void)
   tcase_add_test (tc, test_addresspool);
   tcase_add_test (tc, test_permissions);
   tcase_add_test (tc, test_reset);
+  tcase_add_test (tc, test_udp_send_mode);
+  tcase_add_test (tc, test_standby_pool);
+  tcase_add_test (tc, test_standby_pool_keys);
 
   return s;
 }
@@ -130,6 +130,102 @@ GST_START_TEST (test_match)
 
 GST_END_TEST;
 
+GST_START_TEST (test_match_siblings)
+{
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *f1, *f2, *f3, *f4, *tmp;
+  gint matched;
+
+  mounts = gst_rtsp_mount_points_new ();
+
+  f1 = gst_rtsp_media_factory_new ();
+  gst_rtsp_mount_points_add_factory (mounts, "/cam", f1);
+  f2 = gst_rtsp_media_factory_new ();
+  gst_rtsp_mount_points_add_factory (mounts, "/cam/a", f2);
+  f3 = gst_rtsp_media_factory_new ();
+  gst_rtsp_mount_points_add_factory (mounts, "/cam/b", f3);
+
+  /* a sibling mount point does not hide the longest match */
+  tmp = gst_rtsp_mount_points_match (mounts, "/cam/b/stream=0", &matched);
+  fail_unless (tmp == f3);
+  fail_unless (matched == 6);
+  g_object_unref (tmp);
+  tmp = gst_rtsp_mount_points_match (mounts, "/cam/c", &matched);
+  fail_unless (tmp == f1);
+  fail_unless (matched == 4);
+  g_object_unref (tmp);
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/cam/c", NULL) == NULL);
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/ca", &matched) == NULL);
+
+  /* adding a factory for an existing mount point replaces it */
+  f4 = gst_rtsp_media_factory_new ();
+  gst_rtsp_mount_points_add_factory (mounts, "/cam/b", f4);
+  tmp = gst_rtsp_mount_points_match (mounts, "/cam/b", NULL);
+  fail_unless (tmp == f4);
+  g_object_unref (tmp);
+
+  gst_rtsp_mount_points_remove_factory (mounts, "/cam");
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/cam/c", &matched) ==
+      NULL);
+  tmp = gst_rtsp_mount_points_match (mounts, "/cam/a", NULL);
+  fail_unless (tmp == f2);
+  g_object_unref (tmp);
+
+  gst_rtsp_mount_points_remove_factory (mounts, "/cam/a");
+  gst_rtsp_mount_points_remove_factory (mounts, "/cam/b");
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/cam/a", &matched) ==
+      NULL);
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/cam/b", &matched) ==
+      NULL);
+
+  g_object_unref (mounts);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_update)
+{
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *tmp;
+  gchar *path;
+  gint i;
+
+  mounts = gst_rtsp_mount_points_new ();
+
+  gst_rtsp_mount_points_add_factory (mounts, "/cam/0",
+      gst_rtsp_media_factory_new ());
+
+  gst_rtsp_mount_points_begin_update (mounts);
+  for (i = 1; i < 1000; i++) {
+    path = g_strdup_printf ("/cam/%d", i);
+    gst_rtsp_mount_points_add_factory (mounts, path,
+        gst_rtsp_media_factory_new ());
+    g_free (path);
+  }
+  gst_rtsp_mount_points_remove_factory (mounts, "/cam/0");
+
+  /* nothing changed until the update is committed */
+  tmp = gst_rtsp_mount_points_match (mounts, "/cam/0", NULL);
+  fail_unless (tmp != NULL);
+  g_object_unref (tmp);
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/cam/1", NULL) == NULL);
+
+  gst_rtsp_mount_points_commit_update (mounts);
+
+  fail_unless (gst_rtsp_mount_points_match (mounts, "/cam/0", NULL) == NULL);
+  for (i = 1; i < 1000; i++) {
+    path = g_strdup_printf ("/cam/%d", i);
+    tmp = gst_rtsp_mount_points_match (mounts, path, NULL);
+    fail_unless (tmp != NULL);
+    g_object_unref (tmp);
+    g_free (path);
+  }
+
+  g_object_unref (mounts);
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspmountpoints_suite (void)
 {
@@ -140,6 +236,8 @@ rtspmountpoints_suite (void)
   tcase_set_timeout (tc, 20);
   tcase_add_test (tc, test_create);
   tcase_add_test (tc, test_match);
+  tcase_add_test (tc, test_match_siblings);
+  tcase_add_test (tc, test_update);
 
   return s;
 }
@@ -629,6 +629,116 @@ GST_START_TEST (test_describe)
 
 GST_END_TEST;
 
+#define N_ACCEPTOR_CONNECTIONS 6
+
+GST_START_TEST (test_describe_multiple_acceptors)
+{
+  GstRTSPConnection *conns[N_ACCEPTOR_CONNECTIONS];
+  GstRTSPThreadPool *pool;
+  GstSDPMessage *sdp_message;
+  gint i;
+
+  pool = gst_rtsp_server_get_thread_pool (server);
+  gst_rtsp_thread_pool_set_max_threads (pool, 4);
+  g_object_unref (pool);
+
+  gst_rtsp_server_set_acceptors (server, 3);
+  fail_unless (gst_rtsp_server_get_acceptors (server) == 3);
+
+  start_server ();
+
+  /* the connections are spread over the listening sockets by the kernel,
+   * all of them should be served */
+  for (i = 0; i < N_ACCEPTOR_CONNECTIONS; i++)
+    conns[i] = connect_to_server (test_port, TEST_MOUNT_POINT);
+
+  for (i = 0; i < N_ACCEPTOR_CONNECTIONS; i++) {
+    sdp_message = do_describe (conns[i], TEST_MOUNT_POINT);
+    fail_unless (gst_sdp_message_medias_len (sdp_message) == 2);
+    gst_sdp_message_free (sdp_message);
+  }
+
+  /* clean up and iterate so the clean-up can finish */
+  for (i = 0; i < N_ACCEPTOR_CONNECTIONS; i++)
+    gst_rtsp_connection_free (conns[i]);
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_metrics)
+{
+  GstRTSPConnection *conn;
+  GstSDPMessage *sdp_message;
+  GSocketClient *socket_client;
+  GSocketConnection *connection;
+  GString *response;
+  const gchar *request = "GET /metrics HTTP/1.0\r\n\r\n";
+  gchar *metrics, *service, buffer[1024];
+  gssize len;
+
+  gst_rtsp_server_set_metrics_service (server, "0");
+
+  start_server ();
+
+  conn = connect_to_server (test_port, TEST_MOUNT_POINT);
+  sdp_message = do_describe (conn, TEST_MOUNT_POINT);
+  gst_sdp_message_free (sdp_message);
+  /* the DESCRIBE is counted after its response, the next response is only
+   * sent after that */
+  fail_unless (do_simple_request (conn, GST_RTSP_OPTIONS,
+          NULL) == GST_RTSP_STS_OK);
+
+  metrics = gst_rtsp_server_get_metrics (server);
+  fail_unless (strstr (metrics, "\ngst_rtsp_clients 1\n") != NULL);
+  fail_unless (strstr (metrics,
+          "\ngst_rtsp_factory_media_constructed_total{path=\"/test\"} 1\n")
+      != NULL);
+  /* the request latency is counted per server */
+  fail_unless (strstr (metrics,
+          "\ngst_rtsp_request_duration_seconds_count{method=\"DESCRIBE\"} 1\n")
+      != NULL);
+  /* nothing was streamed yet */
+  fail_unless (strstr (metrics, "\ngst_rtsp_copied_packets_total 0\n") != NULL);
+  fail_unless (strstr (metrics, "\ngst_rtsp_copied_bytes_total 0\n") != NULL);
+  g_free (metrics);
+
+  /* the same metrics are served over HTTP from a thread of the pool */
+  service = gst_rtsp_server_get_metrics_service (server);
+  fail_unless (atoi (service) != 0);
+
+  socket_client = g_socket_client_new ();
+  connection = g_socket_client_connect_to_host (socket_client, "127.0.0.1",
+      atoi (service), NULL, NULL);
+  fail_unless (connection != NULL);
+  g_free (service);
+
+  fail_unless (g_output_stream_write_all (g_io_stream_get_output_stream
+          (G_IO_STREAM (connection)), request, strlen (request), NULL, NULL,
+          NULL));
+
+  response = g_string_new (NULL);
+  while ((len = g_input_stream_read (g_io_stream_get_input_stream
+              (G_IO_STREAM (connection)), buffer, sizeof (buffer), NULL,
+              NULL)) > 0)
+    g_string_append_len (response, buffer, len);
+
+  fail_unless (g_str_has_prefix (response->str, "HTTP/1.0 200 OK\r\n"));
+  fail_unless (strstr (response->str, "\ngst_rtsp_sessions 0\n") != NULL);
+  g_string_free (response, TRUE);
+
+  g_object_unref (connection);
+  g_object_unref (socket_client);
+
+  /* clean up and iterate so the clean-up can finish */
+  gst_rtsp_connection_free (conn);
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_describe_record_media)
 {
   GstRTSPConnection *conn;
@@ -650,6 +760,139 @@ GST_START_TEST (test_describe_record_media)
 
 GST_END_TEST;
 
+/* requests sent while the media prerolls are answered in order */
+GST_START_TEST (test_describe_pipelined)
+{
+  GstRTSPConnection *conn;
+  GstRTSPMessage *request;
+  GstRTSPMessage *response;
+  GstRTSPStatusCode code;
+  gchar *value;
+
+  start_server ();
+
+  conn = connect_to_server (test_port, TEST_MOUNT_POINT);
+
+  /* send DESCRIBE and OPTIONS without waiting for the response */
+  request = create_request (conn, GST_RTSP_DESCRIBE, NULL);
+  fail_unless (send_request (conn, request));
+  gst_rtsp_message_free (request);
+  request = create_request (conn, GST_RTSP_OPTIONS, NULL);
+  fail_unless (send_request (conn, request));
+  gst_rtsp_message_free (request);
+
+  iterate ();
+
+  /* the DESCRIBE response comes first */
+  response = read_response (conn);
+  gst_rtsp_message_parse_response (response, &code, NULL, NULL);
+  fail_unless (code == GST_RTSP_STS_OK);
+  fail_unless (gst_rtsp_message_get_header (response,
+          GST_RTSP_HDR_CONTENT_TYPE, &value, 0) == GST_RTSP_OK);
+  fail_unless (!g_strcmp0 (value, "application/sdp"));
+  gst_rtsp_message_free (response);
+
+  response = read_response (conn);
+  gst_rtsp_message_parse_response (response, &code, NULL, NULL);
+  fail_unless (code == GST_RTSP_STS_OK);
+  fail_unless (gst_rtsp_message_get_header (response,
+          GST_RTSP_HDR_PUBLIC, &value, 0) == GST_RTSP_OK);
+  gst_rtsp_message_free (response);
+
+  /* clean up and iterate so the clean-up can finish */
+  gst_rtsp_connection_free (conn);
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
+static void
+media_configure_valve (GstRTSPMediaFactory * factory, GstRTSPMedia * media,
+    GstElement ** valve)
+{
+  GstElement *element;
+
+  element = gst_rtsp_media_get_element (media);
+
+  g_mutex_lock (&check_mutex);
+  *valve = gst_bin_get_by_name (GST_BIN (element), "valve");
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  gst_object_unref (element);
+}
+
+/* a DESCRIBE waits for the media to preroll without blocking the client
+ * thread and is answered when the preroll completes */
+GST_START_TEST (test_describe_suspended)
+{
+  GstRTSPConnection *conn, *conn2;
+  GstRTSPMountPoints *mounts;
+  GstRTSPMediaFactory *factory;
+  GstRTSPMessage *request;
+  GstRTSPMessage *response;
+  GstRTSPStatusCode code;
+  GstElement *valve = NULL;
+  GTimeVal timeout = { 0, 500000 };
+  gchar *value;
+
+  mounts = gst_rtsp_server_get_mount_points (server);
+  factory = gst_rtsp_media_factory_new ();
+  /* the valve keeps the media from prerolling until we open it */
+  gst_rtsp_media_factory_set_launch (factory,
+      "( videotestsrc ! valve name=valve drop=true ! "
+      "video/x-raw,width=352,height=288 ! rtpgstpay name=pay0 pt=96 )");
+  g_signal_connect (factory, "media-configure",
+      G_CALLBACK (media_configure_valve), &valve);
+  gst_rtsp_mount_points_add_factory (mounts, TEST_MOUNT_POINT "2", factory);
+  g_object_unref (mounts);
+
+  start_server ();
+
+  conn = connect_to_server (test_port, TEST_MOUNT_POINT "2");
+
+  request = create_request (conn, GST_RTSP_DESCRIBE, NULL);
+  fail_unless (send_request (conn, request));
+  gst_rtsp_message_free (request);
+
+  g_mutex_lock (&check_mutex);
+  while (valve == NULL)
+    g_cond_wait (&check_cond, &check_mutex);
+  g_mutex_unlock (&check_mutex);
+
+  /* the media can't preroll, no response yet */
+  gst_rtsp_message_new (&response);
+  fail_unless (gst_rtsp_connection_receive (conn, response,
+          &timeout) == GST_RTSP_ETIMEOUT);
+  gst_rtsp_message_free (response);
+
+  /* the client thread is not blocked, another client is served by it */
+  conn2 = connect_to_server (test_port, TEST_MOUNT_POINT);
+  fail_unless (do_simple_request (conn2, GST_RTSP_OPTIONS,
+          NULL) == GST_RTSP_STS_OK);
+  gst_rtsp_connection_free (conn2);
+
+  /* let the media preroll, the suspended DESCRIBE resumes */
+  g_object_set (valve, "drop", FALSE, NULL);
+
+  response = read_response (conn);
+  fail_unless (response != NULL);
+  gst_rtsp_message_parse_response (response, &code, NULL, NULL);
+  fail_unless (code == GST_RTSP_STS_OK);
+  fail_unless (gst_rtsp_message_get_header (response,
+          GST_RTSP_HDR_CONTENT_TYPE, &value, 0) == GST_RTSP_OK);
+  fail_unless (!g_strcmp0 (value, "application/sdp"));
+  gst_rtsp_message_free (response);
+
+  gst_object_unref (valve);
+  gst_rtsp_connection_free (conn);
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_describe_non_existing_mount_point)
 {
   GstRTSPConnection *conn;
@@ -1109,6 +1352,124 @@ GST_START_TEST (test_play)
 
 GST_END_TEST;
 
+/* receive messages on @conn until an interleaved RTP packet arrives on
+ * @channel. Data on other channels is skipped. */
+static void
+receive_interleaved_rtp (GstRTSPConnection * conn, guint8 channel)
+{
+  GstRTSPMessage *message;
+
+  fail_unless (gst_rtsp_message_new (&message) == GST_RTSP_OK);
+
+  for (;;) {
+    guint8 msg_channel;
+    guint8 *data;
+    guint size;
+
+    fail_unless (gst_rtsp_connection_receive (conn, message,
+            NULL) == GST_RTSP_OK);
+
+    if (gst_rtsp_message_get_type (message) == GST_RTSP_MESSAGE_DATA) {
+      gst_rtsp_message_parse_data (message, &msg_channel);
+
+      if (msg_channel == channel) {
+        gst_rtsp_message_get_body (message, &data, &size);
+        /* must at least contain a version 2 RTP header */
+        fail_unless (size >= 12);
+        fail_unless_equals_int (data[0] >> 6, 2);
+        break;
+      }
+    }
+    gst_rtsp_message_unset (message);
+  }
+  gst_rtsp_message_free (message);
+}
+
+/* send a request with a session and skip interleaved data until the response
+ * is received */
+static GstRTSPStatusCode
+do_simple_request_tcp (GstRTSPConnection * conn, GstRTSPMethod method,
+    const gchar * session)
+{
+  GstRTSPMessage *request;
+  GstRTSPMessage *response;
+  GstRTSPStatusCode code;
+
+  request = create_request (conn, method, NULL);
+  gst_rtsp_message_add_header (request, GST_RTSP_HDR_SESSION, session);
+  fail_unless (send_request (conn, request));
+  gst_rtsp_message_free (request);
+
+  iterate ();
+
+  fail_unless (gst_rtsp_message_new (&response) == GST_RTSP_OK);
+  do {
+    gst_rtsp_message_unset (response);
+    fail_unless (gst_rtsp_connection_receive (conn, response,
+            NULL) == GST_RTSP_OK);
+  } while (gst_rtsp_message_get_type (response) == GST_RTSP_MESSAGE_DATA);
+
+  fail_unless (gst_rtsp_message_get_type (response) ==
+      GST_RTSP_MESSAGE_RESPONSE);
+  gst_rtsp_message_parse_response (response, &code, NULL, NULL);
+  gst_rtsp_message_free (response);
+
+  return code;
+}
+
+GST_START_TEST (test_play_tcp)
+{
+  GstRTSPConnection *conn;
+  GstSDPMessage *sdp_message = NULL;
+  const GstSDPMedia *sdp_media;
+  const gchar *video_control;
+  gchar *session = NULL, *metrics;
+  GstRTSPTransport *video_transport = NULL;
+
+  start_server ();
+
+  conn = connect_to_server (test_port, TEST_MOUNT_POINT);
+
+  sdp_message = do_describe (conn, TEST_MOUNT_POINT);
+
+  /* get control strings from DESCRIBE response */
+  fail_unless (gst_sdp_message_medias_len (sdp_message) == 2);
+  sdp_media = gst_sdp_message_get_media (sdp_message, 0);
+  video_control = gst_sdp_media_get_attribute_val (sdp_media, "control");
+
+  /* do SETUP for video over TCP */
+  fail_unless (do_setup_tcp (conn, video_control, &session,
+          &video_transport) == GST_RTSP_STS_OK);
+  fail_unless (video_transport->lower_transport == GST_RTSP_LOWER_TRANS_TCP);
+
+  /* send PLAY request and check that we get 200 OK */
+  fail_unless (do_simple_request (conn, GST_RTSP_PLAY,
+          session) == GST_RTSP_STS_OK);
+
+  /* RTP is now interleaved on the RTSP connection */
+  receive_interleaved_rtp (conn, video_transport->interleaved.min);
+
+  /* the packets were copied to frame them for the connection */
+  metrics = gst_rtsp_server_get_metrics (server);
+  fail_unless (strstr (metrics, "\ngst_rtsp_copied_packets_total ") != NULL);
+  fail_if (strstr (metrics, "\ngst_rtsp_copied_packets_total 0\n") != NULL);
+  g_free (metrics);
+
+  /* send TEARDOWN request and check that we get 200 OK */
+  fail_unless (do_simple_request_tcp (conn, GST_RTSP_TEARDOWN,
+          session) == GST_RTSP_STS_OK);
+
+  /* clean up and iterate so the clean-up can finish */
+  g_free (session);
+  gst_rtsp_transport_free (video_transport);
+  gst_sdp_message_free (sdp_message);
+  gst_rtsp_connection_free (conn);
+  stop_server ();
+  iterate ();
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_play_without_session)
 {
   GstRTSPConnection *conn;
@@ -1921,6 +2282,10 @@ rtspserver_suite (void)
   tcase_set_timeout (tc, 120);
   tcase_add_test (tc, test_connect);
   tcase_add_test (tc, test_describe);
+  tcase_add_test (tc, test_describe_pipelined);
+  tcase_add_test (tc, test_describe_suspended);
+  tcase_add_test (tc, test_describe_multiple_acceptors);
+  tcase_add_test (tc, test_metrics);
   tcase_add_test (tc, test_describe_non_existing_mount_point);
   tcase_add_test (tc, test_describe_record_media);
   tcase_add_test (tc, test_setup);
@@ -1929,6 +2294,7 @@ rtspserver_suite (void)
   tcase_add_test (tc, test_setup_with_require_header);
   tcase_add_test (tc, test_setup_non_existing_stream);
   tcase_add_test (tc, test_play);
+  tcase_add_test (tc, test_play_tcp);
   tcase_add_test (tc, test_play_without_session);
   tcase_add_test (tc, test_bind_already_in_use);
   tcase_add_test (tc, test_play_multithreaded);
@@ -181,6 +181,61 @@ GST_START_TEST (test_pool)
 
 GST_END_TEST;
 
+GST_START_TEST (test_pool_shards)
+{
+  GstRTSPSessionPool *pool;
+  GstRTSPSession *sessions[16];
+  GstRTSPSession *compare;
+  GList *list;
+  guint n_shards;
+  gint i;
+
+  pool = g_object_new (GST_TYPE_RTSP_SESSION_POOL, "n-shards", 4, NULL);
+  g_object_get (pool, "n-shards", &n_shards, NULL);
+  fail_unless_equals_int (n_shards, 4);
+
+  gst_rtsp_session_pool_set_max_sessions (pool, 16);
+
+  for (i = 0; i < 16; i++) {
+    sessions[i] = gst_rtsp_session_pool_create (pool);
+    fail_unless (GST_IS_RTSP_SESSION (sessions[i]));
+    fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), i + 1);
+  }
+  /* the limit holds over all shards */
+  fail_if (GST_IS_RTSP_SESSION (gst_rtsp_session_pool_create (pool)));
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), 16);
+
+  for (i = 0; i < 16; i++) {
+    compare = gst_rtsp_session_pool_find (pool,
+        gst_rtsp_session_get_sessionid (sessions[i]));
+    fail_unless (compare == sessions[i]);
+    g_object_unref (compare);
+  }
+
+  list = gst_rtsp_session_pool_filter (pool, NULL, NULL);
+  fail_unless_equals_int (g_list_length (list), 16);
+  g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+  for (i = 0; i < 8; i++) {
+    fail_unless (gst_rtsp_session_pool_remove (pool, sessions[i]));
+    fail_if (gst_rtsp_session_pool_remove (pool, sessions[i]));
+  }
+  fail_unless_equals_int (gst_rtsp_session_pool_get_n_sessions (pool), 8);
+
+  list = gst_rtsp_session_pool_filter (pool, NULL, NULL);
+  fail_unless_equals_int (g_list_length (list), 8);
+  for (i = 8; i < 16; i++)
+    fail_unless (g_list_find (list, sessions[i]) != NULL);
+  g_list_free_full (list, (GDestroyNotify) g_object_unref);
+
+  for (i = 0; i < 16; i++)
+    g_object_unref (sessions[i]);
+
+  g_object_unref (pool);
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspsessionpool_suite (void)
 {
@@ -190,6 +245,7 @@ rtspsessionpool_suite (void)
   suite_add_tcase (s, tc);
   tcase_set_timeout (tc, 15);
   tcase_add_test (tc, test_pool);
+  tcase_add_test (tc, test_pool_shards);
 
   return s;
 }
@@ -18,10 +18,28 @@
  */
 
 #include <gst/check/gstcheck.h>
+#include <gst/rtp/gstrtpbuffer.h>
+#include <gst/rtp/gstrtcpbuffer.h>
+
+#ifdef G_OS_UNIX
+#include <sys/socket.h>
+#endif
 
 #include <rtsp-stream.h>
+#include <rtsp-stream-transport.h>
 #include <rtsp-address-pool.h>
 
+/* wait with the check_mutex until @cond holds, the threads that change what
+ * it depends on do that with the check_mutex and broadcast the check_cond */
+#define WAIT_UNTIL(cond) G_STMT_START {                                     \
+  gint64 end_time = g_get_monotonic_time () + 5 * G_TIME_SPAN_SECOND;       \
+                                                                            \
+  g_mutex_lock (&check_mutex);                                              \
+  while (!(cond))                                                           \
+    fail_unless (g_cond_wait_until (&check_cond, &check_mutex, end_time));  \
+  g_mutex_unlock (&check_mutex);                                            \
+} G_STMT_END
+
 GST_START_TEST (test_get_sockets)
 {
   GstPad *srcpad;
@@ -93,6 +111,141 @@ GST_START_TEST (test_get_sockets)
 
 GST_END_TEST;
 
+static GSocket *
+bind_local_socket (gint * port)
+{
+  GSocket *socket;
+  GInetAddress *inetaddr;
+  GSocketAddress *addr;
+
+  socket = g_socket_new (G_SOCKET_FAMILY_IPV4, G_SOCKET_TYPE_DATAGRAM,
+      G_SOCKET_PROTOCOL_UDP, NULL);
+  fail_unless (socket != NULL);
+
+  inetaddr = g_inet_address_new_loopback (G_SOCKET_FAMILY_IPV4);
+  addr = g_inet_socket_address_new (inetaddr, 0);
+  fail_unless (g_socket_bind (socket, addr, FALSE, NULL));
+  g_object_unref (addr);
+  g_object_unref (inetaddr);
+
+  addr = g_socket_get_local_address (socket, NULL);
+  *port = g_inet_socket_address_get_port (G_INET_SOCKET_ADDRESS (addr));
+  g_object_unref (addr);
+
+  return socket;
+}
+
+static GstPadProbeReturn
+count_udpsrc_buffer (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  gint *count = user_data;
+
+  g_mutex_lock (&check_mutex);
+  (*count)++;
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  return GST_PAD_PROBE_OK;
+}
+
+GST_START_TEST (test_connected_udp)
+{
+  GstPad *srcpad;
+  GstElement *pay;
+  GstRTSPStream *stream;
+  GstBin *bin;
+  GstElement *rtpbin;
+  GSocket *socket;
+
+  srcpad = gst_pad_new ("testsrcpad", GST_PAD_SRC);
+  fail_unless (srcpad != NULL);
+  gst_pad_set_active (srcpad, TRUE);
+  pay = gst_element_factory_make ("rtpgstpay", "testpayloader");
+  fail_unless (pay != NULL);
+  stream = gst_rtsp_stream_new (0, pay, srcpad);
+  fail_unless (stream != NULL);
+  gst_object_unref (pay);
+  gst_object_unref (srcpad);
+  rtpbin = gst_element_factory_make ("rtpbin", "testrtpbin");
+  fail_unless (rtpbin != NULL);
+  bin = GST_BIN (gst_bin_new ("testbin"));
+  fail_unless (bin != NULL);
+  fail_unless (gst_bin_add (bin, rtpbin));
+
+  fail_if (gst_rtsp_stream_get_connected_udp (stream));
+  gst_rtsp_stream_set_connected_udp (stream, TRUE);
+  fail_unless (gst_rtsp_stream_get_connected_udp (stream));
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, bin, rtpbin, GST_STATE_NULL));
+
+  /* the connected sockets need IPv4 and SO_REUSEPORT */
+  socket = gst_rtsp_stream_get_rtcp_socket (stream, G_SOCKET_FAMILY_IPV4);
+#ifdef SO_REUSEPORT
+  if (socket != NULL) {
+    GstRTSPTransport *tr;
+    GstRTSPStreamTransport *trans;
+    GstRTSPRange server_port;
+    GList *children, *l;
+    GSocket *client;
+    GSocketAddress *addr;
+    gint client_port, count = 0, n_children;
+
+    client = bind_local_socket (&client_port);
+    gst_rtsp_stream_get_server_port (stream, &server_port,
+        G_SOCKET_FAMILY_IPV4);
+
+    fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+    tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+    tr->destination = g_strdup ("127.0.0.1");
+    tr->client_port.min = client_port;
+    tr->client_port.max = client_port + 1;
+    trans = gst_rtsp_stream_transport_new (stream, tr);
+
+    /* a udpsrc for RTP and RTCP of the client */
+    children = g_list_copy (bin->children);
+    n_children = bin->numchildren;
+    fail_unless (gst_rtsp_stream_add_transport (stream, trans));
+    fail_unless_equals_int (bin->numchildren, n_children + 2);
+
+    for (l = bin->children; l; l = l->next) {
+      GstPad *pad;
+
+      if (g_list_find (children, l->data))
+        continue;
+
+      pad = gst_element_get_static_pad (l->data, "src");
+      gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_BUFFER, count_udpsrc_buffer,
+          &count, NULL);
+      gst_object_unref (pad);
+    }
+    g_list_free (children);
+
+    /* a packet from the client port arrives on the udpsrc of the client */
+    addr = g_inet_socket_address_new_from_string ("127.0.0.1",
+        server_port.min);
+    fail_unless_equals_int (g_socket_send_to (client, addr, "test", 4, NULL,
+            NULL), 4);
+    g_object_unref (addr);
+
+    WAIT_UNTIL (count > 0);
+
+    fail_unless (gst_rtsp_stream_remove_transport (stream, trans));
+    fail_unless_equals_int (bin->numchildren, n_children);
+    g_object_unref (trans);
+    g_object_unref (client);
+  }
+#endif
+  if (socket)
+    g_object_unref (socket);
+
+  fail_unless (gst_rtsp_stream_leave_bin (stream, bin, rtpbin));
+
+  gst_object_unref (bin);
+  gst_object_unref (stream);
+}
+
+GST_END_TEST;
+
 GST_START_TEST (test_get_multicast_address)
 {
   GstPad *srcpad;
@@ -156,6 +309,1118 @@ GST_START_TEST (test_get_multicast_address)
 
 GST_END_TEST;
 
+static gboolean
+count_send (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  guint *count = user_data;
+
+  fail_unless_equals_int (channel, 2);
+  (*count)++;
+
+  return TRUE;
+}
+
+static gboolean
+count_send_list (GstBufferList * buffer_list, guint8 channel,
+    gpointer user_data)
+{
+  guint *count = user_data;
+
+  fail_unless_equals_int (channel, 2);
+  *count += gst_buffer_list_length (buffer_list);
+
+  return TRUE;
+}
+
+GST_START_TEST (test_send_rtp_list)
+{
+  GstPad *srcpad;
+  GstElement *pay;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *trans;
+  GstBufferList *list;
+  guint i, count = 0, list_count = 0;
+
+  srcpad = gst_pad_new ("testsrcpad", GST_PAD_SRC);
+  fail_unless (srcpad != NULL);
+  gst_pad_set_active (srcpad, TRUE);
+  pay = gst_element_factory_make ("rtpgstpay", "testpayloader");
+  fail_unless (pay != NULL);
+  stream = gst_rtsp_stream_new (0, pay, srcpad);
+  fail_unless (stream != NULL);
+  gst_object_unref (pay);
+  gst_object_unref (srcpad);
+
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  tr->interleaved.min = 2;
+  tr->interleaved.max = 3;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < 5; i++)
+    gst_buffer_list_add (list, gst_buffer_new_allocate (NULL, 100, NULL));
+
+  /* without list callbacks, every buffer goes to the send callback */
+  gst_rtsp_stream_transport_set_callbacks (trans, count_send, count_send,
+      &count, NULL);
+  fail_unless (gst_rtsp_stream_transport_send_rtp_list (trans, list));
+  fail_unless_equals_int (count, 5);
+
+  /* with list callbacks, the list is sent in one go */
+  gst_rtsp_stream_transport_set_list_callbacks (trans, count_send_list,
+      count_send_list, &list_count, NULL);
+  fail_unless (gst_rtsp_stream_transport_send_rtp_list (trans, list));
+  fail_unless_equals_int (list_count, 5);
+  fail_unless_equals_int (count, 5);
+
+  gst_buffer_list_unref (list);
+  g_object_unref (trans);
+  gst_object_unref (stream);
+}
+
+GST_END_TEST;
+
+static gboolean
+fail_send (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  return FALSE;
+}
+
+GST_START_TEST (test_transport_stats)
+{
+  GstPad *srcpad;
+  GstElement *pay;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *trans;
+  GstRTSPStreamTransportStats stats;
+  GstBufferList *list;
+  GstBuffer *buffer;
+  guint i, count = 0;
+
+  srcpad = gst_pad_new ("testsrcpad", GST_PAD_SRC);
+  fail_unless (srcpad != NULL);
+  gst_pad_set_active (srcpad, TRUE);
+  pay = gst_element_factory_make ("rtpgstpay", "testpayloader");
+  fail_unless (pay != NULL);
+  stream = gst_rtsp_stream_new (0, pay, srcpad);
+  fail_unless (stream != NULL);
+  gst_object_unref (pay);
+  gst_object_unref (srcpad);
+
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  tr->interleaved.min = 2;
+  tr->interleaved.max = 3;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+
+  gst_rtsp_stream_transport_get_stats (trans, &stats);
+  fail_unless (stats.transport == trans);
+  fail_unless_equals_int (stats.rtp_packets, 0);
+  fail_unless_equals_int (stats.dropped, 0);
+  fail_if (stats.have_rb);
+
+  gst_rtsp_stream_transport_set_callbacks (trans, count_send, count_send,
+      &count, NULL);
+
+  list = gst_buffer_list_new ();
+  for (i = 0; i < 5; i++)
+    gst_buffer_list_add (list, gst_buffer_new_allocate (NULL, 100, NULL));
+  fail_unless (gst_rtsp_stream_transport_send_rtp_list (trans, list));
+
+  buffer = gst_buffer_new_allocate (NULL, 50, NULL);
+  fail_unless (gst_rtsp_stream_transport_send_rtcp (trans, buffer));
+
+  gst_rtsp_stream_transport_get_stats (trans, &stats);
+  fail_unless_equals_int (stats.rtp_packets, 5);
+  fail_unless_equals_int (stats.rtp_bytes, 500);
+  fail_unless_equals_int (stats.rtcp_packets, 1);
+  fail_unless_equals_int (stats.rtcp_bytes, 50);
+  fail_unless_equals_int (stats.dropped, 0);
+
+  /* failed sends are counted as dropped */
+  gst_rtsp_stream_transport_set_callbacks (trans, fail_send, fail_send,
+      NULL, NULL);
+  fail_if (gst_rtsp_stream_transport_send_rtp_list (trans, list));
+  fail_if (gst_rtsp_stream_transport_send_rtcp (trans, buffer));
+
+  gst_rtsp_stream_transport_get_stats (trans, &stats);
+  fail_unless_equals_int (stats.rtp_packets, 5);
+  fail_unless_equals_int (stats.rtcp_packets, 1);
+  fail_unless_equals_int (stats.dropped, 6);
+
+  gst_buffer_unref (buffer);
+  gst_buffer_list_unref (list);
+  g_object_unref (trans);
+  gst_object_unref (stream);
+}
+
+GST_END_TEST;
+
+/* a stream for the payloader of an appsrc in a new pipeline with an rtpbin,
+ * @mtu is the MTU of the payloader or 0 for the default */
+static GstRTSPStream *
+new_test_stream (guint mtu, GstElement ** pipeline, GstElement ** src,
+    GstElement ** rtpbin)
+{
+  GstElement *appsrc, *pay;
+  GstPad *srcpad;
+  GstCaps *caps;
+  GstRTSPStream *stream;
+
+  *pipeline = gst_pipeline_new ("testpipeline");
+  appsrc = gst_element_factory_make ("appsrc", "testsrc");
+  fail_unless (appsrc != NULL);
+  pay = gst_element_factory_make ("rtpgstpay", "testpayloader");
+  fail_unless (pay != NULL);
+  *rtpbin = gst_element_factory_make ("rtpbin", "testrtpbin");
+  fail_unless (*rtpbin != NULL);
+  gst_bin_add_many (GST_BIN (*pipeline), appsrc, pay, *rtpbin, NULL);
+  fail_unless (gst_element_link (appsrc, pay));
+
+  caps = gst_caps_new_empty_simple ("application/x-test");
+  g_object_set (appsrc, "format", GST_FORMAT_TIME, "caps", caps, NULL);
+  gst_caps_unref (caps);
+  if (mtu != 0)
+    g_object_set (pay, "mtu", mtu, NULL);
+
+  srcpad = gst_element_get_static_pad (pay, "src");
+  stream = gst_rtsp_stream_new (0, pay, srcpad);
+  fail_unless (stream != NULL);
+  gst_object_unref (srcpad);
+
+  if (src)
+    *src = appsrc;
+
+  return stream;
+}
+
+/* stop the pipeline of a stream from new_test_stream() and free both */
+static void
+free_test_stream (GstRTSPStream * stream, GstElement * pipeline,
+    GstElement * rtpbin)
+{
+  fail_if (gst_element_set_state (pipeline, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_FAILURE);
+  fail_unless (gst_rtsp_stream_leave_bin (stream, GST_BIN (pipeline),
+          rtpbin));
+
+  gst_object_unref (pipeline);
+  gst_object_unref (stream);
+}
+
+static gboolean eos;
+
+static GstPadProbeReturn
+notify_eos (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  if (GST_EVENT_TYPE (GST_PAD_PROBE_INFO_EVENT (info)) == GST_EVENT_EOS) {
+    g_mutex_lock (&check_mutex);
+    eos = TRUE;
+    g_cond_broadcast (&check_cond);
+    g_mutex_unlock (&check_mutex);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static gboolean
+collect_seqnum (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  GArray *seqnums = user_data;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint16 seqnum;
+
+  if (channel != 2)
+    return TRUE;
+
+  fail_unless (gst_rtp_buffer_map (buffer, GST_MAP_READ, &rtp));
+  seqnum = gst_rtp_buffer_get_seq (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+  g_array_append_val (seqnums, seqnum);
+
+  return TRUE;
+}
+
+static gboolean
+collect_output_seqnum (GstBuffer ** buffer, guint idx, gpointer user_data)
+{
+  GArray *seqnums = user_data;
+  GstRTPBuffer rtp = GST_RTP_BUFFER_INIT;
+  guint16 seqnum;
+
+  fail_unless (gst_rtp_buffer_map (*buffer, GST_MAP_READ, &rtp));
+  seqnum = gst_rtp_buffer_get_seq (&rtp);
+  gst_rtp_buffer_unmap (&rtp);
+  g_array_append_val (seqnums, seqnum);
+
+  return TRUE;
+}
+
+static GstPadProbeReturn
+collect_output (GstPad * pad, GstPadProbeInfo * info, gpointer user_data)
+{
+  if (info->type & GST_PAD_PROBE_TYPE_BUFFER) {
+    GstBuffer *buffer = GST_PAD_PROBE_INFO_BUFFER (info);
+
+    collect_output_seqnum (&buffer, 0, user_data);
+  } else {
+    gst_buffer_list_foreach (GST_PAD_PROBE_INFO_BUFFER_LIST (info),
+        collect_output_seqnum, user_data);
+  }
+  return GST_PAD_PROBE_OK;
+}
+
+static guint
+get_rtpinfo_seq (GstRTSPStreamTransport * trans)
+{
+  gchar *rtpinfo, *str;
+  guint seq;
+
+  rtpinfo = gst_rtsp_stream_transport_get_rtpinfo (trans, GST_CLOCK_TIME_NONE);
+  fail_unless (rtpinfo != NULL);
+  str = g_strstr_len (rtpinfo, -1, ";seq=");
+  fail_unless (str != NULL);
+  seq = g_ascii_strtoull (str + 5, NULL, 10);
+  g_free (rtpinfo);
+
+  return seq;
+}
+
+/* run the main context until the cached GOP was sent to @trans and it was
+ * added to @stream */
+static void
+wait_transport_added (GstRTSPStream * stream, GstRTSPStreamTransport * trans)
+{
+  GList *transports;
+  gboolean added;
+
+  while (TRUE) {
+    transports = gst_rtsp_stream_transport_filter (stream, NULL, NULL);
+    added = g_list_find (transports, trans) != NULL;
+    g_list_free_full (transports, g_object_unref);
+    if (added)
+      break;
+    g_main_context_iteration (NULL, TRUE);
+  }
+}
+
+GST_START_TEST (test_gop_cache)
+{
+  GstElement *pipeline, *src, *rtpbin;
+  GstPad *pad;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *trans;
+  GstRTSPUrl *url;
+  GstFlowReturn flow;
+  GArray *seqnums, *output;
+  guint i, seq;
+
+  stream = new_test_stream (0, &pipeline, &src, &rtpbin);
+
+  fail_if (gst_rtsp_stream_get_gop_cache (stream));
+  gst_rtsp_stream_set_gop_cache (stream, TRUE);
+  fail_unless (gst_rtsp_stream_get_gop_cache (stream));
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+
+  pad = gst_element_get_static_pad (rtpbin, "send_rtp_src_0");
+  fail_unless (pad != NULL);
+  gst_pad_add_probe (pad, GST_PAD_PROBE_TYPE_EVENT_DOWNSTREAM, notify_eos,
+      NULL, NULL);
+  output = g_array_new (FALSE, FALSE, sizeof (guint16));
+  gst_pad_add_probe (pad,
+      GST_PAD_PROBE_TYPE_BUFFER | GST_PAD_PROBE_TYPE_BUFFER_LIST,
+      collect_output, output, NULL);
+  gst_object_unref (pad);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  /* two GOPs, only the second one should be cached */
+  for (i = 0; i < 5; i++) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+
+    GST_BUFFER_PTS (buffer) = i * 10 * GST_MSECOND;
+    GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+    if (i != 0 && i != 2)
+      GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+    g_signal_emit_by_name (src, "push-buffer", buffer, &flow);
+    fail_unless_equals_int (flow, GST_FLOW_OK);
+    gst_buffer_unref (buffer);
+  }
+  g_signal_emit_by_name (src, "end-of-stream", &flow);
+
+  WAIT_UNTIL (eos);
+
+  /* the three packets of the second GOP are the last ones that were sent */
+  fail_unless (output->len >= 5);
+
+  fail_unless (gst_rtsp_url_parse ("rtsp://localhost/test/stream=0",
+          &url) == GST_RTSP_OK);
+
+  /* multicast transports get no cached packets and no RTP-Info for them */
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP_MCAST;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+  gst_rtsp_stream_transport_set_url (trans, url);
+  fail_if (get_rtpinfo_seq (trans) ==
+      g_array_index (output, guint16, output->len - 3));
+  g_object_unref (trans);
+
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  tr->interleaved.min = 2;
+  tr->interleaved.max = 3;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+  gst_rtsp_stream_transport_set_url (trans, url);
+
+  /* RTP-Info points at the start of the cached GOP */
+  seq = get_rtpinfo_seq (trans);
+  fail_unless_equals_int (seq, g_array_index (output, guint16,
+          output->len - 3));
+
+  seqnums = g_array_new (FALSE, FALSE, sizeof (guint16));
+  gst_rtsp_stream_transport_set_callbacks (trans, collect_seqnum,
+      collect_seqnum, seqnums, NULL);
+
+  /* exactly the cached GOP is sent before the transport is added */
+  fail_unless (gst_rtsp_stream_add_transport (stream, trans));
+  wait_transport_added (stream, trans);
+  fail_unless_equals_int (seqnums->len, 3);
+  for (i = 0; i < seqnums->len; i++)
+    fail_unless_equals_int (g_array_index (seqnums, guint16, i),
+        (guint16) (seq + i));
+
+  fail_unless (gst_rtsp_stream_remove_transport (stream, trans));
+  g_array_free (seqnums, TRUE);
+  g_object_unref (trans);
+  gst_rtsp_url_free (url);
+
+  free_test_stream (stream, pipeline, rtpbin);
+  g_array_free (output, TRUE);
+}
+
+GST_END_TEST;
+
+static gboolean
+collect_memory (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  GPtrArray *memory = user_data;
+
+  /* only RTP, on the even channels */
+  if (channel % 2)
+    return TRUE;
+
+  g_mutex_lock (&check_mutex);
+  g_ptr_array_add (memory, gst_memory_ref (gst_buffer_peek_memory (buffer,
+              0)));
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  return TRUE;
+}
+
+GST_START_TEST (test_shared_memory)
+{
+  GstElement *pipeline, *src, *rtpbin;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *trans[2];
+  GPtrArray *memory[2];
+  GstFlowReturn flow;
+  guint i;
+
+  stream = new_test_stream (0, &pipeline, &src, &rtpbin);
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+
+  for (i = 0; i < 2; i++) {
+    fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+    tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+    tr->interleaved.min = 2 * i;
+    tr->interleaved.max = 2 * i + 1;
+    trans[i] = gst_rtsp_stream_transport_new (stream, tr);
+
+    memory[i] = g_ptr_array_new_with_free_func ((GDestroyNotify)
+        gst_memory_unref);
+    gst_rtsp_stream_transport_set_callbacks (trans[i], collect_memory,
+        collect_memory, memory[i], NULL);
+    fail_unless (gst_rtsp_stream_add_transport (stream, trans[i]));
+  }
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  for (i = 0; i < 5; i++) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+
+    GST_BUFFER_PTS (buffer) = i * 10 * GST_MSECOND;
+    GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+    g_signal_emit_by_name (src, "push-buffer", buffer, &flow);
+    fail_unless_equals_int (flow, GST_FLOW_OK);
+    gst_buffer_unref (buffer);
+  }
+
+  WAIT_UNTIL (memory[0]->len >= 5 && memory[1]->len >= 5);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  /* both transports got the very same memory, nothing was copied */
+  fail_unless_equals_int (memory[0]->len, memory[1]->len);
+  for (i = 0; i < memory[0]->len; i++)
+    fail_unless (g_ptr_array_index (memory[0], i) ==
+        g_ptr_array_index (memory[1], i));
+
+  for (i = 0; i < 2; i++) {
+    fail_unless (gst_rtsp_stream_remove_transport (stream, trans[i]));
+    g_object_unref (trans[i]);
+    g_ptr_array_unref (memory[i]);
+  }
+
+  free_test_stream (stream, pipeline, rtpbin);
+}
+
+GST_END_TEST;
+
+static gboolean
+collect_buffer (GstBuffer * buffer, guint8 channel, gpointer user_data)
+{
+  GPtrArray *buffers = user_data;
+
+  /* only RTP, on the even channels */
+  if (channel % 2)
+    return TRUE;
+
+  g_mutex_lock (&check_mutex);
+  g_ptr_array_add (buffers, gst_buffer_ref (buffer));
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+
+  return TRUE;
+}
+
+static GstCaps *
+make_test_crypto (guint8 fill)
+{
+  GstBuffer *key;
+  GstCaps *caps;
+
+  /* master key and salt for aes-128-icm */
+  key = gst_buffer_new_allocate (NULL, 30, NULL);
+  gst_buffer_memset (key, 0, fill, 30);
+
+  caps = gst_caps_new_simple ("application/x-srtp",
+      "srtp-key", GST_TYPE_BUFFER, key,
+      "srtp-cipher", G_TYPE_STRING, "aes-128-icm",
+      "srtp-auth", G_TYPE_STRING, "hmac-sha1-80",
+      "srtcp-cipher", G_TYPE_STRING, "aes-128-icm",
+      "srtcp-auth", G_TYPE_STRING, "hmac-sha1-80", NULL);
+  gst_buffer_unref (key);
+
+  return caps;
+}
+
+GST_START_TEST (test_transport_crypto)
+{
+  GstElementFactory *factory;
+  GstElement *pipeline, *src, *rtpbin;
+  GstCaps *crypto;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *trans[3];
+  GPtrArray *buffers[3];
+  GstFlowReturn flow;
+  guint i;
+
+  /* needs the srtp plugin */
+  if (!(factory = gst_element_factory_find ("srtpenc")))
+    return;
+  gst_object_unref (factory);
+
+  stream = new_test_stream (0, &pipeline, &src, &rtpbin);
+
+  gst_rtsp_stream_set_profiles (stream,
+      GST_RTSP_PROFILE_AVP | GST_RTSP_PROFILE_SAVP);
+  fail_if (gst_rtsp_stream_get_per_transport_keys (stream));
+  gst_rtsp_stream_set_per_transport_keys (stream, TRUE);
+  fail_unless (gst_rtsp_stream_get_per_transport_keys (stream));
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+
+  /* two transports with their own key and one without */
+  for (i = 0; i < 3; i++) {
+    fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+    tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+    tr->interleaved.min = 2 * i;
+    tr->interleaved.max = 2 * i + 1;
+    trans[i] = gst_rtsp_stream_transport_new (stream, tr);
+
+    fail_unless (gst_rtsp_stream_transport_get_crypto (trans[i]) == NULL);
+    if (i < 2) {
+      crypto = make_test_crypto (i + 1);
+      fail_unless (gst_rtsp_stream_transport_set_crypto (trans[i], crypto));
+      gst_caps_unref (crypto);
+      crypto = gst_rtsp_stream_transport_get_crypto (trans[i]);
+      fail_unless (crypto != NULL);
+      gst_caps_unref (crypto);
+    }
+
+    buffers[i] = g_ptr_array_new_with_free_func ((GDestroyNotify)
+        gst_buffer_unref);
+    gst_rtsp_stream_transport_set_callbacks (trans[i], collect_buffer,
+        collect_buffer, buffers[i], NULL);
+    fail_unless (gst_rtsp_stream_add_transport (stream, trans[i]));
+  }
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  for (i = 0; i < 5; i++) {
+    GstBuffer *buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+
+    gst_buffer_memset (buffer, 0, i, 100);
+    GST_BUFFER_PTS (buffer) = i * 10 * GST_MSECOND;
+    GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+    g_signal_emit_by_name (src, "push-buffer", buffer, &flow);
+    fail_unless_equals_int (flow, GST_FLOW_OK);
+    gst_buffer_unref (buffer);
+  }
+
+  WAIT_UNTIL (buffers[0]->len >= 5 && buffers[1]->len >= 5 &&
+      buffers[2]->len >= 5);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_NULL) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  /* the same packets, with the header in the clear, the payload encrypted
+   * with a different key and an authentication tag of 10 bytes */
+  for (i = 0; i < 5; i++) {
+    GstBuffer *plain = g_ptr_array_index (buffers[2], i);
+    GstMapInfo map[3];
+    guint j;
+
+    for (j = 0; j < 3; j++)
+      fail_unless (gst_buffer_map (g_ptr_array_index (buffers[j], i), &map[j],
+              GST_MAP_READ));
+
+    fail_unless_equals_int (map[0].size, gst_buffer_get_size (plain) + 10);
+    fail_unless_equals_int (map[1].size, gst_buffer_get_size (plain) + 10);
+    fail_unless (memcmp (map[0].data, map[2].data, 12) == 0);
+    fail_unless (memcmp (map[1].data, map[2].data, 12) == 0);
+    fail_if (memcmp (map[0].data + 12, map[2].data + 12, map[2].size - 12) ==
+        0);
+    fail_if (memcmp (map[0].data + 12, map[1].data + 12, map[2].size - 12) ==
+        0);
+
+    for (j = 0; j < 3; j++)
+      gst_buffer_unmap (g_ptr_array_index (buffers[j], i), &map[j]);
+  }
+
+  for (i = 0; i < 3; i++) {
+    fail_unless (gst_rtsp_stream_remove_transport (stream, trans[i]));
+    g_object_unref (trans[i]);
+    g_ptr_array_unref (buffers[i]);
+  }
+
+  free_test_stream (stream, pipeline, rtpbin);
+}
+
+GST_END_TEST;
+
+/* the last byte of the payload of the last packet in @buffers, must be called
+ * with the check_mutex */
+static gint
+get_last_fill (GPtrArray * buffers)
+{
+  GstBuffer *buffer;
+  guint8 fill;
+
+  if (buffers->len == 0)
+    return -1;
+
+  buffer = g_ptr_array_index (buffers, buffers->len - 1);
+  gst_buffer_extract (buffer, gst_buffer_get_size (buffer) - 1, &fill, 1);
+
+  return fill;
+}
+
+static void
+push_fill (GstElement * src, guint8 fill, gboolean keyframe)
+{
+  GstBuffer *buffer = gst_buffer_new_allocate (NULL, 100, NULL);
+  GstFlowReturn flow;
+
+  gst_buffer_memset (buffer, 0, fill, 100);
+  GST_BUFFER_PTS (buffer) = fill * 10 * GST_MSECOND;
+  GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+  if (!keyframe)
+    GST_BUFFER_FLAG_SET (buffer, GST_BUFFER_FLAG_DELTA_UNIT);
+  g_signal_emit_by_name (src, "push-buffer", buffer, &flow);
+  fail_unless_equals_int (flow, GST_FLOW_OK);
+  gst_buffer_unref (buffer);
+}
+
+GST_START_TEST (test_transport_crypto_udp)
+{
+  GstElementFactory *factory;
+  GstElement *pipeline, *src, *rtpbin;
+  GstCaps *crypto;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *plain, *trans;
+  GPtrArray *buffers;
+  GSocket *socket, *client;
+  gint client_port;
+  guint i;
+
+  /* needs the srtp plugin */
+  if (!(factory = gst_element_factory_find ("srtpenc")))
+    return;
+  gst_object_unref (factory);
+
+  stream = new_test_stream (0, &pipeline, &src, &rtpbin);
+
+  gst_rtsp_stream_set_profiles (stream,
+      GST_RTSP_PROFILE_AVP | GST_RTSP_PROFILE_SAVP);
+  gst_rtsp_stream_set_per_transport_keys (stream, TRUE);
+  gst_rtsp_stream_set_gop_cache (stream, TRUE);
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+
+  /* the packets are sent to the UDP client from the IPv4 socket */
+  socket = gst_rtsp_stream_get_rtp_socket (stream, G_SOCKET_FAMILY_IPV4);
+  if (socket == NULL)
+    goto done;
+  g_object_unref (socket);
+
+  /* the packets in the clear, to compare with */
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  tr->interleaved.min = 0;
+  tr->interleaved.max = 1;
+  plain = gst_rtsp_stream_transport_new (stream, tr);
+  buffers = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  gst_rtsp_stream_transport_set_callbacks (plain, collect_buffer,
+      collect_buffer, buffers, NULL);
+  fail_unless (gst_rtsp_stream_add_transport (stream, plain));
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  /* the cached GOP starts with the packet filled with 1 */
+  push_fill (src, 0, TRUE);
+  push_fill (src, 1, TRUE);
+  push_fill (src, 2, FALSE);
+
+  WAIT_UNTIL (get_last_fill (buffers) == 2);
+
+  client = bind_local_socket (&client_port);
+  g_socket_set_timeout (client, 5);
+
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+  tr->destination = g_strdup ("127.0.0.1");
+  tr->client_port.min = client_port;
+  tr->client_port.max = client_port + 1;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+  crypto = make_test_crypto (1);
+  fail_unless (gst_rtsp_stream_transport_set_crypto (trans, crypto));
+  gst_caps_unref (crypto);
+
+  /* the cached GOP and then the live packets, all encrypted */
+  fail_unless (gst_rtsp_stream_add_transport (stream, trans));
+  wait_transport_added (stream, trans);
+  push_fill (src, 3, FALSE);
+  push_fill (src, 4, FALSE);
+
+  WAIT_UNTIL (get_last_fill (buffers) == 4);
+
+  for (i = 1; i < 5; i++) {
+    GstBuffer *buffer = NULL;
+    GstMapInfo map;
+    gchar data[2048];
+    gssize len;
+    guint j;
+
+    len = g_socket_receive (client, data, sizeof (data), NULL, NULL);
+    fail_unless (len > 12);
+
+    /* the header is in the clear */
+    for (j = 0; j < buffers->len && buffer == NULL; j++) {
+      buffer = g_ptr_array_index (buffers, j);
+      if (gst_buffer_memcmp (buffer, 0, data, 12) != 0)
+        buffer = NULL;
+    }
+    fail_unless (buffer != NULL);
+    fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+    fail_unless_equals_int (map.data[map.size - 1], i);
+    fail_unless_equals_int (len, map.size + 10);
+    fail_if (memcmp (data + 12, map.data + 12, map.size - 12) == 0);
+    gst_buffer_unmap (buffer, &map);
+  }
+
+  fail_unless (gst_rtsp_stream_remove_transport (stream, trans));
+  fail_unless (gst_rtsp_stream_remove_transport (stream, plain));
+  g_object_unref (trans);
+  g_object_unref (plain);
+  g_object_unref (client);
+  g_ptr_array_unref (buffers);
+
+done:
+  free_test_stream (stream, pipeline, rtpbin);
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_udp_stats)
+{
+  GstElement *pipeline, *src, *rtpbin;
+  GstBuffer *buffer;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *plain, *trans;
+  GstRTSPStreamTransportStats stats;
+  GPtrArray *buffers;
+  GSocket *socket, *client;
+  GstFlowReturn flow;
+  gint client_port;
+  guint64 bytes = 0;
+  guint i;
+
+  stream = new_test_stream (1000, &pipeline, &src, &rtpbin);
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+
+  socket = gst_rtsp_stream_get_rtp_socket (stream, G_SOCKET_FAMILY_IPV4);
+  if (socket == NULL)
+    goto done;
+  g_object_unref (socket);
+
+  /* the packets as they are sent, to compare with */
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  tr->interleaved.min = 0;
+  tr->interleaved.max = 1;
+  plain = gst_rtsp_stream_transport_new (stream, tr);
+  buffers = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  gst_rtsp_stream_transport_set_callbacks (plain, collect_buffer,
+      collect_buffer, buffers, NULL);
+  fail_unless (gst_rtsp_stream_add_transport (stream, plain));
+
+  client = bind_local_socket (&client_port);
+  g_socket_set_timeout (client, 5);
+
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+  tr->destination = g_strdup ("127.0.0.1");
+  tr->client_port.min = client_port;
+  tr->client_port.max = client_port + 1;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+  fail_unless (gst_rtsp_stream_add_transport (stream, trans));
+
+  gst_rtsp_stream_transport_get_stats (trans, &stats);
+  fail_unless_equals_int (stats.rtp_packets, 0);
+  fail_unless_equals_int (stats.rtp_bytes, 0);
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  buffer = gst_buffer_new_allocate (NULL, 4500, NULL);
+  gst_buffer_memset (buffer, 0, 7, 4500);
+  GST_BUFFER_PTS (buffer) = 0;
+  GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+  g_signal_emit_by_name (src, "push-buffer", buffer, &flow);
+  fail_unless_equals_int (flow, GST_FLOW_OK);
+  gst_buffer_unref (buffer);
+
+  WAIT_UNTIL (get_last_fill (buffers) == 7);
+  fail_unless (buffers->len > 4);
+
+  /* the packets are counted before the udpsink sends them */
+  for (i = 0; i < buffers->len; i++) {
+    gchar data[2048];
+
+    buffer = g_ptr_array_index (buffers, i);
+    fail_unless_equals_int (g_socket_receive (client, data, sizeof (data),
+            NULL, NULL), gst_buffer_get_size (buffer));
+    bytes += gst_buffer_get_size (buffer);
+  }
+
+  gst_rtsp_stream_transport_get_stats (trans, &stats);
+  fail_unless_equals_int (stats.rtp_packets, buffers->len);
+  fail_unless_equals_uint64 (stats.rtp_bytes, bytes);
+  fail_unless_equals_int (stats.dropped, 0);
+
+  /* the counters are kept when the transport is removed */
+  fail_unless (gst_rtsp_stream_remove_transport (stream, trans));
+  gst_rtsp_stream_transport_get_stats (trans, &stats);
+  fail_unless_equals_int (stats.rtp_packets, buffers->len);
+  fail_unless_equals_uint64 (stats.rtp_bytes, bytes);
+
+  g_object_unref (trans);
+  g_object_unref (client);
+  fail_unless (gst_rtsp_stream_remove_transport (stream, plain));
+  g_object_unref (plain);
+  g_ptr_array_unref (buffers);
+
+done:
+  free_test_stream (stream, pipeline, rtpbin);
+}
+
+GST_END_TEST;
+
+static void
+check_udp_fanout (GstRTSPUdpSendMode mode)
+{
+  GstElement *pipeline, *src, *rtpbin;
+  GstBuffer *buffer;
+  GstRTSPStream *stream;
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *plain, *trans[2];
+  GPtrArray *buffers;
+  GSocket *socket, *client[2];
+  GstFlowReturn flow;
+  gint client_port;
+  guint i, j;
+
+  /* a list of packets of the same size, for GSO */
+  stream = new_test_stream (1000, &pipeline, &src, &rtpbin);
+
+  gst_rtsp_stream_set_udp_send_mode (stream, mode);
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+
+  socket = gst_rtsp_stream_get_rtp_socket (stream, G_SOCKET_FAMILY_IPV4);
+  if (socket == NULL)
+    goto done;
+  g_object_unref (socket);
+
+  /* the packets as they are sent, to compare with */
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_TCP;
+  tr->interleaved.min = 0;
+  tr->interleaved.max = 1;
+  plain = gst_rtsp_stream_transport_new (stream, tr);
+  buffers = g_ptr_array_new_with_free_func ((GDestroyNotify) gst_buffer_unref);
+  gst_rtsp_stream_transport_set_callbacks (plain, collect_buffer,
+      collect_buffer, buffers, NULL);
+  fail_unless (gst_rtsp_stream_add_transport (stream, plain));
+
+  for (i = 0; i < 2; i++) {
+    client[i] = bind_local_socket (&client_port);
+    g_socket_set_timeout (client[i], 5);
+
+    fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+    tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+    tr->destination = g_strdup ("127.0.0.1");
+    tr->client_port.min = client_port;
+    tr->client_port.max = client_port + 1;
+    trans[i] = gst_rtsp_stream_transport_new (stream, tr);
+    fail_unless (gst_rtsp_stream_add_transport (stream, trans[i]));
+  }
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  buffer = gst_buffer_new_allocate (NULL, 4500, NULL);
+  gst_buffer_memset (buffer, 0, 7, 4500);
+  GST_BUFFER_PTS (buffer) = 0;
+  GST_BUFFER_DURATION (buffer) = 10 * GST_MSECOND;
+  g_signal_emit_by_name (src, "push-buffer", buffer, &flow);
+  fail_unless_equals_int (flow, GST_FLOW_OK);
+  gst_buffer_unref (buffer);
+
+  WAIT_UNTIL (get_last_fill (buffers) == 7);
+  fail_unless (buffers->len > 4);
+
+  /* every client gets each packet as its own datagram */
+  for (i = 0; i < 2; i++) {
+    guint64 dropped = G_MAXUINT64;
+
+    for (j = 0; j < buffers->len; j++) {
+      GstMapInfo map;
+      gchar data[2048];
+      gssize len;
+
+      len = g_socket_receive (client[i], data, sizeof (data), NULL, NULL);
+      buffer = g_ptr_array_index (buffers, j);
+      fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+      fail_unless_equals_int (len, map.size);
+      fail_unless (memcmp (data, map.data, map.size) == 0);
+      gst_buffer_unmap (buffer, &map);
+    }
+
+    fail_unless (gst_rtsp_stream_get_udp_dropped (stream, trans[i], &dropped,
+            NULL));
+    fail_unless_equals_int (dropped, 0);
+  }
+
+  for (i = 0; i < 2; i++) {
+    fail_unless (gst_rtsp_stream_remove_transport (stream, trans[i]));
+    g_object_unref (trans[i]);
+    g_object_unref (client[i]);
+  }
+  fail_unless (gst_rtsp_stream_remove_transport (stream, plain));
+  g_object_unref (plain);
+  g_ptr_array_unref (buffers);
+
+done:
+  free_test_stream (stream, pipeline, rtpbin);
+}
+
+GST_START_TEST (test_udp_fanout)
+{
+  check_udp_fanout (GST_RTSP_UDP_SEND_MODE_FANOUT);
+  /* falls back to one message per packet without kernel support */
+  check_udp_fanout (GST_RTSP_UDP_SEND_MODE_FANOUT_GSO);
+}
+
+GST_END_TEST;
+
+static void
+count_keep_alive (gpointer user_data)
+{
+  gint *count = user_data;
+
+  g_mutex_lock (&check_mutex);
+  (*count)++;
+  g_cond_broadcast (&check_cond);
+  g_mutex_unlock (&check_mutex);
+}
+
+/* send a receiver report of @ssrc from @socket to @port */
+static void
+send_receiver_report (GSocket * socket, gint port, guint32 ssrc)
+{
+  GstBuffer *buffer;
+  GstRTCPBuffer rtcp = GST_RTCP_BUFFER_INIT;
+  GstRTCPPacket packet;
+  GSocketAddress *addr;
+  GstMapInfo map;
+
+  buffer = gst_rtcp_buffer_new (1000);
+  fail_unless (gst_rtcp_buffer_map (buffer, GST_MAP_READWRITE, &rtcp));
+  fail_unless (gst_rtcp_buffer_add_packet (&rtcp, GST_RTCP_TYPE_RR, &packet));
+  gst_rtcp_packet_rr_set_ssrc (&packet, ssrc);
+  gst_rtcp_buffer_unmap (&rtcp);
+
+  addr = g_inet_socket_address_new_from_string ("127.0.0.1", port);
+  fail_unless (gst_buffer_map (buffer, &map, GST_MAP_READ));
+  fail_unless_equals_int (g_socket_send_to (socket, addr, (gchar *) map.data,
+          map.size, NULL, NULL), map.size);
+  gst_buffer_unmap (buffer, &map);
+  g_object_unref (addr);
+  gst_buffer_unref (buffer);
+}
+
+static GstRTSPStreamTransport *
+new_udp_transport (GstRTSPStream * stream, gint rtp_port, gint rtcp_port,
+    gint * count)
+{
+  GstRTSPTransport *tr;
+  GstRTSPStreamTransport *trans;
+
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+  tr->destination = g_strdup ("127.0.0.1");
+  tr->client_port.min = rtp_port;
+  tr->client_port.max = rtcp_port;
+  trans = gst_rtsp_stream_transport_new (stream, tr);
+  gst_rtsp_stream_transport_set_keepalive (trans, count_keep_alive, count,
+      NULL);
+
+  return trans;
+}
+
+/* RTCP from the client port of a transport keeps that transport alive */
+GST_START_TEST (test_transport_index)
+{
+  GstElement *pipeline, *rtpbin;
+  GstRTSPStream *stream;
+  GstRTSPStreamTransport *trans[3];
+  GstRTSPTransport *tr;
+  GstRTSPRange server_port;
+  GSocket *rtp[3], *rtcp[3];
+  gint rtp_port[3], rtcp_port[3];
+  gint count[3] = { 0, 0, 0 };
+  gint i;
+
+  stream = new_test_stream (0, &pipeline, NULL, &rtpbin);
+
+  fail_unless (gst_rtsp_stream_join_bin (stream, GST_BIN (pipeline), rtpbin,
+          GST_STATE_NULL));
+  gst_rtsp_stream_get_server_port (stream, &server_port, G_SOCKET_FAMILY_IPV4);
+
+  for (i = 0; i < 3; i++) {
+    rtp[i] = bind_local_socket (&rtp_port[i]);
+    rtcp[i] = bind_local_socket (&rtcp_port[i]);
+  }
+
+  fail_if (gst_element_set_state (pipeline, GST_STATE_PLAYING) ==
+      GST_STATE_CHANGE_FAILURE);
+
+  /* lookup: the reports of each client find its transport */
+  for (i = 0; i < 2; i++) {
+    trans[i] = new_udp_transport (stream, rtp_port[i], rtcp_port[i],
+        &count[i]);
+    fail_unless (gst_rtsp_stream_add_transport (stream, trans[i]));
+  }
+  send_receiver_report (rtcp[0], server_port.max, 1);
+  WAIT_UNTIL (count[0] >= 1);
+  send_receiver_report (rtcp[1], server_port.max, 2);
+  WAIT_UNTIL (count[1] >= 1);
+  fail_unless_equals_int (count[0], 1);
+
+  /* removal: a new source from the ports of a removed transport matches
+   * nothing. The reports are handled in order, when the one of the second
+   * client was handled, the one before it was too. */
+  fail_unless (gst_rtsp_stream_remove_transport (stream, trans[0]));
+  g_object_unref (trans[0]);
+  send_receiver_report (rtcp[0], server_port.max, 3);
+  send_receiver_report (rtcp[1], server_port.max, 2);
+  WAIT_UNTIL (count[1] >= 2);
+  fail_unless_equals_int (count[0], 1);
+
+  /* re-SETUP: the second transport moves to the ports of the third client
+   * while it is added, removing it still removes its old ports */
+  fail_unless (gst_rtsp_transport_new (&tr) == GST_RTSP_OK);
+  tr->lower_transport = GST_RTSP_LOWER_TRANS_UDP;
+  tr->destination = g_strdup ("127.0.0.1");
+  tr->client_port.min = rtp_port[2];
+  tr->client_port.max = rtcp_port[2];
+  gst_rtsp_stream_transport_set_transport (trans[1], tr);
+  fail_unless (gst_rtsp_stream_remove_transport (stream, trans[1]));
+  g_object_unref (trans[1]);
+
+  trans[2] = new_udp_transport (stream, rtp_port[2], rtcp_port[2], &count[2]);
+  fail_unless (gst_rtsp_stream_add_transport (stream, trans[2]));
+  send_receiver_report (rtcp[1], server_port.max, 4);
+  send_receiver_report (rtcp[2], server_port.max, 5);
+  WAIT_UNTIL (count[2] >= 1);
+  fail_unless_equals_int (count[1], 2);
+
+  fail_unless (gst_rtsp_stream_remove_transport (stream, trans[2]));
+  g_object_unref (trans[2]);
+
+  free_test_stream (stream, pipeline, rtpbin);
+
+  for (i = 0; i < 3; i++) {
+    g_object_unref (rtp[i]);
+    g_object_unref (rtcp[i]);
+  }
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspstream_suite (void)
 {
@@ -165,6 +1430,16 @@ rtspstream_suite (void)
   suite_add_tcase (s, tc);
   tcase_add_test (tc, test_get_sockets);
   tcase_add_test (tc, test_get_multicast_address);
+  tcase_add_test (tc, test_connected_udp);
+  tcase_add_test (tc, test_send_rtp_list);
+  tcase_add_test (tc, test_transport_stats);
+  tcase_add_test (tc, test_gop_cache);
+  tcase_add_test (tc, test_shared_memory);
+  tcase_add_test (tc, test_transport_crypto);
+  tcase_add_test (tc, test_transport_crypto_udp);
+  tcase_add_test (tc, test_udp_stats);
+  tcase_add_test (tc, test_udp_fanout);
+  tcase_add_test (tc, test_transport_index);
 
   return s;
 }
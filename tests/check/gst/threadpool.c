@@ -215,6 +215,73 @@ GST_START_TEST (test_pool_thread_copy)
 
 GST_END_TEST;
 
+GST_START_TEST (test_pool_least_loaded)
+{
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread1;
+  GstRTSPThread *thread2;
+  GstRTSPThread *thread3;
+  GstRTSPThread *thread4;
+  GstRTSPThread *thread5;
+
+  pool = gst_rtsp_thread_pool_new ();
+  gst_rtsp_thread_pool_set_max_threads (pool, 2);
+
+  thread1 = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  thread2 = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  fail_unless (thread1 != thread2);
+
+  /* equally loaded, the threads are used in turn */
+  thread3 = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  fail_unless (thread3 == thread1);
+  thread4 = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  fail_unless (thread4 == thread2);
+
+  /* the thread with fewer clients is picked, even if it was used last */
+  gst_rtsp_thread_stop (thread4);
+  thread5 = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  fail_unless (thread5 == thread2);
+
+  gst_rtsp_thread_stop (thread1);
+  gst_rtsp_thread_stop (thread2);
+  gst_rtsp_thread_stop (thread3);
+  gst_rtsp_thread_stop (thread5);
+  g_object_unref (pool);
+
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
+GST_START_TEST (test_pool_pin_threads)
+{
+  GstRTSPThreadPool *pool;
+  GstRTSPThread *thread;
+  gboolean pin;
+
+  pool = gst_rtsp_thread_pool_new ();
+  fail_if (gst_rtsp_thread_pool_get_pin_threads (pool));
+
+  g_object_set (pool, "pin-threads", TRUE, NULL);
+  g_object_get (pool, "pin-threads", &pin, NULL);
+  fail_unless (pin);
+
+  thread = gst_rtsp_thread_pool_get_thread (pool, GST_RTSP_THREAD_TYPE_CLIENT,
+      NULL);
+  fail_unless (GST_IS_RTSP_THREAD (thread));
+
+  gst_rtsp_thread_stop (thread);
+  g_object_unref (pool);
+  gst_rtsp_thread_pool_cleanup ();
+}
+
+GST_END_TEST;
+
 static Suite *
 rtspthreadpool_suite (void)
 {
@@ -229,6 +296,8 @@ rtspthreadpool_suite (void)
   tcase_add_test (tc, test_pool_max_threads);
   tcase_add_test (tc, test_pool_max_threads_property);
   tcase_add_test (tc, test_pool_thread_copy);
+  tcase_add_test (tc, test_pool_least_loaded);
+  tcase_add_test (tc, test_pool_pin_threads);
 
   return s;
 }